@@ -0,0 +1,122 @@
+#include "batch_executor.h"
+
+#include <algorithm>
+#include <exception>
+#include <unordered_map>
+#include <unistd.h>
+
+#include "thread_pool.h"
+
+// The constructor
+BatchExecutor::BatchExecutor(const Joiner &joiner, uint64_t memory_limit)
+    : joiner_(joiner),
+      memory_limit_(memory_limit ? memory_limit
+                                 : static_cast<uint64_t>(
+                                     kMemoryFraction * physicalMemory())) {}
+
+// The physical memory of the machine
+uint64_t BatchExecutor::physicalMemory() {
+  auto pages = sysconf(_SC_PHYS_PAGES), page_size = sysconf(_SC_PAGESIZE);
+  if (pages <= 0 || page_size <= 0)
+    return 1ull << 32;
+  return static_cast<uint64_t>(pages) * static_cast<uint64_t>(page_size);
+}
+
+// Wait until a query can run and reserve its memory
+void BatchExecutor::admit(uint64_t memory) {
+  std::unique_lock<std::mutex> lock(mutex_);
+  released_cv_.wait(lock, [&] {
+    return running_ == 0 || reserved_ + memory <= memory_limit_;
+  });
+  reserved_ += memory;
+  ++running_;
+  peak_reserved_ = std::max(peak_reserved_, reserved_);
+  peak_running_ = std::max(peak_running_, running_);
+}
+
+// Release the reservation of a finished query
+void BatchExecutor::release(uint64_t memory) {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    reserved_ -= memory;
+    --running_;
+  }
+  released_cv_.notify_all();
+}
+
+// Run the queries of a batch
+std::vector<std::string> BatchExecutor::run(std::vector<QueryInfo> &queries) {
+  std::vector<std::string> results(queries.size());
+  std::vector<std::exception_ptr> errors(queries.size());
+  std::vector<std::unique_ptr<PlanNode>> plans(queries.size());
+  auto &pool = ThreadPool::global();
+
+  // Answer the cached queries, and the repetitions of a query of the batch
+  // with the result of its first instance
+  auto cache = joiner_.resultCache();
+  std::vector<std::string> keys(cache ? queries.size() : 0);
+  std::vector<unsigned> first(queries.size());
+  std::vector<bool> execute(queries.size(), true);
+  std::unordered_map<std::string, unsigned> instances;
+  for (unsigned i = 0; i < queries.size(); ++i) {
+    first[i] = i;
+    if (!cache)
+      continue;
+    keys[i] = ResultCache::key(queries[i]);
+    auto instance = instances.emplace(keys[i], i);
+    if (!instance.second)
+      first[i] = instance.first->second;
+    execute[i] = instance.second && !cache->find(keys[i], results[i]);
+  }
+
+  pool.parallelFor(queries.size(), 1, [&](uint64_t i, uint64_t) {
+    if (!execute[i])
+      return;
+    try {
+      plans[i] = joiner_.plan(queries[i]);
+    } catch (...) {
+      errors[i] = std::current_exception();
+    }
+  });
+  for (auto &error : errors) {
+    if (error)
+      std::rethrow_exception(error);
+  }
+
+  // Execute the common subplans once
+  BatchPlanner planner(joiner_);
+  if (sharing_) {
+    planner.analyze(plans, queries);
+    planner.execute();
+    sharing_report_ += planner.report();
+  }
+  auto shared = sharing_ ? &planner.inputs() : nullptr;
+
+  // Every query is a task, the morsels of its operators are nested tasks
+  // that idle threads steal. A thread whose query does not fit waits for
+  // running queries to release their memory.
+  pool.parallelFor(queries.size(), 1, [&](uint64_t i, uint64_t) {
+    if (!execute[i])
+      return;
+    uint64_t memory = std::max(joiner_.memoryEstimate(*plans[i], queries[i]),
+                               kMinQueryMemory);
+    admit(memory);
+    try {
+      results[i] = joiner_.join(queries[i], *plans[i], shared);
+    } catch (...) {
+      errors[i] = std::current_exception();
+    }
+    release(memory);
+  });
+  for (auto &error : errors) {
+    if (error)
+      std::rethrow_exception(error);
+  }
+  for (unsigned i = 0; i < queries.size(); ++i) {
+    if (execute[i] && cache)
+      cache->insert(keys[i], results[i]);
+    else if (first[i] != i)
+      results[i] = results[first[i]];
+  }
+  return results;
+}
@@ -0,0 +1,248 @@
+#include "batch_planner.h"
+
+#include <algorithm>
+#include <functional>
+#include <set>
+#include <string>
+#include <unordered_set>
+
+#include "joiner.h"
+#include "thread_pool.h"
+
+namespace {
+
+// The position of a binding among the leaves of a node
+unsigned leafOf(const std::vector<unsigned> &leaves, unsigned binding) {
+  return std::find(leaves.begin(), leaves.end(), binding) - leaves.begin();
+}
+
+}
+
+// The canonical leaf of a binding of the node
+unsigned SharedInput::leaf(unsigned binding) const {
+  return leafOf(bindings, binding);
+}
+
+// Add the savings of another batch
+SharingReport &SharingReport::operator+=(const SharingReport &other) {
+  shared_subplans += other.shared_subplans;
+  consumers += other.consumers;
+  deduplicated_operators += other.deduplicated_operators;
+  deduplicated_tuples += other.deduplicated_tuples;
+  shared_tables += other.shared_tables;
+  deduplicated_builds += other.deduplicated_builds;
+  return *this;
+}
+
+// Compute the signatures of the nodes of a plan
+const BatchPlanner::Signature &BatchPlanner::sign(const PlanNode &node,
+                                                  QueryInfo &query,
+                                                  Signatures &signatures)
+const {
+  Signature signature;
+  std::vector<std::string> parts;
+  if (node.isLeaf()) {
+    // The relation, its filters and the predicates among its columns
+    signature.leaves = {node.binding};
+    signature.text = "r" + std::to_string(query.relation_ids()[node.binding]);
+    for (auto &f : joiner_.filters(node.binding, query)) {
+      parts.push_back(std::to_string(f.filter_column.col_id)
+                          + static_cast<char>(f.comparison)
+                          + std::to_string(f.constant));
+    }
+    for (auto &p : node.predicates) {
+      auto columns = std::minmax(p.left.col_id, p.right.col_id);
+      parts.push_back(std::to_string(columns.first) + "="
+                          + std::to_string(columns.second));
+    }
+    signature.worth_sharing = !parts.empty();
+  } else {
+    // The inputs in join order and the predicates between their leaves
+    auto &left = sign(*node.left, query, signatures);
+    auto &right = sign(*node.right, query, signatures);
+    signature.leaves = left.leaves;
+    signature.leaves.insert(signature.leaves.end(),
+                            right.leaves.begin(),
+                            right.leaves.end());
+    auto column = [&](const SelectInfo &info) {
+      return std::to_string(leafOf(signature.leaves, info.binding)) + "."
+          + std::to_string(info.col_id);
+    };
+    signature.text = "(" + left.text + "," + right.text + ";"
+        + column(node.predicates[0].left) + "="
+        + column(node.predicates[0].right);
+    // The hash join predicate comes first, the order of the others does not
+    // matter
+    for (unsigned p = 1; p < node.predicates.size(); ++p) {
+      auto first = column(node.predicates[p].left);
+      auto second = column(node.predicates[p].right);
+      if (second < first)
+        std::swap(first, second);
+      parts.push_back(first + "=" + second);
+    }
+    signature.worth_sharing = true;
+  }
+  std::sort(parts.begin(), parts.end());
+  for (auto &part : parts)
+    signature.text += "|" + part;
+  if (!node.isLeaf())
+    signature.text += ")";
+  return signatures[&node] = std::move(signature);
+}
+
+// Find the subplans that the plans of a batch share
+void BatchPlanner::analyze(const std::vector<std::unique_ptr<PlanNode>> &plans,
+                           std::vector<QueryInfo> &queries) {
+  Signatures signatures;
+  std::unordered_map<std::string, unsigned> occurrences;
+  for (unsigned q = 0; q < plans.size(); ++q) {
+    if (plans[q])
+      sign(*plans[q], queries[q], signatures);
+  }
+  for (auto &entry : signatures) {
+    if (entry.second.worth_sharing)
+      ++occurrences[entry.second.text];
+  }
+  std::set<std::string> candidates;
+  for (auto &entry : occurrences) {
+    if (entry.second >= 2)
+      candidates.insert(entry.first);
+  }
+  if (candidates.empty())
+    return;
+
+  // Only the first instance of a shared subplan runs its inputs, thus the
+  // inputs' other instances do not count. Drop the candidates that are read
+  // once until all are read at least twice.
+  std::unordered_map<std::string, unsigned> uses;
+  std::unordered_set<std::string> seen;
+  std::function<void(const PlanNode &)> count = [&](const PlanNode &node) {
+    auto &text = signatures[&node].text;
+    if (candidates.count(text)) {
+      ++uses[text];
+      if (!seen.insert(text).second)
+        return;
+    }
+    if (!node.isLeaf()) {
+      count(*node.left);
+      count(*node.right);
+    }
+  };
+  while (true) {
+    uses.clear();
+    seen.clear();
+    for (auto &plan : plans) {
+      if (plan)
+        count(*plan);
+    }
+    auto before = candidates.size();
+    for (auto it = candidates.begin(); it != candidates.end();) {
+      it = uses[*it] < 2 ? candidates.erase(it) : std::next(it);
+    }
+    if (candidates.size() == before)
+      break;
+  }
+  if (candidates.empty())
+    return;
+
+  // Collect the instances of the shared subplans and the hash tables that
+  // are built on them
+  std::unordered_map<std::string, SharedSubplan *> subplans;
+  std::function<void(const PlanNode &, QueryInfo &)> collect =
+      [&](const PlanNode &node, QueryInfo &query) {
+    auto &signature = signatures[&node];
+    if (candidates.count(signature.text)) {
+      auto &subplan = subplans[signature.text];
+      bool first = !subplan;
+      if (first) {
+        subplans_.push_back(std::make_unique<SharedSubplan>());
+        subplan = subplans_.back().get();
+        subplan->signature = signature.text;
+        subplan->plan = &node;
+        subplan->query = &query;
+        subplan->bindings = signature.leaves;
+      }
+      ++subplan->uses;
+      inputs_[&node] = SharedInput{subplan, signature.leaves};
+      if (!first)
+        return;
+    }
+    if (node.isLeaf())
+      return;
+    collect(*node.left, query);
+    collect(*node.right, query);
+    auto shared = inputs_.find(node.left.get());
+    if (shared != inputs_.end() && joiner_.buildsHashTable(node, query)) {
+      auto &key = node.predicates[0].left;
+      auto subplan = subplans[signatures[node.left.get()].text];
+      ++subplan->builds[{shared->second.leaf(key.binding), key.col_id}];
+    }
+  };
+  for (unsigned q = 0; q < plans.size(); ++q) {
+    if (plans[q])
+      collect(*plans[q], queries[q]);
+  }
+}
+
+// Execute the shared subplans
+void BatchPlanner::execute() {
+  // The inputs of a subplan have fewer leaves than the subplan
+  std::stable_sort(subplans_.begin(), subplans_.end(),
+                   [](const auto &a, const auto &b) {
+    return a->bindings.size() < b->bindings.size();
+  });
+  for (unsigned begin = 0, end; begin < subplans_.size(); begin = end) {
+    end = begin + 1;
+    while (end < subplans_.size()
+        && subplans_[end]->bindings.size() == subplans_[begin]->bindings.size())
+      ++end;
+    ThreadPool::global().parallelFor(end - begin, 1,
+                                     [&](uint64_t i, uint64_t) {
+      auto &subplan = *subplans_[begin + i];
+      auto &query = *subplan.query;
+      subplan.root = joiner_.addPlan(*subplan.plan, query, &inputs_);
+      for (auto binding : subplan.bindings)
+        subplan.root->require(
+            SelectInfo(query.relation_ids()[binding], binding, 0));
+      subplan.root->run();
+      subplan.size = subplan.root->result_size();
+      for (auto binding : subplan.bindings)
+        subplan.columns.push_back(subplan.root->rowIds(binding));
+
+      // The hash tables that more than one join builds
+      for (auto &build : subplan.builds) {
+        if (build.second < 2)
+          continue;
+        auto &column = subplan.columns[build.first.first];
+        std::vector<uint64_t> keys(subplan.size);
+        ThreadPool::global().parallelFor(subplan.size,
+                                         [&](uint64_t begin, uint64_t end) {
+          for (auto t = begin; t != end; ++t)
+            keys[t] = column.value(build.first.second, t);
+        });
+        auto table = std::make_shared<Join::HT>();
+#ifdef USE_STD_HASH_TABLE
+        table->reserve(subplan.size * 2);
+        for (uint64_t t = 0; t != subplan.size; ++t)
+          table->emplace(keys[t], t);
+#else
+        table->build(keys.data(), subplan.size);
+#endif
+        subplan.tables[build.first] = std::move(table);
+      }
+    });
+  }
+
+  report_ = SharingReport();
+  for (auto &subplan : subplans_) {
+    auto reads = subplan->uses - 1;
+    ++report_.shared_subplans;
+    report_.consumers += subplan->uses;
+    report_.deduplicated_operators += reads * (2 * subplan->bindings.size() - 1);
+    report_.deduplicated_tuples += reads * subplan->size;
+    for (auto &table : subplan->tables) {
+      ++report_.shared_tables;
+      report_.deduplicated_builds += subplan->builds[table.first] - 1;
+    }
+  }
+}
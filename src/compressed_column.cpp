@@ -0,0 +1,252 @@
+#include "compressed_column.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include "filter_kernel.h"
+
+namespace {
+
+// The number of bits of a value
+inline unsigned bitsFor(uint64_t value) {
+  return value ? 64 - __builtin_clzll(value) : 0;
+}
+
+// Store a word of the mask
+inline void storeWord(uint64_t *mask, uint64_t w, uint64_t word,
+                      bool combine) {
+  mask[w] = combine ? mask[w] & word : word;
+}
+
+// The number of bits that a code of the given bits occupies in memory: a
+// fixed width of 8, 16 or 32 bits unless bit-packing needs at most half of it
+inline unsigned storedBits(unsigned bits) {
+  for (unsigned width : {8u, 16u, 32u}) {
+    if (bits <= width)
+      return 2 * bits <= width ? bits : width;
+  }
+  return bits;
+}
+
+}
+
+// Compress a column
+bool CompressedColumn::compress(const uint64_t *column,
+                                uint64_t size,
+                                uint64_t min,
+                                uint64_t max,
+                                double distinct) {
+  size_ = size;
+  min_ = min;
+  max_ = max;
+  encoding_ = Encoding::FrameOfReference;
+  bits_ = bitsFor(max - min);
+  dictionary_.clear();
+
+  // A dictionary pays off if there are much fewer values than the range,
+  // the dictionary itself is part of its memory
+  if (distinct <= kMaxDictionarySize
+      && bitsFor(static_cast<uint64_t>(distinct)) < bits_) {
+    std::vector<uint64_t> values(column, column + size);
+    std::sort(values.begin(), values.end());
+    values.erase(std::unique(values.begin(), values.end()), values.end());
+    auto dictionary_bits = bitsFor(values.size() - 1);
+    auto dictionary_memory = values.size() * 64
+        + size * storedBits(dictionary_bits);
+    if (values.size() <= kMaxDictionarySize
+        && dictionary_memory < size * storedBits(bits_)) {
+      encoding_ = Encoding::Dictionary;
+      bits_ = dictionary_bits;
+      dictionary_ = std::move(values);
+    }
+  }
+  if (bits_ > kMaxBits)
+    return false;
+  encode(column);
+  return true;
+}
+
+// The code of a value that occurs in the column
+uint64_t CompressedColumn::code(uint64_t value) const {
+  if (encoding_ == Encoding::FrameOfReference)
+    return value - min_;
+  return std::lower_bound(dictionary_.begin(), dictionary_.end(), value)
+      - dictionary_.begin();
+}
+
+// Store the code of every value
+void CompressedColumn::encode(const uint64_t *column) {
+  codes8_.clear();
+  codes16_.clear();
+  codes32_.clear();
+  packed_.clear();
+  auto width = storedBits(bits_);
+  if (width == 8 || width == 16 || width == 32) {
+    for (uint64_t i = 0; i < size_; ++i) {
+      auto c = code(column[i]);
+      if (width == 8)
+        codes8_.push_back(c);
+      else if (width == 16)
+        codes16_.push_back(c);
+      else
+        codes32_.push_back(c);
+    }
+    return;
+  }
+
+  // One more word, so that a code never straddles the end
+  packed_.assign((size_ * bits_ + 63) / 64 + 1, 0);
+  if (bits_ == 0)
+    return;
+  for (uint64_t i = 0; i < size_; ++i) {
+    auto c = code(column[i]);
+    auto bit = i * bits_;
+    auto word = bit / 64, offset = bit % 64;
+    packed_[word] |= c << offset;
+    if (offset + bits_ > 64)
+      packed_[word + 1] |= c >> (64 - offset);
+  }
+}
+
+// The memory used by the codes and the dictionary in bytes
+uint64_t CompressedColumn::memory() const {
+  return dictionary_.size() * sizeof(uint64_t) + codes8_.size()
+      + codes16_.size() * sizeof(uint16_t) + codes32_.size() * sizeof(uint32_t)
+      + packed_.size() * sizeof(uint64_t);
+}
+
+// The codes of the values in [low, high]
+bool CompressedColumn::codeRange(uint64_t low,
+                                 uint64_t high,
+                                 uint64_t &code_low,
+                                 uint64_t &code_high) const {
+  if (low > high || high < min_ || low > max_ || size_ == 0)
+    return false;
+  if (encoding_ == Encoding::FrameOfReference) {
+    code_low = std::max(low, min_) - min_;
+    code_high = std::min(high, max_) - min_;
+    return true;
+  }
+  auto begin = std::lower_bound(dictionary_.begin(), dictionary_.end(), low);
+  auto end = std::upper_bound(begin, dictionary_.end(), high);
+  if (begin == end)
+    return false;
+  code_low = begin - dictionary_.begin();
+  code_high = end - dictionary_.begin() - 1;
+  return true;
+}
+
+// Evaluate a code range on the values [begin, begin + size)
+void CompressedColumn::evaluate(uint64_t begin,
+                                uint64_t size,
+                                uint64_t code_low,
+                                uint64_t code_high,
+                                uint64_t *mask,
+                                bool combine) const {
+  if (!codes8_.empty())
+    return FilterKernel::evaluateRange(codes8_.data() + begin, size, code_low,
+                                       code_high, mask, combine);
+  if (!codes16_.empty())
+    return FilterKernel::evaluateRange(codes16_.data() + begin, size,
+                                       code_low, code_high, mask, combine);
+  if (!codes32_.empty())
+    return FilterKernel::evaluateRange(codes32_.data() + begin, size,
+                                       code_low, code_high, mask, combine);
+  auto width = code_high - code_low;
+  for (uint64_t w = 0; w * 64 < size; ++w) {
+    auto first = begin + w * 64;
+    auto count = std::min<uint64_t>(64, size - w * 64);
+    uint64_t word = 0;
+    for (uint64_t i = 0; i < count; ++i)
+      word |= uint64_t(packedCode(first + i) - code_low <= width) << i;
+    storeWord(mask, w, word, combine);
+  }
+}
+
+// Decode the i-th value
+uint64_t CompressedColumn::value(uint64_t i) const {
+  uint64_t c = !codes8_.empty() ? codes8_[i]
+                                : !codes16_.empty() ? codes16_[i]
+                                  : !codes32_.empty() ? codes32_[i]
+                                    : packedCode(i);
+  return encoding_ == Encoding::FrameOfReference ? min_ + c : dictionary_[c];
+}
+
+// Decode the values [begin, begin + size)
+void CompressedColumn::decode(uint64_t begin,
+                              uint64_t size,
+                              uint64_t *out) const {
+  for (uint64_t i = 0; i < size; ++i)
+    out[i] = value(begin + i);
+}
+
+// Append the column to words
+void CompressedColumn::serialize(std::vector<uint64_t> &words) const {
+  words.insert(words.end(), {static_cast<uint64_t>(encoding_), bits_, width(),
+                             min_, max_, size_, dictionary_.size()});
+  words.insert(words.end(), dictionary_.begin(), dictionary_.end());
+  const void *codes = nullptr;
+  if (!codes8_.empty())
+    codes = codes8_.data();
+  else if (!codes16_.empty())
+    codes = codes16_.data();
+  else if (!codes32_.empty())
+    codes = codes32_.data();
+  if (codes) {
+    auto offset = words.size();
+    auto bytes = size_ * width() / 8;
+    words.resize(offset + (bytes + 7) / 8, 0);
+    std::memcpy(words.data() + offset, codes, bytes);
+  } else {
+    words.push_back(packed_.size());
+    words.insert(words.end(), packed_.begin(), packed_.end());
+  }
+}
+
+// Read a serialized column
+const uint64_t *CompressedColumn::deserialize(const uint64_t *words,
+                                              const uint64_t *end) {
+  if (end - words < 7)
+    return nullptr;
+  encoding_ = static_cast<Encoding>(words[0]);
+  bits_ = words[1];
+  auto width = words[2];
+  min_ = words[3];
+  max_ = words[4];
+  size_ = words[5];
+  auto dictionary_size = words[6];
+  words += 7;
+  if (bits_ > kMaxBits || uint64_t(end - words) < dictionary_size)
+    return nullptr;
+  dictionary_.assign(words, words + dictionary_size);
+  words += dictionary_size;
+
+  codes8_.clear();
+  codes16_.clear();
+  codes32_.clear();
+  packed_.clear();
+  if (width == 8 || width == 16 || width == 32) {
+    auto bytes = size_ * width / 8;
+    if (uint64_t(end - words) < (bytes + 7) / 8)
+      return nullptr;
+    void *codes;
+    if (width == 8) {
+      codes8_.resize(size_);
+      codes = codes8_.data();
+    } else if (width == 16) {
+      codes16_.resize(size_);
+      codes = codes16_.data();
+    } else {
+      codes32_.resize(size_);
+      codes = codes32_.data();
+    }
+    std::memcpy(codes, words, bytes);
+    return words + (bytes + 7) / 8;
+  }
+  if (width != bits_ || end == words
+      || uint64_t(end - words - 1) < words[0]
+      || words[0] != (size_ * bits_ + 63) / 64 + 1)
+    return nullptr;
+  packed_.assign(words + 1, words + 1 + words[0]);
+  return words + 1 + words[0];
+}
@@ -0,0 +1,386 @@
+#include "filter_kernel.h"
+
+#include <algorithm>
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
+
+namespace {
+
+using Comparison = FilterInfo::Comparison;
+
+/// Signature of the kernels
+using EvaluateFn = void (*)(const uint64_t *, uint64_t, Comparison, uint64_t,
+                            uint64_t *, bool);
+
+// Store a word of the mask
+inline void storeWord(uint64_t *mask, uint64_t w, uint64_t word,
+                      bool combine) {
+  mask[w] = combine ? mask[w] & word : word;
+}
+
+// Compare up to 64 values
+template<Comparison C>
+inline uint64_t compareWord(const uint64_t *column,
+                            uint64_t size,
+                            uint64_t constant) {
+  uint64_t word = 0;
+  for (uint64_t i = 0; i < size; ++i) {
+    bool pass = C == Comparison::Less ? column[i] < constant
+                                      : C == Comparison::Greater
+                                        ? column[i] > constant
+                                        : column[i] == constant;
+    word |= uint64_t(pass) << i;
+  }
+  return word;
+}
+
+template<Comparison C>
+void evaluateScalar(const uint64_t *column, uint64_t size, uint64_t constant,
+                    uint64_t *mask, bool combine) {
+  for (uint64_t w = 0; w * 64 < size; ++w) {
+    auto word = compareWord<C>(column + w * 64,
+                               std::min<uint64_t>(64, size - w * 64),
+                               constant);
+    storeWord(mask, w, word, combine);
+  }
+}
+
+void scalarKernel(const uint64_t *column, uint64_t size, Comparison comparison,
+                  uint64_t constant, uint64_t *mask, bool combine) {
+  switch (comparison) {
+    case Comparison::Less:
+      return evaluateScalar<Comparison::Less>(column, size, constant, mask,
+                                              combine);
+    case Comparison::Greater:
+      return evaluateScalar<Comparison::Greater>(column, size, constant, mask,
+                                                 combine);
+    case Comparison::Equal:
+      return evaluateScalar<Comparison::Equal>(column, size, constant, mask,
+                                               combine);
+  }
+}
+
+// Compare up to 64 codes with `code - low <= range` (in the codes' width)
+template<typename Code>
+inline uint64_t compareCodeWord(const Code *codes,
+                                uint64_t size,
+                                Code low,
+                                Code range) {
+  uint64_t word = 0;
+  for (uint64_t i = 0; i < size; ++i)
+    word |= uint64_t(static_cast<Code>(codes[i] - low) <= range) << i;
+  return word;
+}
+
+#if defined(__x86_64__)
+
+// AVX2 only compares signed 64-bit integers, so unsigned values are compared
+// with flipped sign bits
+template<Comparison C>
+__attribute__((target("avx2")))
+void evaluateAVX2(const uint64_t *column, uint64_t size, uint64_t constant,
+                  uint64_t *mask, bool combine) {
+  const __m256i sign = _mm256_set1_epi64x(INT64_MIN);
+  const __m256i value = _mm256_set1_epi64x(constant);
+  const __m256i signed_value = _mm256_xor_si256(value, sign);
+  uint64_t full_words = size / 64;
+  for (uint64_t w = 0; w < full_words; ++w) {
+    auto values = column + w * 64;
+    uint64_t word = 0;
+    for (unsigned j = 0; j < 64; j += 4) {
+      auto v = _mm256_loadu_si256(
+          reinterpret_cast<const __m256i *>(values + j));
+      __m256i result;
+      if (C == Comparison::Equal) {
+        result = _mm256_cmpeq_epi64(v, value);
+      } else if (C == Comparison::Less) {
+        result = _mm256_cmpgt_epi64(signed_value, _mm256_xor_si256(v, sign));
+      } else {
+        result = _mm256_cmpgt_epi64(_mm256_xor_si256(v, sign), signed_value);
+      }
+      word |= uint64_t(_mm256_movemask_pd(_mm256_castsi256_pd(result))) << j;
+    }
+    storeWord(mask, w, word, combine);
+  }
+  if (size % 64) {
+    auto word = compareWord<C>(column + full_words * 64, size % 64, constant);
+    storeWord(mask, full_words, word, combine);
+  }
+}
+
+__attribute__((target("avx2")))
+void avx2Kernel(const uint64_t *column, uint64_t size, Comparison comparison,
+                uint64_t constant, uint64_t *mask, bool combine) {
+  switch (comparison) {
+    case Comparison::Less:
+      return evaluateAVX2<Comparison::Less>(column, size, constant, mask,
+                                            combine);
+    case Comparison::Greater:
+      return evaluateAVX2<Comparison::Greater>(column, size, constant, mask,
+                                               combine);
+    case Comparison::Equal:
+      return evaluateAVX2<Comparison::Equal>(column, size, constant, mask,
+                                             combine);
+  }
+}
+
+template<Comparison C>
+__attribute__((target("avx512f")))
+void evaluateAVX512(const uint64_t *column, uint64_t size, uint64_t constant,
+                    uint64_t *mask, bool combine) {
+  const __m512i value = _mm512_set1_epi64(constant);
+  uint64_t full_words = size / 64;
+  for (uint64_t w = 0; w < full_words; ++w) {
+    auto values = column + w * 64;
+    uint64_t word = 0;
+    for (unsigned j = 0; j < 64; j += 8) {
+      auto v = _mm512_loadu_si512(values + j);
+      __mmask8 result;
+      if (C == Comparison::Equal) {
+        result = _mm512_cmp_epu64_mask(v, value, _MM_CMPINT_EQ);
+      } else if (C == Comparison::Less) {
+        result = _mm512_cmp_epu64_mask(v, value, _MM_CMPINT_LT);
+      } else {
+        result = _mm512_cmp_epu64_mask(v, value, _MM_CMPINT_NLE);
+      }
+      word |= uint64_t(result) << j;
+    }
+    storeWord(mask, w, word, combine);
+  }
+  if (size % 64) {
+    auto word = compareWord<C>(column + full_words * 64, size % 64, constant);
+    storeWord(mask, full_words, word, combine);
+  }
+}
+
+__attribute__((target("avx512f")))
+void avx512Kernel(const uint64_t *column, uint64_t size, Comparison comparison,
+                  uint64_t constant, uint64_t *mask, bool combine) {
+  switch (comparison) {
+    case Comparison::Less:
+      return evaluateAVX512<Comparison::Less>(column, size, constant, mask,
+                                              combine);
+    case Comparison::Greater:
+      return evaluateAVX512<Comparison::Greater>(column, size, constant, mask,
+                                                 combine);
+    case Comparison::Equal:
+      return evaluateAVX512<Comparison::Equal>(column, size, constant, mask,
+                                               combine);
+  }
+}
+
+// Compare 64 codes with `code - low <= range`. Unsigned `a <= b` is
+// evaluated as `min(a, b) == a`.
+__attribute__((target("avx2")))
+inline uint64_t compareCodeWordAVX2(const uint8_t *codes, __m256i low,
+                                    __m256i range) {
+  uint64_t word = 0;
+  for (unsigned j = 0; j < 64; j += 32) {
+    auto v = _mm256_sub_epi8(
+        _mm256_loadu_si256(reinterpret_cast<const __m256i *>(codes + j)), low);
+    auto pass = _mm256_cmpeq_epi8(_mm256_min_epu8(v, range), v);
+    word |= uint64_t(uint32_t(_mm256_movemask_epi8(pass))) << j;
+  }
+  return word;
+}
+
+__attribute__((target("avx2")))
+inline uint64_t compareCodeWordAVX2(const uint16_t *codes, __m256i low,
+                                    __m256i range) {
+  uint64_t word = 0;
+  for (unsigned j = 0; j < 64; j += 32) {
+    __m256i pass[2];
+    for (unsigned k = 0; k < 2; ++k) {
+      auto v = _mm256_sub_epi16(_mm256_loadu_si256(
+          reinterpret_cast<const __m256i *>(codes + j + 16 * k)), low);
+      pass[k] = _mm256_cmpeq_epi16(_mm256_min_epu16(v, range), v);
+    }
+    // Narrow to bytes, packing interleaves the 128-bit lanes
+    auto bytes = _mm256_permute4x64_epi64(
+        _mm256_packs_epi16(pass[0], pass[1]), 0xD8);
+    word |= uint64_t(uint32_t(_mm256_movemask_epi8(bytes))) << j;
+  }
+  return word;
+}
+
+__attribute__((target("avx2")))
+inline uint64_t compareCodeWordAVX2(const uint32_t *codes, __m256i low,
+                                    __m256i range) {
+  uint64_t word = 0;
+  for (unsigned j = 0; j < 64; j += 8) {
+    auto v = _mm256_sub_epi32(
+        _mm256_loadu_si256(reinterpret_cast<const __m256i *>(codes + j)), low);
+    auto pass = _mm256_cmpeq_epi32(_mm256_min_epu32(v, range), v);
+    word |= uint64_t(_mm256_movemask_ps(_mm256_castsi256_ps(pass))) << j;
+  }
+  return word;
+}
+
+// Broadcast a code to every lane of its width
+__attribute__((target("avx2")))
+inline __m256i broadcastCode(uint8_t code) { return _mm256_set1_epi8(code); }
+__attribute__((target("avx2")))
+inline __m256i broadcastCode(uint16_t code) {
+  return _mm256_set1_epi16(code);
+}
+__attribute__((target("avx2")))
+inline __m256i broadcastCode(uint32_t code) {
+  return _mm256_set1_epi32(code);
+}
+
+template<typename Code>
+__attribute__((target("avx2")))
+void evaluateRangeAVX2(const Code *codes, uint64_t size, Code low, Code range,
+                       uint64_t *mask, bool combine) {
+  auto low_vector = broadcastCode(low);
+  auto range_vector = broadcastCode(range);
+  uint64_t full_words = size / 64;
+  for (uint64_t w = 0; w < full_words; ++w) {
+    auto word = compareCodeWordAVX2(codes + w * 64, low_vector, range_vector);
+    storeWord(mask, w, word, combine);
+  }
+  if (size % 64) {
+    auto word = compareCodeWord(codes + full_words * 64, size % 64, low,
+                                range);
+    storeWord(mask, full_words, word, combine);
+  }
+}
+
+#endif
+
+// Evaluate `low <= code <= high` on fixed-width codes with the kernel in use
+template<typename Code>
+void evaluateCodes(const Code *codes, uint64_t size, uint64_t low,
+                   uint64_t high, uint64_t *mask, bool combine) {
+  auto code_low = static_cast<Code>(low);
+  auto range = static_cast<Code>(high - low);
+#if defined(__x86_64__)
+  if (FilterKernel::selected() != FilterKernel::Scalar)
+    return evaluateRangeAVX2(codes, size, code_low, range, mask, combine);
+#endif
+  for (uint64_t w = 0; w * 64 < size; ++w) {
+    auto word = compareCodeWord(codes + w * 64,
+                                std::min<uint64_t>(64, size - w * 64),
+                                code_low, range);
+    storeWord(mask, w, word, combine);
+  }
+}
+
+// The best kernel of this CPU
+FilterKernel::Kind detectKernel() {
+#if defined(__x86_64__)
+  // Runs before the static constructors that set up CPU detection
+  __builtin_cpu_init();
+#endif
+  if (FilterKernel::supported(FilterKernel::AVX512))
+    return FilterKernel::AVX512;
+  if (FilterKernel::supported(FilterKernel::AVX2))
+    return FilterKernel::AVX2;
+  return FilterKernel::Scalar;
+}
+
+// The function of a kernel
+EvaluateFn kernelFn(FilterKernel::Kind kind) {
+  switch (kind) {
+#if defined(__x86_64__)
+    case FilterKernel::AVX512:return avx512Kernel;
+    case FilterKernel::AVX2:return avx2Kernel;
+#endif
+    default:return scalarKernel;
+  }
+}
+
+/// The kernel in use
+FilterKernel::Kind selected_kind = detectKernel();
+EvaluateFn selected_fn = kernelFn(selected_kind);
+
+}
+
+// Whether the CPU supports a kernel
+bool FilterKernel::supported(Kind kind) {
+  switch (kind) {
+#if defined(__x86_64__)
+    case AVX512:return __builtin_cpu_supports("avx512f");
+    case AVX2:return __builtin_cpu_supports("avx2");
+#endif
+    case Scalar:return true;
+    default:return false;
+  }
+}
+
+// The best kernel supported by the CPU
+FilterKernel::Kind FilterKernel::best() {
+  return detectKernel();
+}
+
+// The kernel in use
+FilterKernel::Kind FilterKernel::selected() {
+  return selected_kind;
+}
+
+// Use another kernel
+void FilterKernel::select(Kind kind) {
+  selected_kind = supported(kind) ? kind : Scalar;
+  selected_fn = kernelFn(selected_kind);
+}
+
+// The name of a kernel
+const char *FilterKernel::name(Kind kind) {
+  switch (kind) {
+    case AVX512:return "avx512";
+    case AVX2:return "avx2";
+    default:return "scalar";
+  }
+}
+
+// Evaluate a comparison into a bitmask
+void FilterKernel::evaluate(const uint64_t *column,
+                            uint64_t size,
+                            FilterInfo::Comparison comparison,
+                            uint64_t constant,
+                            uint64_t *mask,
+                            bool combine) {
+  selected_fn(column, size, comparison, constant, mask, combine);
+}
+
+// Evaluate a range on fixed-width codes into a bitmask
+void FilterKernel::evaluateRange(const uint8_t *codes, uint64_t size,
+                                 uint64_t low, uint64_t high, uint64_t *mask,
+                                 bool combine) {
+  evaluateCodes(codes, size, low, high, mask, combine);
+}
+
+void FilterKernel::evaluateRange(const uint16_t *codes, uint64_t size,
+                                 uint64_t low, uint64_t high, uint64_t *mask,
+                                 bool combine) {
+  evaluateCodes(codes, size, low, high, mask, combine);
+}
+
+void FilterKernel::evaluateRange(const uint32_t *codes, uint64_t size,
+                                 uint64_t low, uint64_t high, uint64_t *mask,
+                                 bool combine) {
+  evaluateCodes(codes, size, low, high, mask, combine);
+}
+
+// Turn a bitmask into a selection vector
+void FilterKernel::toSelection(const uint64_t *mask,
+                               uint64_t size,
+                               uint64_t offset,
+                               std::vector<uint64_t> &ids) {
+  for (uint64_t w = 0; w * 64 < size; ++w) {
+    auto word = mask[w];
+    auto base = offset + w * 64;
+    if (word == ~0ull) {
+      // All tuples of the word qualify
+      for (unsigned j = 0; j < 64; ++j)
+        ids.push_back(base + j);
+      continue;
+    }
+    while (word) {
+      ids.push_back(base + __builtin_ctzll(word));
+      word &= word - 1;
+    }
+  }
+}
@@ -0,0 +1,223 @@
+#include "hash_table.h"
+
+#include <algorithm>
+
+#include "thread_pool.h"
+
+// Build the table
+void HashTable::build(const uint64_t *keys,
+                      const uint64_t *values,
+                      uint64_t size,
+                      uint64_t expected_keys) {
+  // Size the slots once: a power of two with at least 50% empty slots
+  auto capacity = expected_keys ? std::min(size, expected_keys) : size;
+  unsigned log_capacity = 1;
+  while ((1ull << log_capacity) < 2 * capacity)
+    ++log_capacity;
+  shift_ = 64 - log_capacity;
+  slots_.assign(1ull << log_capacity, Slot{0, 0, 0});
+  num_keys_ = 0;
+
+  // Count the values per key, the count is kept in `end`
+  std::vector<uint64_t> positions(size);
+  for (uint64_t i = 0; i < size; ++i) {
+    auto pos = findSlot(keys[i]);
+    auto &slot = slots_[pos];
+    if (slot.begin == slot.end) {
+      slot.key = keys[i];
+      // More keys than expected, size the slots for all tuples instead
+      if (2 * ++num_keys_ > slots_.size())
+        return build(keys, values, size);
+    }
+    ++slot.end;
+    positions[i] = pos;
+  }
+
+  // Assign each key a consecutive range of the value array
+  uint64_t offset = 0;
+  for (auto &slot : slots_) {
+    auto count = slot.end;
+    slot.begin = slot.end = offset;
+    offset += count;
+  }
+
+  // Scatter the values into their ranges
+  values_.resize(size);
+  for (uint64_t i = 0; i < size; ++i) {
+    auto &slot = slots_[positions[i]];
+    values_[slot.end++] = values ? values[i] : i;
+  }
+}
+
+// Sum the values of every key
+void HashTable::sumValues() {
+  // The ranges are assigned in slot order, thus the sums move to the front
+  uint64_t offset = 0;
+  for (auto &slot : slots_) {
+    if (slot.begin == slot.end) {
+      slot.begin = slot.end = 0;
+      continue;
+    }
+    uint64_t sum = 0;
+    for (auto i = slot.begin; i != slot.end; ++i)
+      sum += values_[i];
+    values_[offset] = sum;
+    slot.begin = offset;
+    slot.end = ++offset;
+  }
+  values_.resize(offset);
+}
+
+// Number the keys
+std::vector<uint64_t> HashTable::groupValues() {
+  std::vector<uint64_t> groups(values_.size());
+  uint64_t group = 0;
+  for (auto &slot : slots_) {
+    if (slot.begin == slot.end) {
+      slot.begin = slot.end = 0;
+      continue;
+    }
+    for (auto i = slot.begin; i != slot.end; ++i)
+      groups[values_[i]] = group;
+    values_[group] = group;
+    slot.begin = group;
+    slot.end = ++group;
+  }
+  values_.resize(group);
+  return groups;
+}
+
+namespace {
+
+// Scatter the tuples [begin, end) into the same range of the output, grouped
+// by the hash bits [shift, shift + bits). Appends the partition offsets.
+void partitionRange(const uint64_t *keys, const uint64_t *ids,
+                    uint64_t begin, uint64_t end,
+                    unsigned shift, unsigned bits,
+                    uint64_t *out_keys, uint64_t *out_ids,
+                    std::vector<uint64_t> &offsets) {
+  uint64_t mask = (1ull << bits) - 1;
+  std::vector<uint64_t> cursors(mask + 1, 0);
+  for (uint64_t i = begin; i < end; ++i)
+    ++cursors[(partitionHash(keys[i]) >> shift) & mask];
+
+  uint64_t pos = begin;
+  for (auto &cursor : cursors) {
+    offsets.push_back(pos);
+    auto count = cursor;
+    cursor = pos;
+    pos += count;
+  }
+
+  for (uint64_t i = begin; i < end; ++i) {
+    auto target = cursors[(partitionHash(keys[i]) >> shift) & mask]++;
+    out_keys[target] = keys[i];
+    out_ids[target] = ids ? ids[i] : i;
+  }
+}
+
+// Partition the tuples (keys[i], i) on the lowest `bits` hash bits. Every
+// morsel computes its histogram and scatters its tuples in parallel.
+Partitions partitionParallel(const uint64_t *keys,
+                             uint64_t size,
+                             unsigned bits) {
+  auto &pool = ThreadPool::global();
+  uint64_t fanout = 1ull << bits, mask = fanout - 1;
+  auto num_morsels = ThreadPool::numMorsels(size);
+
+  // Histogram of every morsel
+  std::vector<std::vector<uint64_t>> cursors(num_morsels);
+  pool.parallelFor(size, [&](uint64_t begin, uint64_t end) {
+    auto &histogram = cursors[begin / ThreadPool::kMorselSize];
+    histogram.assign(fanout, 0);
+    for (uint64_t i = begin; i < end; ++i)
+      ++histogram[partitionHash(keys[i]) & mask];
+  });
+
+  // Prefix sums: partitions in order, morsels in order within a partition
+  Partitions result;
+  uint64_t pos = 0;
+  for (uint64_t p = 0; p < fanout; ++p) {
+    result.offsets.push_back(pos);
+    for (auto &histogram : cursors) {
+      auto count = histogram[p];
+      histogram[p] = pos;
+      pos += count;
+    }
+  }
+  result.offsets.push_back(size);
+
+  // Scatter
+  result.keys.resize(size);
+  result.ids.resize(size);
+  pool.parallelFor(size, [&](uint64_t begin, uint64_t end) {
+    auto &cursor = cursors[begin / ThreadPool::kMorselSize];
+    for (uint64_t i = begin; i < end; ++i) {
+      auto target = cursor[partitionHash(keys[i]) & mask]++;
+      result.keys[target] = keys[i];
+      result.ids[target] = i;
+    }
+  });
+  return result;
+}
+
+}
+
+// Partition tuples (keys[i], i) on `bits` hash bits in one or two passes
+Partitions radixPartition(const uint64_t *keys, uint64_t size, unsigned bits) {
+  unsigned first_bits = std::min(bits, kMaxRadixBitsPerPass);
+  auto first = partitionParallel(keys, size, first_bits);
+  if (first_bits == bits)
+    return first;
+
+  // Second pass: split every partition of the first pass again
+  Partitions second;
+  second.keys.resize(size);
+  second.ids.resize(size);
+  auto num_partitions = first.offsets.size() - 1;
+  std::vector<std::vector<uint64_t>> offsets(num_partitions);
+  ThreadPool::global().parallelFor(num_partitions, 1,
+                                   [&](uint64_t p, uint64_t) {
+    partitionRange(first.keys.data(), first.ids.data(),
+                   first.offsets[p], first.offsets[p + 1],
+                   first_bits, bits - first_bits,
+                   second.keys.data(), second.ids.data(), offsets[p]);
+  });
+  for (auto &partition_offsets : offsets) {
+    second.offsets.insert(second.offsets.end(),
+                          partition_offsets.begin(),
+                          partition_offsets.end());
+  }
+  second.offsets.push_back(size);
+  return second;
+}
+
+// Build the table
+void PartitionedHashTable::build(const uint64_t *keys, uint64_t size) {
+  auto &pool = ThreadPool::global();
+  // Partitioning only pays off if other threads help, not if all of them
+  // run queries of their own
+  if (pool.num_threads() == 1 || pool.idle_threads() == 0
+      || size < kMinParallelBuildSize) {
+    mask_ = 0;
+    tables_.resize(1);
+    tables_[0].build(keys, nullptr, size);
+    return;
+  }
+
+  // Enough partitions to balance the load over the threads
+  unsigned bits = 0;
+  while ((1u << bits) < 4 * pool.num_threads()
+      && bits < kMaxRadixBitsPerPass)
+    ++bits;
+  mask_ = (1ull << bits) - 1;
+
+  auto partitions = partitionParallel(keys, size, bits);
+  tables_.resize(mask_ + 1);
+  pool.parallelFor(tables_.size(), 1, [&](uint64_t p, uint64_t) {
+    auto begin = partitions.offsets[p];
+    tables_[p].build(partitions.keys.data() + begin,
+                     partitions.ids.data() + begin,
+                     partitions.offsets[p + 1] - begin);
+  });
+}
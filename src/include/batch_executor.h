@@ -0,0 +1,80 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "batch_planner.h"
+#include "joiner.h"
+#include "parser.h"
+
+/// Runs the queries of a batch concurrently on the global thread pool and
+/// returns their results in the order of the batch. Every query is a task
+/// of the pool and the morsels of its operators are nested tasks, thus
+/// threads that are done with their queries steal the morsels of the
+/// queries that are behind. A query is admitted only while the estimated
+/// memory of the running queries stays within a limit; a query that exceeds
+/// the limit on its own runs when no other query does. Before the queries
+/// run, the subplans that several of them contain are executed once (see
+/// BatchPlanner); their results are kept until the batch is done and do not
+/// count against the limit. If the joiner caches results, cached queries
+/// and repetitions of a query within the batch are not executed.
+class BatchExecutor {
+ public:
+  /// The default memory limit relative to the physical memory
+  static constexpr double kMemoryFraction = 0.5;
+  /// The memory reserved for a query at least (its operators' state), so
+  /// that queries without hash tables count against the limit as well
+  static constexpr uint64_t kMinQueryMemory = 1ull << 16;
+
+ private:
+  /// The joiner that runs the queries
+  const Joiner &joiner_;
+  /// The memory that the running queries may reserve in bytes
+  uint64_t memory_limit_;
+  /// Protects the reservations
+  std::mutex mutex_;
+  /// Signals that a query finished
+  std::condition_variable released_cv_;
+  /// The memory reserved by the running queries and their number
+  uint64_t reserved_ = 0;
+  unsigned running_ = 0;
+  /// The most memory reserved at once and the most queries run at once
+  uint64_t peak_reserved_ = 0;
+  unsigned peak_running_ = 0;
+  /// Whether common subplans of a batch are executed once
+  bool sharing_ = true;
+  /// What sharing saved in all batches
+  SharingReport sharing_report_;
+
+  /// Wait until a query with the given estimate can run and reserve it
+  void admit(uint64_t memory);
+  /// Release the reservation of a finished query
+  void release(uint64_t memory);
+
+ public:
+  /// The constructor (a limit of 0 uses kMemoryFraction of the physical
+  /// memory)
+  explicit BatchExecutor(const Joiner &joiner, uint64_t memory_limit = 0);
+
+  /// Run the queries of a batch, the i-th result belongs to the i-th query.
+  /// Rethrows the exception of the first query that failed.
+  std::vector<std::string> run(std::vector<QueryInfo> &queries);
+
+  /// Switch sharing common subplans on or off
+  void setSharing(bool sharing) { sharing_ = sharing; }
+  /// What sharing saved in all batches
+  const SharingReport &sharing_report() const { return sharing_report_; }
+
+  /// The memory that the running queries may reserve in bytes
+  uint64_t memory_limit() const { return memory_limit_; }
+  /// The most memory reserved at once in bytes
+  uint64_t peak_reserved() const { return peak_reserved_; }
+  /// The most queries run at once
+  unsigned peak_running() const { return peak_running_; }
+
+  /// The physical memory of the machine in bytes
+  static uint64_t physicalMemory();
+};
@@ -0,0 +1,137 @@
+#pragma once
+
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "operators.h"
+#include "parser.h"
+#include "planner.h"
+
+class Joiner;
+
+/// A subplan that several plans of a batch contain: the same filtered scan
+/// or the same join subtree (with the same build sides) of the same
+/// relations. It is executed once and its result is read by all of them.
+struct SharedSubplan {
+  /// The join column (canonical leaf and column id) of a hash table
+  using Key = std::pair<unsigned, unsigned>;
+
+  /// The canonical description of the subplan
+  std::string signature;
+  /// The first instance of the subplan and its query, which is executed
+  const PlanNode *plan = nullptr;
+  QueryInfo *query = nullptr;
+  /// The bindings of the first instance's leaves in canonical order (left
+  /// subtree first)
+  std::vector<unsigned> bindings;
+  /// The number of plans that read the result
+  unsigned uses = 0;
+  /// The number of joins that would build a hash table on each join column
+  /// of the result
+  std::map<Key, unsigned> builds;
+
+  /// The operators of the first instance (which own the row ids)
+  std::unique_ptr<Operator> root;
+  /// The row ids of the result in canonical order of the leaves
+  std::vector<RowIdColumn> columns;
+  /// The size of the result
+  uint64_t size = 0;
+  /// The hash tables on the join columns that several joins build on
+  std::map<Key, std::shared_ptr<const Join::HT>> tables;
+
+  /// The hash table on a join column (nullptr if not built)
+  std::shared_ptr<const Join::HT> table(Key key) const {
+    auto it = tables.find(key);
+    return it == tables.end() ? nullptr : it->second;
+  }
+};
+
+/// A plan node that reads a shared subplan
+struct SharedInput {
+  /// The subplan
+  const SharedSubplan *subplan;
+  /// The bindings of the node's leaves in canonical order
+  std::vector<unsigned> bindings;
+
+  /// The canonical leaf of a binding of the node
+  unsigned leaf(unsigned binding) const;
+};
+
+/// The plan nodes of a batch that read shared subplans
+using SharedInputs = std::unordered_map<const PlanNode *, SharedInput>;
+
+/// What sharing subplans saved in a batch
+struct SharingReport {
+  /// The subplans that were executed once and the plan nodes that read them
+  uint64_t shared_subplans = 0, consumers = 0;
+  /// The operators (scans and joins) that did not run since their result
+  /// was shared
+  uint64_t deduplicated_operators = 0;
+  /// The tuples that these operators would have produced
+  uint64_t deduplicated_tuples = 0;
+  /// The hash tables that were built once for several joins and the builds
+  /// that this saved
+  uint64_t shared_tables = 0, deduplicated_builds = 0;
+
+  /// Add the savings of another batch
+  SharingReport &operator+=(const SharingReport &other);
+};
+
+/// Finds the common subexpressions of the plans of a batch and executes them
+/// once. Every node gets a signature of its relations, filters, predicates
+/// and join order that is independent of the bindings in its query; nodes
+/// with the same signature produce the same tuples. A subplan is shared if
+/// it is read at least twice after all reads within other shared subplans
+/// (except for the first one, which is executed) are discounted. Hash tables
+/// on a shared result are built once if several joins build on the same
+/// column.
+class BatchPlanner {
+ private:
+  /// The joiner that executes the subplans
+  const Joiner &joiner_;
+  /// The shared subplans
+  std::vector<std::unique_ptr<SharedSubplan>> subplans_;
+  /// The plan nodes that read them
+  SharedInputs inputs_;
+  /// What sharing saved
+  SharingReport report_;
+
+  /// The signature of a plan node
+  struct Signature {
+    /// The canonical description of the subtree
+    std::string text;
+    /// The bindings of the leaves in canonical order
+    std::vector<unsigned> leaves;
+    /// Whether executing the subtree costs anything (not a plain scan)
+    bool worth_sharing;
+  };
+  using Signatures = std::unordered_map<const PlanNode *, Signature>;
+
+  /// Compute the signatures of the nodes of a plan
+  const Signature &sign(const PlanNode &node,
+                        QueryInfo &query,
+                        Signatures &signatures) const;
+
+ public:
+  /// The constructor
+  explicit BatchPlanner(const Joiner &joiner) : joiner_(joiner) {}
+
+  /// Find the subplans that the plans of a batch share. plans[i] is a plan
+  /// of queries[i] (nullptr if the query is not executed), both have to
+  /// outlive the planner.
+  void analyze(const std::vector<std::unique_ptr<PlanNode>> &plans,
+               std::vector<QueryInfo> &queries);
+  /// Execute the shared subplans (smaller ones first, those of the same
+  /// size in parallel) and build their shared hash tables
+  void execute();
+
+  /// The plan nodes that read shared subplans
+  const SharedInputs &inputs() const { return inputs_; }
+  /// What sharing saved
+  const SharingReport &report() const { return report_; }
+};
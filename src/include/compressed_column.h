@@ -0,0 +1,105 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+/// A compressed copy of a column that scans evaluate filters on. Every value
+/// is replaced by a code: its difference to the column's minimum (frame of
+/// reference) or its position in the sorted distinct values (dictionary),
+/// whichever needs fewer bits. Both keep the order of the values, thus a
+/// range of values is a range of codes and filters never decode. The codes
+/// are stored with a fixed width of 8, 16 or 32 bits, which the SIMD filter
+/// kernels compare 32 bytes at a time, unless bit-packing needs at most half
+/// of that width.
+class CompressedColumn {
+ public:
+  /// How values are mapped to codes
+  enum class Encoding { FrameOfReference, Dictionary };
+  /// Columns with more distinct values are not dictionary encoded
+  static constexpr uint64_t kMaxDictionarySize = 1ull << 16;
+  /// Codes of more bits are not worth compressing
+  static constexpr unsigned kMaxBits = 48;
+
+ private:
+  /// The number of values
+  uint64_t size_ = 0;
+  /// The encoding
+  Encoding encoding_ = Encoding::FrameOfReference;
+  /// The number of bits of a code
+  unsigned bits_ = 0;
+  /// The smallest and the largest value
+  uint64_t min_ = 0, max_ = 0;
+  /// The distinct values in order (dictionary encoding only)
+  std::vector<uint64_t> dictionary_;
+  /// The codes, only the vector of the chosen width is filled
+  std::vector<uint8_t> codes8_;
+  std::vector<uint16_t> codes16_;
+  std::vector<uint32_t> codes32_;
+  /// Bit-packed codes (code i starts at bit i * bits_)
+  std::vector<uint64_t> packed_;
+
+ private:
+  /// Store the code of every value
+  void encode(const uint64_t *column);
+  /// The code of a value that occurs in the column
+  uint64_t code(uint64_t value) const;
+  /// The i-th bit-packed code
+  uint64_t packedCode(uint64_t i) const {
+    auto bit = i * bits_;
+    auto word = bit / 64, offset = bit % 64;
+    auto code = packed_[word] >> offset;
+    if (offset + bits_ > 64)
+      code |= packed_[word + 1] << (64 - offset);
+    return bits_ == 64 ? code : code & ((1ull << bits_) - 1);
+  }
+
+ public:
+  /// Compress a column with the given bounds. The dictionary is only tried
+  /// if the (estimated) number of distinct values is small enough. Returns
+  /// false if the column does not compress.
+  bool compress(const uint64_t *column,
+                uint64_t size,
+                uint64_t min,
+                uint64_t max,
+                double distinct);
+
+  /// The number of values
+  uint64_t size() const { return size_; }
+  /// The encoding
+  Encoding encoding() const { return encoding_; }
+  /// The number of bits of a code
+  unsigned bits() const { return bits_; }
+  /// The number of bits that a code occupies in memory
+  unsigned width() const {
+    return !codes8_.empty() ? 8 : !codes16_.empty() ? 16
+                                  : !codes32_.empty() ? 32 : bits_;
+  }
+  /// The memory used by the codes and the dictionary in bytes
+  uint64_t memory() const;
+
+  /// The codes of the values in [low, high] are [code_low, code_high].
+  /// Returns false if no value of the column is in the range.
+  bool codeRange(uint64_t low,
+                 uint64_t high,
+                 uint64_t &code_low,
+                 uint64_t &code_high) const;
+  /// Evaluate `code_low <= code(i) <= code_high` for the values
+  /// [begin, begin + size) into a bitmask like FilterKernel::evaluate. The
+  /// result is ANDed into mask if combine is set.
+  void evaluate(uint64_t begin,
+                uint64_t size,
+                uint64_t code_low,
+                uint64_t code_high,
+                uint64_t *mask,
+                bool combine) const;
+  /// Decode the i-th value
+  uint64_t value(uint64_t i) const;
+  /// Decode the values [begin, begin + size)
+  void decode(uint64_t begin, uint64_t size, uint64_t *out) const;
+
+  /// Append the column to words (to persist it)
+  void serialize(std::vector<uint64_t> &words) const;
+  /// Read a column that was serialized to [words, end). Returns the word
+  /// after it or nullptr if the words do not hold a valid column.
+  const uint64_t *deserialize(const uint64_t *words, const uint64_t *end);
+};
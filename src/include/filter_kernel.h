@@ -0,0 +1,51 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "parser.h"
+
+/// Kernels that evaluate a comparison over a 64-bit column into a bitmask
+/// (bit i of word i / 64 is set if tuple i qualifies). Every instruction set
+/// has its own kernel, the best one supported by the CPU is picked at
+/// runtime.
+class FilterKernel {
+ public:
+  enum Kind : unsigned { Scalar, AVX2, AVX512 };
+
+  /// Whether the CPU supports a kernel
+  static bool supported(Kind kind);
+  /// The best kernel supported by the CPU
+  static Kind best();
+  /// The kernel in use
+  static Kind selected();
+  /// Use another kernel (e.g., to compare them)
+  static void select(Kind kind);
+  /// The name of a kernel
+  static const char *name(Kind kind);
+
+  /// Evaluate `column[i] <comparison> constant` for i < size. The result is
+  /// ANDed into mask if combine is set, otherwise it overwrites mask.
+  static void evaluate(const uint64_t *column,
+                       uint64_t size,
+                       FilterInfo::Comparison comparison,
+                       uint64_t constant,
+                       uint64_t *mask,
+                       bool combine);
+  /// Evaluate `low <= codes[i] <= high` for i < size on the fixed-width
+  /// codes of a compressed column. The AVX kernels share an AVX2
+  /// implementation that compares 32 bytes of codes at once.
+  static void evaluateRange(const uint8_t *codes, uint64_t size, uint64_t low,
+                            uint64_t high, uint64_t *mask, bool combine);
+  static void evaluateRange(const uint16_t *codes, uint64_t size,
+                            uint64_t low, uint64_t high, uint64_t *mask,
+                            bool combine);
+  static void evaluateRange(const uint32_t *codes, uint64_t size,
+                            uint64_t low, uint64_t high, uint64_t *mask,
+                            bool combine);
+  /// Append offset + i to ids for every bit i < size that is set in mask
+  static void toSelection(const uint64_t *mask,
+                          uint64_t size,
+                          uint64_t offset,
+                          std::vector<uint64_t> &ids);
+};
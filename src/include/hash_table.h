@@ -0,0 +1,150 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+/// A flat multimap from 64-bit keys to 64-bit values (usually tuple ids).
+/// Distinct keys are stored in a linear-probing slot array. The values of
+/// each key are stored contiguously in one value array, so a probe touches
+/// one slot and one consecutive range of values. The table is built once
+/// from all keys and never rehashes.
+class HashTable {
+ public:
+  /// The values that belong to one key
+  class Range {
+   private:
+    const uint64_t *begin_, *end_;
+
+   public:
+    /// The constructor
+    Range(const uint64_t *begin, const uint64_t *end)
+        : begin_(begin), end_(end) {};
+
+    const uint64_t *begin() const { return begin_; }
+    const uint64_t *end() const { return end_; }
+    /// The number of values
+    uint64_t size() const { return end_ - begin_; }
+    bool empty() const { return begin_ == end_; }
+  };
+
+ private:
+  struct Slot {
+    /// The key
+    uint64_t key;
+    /// The range of the key's values (begin == end if the slot is empty)
+    uint64_t begin, end;
+  };
+
+  /// The slots (power of two, at least twice the number of keys)
+  std::vector<Slot> slots_;
+  /// The values grouped by key
+  std::vector<uint64_t> values_;
+  /// Shift to map a hash to a slot
+  unsigned shift_ = 63;
+  /// The number of distinct keys
+  uint64_t num_keys_ = 0;
+
+ private:
+  /// Hash a key to its home slot
+  uint64_t home(uint64_t key) const {
+    return (key * 0x9E3779B97F4A7C15ull) >> shift_;
+  }
+  /// Find the slot of a key (or the empty slot where it belongs)
+  uint64_t findSlot(uint64_t key) const {
+    auto mask = slots_.size() - 1;
+    auto pos = home(key);
+    while (slots_[pos].begin != slots_[pos].end && slots_[pos].key != key)
+      pos = (pos + 1) & mask;
+    return pos;
+  }
+
+ public:
+  /// Build the table over keys[i] -> values[i] for i < size.
+  /// If values is nullptr, the value of keys[i] is i. The slots are sized
+  /// for expected_keys distinct keys if given (e.g., from statistics).
+  void build(const uint64_t *keys,
+             const uint64_t *values,
+             uint64_t size,
+             uint64_t expected_keys = 0);
+
+  /// Replace the values of every key by their sum (modulo 2^64), which
+  /// find() then returns as the key's only value
+  void sumValues();
+  /// Number the keys 0, 1, ... and replace the values of every key by its
+  /// number, which find() then returns as the key's only value. The values
+  /// have to be 0, ..., size() - 1 (as if built without values). Returns
+  /// the number of the key of every former value.
+  std::vector<uint64_t> groupValues();
+
+  /// Find all values of a key
+  Range find(uint64_t key) const {
+    auto &slot = slots_[findSlot(key)];
+    return Range(values_.data() + slot.begin, values_.data() + slot.end);
+  }
+
+  /// The number of values
+  uint64_t size() const { return values_.size(); }
+  /// The number of distinct keys
+  uint64_t num_keys() const { return num_keys_; }
+  /// The memory used by the table in bytes
+  uint64_t memory() const {
+    return slots_.size() * sizeof(Slot) + values_.size() * sizeof(uint64_t);
+  }
+};
+
+/// The maximum fan-out (in bits) of one radix partitioning pass
+static constexpr unsigned kMaxRadixBitsPerPass = 8;
+
+/// Hash a key to its partition (independent of the HashTable slot hash)
+inline uint64_t partitionHash(uint64_t key) {
+  key ^= key >> 33;
+  key *= 0xFF51AFD7ED558CCDull;
+  return key ^ (key >> 33);
+}
+
+/// Fold the value of a further key column into a composite key
+inline uint64_t compositeKey(uint64_t key, uint64_t value) {
+  return partitionHash(key ^ (value * 0x9E3779B97F4A7C15ull));
+}
+
+/// Tuples (key, tuple id) grouped by partition
+struct Partitions {
+  /// The keys and tuple ids
+  std::vector<uint64_t> keys, ids;
+  /// The begin of each partition and the end of the last one
+  std::vector<uint64_t> offsets;
+};
+
+/// Partition the tuples (keys[i], i) on `bits` hash bits in one or two
+/// passes. Runs on the global thread pool.
+Partitions radixPartition(const uint64_t *keys, uint64_t size, unsigned bits);
+
+/// A HashTable split into hash partitions that are built in parallel
+class PartitionedHashTable {
+ public:
+  /// Build sides below this size (or while no thread of the pool is idle)
+  /// are built as a single partition
+  static constexpr uint64_t kMinParallelBuildSize = 1ull << 14;
+
+ private:
+  /// The table of every partition
+  std::vector<HashTable> tables_;
+  /// Mask to map a partition hash to its table
+  uint64_t mask_ = 0;
+
+ public:
+  /// Build the table over keys[i] -> i for i < size
+  void build(const uint64_t *keys, uint64_t size);
+
+  /// Find all values of a key
+  HashTable::Range find(uint64_t key) const {
+    return tables_[mask_ ? partitionHash(key) & mask_ : 0].find(key);
+  }
+  /// The memory used by the tables in bytes
+  uint64_t memory() const {
+    uint64_t memory = 0;
+    for (auto &table : tables_)
+      memory += table.memory();
+    return memory;
+  }
+};
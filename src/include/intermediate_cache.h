@@ -0,0 +1,145 @@
+#pragma once
+
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "operators.h"
+#include "parser.h"
+
+/// A memory-bounded cache of intermediate results that the queries of all
+/// batches share: the row ids of the tuples of a relation that pass a set
+/// of filters (selections) and hash tables on a join column of such tuples.
+/// A lookup hits if the filters of an entry are equivalent to the requested
+/// ones, or if they are weaker (the entry subsumes the request) and the
+/// caller applies the residual filters to its tuples. Entries are evicted
+/// in least recently used order once the budget is exceeded; queries that
+/// still use an evicted entry keep it alive. Most filters and build sides
+/// are used once, and materializing them costs more than a pipelined scan,
+/// thus an entry is only worth adding for a key that missed before (see
+/// admit()). The cache is thread-safe.
+class IntermediateCache {
+ public:
+  /// The number of recent misses that admit() remembers
+  static constexpr unsigned kMissHistory = 1024;
+  /// The column of the key of a selection in admit()
+  static constexpr unsigned kSelection = ~0u;
+
+  /// The row ids of the tuples of a relation that pass filters
+  struct Selection {
+    /// The relation and the filters (whose bindings do not matter)
+    unsigned rel_id;
+    std::vector<FilterInfo> filters;
+    /// The row ids in ascending order
+    std::vector<uint64_t> ids;
+  };
+  /// A hash table from the values of a join column to the positions of the
+  /// tuples of a selection
+  struct Table {
+    /// The relation, the column and the filters of the selection
+    unsigned rel_id, col_id;
+    std::vector<FilterInfo> filters;
+    /// The selection (nullptr if the table contains every tuple)
+    std::shared_ptr<const Selection> selection;
+    /// The table
+    Join::HT table;
+
+    /// The number of tuples in the table
+    uint64_t size(const Relation &relation) const {
+      return selection ? selection->ids.size() : relation.size();
+    }
+  };
+  /// The lookups of one kind of entry
+  struct Counters {
+    /// Lookups with equivalent filters, with weaker filters and without
+    /// entry
+    uint64_t hits = 0, subsumed_hits = 0, misses = 0;
+    /// The entries that were added and evicted
+    uint64_t insertions = 0, evictions = 0;
+  };
+
+ private:
+  /// A cached selection or table
+  struct Entry {
+    std::shared_ptr<const Selection> selection;
+    std::shared_ptr<const Table> table;
+    /// The memory of the entry in bytes
+    uint64_t memory;
+  };
+
+  /// The most memory that the entries may use in bytes
+  uint64_t budget_;
+  /// The memory used by the entries in bytes
+  uint64_t memory_ = 0;
+  /// Protects the entries and the counters
+  mutable std::mutex mutex_;
+  /// The entries, the least recently used first
+  std::list<Entry> entries_;
+  /// The lookups of selections and tables
+  Counters selection_counters_, table_counters_;
+  /// A key that missed: the relation, the column of a table (kSelection for
+  /// a selection) and the filters
+  struct Miss {
+    unsigned rel_id, col_id;
+    std::vector<FilterInfo> filters;
+  };
+  /// The last kMissHistory misses, the oldest first
+  std::list<Miss> misses_;
+
+  /// Add an entry and evict the least recently used ones that exceed the
+  /// budget
+  void insert(Entry &&entry, Counters &counters);
+
+ public:
+  /// The constructor
+  explicit IntermediateCache(uint64_t budget) : budget_(budget) {}
+
+  /// Find the selection of a relation with filters equivalent to the given
+  /// ones, else the smallest one with weaker filters. residual gets the
+  /// filters that its tuples still have to pass (empty on an exact hit).
+  std::shared_ptr<const Selection> findSelection(
+      unsigned rel_id,
+      const std::vector<FilterInfo> &filters,
+      std::vector<FilterInfo> &residual);
+  /// Add a selection (returns the cached one if an equivalent one was added
+  /// in the meantime)
+  std::shared_ptr<const Selection> addSelection(Selection &&selection);
+  /// Find the table on a column of a relation with filters equivalent to
+  /// the given ones, else the smallest one with weaker filters that has at
+  /// most max_size tuples. residual gets the filters that its tuples still
+  /// have to pass (empty on an exact hit).
+  std::shared_ptr<const Table> findTable(unsigned rel_id,
+                                         unsigned col_id,
+                                         const std::vector<FilterInfo> &filters,
+                                         uint64_t max_size,
+                                         const Relation &relation,
+                                         std::vector<FilterInfo> &residual);
+  /// Add a table (returns the cached one if an equivalent one was added in
+  /// the meantime)
+  std::shared_ptr<const Table> addTable(Table &&table);
+  /// Whether the entry of a key that missed should be added: the key of a
+  /// selection (col_id = kSelection) or table missed before, within the
+  /// last kMissHistory misses. Otherwise the miss is remembered.
+  bool admit(unsigned rel_id,
+             unsigned col_id,
+             const std::vector<FilterInfo> &filters);
+
+  /// The lookups of selections and tables
+  Counters selection_counters() const;
+  Counters table_counters() const;
+  /// The memory used by the entries in bytes
+  uint64_t memory() const;
+  /// The most memory that the entries may use in bytes
+  uint64_t budget() const { return budget_; }
+
+  /// Whether every tuple that passes filter passes implied as well (both on
+  /// the same relation)
+  static bool implies(const FilterInfo &filter, const FilterInfo &implied);
+  /// The filters that not every tuple passing the cached filters passes
+  /// (the cached filters have to be implied by filters)
+  static std::vector<FilterInfo> residual(
+      const std::vector<FilterInfo> &filters,
+      const std::vector<FilterInfo> &cached);
+};
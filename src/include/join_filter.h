@@ -0,0 +1,79 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <vector>
+
+/// A runtime filter on the join keys of a hash join's build side that scans
+/// below the join's probe side apply before they materialize their tuples
+/// (sideways information passing). It is a register-blocked Bloom filter:
+/// the bits of a key lie in one 64-bit word, thus a lookup costs one memory
+/// access. Keys outside the build side's [min, max] are rejected before.
+/// The filter counts the tuples it tested and eliminated; a scan stops
+/// applying it once it eliminates too few of them.
+class JoinFilter {
+ public:
+  /// The bits per key (a false positive rate of about 0.2%)
+  static constexpr uint64_t kBitsPerKey = 16;
+  /// Build sides with more keys get no filter (it would not fit into cache)
+  static constexpr uint64_t kMaxKeys = 1ull << 22;
+  /// After this many tested tuples, a filter that eliminated less than
+  /// kMinEliminated of them is no longer applied
+  static constexpr uint64_t kMinTested = 1ull << 16;
+  static constexpr double kMinEliminated = 0.1;
+
+  /// The tuples that filters tested and eliminated
+  struct Counters {
+    uint64_t tested = 0, eliminated = 0;
+  };
+
+ private:
+  /// The bit words (a power of two)
+  std::vector<uint64_t> words_;
+  /// Shift to map a hash to a word
+  unsigned shift_ = 63;
+  /// The smallest and the largest key
+  uint64_t min_ = 1, max_ = 0;
+  /// The tuples that the filter tested and eliminated
+  mutable std::atomic<uint64_t> tested_{0}, eliminated_{0};
+  /// The tuples that all filters tested and eliminated
+  static std::atomic<uint64_t> total_tested_, total_eliminated_;
+
+  /// The bits of a key within its word
+  static uint64_t bits(uint64_t key) {
+    auto hash = key * 0xC2B2AE3D27D4EB4Full;
+    return (1ull << (hash >> 58)) | (1ull << ((hash >> 52) & 63))
+        | (1ull << ((hash >> 46) & 63)) | (1ull << ((hash >> 40) & 63));
+  }
+  /// The word of a key
+  uint64_t word(uint64_t key) const {
+    return (key * 0x9E3779B97F4A7C15ull) >> shift_;
+  }
+
+ public:
+  /// Build the filter on the keys
+  void build(const uint64_t *keys, uint64_t size);
+  /// Whether a key may be one of the build side's keys
+  bool mayContain(uint64_t key) const {
+    if (key < min_ || key > max_)
+      return false;
+    auto bits = JoinFilter::bits(key);
+    return (words_[word(key)] & bits) == bits;
+  }
+
+  /// Count tested and eliminated tuples
+  void record(uint64_t tested, uint64_t eliminated) const;
+  /// Whether the filter eliminated enough of the tuples it tested so far
+  bool useful() const {
+    auto tested = tested_.load(std::memory_order_relaxed);
+    return tested < kMinTested
+        || eliminated_.load(std::memory_order_relaxed)
+            >= kMinEliminated * tested;
+  }
+  /// The tuples that the filter tested and eliminated
+  Counters counters() const { return {tested_, eliminated_}; }
+  /// The tuples that all filters tested and eliminated
+  static Counters totals() { return {total_tested_, total_eliminated_}; }
+  /// The memory used by the filter in bytes
+  uint64_t memory() const { return words_.size() * sizeof(uint64_t); }
+};
@@ -4,30 +4,251 @@
 #include <cstdint>
 #include <set>
 
+#include "batch_planner.h"
+#include "intermediate_cache.h"
 #include "operators.h"
 #include "relation.h"
 #include "parser.h"
+#include "planner.h"
+#include "result_cache.h"
+#include "semi_join.h"
+#include "statistics.h"
+
+/// What loading the relations cost
+struct LoadReport {
+  /// The number of relations and their total file size in bytes
+  uint64_t relations = 0, bytes = 0;
+  /// The wall-clock time of loading in ms
+  double ms = 0;
+  /// The page faults during loading (minor and major)
+  uint64_t page_faults = 0;
+  /// The pages that were mapped during loading, which queries would
+  /// otherwise fault in
+  uint64_t prefaulted_pages = 0;
+};
 
 class Joiner {
+ public:
+  /// The default memory budget of the hash indexes relative to the size of
+  /// the data
+  static constexpr double kHashIndexBudget = 2.0;
+  /// An index nested-loop join probes the index of the larger input only if
+  /// the other input is this many times smaller (a probe into a large index
+  /// costs about as much as scanning and building this many tuples)
+  static constexpr double kIndexProbeCost = 4.0;
+  /// The default memory budget of the intermediate cache relative to the
+  /// size of the data
+  static constexpr double kCacheBudget = 0.5;
+  /// A cached hash table with weaker filters than the build side is probed
+  /// (and its tuples filtered) only if it has at most this many times the
+  /// estimated tuples of the build side
+  static constexpr double kMaxSubsumedTableRatio = 4.0;
+  /// The default memory limit of the result cache in bytes
+  static constexpr uint64_t kResultCacheLimit = 64ull << 20;
+  /// A cyclic query is joined with a multiway join if the intermediate
+  /// results of its binary plan are estimated to hold this many tuples
+  /// beyond its result per base tuple
+  static constexpr double kMinMultiwayDangling = 1.0;
+  /// An input of a join is collapsed into counts per join key only if the
+  /// join is estimated to produce this many tuples per tuple of its other
+  /// input
+  static constexpr double kMinCountMultiplicity = 2.0;
+
  private:
   /// The relations that might be joined
   std::vector<Relation> relations_;
+  /// The statistics of the relations' columns
+  StatisticsCatalog statistics_;
+  /// Whether joins push their results through the plan to the checksum
+  /// instead of materializing them
+  bool pipelined_ = true;
+  /// Whether hash joins push filters on their build side's keys into the
+  /// scans of their probe side
+  bool join_filters_ = true;
+  /// Whether acyclic queries are reduced with semi-joins before they are
+  /// joined
+  bool semi_join_reduction_ = true;
+  /// Whether cyclic queries may be joined with a multiway join
+  bool multiway_joins_ = true;
+  /// Whether join inputs without requested columns are collapsed into
+  /// counts per join key
+  bool eager_aggregation_ = true;
+  /// Whether the matching tuples of join inputs whose columns only the
+  /// checksum reads are kept unexpanded
+  bool factorized_joins_ = true;
+  /// The filtered scans and hash tables that queries reuse (nullptr if
+  /// caching is disabled)
+  std::unique_ptr<IntermediateCache> cache_;
+  /// The results of earlier queries by their canonical form (nullptr if
+  /// disabled)
+  std::unique_ptr<ResultCache> results_;
 
  public:
   /// Add relation
   void addRelation(const char *file_name);
   void addRelation(Relation &&relation);
+  /// Load relations in parallel (preparation phase), in the given order.
+  /// Throws std::runtime_error if a file cannot be loaded.
+  LoadReport addRelations(const std::vector<std::string> &file_names,
+                          const LoadOptions &options = LoadOptions());
   /// Get relation
-  const Relation &getRelation(unsigned relation_id);
-  /// Joins a given set of relations
-  std::string join(QueryInfo &i);
+  const Relation &getRelation(unsigned relation_id) const;
+  /// Find the join order and the build sides of a query
+  std::unique_ptr<PlanNode> plan(QueryInfo &query) const;
+  /// The estimated memory that executing a plan needs in bytes: its hash
+  /// tables and materialized inputs
+  uint64_t memoryEstimate(const PlanNode &plan, QueryInfo &query) const;
+  /// Joins a given set of relations. Queries only read the relations, the
+  /// statistics and the indexes, thus they can be joined concurrently. A
+  /// query whose result is cached is not executed.
+  std::string join(QueryInfo &i) const;
+  /// Joins a given set of relations with a plan of the query. The subtrees
+  /// of the plan in shared read the results of shared subplans.
+  std::string join(QueryInfo &query,
+                   const PlanNode &plan,
+                   const SharedInputs *shared = nullptr) const;
+  /// Add the operators of a plan to query. The subtrees in shared (except
+  /// for node itself) read the results of shared subplans, the other leaves
+  /// scan the tuples of a reduction if given. With eager aggregation, the
+  /// inputs that countedInput() picks are collapsed by count joins and
+  /// those that factorizedInput() picks are grouped by factorized joins
+  /// (the result then carries count columns).
+  std::unique_ptr<Operator> addPlan(
+      const PlanNode &node,
+      QueryInfo &query,
+      const SharedInputs *shared = nullptr,
+      const SemiJoinReduction *reduction = nullptr,
+      bool eager_aggregation = false) const;
+  /// The input of a join whose tuples only matter through their number per
+  /// join key (nullptr if none): no column of it is selected or joined
+  /// above the join, the join has a single predicate, and the join is
+  /// estimated to produce kMinCountMultiplicity tuples per tuple of the
+  /// other input and more tuples than collapsing the input reads
+  const PlanNode *countedInput(const PlanNode &node, QueryInfo &query) const;
+  /// The input of a join whose matching tuples are kept unexpanded per
+  /// join key (nullptr if none): like countedInput(), except that columns
+  /// of it may be selected (and it is not counted)
+  const PlanNode *factorizedInput(const PlanNode &node,
+                                  QueryInfo &query) const;
+  /// Whether a query is joined with a multiway join instead of the binary
+  /// joins of its plan: its join graph has a cycle and the binary joins
+  /// would produce many tuples that do not reach the result
+  bool joinsMultiway(const PlanNode &plan, const QueryInfo &query) const;
+  /// Add a multiway join of all leaves of a plan to query on all
+  /// predicates between them (the leaves in shared read the results of
+  /// shared subplans)
+  std::unique_ptr<Operator> addMultiwayJoin(
+      const PlanNode &plan,
+      QueryInfo &query,
+      const SharedInputs *shared = nullptr) const;
+  /// Whether a join of a plan builds a hash table on its left input (no
+  /// index answers its predicate)
+  bool buildsHashTable(const PlanNode &node, QueryInfo &query) const;
+  /// The filters of a binding that not every tuple passes
+  std::vector<FilterInfo> filters(unsigned binding, QueryInfo &query) const;
 
   const std::vector<Relation> &relations() const { return relations_; }
+  /// Compute the statistics of all relations (preparation phase)
+  void buildStatistics() { statistics_.build(relations_); }
+  /// The statistics (empty unless built)
+  const StatisticsCatalog &statistics() const { return statistics_; }
+  /// Build the sorted index of every column (preparation phase)
+  void buildSortedIndexes();
+  /// The memory used by the sorted indexes in bytes
+  uint64_t sortedIndexMemory() const;
+  /// Build hash indexes on the likely join-key columns within the memory
+  /// budget (preparation phase). Returns the memory used in bytes.
+  uint64_t buildHashIndexes(double budget = kHashIndexBudget);
+  /// Compress the columns that scans filter on (preparation phase). Returns
+  /// the memory used by the compressed columns in bytes.
+  uint64_t compressColumns();
+  /// Switch between pipelined and materializing execution
+  void setPipelined(bool pipelined) { pipelined_ = pipelined; }
+  /// Switch the join filters of hash joins on or off
+  void setJoinFilters(bool join_filters) { join_filters_ = join_filters; }
+  /// Switch the semi-join reduction of acyclic queries on or off
+  void setSemiJoinReduction(bool reduction) {
+    semi_join_reduction_ = reduction;
+  }
+  /// Switch multiway joins of cyclic queries on or off
+  void setMultiwayJoins(bool multiway_joins) {
+    multiway_joins_ = multiway_joins;
+  }
+  /// Switch the eager aggregation of join inputs on or off
+  void setEagerAggregation(bool eager_aggregation) {
+    eager_aggregation_ = eager_aggregation;
+  }
+  /// Switch factorized joins on or off
+  void setFactorizedJoins(bool factorized_joins) {
+    factorized_joins_ = factorized_joins;
+  }
+  /// Cache the filtered scans and the hash tables on base relations across
+  /// queries within a memory budget relative to the size of the data (0
+  /// disables the cache). Returns the budget in bytes.
+  uint64_t enableCache(double budget = kCacheBudget);
+  /// The intermediate cache (nullptr if disabled)
+  const IntermediateCache *cache() const { return cache_.get(); }
+  /// Cache the results of queries within a memory limit in bytes (0
+  /// disables the cache)
+  void enableResultCache(uint64_t limit = kResultCacheLimit) {
+    results_ = limit ? std::make_unique<ResultCache>(limit) : nullptr;
+  }
+  /// The result cache (nullptr if disabled)
+  ResultCache *resultCache() const { return results_.get(); }
 
  private:
   /// Add scan to query
-  std::unique_ptr<Operator> addScan(std::set<unsigned> &used_relations,
-                                    const SelectInfo &info,
-                                    QueryInfo &query);
+  std::unique_ptr<Operator> addScan(const SelectInfo &info,
+                                    QueryInfo &query) const;
+  /// The tuples of a relation that pass filters, from the cache or filtered
+  /// and added to it if the cache admits them. Tuples that are not admitted
+  /// are only filtered if materialize is set or a cached selection subsumes
+  /// the filters (nullptr otherwise).
+  std::shared_ptr<const IntermediateCache::Selection> select(
+      unsigned rel_id,
+      const std::vector<FilterInfo> &filters,
+      bool materialize) const;
+  /// Add a join whose hash table on its left input (a base relation) comes
+  /// from the cache or is built and added to it if the cache admits it
+  /// (nullptr if it does not)
+  std::unique_ptr<Operator> addCachedJoin(
+      const PlanNode &node,
+      QueryInfo &query,
+      const SharedInputs *shared,
+      const SemiJoinReduction *reduction,
+      bool eager_aggregation) const;
+  /// An input of a join node that no predicate above the join reads and
+  /// that pays to collapse (nullptr if none); unless selected is set, no
+  /// column of it may be selected either
+  const PlanNode *collapsedInput(const PlanNode &node,
+                                 QueryInfo &query,
+                                 bool selected) const;
+  /// Add a count join that collapses the counted input of a join node
+  std::unique_ptr<Operator> addCountJoin(
+      const PlanNode &node,
+      const PlanNode &counted,
+      QueryInfo &query,
+      const SharedInputs *shared,
+      const SemiJoinReduction *reduction) const;
+  /// Add a factorized join that groups an input of a join node
+  std::unique_ptr<Operator> addFactorizedJoin(
+      const PlanNode &node,
+      const PlanNode &grouped,
+      QueryInfo &query,
+      const SharedInputs *shared,
+      const SemiJoinReduction *reduction) const;
+  /// The hash index that answers the join predicate on a plan leaf without
+  /// scanning it (nullptr if the leaf is filtered or not indexed)
+  const HashTable *leafIndex(const PlanNode &node,
+                             const SelectInfo &column,
+                             QueryInfo &query) const;
+  /// Add the operators of an input of a join to query (a scan of the
+  /// shared result if the input is shared)
+  std::unique_ptr<Operator> addInput(
+      const PlanNode &node,
+      QueryInfo &query,
+      const SharedInputs *shared,
+      const SemiJoinReduction *reduction = nullptr,
+      bool eager_aggregation = false) const;
 };
 
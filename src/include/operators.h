@@ -9,6 +9,8 @@
 #include <vector>
 #include <set>
 
+#include "hash_table.h"
+#include "join_filter.h"
 #include "relation.h"
 #include "parser.h"
 
@@ -22,7 +24,56 @@ struct hash<SelectInfo> {
 };
 };
 
-/// Operators materialize their entire result
+/// The groups of tuples of a binding that a FactorizedJoin keeps
+/// unexpanded: their number and the sums of their requested columns
+struct TupleGroups {
+  /// The number of tuples of every group (the sum of their multiplicities)
+  std::vector<uint64_t> counts;
+  /// The sums of every requested column per group (each value times the
+  /// multiplicity of its tuple)
+  std::unordered_map<SelectInfo, std::vector<uint64_t>> sums;
+};
+
+/// The row ids of one base relation binding in an intermediate result
+struct RowIdColumn {
+  /// The binding of the relation in the query
+  unsigned binding;
+  /// The base relation (nullptr if the column holds the counts of a
+  /// CountJoin or the groups of a FactorizedJoin instead of row ids)
+  const Relation *relation;
+  /// The row ids (nullptr if the result contains every row in order)
+  const uint64_t *ids;
+  /// The groups that the ids refer to (nullptr unless factorized)
+  const TupleGroups *groups = nullptr;
+
+  /// The row id of the i-th tuple
+  uint64_t rowId(uint64_t i) const { return ids ? ids[i] : i; }
+  /// The value of a column of the i-th tuple
+  uint64_t value(unsigned col_id, uint64_t i) const {
+    return relation->columns()[col_id][rowId(i)];
+  }
+};
+
+/// The tuple ids produced by every morsel
+using MorselIds = std::vector<std::vector<uint64_t>>;
+
+/// Consumer of the tuples that an operator pushes in pipelined execution
+class Consumer {
+ public:
+  /// The destructor
+  virtual ~Consumer() = default;
+  /// Consume the tuples [begin, end) of the row id columns. Called
+  /// concurrently by several threads.
+  virtual void consume(const std::vector<RowIdColumn> &columns,
+                       uint64_t begin,
+                       uint64_t end) = 0;
+};
+
+/// Operators materialize their entire result as row ids into the base
+/// relations, one row id column per binding (late materialization). Column
+/// values are only fetched for join keys, the checksum and getResults().
+/// In pipelined execution (produce()), joins only materialize their build
+/// side and push the probe side's tuples batch by batch to their consumer.
 class Operator {
  protected:
   /// Mapping from select info to data
@@ -33,6 +84,20 @@ class Operator {
   std::vector<std::vector<uint64_t>> tmp_results_;
   /// The result size
   uint64_t result_size_ = 0;
+  /// The row ids of the result
+  std::vector<RowIdColumn> row_id_columns_;
+  /// The storage of the row ids
+  std::vector<std::vector<uint64_t>> row_ids_;
+  /// The count columns of the result: every tuple stands for the product
+  /// of its counts many tuples (empty if every tuple counts once)
+  std::vector<SelectInfo> count_columns_;
+
+ protected:
+  /// Store the row ids of the selected tuples of the inputs, one output
+  /// column per input. The output of every morsel is placed at the prefix
+  /// sum of the sizes of all previous morsels. Returns the result size.
+  uint64_t gatherRowIds(const MorselIds &ids,
+                        const std::vector<RowIdColumn> &inputs);
 
  public:
   /// The destructor
@@ -47,8 +112,28 @@ class Operator {
   }
   /// Run
   virtual void run() = 0;
+  /// Push the result to a consumer instead of materializing it (pipelined
+  /// execution). By default the result is materialized and then pushed.
+  virtual void produce(Consumer &consumer);
   /// Get  materialized results
   virtual std::vector<uint64_t *> getResults();
+  /// Let the scan of the column's binding below this operator drop the
+  /// tuples whose value of the column fails a join filter before it
+  /// materializes them (has to be called before the operator runs). Returns
+  /// false if no scan applies it.
+  virtual bool pushJoinFilter(const JoinFilter &filter,
+                              const SelectInfo &column) {
+    return false;
+  }
+
+  /// The row ids of the result
+  const std::vector<RowIdColumn> &getRowIds() const { return row_id_columns_; }
+  /// The row ids of a binding (which has to be required before)
+  const RowIdColumn &rowIds(unsigned binding) const;
+  /// The count columns of the result
+  const std::vector<SelectInfo> &countColumns() const {
+    return count_columns_;
+  }
 
   uint64_t result_size() const { return result_size_; }
 };
@@ -59,6 +144,12 @@ class Scan : public Operator {
   const Relation &relation_;
   /// The name of the relation in the query
   unsigned relation_binding_;
+  /// The join filters pushed down from joins above and their columns
+  std::vector<std::pair<const JoinFilter *, unsigned>> join_filters_;
+
+ protected:
+  /// Remove the ids from position from on whose tuples fail a join filter
+  void applyJoinFilters(std::vector<uint64_t> &ids, uint64_t from) const;
 
  public:
   /// The constructor
@@ -68,22 +159,46 @@ class Scan : public Operator {
   bool require(SelectInfo info) override;
   /// Run
   void run() override;
+  /// Push the tuples that pass the join filters to a consumer
+  void produce(Consumer &consumer) override;
   /// Get  materialized results
   virtual std::vector<uint64_t *> getResults() override;
+  /// Apply a join filter on a column of the scanned binding
+  bool pushJoinFilter(const JoinFilter &filter,
+                      const SelectInfo &column) override;
 };
 
 class FilterScan : public Scan {
+ public:
+  /// Filters that select at most this fraction of the relation are answered
+  /// with an index (if there is one) instead of a full scan
+  static constexpr double kMaxIndexSelectivity = 0.02;
+
  private:
   /// The filter info
   std::vector<FilterInfo> filters_;
-  /// The input data
-  std::vector<uint64_t *> input_data_;
+  /// The row ids that pass the filters of one column according to an index
+  /// (nullptr if the relation is scanned)
+  const uint64_t *index_row_ids_ = nullptr;
+  /// The number of those row ids
+  uint64_t index_size_ = 0;
+  /// The filters on other columns than the index's
+  std::vector<FilterInfo> residual_filters_;
+  /// The row ids of a superset of the qualifying tuples that were selected
+  /// before, e.g. by a cached scan (nullptr if none)
+  std::shared_ptr<const std::vector<uint64_t>> candidates_;
 
  private:
-  /// Apply filter
-  bool applyFilter(uint64_t id, FilterInfo &f);
-  /// Copy tuple to result
-  void copy2Result(uint64_t id);
+  /// Choose between the most selective index and a full scan. Equality
+  /// filters use a hash index, other ranges a sorted index.
+  void chooseAccessPath();
+  /// Append the ids of the tuples in [begin, end) that pass all filters
+  void select(uint64_t begin, uint64_t end, std::vector<uint64_t> &ids);
+  /// Append the ids of the tuples at the positions [begin, end) of the
+  /// index row ids that pass the residual filters
+  void selectFromIndex(uint64_t begin,
+                       uint64_t end,
+                       std::vector<uint64_t> &ids);
 
  public:
   /// The constructor
@@ -97,11 +212,22 @@ class FilterScan : public Scan {
                    std::vector<
                        FilterInfo>{
                        filter_info}) {};
+  /// The constructor for a scan of the given row ids (in their order) that
+  /// applies the remaining filters
+  FilterScan(const Relation &r,
+             unsigned relation_binding,
+             std::shared_ptr<const std::vector<uint64_t>> candidates,
+             std::vector<FilterInfo> filters = {})
+      : Scan(r, relation_binding),
+        filters_(std::move(filters)),
+        candidates_(std::move(candidates)) {};
 
   /// Require a column and add it to results
   bool require(SelectInfo info) override;
   /// Run
   void run() override;
+  /// Push the qualifying tuples of every morsel to a consumer
+  void produce(Consumer &consumer) override;
   /// Get  materialized results
   virtual std::vector<uint64_t *> getResults() override {
     return Operator::getResults();
@@ -109,38 +235,406 @@ class FilterScan : public Scan {
 };
 
 class Join : public Operator {
- private:
+ public:
+  /// The input the hash table is built on
+  enum class BuildSide { Smaller, Left, Right };
+#ifdef USE_STD_HASH_TABLE
+  using HT = std::unordered_multimap<uint64_t, uint64_t>;
+#else
+  using HT = PartitionedHashTable;
+#endif
+
+ protected:
   /// The input operators
   std::unique_ptr<Operator> left_, right_;
   /// The join predicate info
   PredicateInfo p_info_;
-
-  using HT = std::unordered_multimap<uint64_t, uint64_t>;
+  /// Further predicates between the inputs whose columns extend the join
+  /// key (empty if the key is a single column)
+  std::vector<PredicateInfo> key_predicates_;
+  /// The input the hash table is built on
+  BuildSide build_side_;
+  /// Whether the probe side (right) has been run
+  bool probe_side_materialized_ = false;
 
   /// The hash table for the join
   HT hash_table_;
+  /// A hash table on the left input's join keys that was built before
+  /// (nullptr if the join builds its own)
+  std::shared_ptr<const HT> prebuilt_table_;
+  /// The positions of the prebuilt table that qualify (empty if all)
+  std::vector<uint8_t> build_mask_;
+  /// Whether the join pushes a filter on its build side's keys into the
+  /// probe side
+  bool use_join_filter_ = true;
+  /// The filter on the build side's keys (nullptr if none was pushed)
+  std::unique_ptr<JoinFilter> join_filter_;
   /// Columns that have to be materialized
   std::unordered_set<SelectInfo> requested_columns_;
   /// Left/right columns that have been requested
   std::vector<SelectInfo> requested_columns_left_, requested_columns_right_;
 
-  /// The entire input data of left and right
-  std::vector<uint64_t *> left_input_data_, right_input_data_;
-  /// The input data that has to be copied
-  std::vector<uint64_t *> copy_left_data_, copy_right_data_;
+  /// The row ids of left and right that are passed to the result
+  std::vector<RowIdColumn> copy_left_ids_, copy_right_ids_;
+  /// The join keys of left (build side) and right (probe side)
+  const uint64_t *left_key_column_ = nullptr, *right_key_column_ = nullptr;
+  /// The join keys fetched through row ids
+  std::vector<uint64_t> left_keys_, right_keys_;
+  /// All key columns of left and right (composite keys only) and the
+  /// storage of those fetched through row ids
+  std::vector<const uint64_t *> left_key_columns_, right_key_columns_;
+  std::vector<std::vector<uint64_t>> left_key_buffers_, right_key_buffers_;
+  /// The composite keys of left that the hash table is built on
+  std::vector<uint64_t> left_composite_keys_;
 
- private:
-  /// Copy tuple to result
-  void copy2Result(uint64_t left_id, uint64_t right_id);
-  /// Create mapping for bindings
-  void createMappingForBindings();
+ protected:
+  /// Make the build side the left input, run the inputs and fetch the join
+  /// keys. The probe side is only run if materialize_probe_side is set or
+  /// the build side is the smaller input.
+  void prepareInputs(bool materialize_probe_side = true);
+  /// Run the probe side and fetch its join keys
+  void materializeProbeSide();
+  /// Build the hash table on the left input
+  void build();
+  /// Push a filter on the build side's keys into the probe side unless it
+  /// has run already
+  void pushBuildKeys();
+  /// Call fn(left_id) for every left tuple with the given key
+  template<typename Fn>
+  void forEachMatch(uint64_t key, Fn &&fn) const {
+    auto &table = prebuilt_table_ ? *prebuilt_table_ : hash_table_;
+    auto mask = build_mask_.empty() ? nullptr : build_mask_.data();
+#ifdef USE_STD_HASH_TABLE
+    auto range = table.equal_range(key);
+    for (auto iter = range.first; iter != range.second; ++iter) {
+      if (!mask || mask[iter->second])
+        fn(iter->second);
+    }
+#else
+    for (auto left_id : table.find(key)) {
+      if (!mask || mask[left_id])
+        fn(left_id);
+    }
+#endif
+  }
+  /// Call fn(left_id) for every left tuple whose key columns hold the
+  /// values in keys (one per key column)
+  template<typename Fn>
+  void forEachKeyMatch(const uint64_t *keys, Fn &&fn) const {
+    auto key = keys[0];
+    for (unsigned k = 1; k < left_key_columns_.size(); ++k)
+      key = compositeKey(key, keys[k]);
+    forEachMatch(key, [&](uint64_t left_id) {
+      // Different composite keys may hash alike
+      for (unsigned k = 0; k < left_key_columns_.size(); ++k) {
+        if (left_key_columns_[k][left_id] != keys[k])
+          return;
+      }
+      fn(left_id);
+    });
+  }
+  /// Whether a left and a right tuple agree on all columns of a composite
+  /// key (whose hashes may collide)
+  bool keysMatch(uint64_t left_id, uint64_t right_id) const {
+    for (unsigned k = 0; k < left_key_columns_.size(); ++k) {
+      if (left_key_columns_[k][left_id] != right_key_columns_[k][right_id])
+        return false;
+    }
+    return true;
+  }
+  /// Store the row ids of the matching (left, right) tuples as result
+  void materialize(const MorselIds &left_ids, const MorselIds &right_ids);
 
  public:
-  /// The constructor
+  /// The constructor. A prebuilt table has to map the join keys of the
+  /// left input's result to their positions and makes the left input the
+  /// build side; a build mask restricts it to the positions that are set.
   Join(std::unique_ptr<Operator> &&left,
        std::unique_ptr<Operator> &&right,
-       const PredicateInfo &p_info)
-      : left_(std::move(left)), right_(std::move(right)), p_info_(p_info) {};
+       const PredicateInfo &p_info,
+       BuildSide build_side = BuildSide::Smaller,
+       std::shared_ptr<const HT> prebuilt_table = nullptr,
+       std::vector<uint8_t> build_mask = {})
+      : left_(std::move(left)), right_(std::move(right)), p_info_(p_info),
+        build_side_(prebuilt_table ? BuildSide::Left : build_side),
+        prebuilt_table_(std::move(prebuilt_table)),
+        build_mask_(std::move(build_mask)) {
+    count_columns_ = left_->countColumns();
+    count_columns_.insert(count_columns_.end(),
+                          right_->countColumns().begin(),
+                          right_->countColumns().end());
+  };
+  /// Require a column and add it to results
+  bool require(SelectInfo info) override;
+  /// Run
+  void run() override;
+  /// Build the hash table and push the probe side's tuples through it
+  void produce(Consumer &consumer) override;
+  /// Apply a join filter in the scan of either input (not in a build side
+  /// whose prebuilt table refers to its positions)
+  bool pushJoinFilter(const JoinFilter &filter,
+                      const SelectInfo &column) override;
+  /// Switch pushing a filter on the build side's keys on or off
+  void setJoinFilter(bool enabled) { use_join_filter_ = enabled; }
+  /// Extend the join key by the columns of a further predicate between the
+  /// inputs, instead of filtering the join's result on it (not with a
+  /// prebuilt table, has to be called before the join runs)
+  void addKey(const PredicateInfo &p_info) {
+    assert(!prebuilt_table_);
+    key_predicates_.push_back(p_info);
+  }
+  /// The filter that was pushed into the probe side (nullptr if none)
+  const JoinFilter *joinFilter() const { return join_filter_.get(); }
+};
+
+/// Hash join that first partitions both inputs on the bits of the join key,
+/// so that the hash table of each partition fits into the cache, and then
+/// joins the partition pairs independently
+class RadixJoin : public Join {
+ public:
+  /// Build sides with fewer tuples are not partitioned
+  static constexpr uint64_t kMinBuildSize = 1ull << 17;
+  /// The target number of build tuples per partition
+  static constexpr uint64_t kPartitionSize = 1ull << 12;
+
+ private:
+  /// The number of radix bits (0 = derive from build size)
+  unsigned radix_bits_;
+
+ public:
+  /// The constructor
+  RadixJoin(std::unique_ptr<Operator> &&left,
+            std::unique_ptr<Operator> &&right,
+            const PredicateInfo &p_info,
+            unsigned radix_bits = 0)
+      : Join(std::move(left), std::move(right), p_info),
+        radix_bits_(radix_bits) {};
+  /// Run
+  void run() override;
+  /// Push the result to a consumer (both inputs are partitioned, thus the
+  /// result is materialized first)
+  void produce(Consumer &consumer) override {
+    Operator::produce(consumer);
+  }
+};
+
+/// An index nested-loop join: every tuple of the input is looked up in the
+/// prebuilt hash index on the join column of a base relation, thus there is
+/// no build phase
+class IndexJoin : public Operator {
+ private:
+  /// The input operator (probe side)
+  std::unique_ptr<Operator> input_;
+  /// The indexed relation
+  const Relation &relation_;
+  /// The hash index on the relation's join column
+  const HashTable &index_;
+  /// The join predicate info (left is the relation's column)
+  PredicateInfo p_info_;
+  /// Columns that have been requested
+  std::unordered_set<SelectInfo> requested_columns_;
+  /// Requested columns of the relation and of the input
+  std::vector<SelectInfo> requested_columns_relation_,
+      requested_columns_input_;
+  /// The join keys of the input fetched through row ids
+  std::vector<uint64_t> keys_;
+
+ private:
+  /// Require the join key and resolve the result columns
+  void prepare();
+
+ public:
+  /// The constructor
+  IndexJoin(std::unique_ptr<Operator> &&input,
+            const Relation &relation,
+            const HashTable &index,
+            const PredicateInfo &p_info)
+      : input_(std::move(input)), relation_(relation), index_(index),
+        p_info_(p_info) {
+    count_columns_ = input_->countColumns();
+  };
+  /// Require a column and add it to results
+  bool require(SelectInfo info) override;
+  /// Run
+  void run() override;
+  /// Push the input's tuples through the index to a consumer
+  void produce(Consumer &consumer) override;
+  /// Apply a join filter in the input's scans
+  bool pushJoinFilter(const JoinFilter &filter,
+                      const SelectInfo &column) override {
+    return input_->pushJoinFilter(filter, column);
+  }
+};
+
+/// A join whose left input only matters through its number of tuples per
+/// join key, since no column of it is requested above the join (eager
+/// aggregation). The left input is collapsed into a table from its join
+/// keys to their multiplicities, and every right tuple with a partner is
+/// passed on once, with the multiplicity of its key in a count column,
+/// instead of once per partner. A tuple of the left input counts as the
+/// product of its own counts; the checksum sums the values of a tuple times
+/// the product of its counts.
+class CountJoin : public Operator {
+ public:
+  /// The column id of the count column of the left input's key binding
+  static constexpr unsigned kCountColumn = ~0u;
+
+ private:
+  /// The counted input (nullptr if an index counts its tuples) and the
+  /// input whose tuples are passed on
+  std::unique_ptr<Operator> left_, right_;
+  /// The hash index on the join column of the counted relation (nullptr if
+  /// the left input is aggregated)
+  const HashTable *index_ = nullptr;
+  /// The join predicate info (left is the counted input's column)
+  PredicateInfo p_info_;
+  /// The multiplicity of every join key of the left input
+  HashTable counts_;
+  /// Whether the join pushes a filter on the counted keys into the right
+  /// input
+  bool use_join_filter_ = true;
+  /// The filter on the counted keys (nullptr if none was pushed)
+  std::unique_ptr<JoinFilter> join_filter_;
+  /// Columns that have been requested
+  std::unordered_set<SelectInfo> requested_columns_;
+  /// Requested columns of the right input
+  std::vector<SelectInfo> requested_columns_right_;
+  /// Whether the count column has been requested
+  bool counts_requested_ = false;
+
+ private:
+  /// Aggregate the left input, require the right input's join key and
+  /// resolve the result columns
+  void prepare();
+  /// The multiplicity of a key (0 if no left tuple has it)
+  uint64_t count(uint64_t key) const {
+    if (index_)
+      return index_->find(key).size();
+    auto range = counts_.find(key);
+    return range.empty() ? 0 : *range.begin();
+  }
+
+ public:
+  /// The constructor
+  CountJoin(std::unique_ptr<Operator> &&left,
+            std::unique_ptr<Operator> &&right,
+            const PredicateInfo &p_info)
+      : left_(std::move(left)), right_(std::move(right)), p_info_(p_info) {
+    count_columns_ = right_->countColumns();
+    count_columns_.push_back(countColumn(p_info_.left.binding));
+  };
+  /// The constructor for a counted base relation whose hash index on the
+  /// join column counts its tuples
+  CountJoin(const HashTable &index,
+            std::unique_ptr<Operator> &&right,
+            const PredicateInfo &p_info)
+      : right_(std::move(right)), index_(&index), p_info_(p_info) {
+    count_columns_ = right_->countColumns();
+    count_columns_.push_back(countColumn(p_info_.left.binding));
+  };
+  /// The count column of a counted binding
+  static SelectInfo countColumn(unsigned binding) {
+    return SelectInfo(binding, kCountColumn);
+  }
+  /// Require a column and add it to results
+  bool require(SelectInfo info) override;
+  /// Run
+  void run() override;
+  /// Push the right input's tuples with their multiplicities to a consumer
+  void produce(Consumer &consumer) override;
+  /// Apply a join filter in the right input's scans
+  bool pushJoinFilter(const JoinFilter &filter,
+                      const SelectInfo &column) override {
+    return right_->pushJoinFilter(filter, column);
+  }
+  /// Switch pushing a filter on the counted keys on or off
+  void setJoinFilter(bool enabled) { use_join_filter_ = enabled; }
+};
+
+/// A join that keeps the matching tuples of its left input unexpanded,
+/// since only the checksum reads columns of it (a factorized result): the
+/// left input is grouped on its join key, and every right tuple with
+/// partners is passed on once with the id of its group of partners,
+/// instead of once per partner. The groups hold their number of tuples and
+/// the sums of the left input's requested columns, which the checksum
+/// multiplies with the counts of the right tuple. The left input's bindings
+/// hold the group ids, and the count column of the key's binding stands
+/// for the number of tuples of the group.
+class FactorizedJoin : public Operator {
+ private:
+  /// The grouped input and the input whose tuples are passed on
+  std::unique_ptr<Operator> left_, right_;
+  /// The join predicate info (left is the grouped input's column)
+  PredicateInfo p_info_;
+  /// The group id of every join key of the left input
+  HashTable table_;
+  /// The groups of the left input
+  TupleGroups groups_;
+  /// Whether the join pushes a filter on the grouped keys into the right
+  /// input
+  bool use_join_filter_ = true;
+  /// The filter on the grouped keys (nullptr if none was pushed)
+  std::unique_ptr<JoinFilter> join_filter_;
+  /// Columns that have been requested
+  std::unordered_set<SelectInfo> requested_columns_;
+  /// Requested columns of the left input (summed) and of the right input
+  std::vector<SelectInfo> requested_columns_left_, requested_columns_right_;
+  /// The bindings of the left input whose group ids are passed on
+  std::vector<unsigned> left_bindings_;
+
+ private:
+  /// Group the left input, require the right input's join key and resolve
+  /// the result columns
+  void prepare();
+  /// The group of a key (nullptr if no left tuple has it)
+  const uint64_t *group(uint64_t key) const {
+    auto range = table_.find(key);
+    return range.empty() ? nullptr : range.begin();
+  }
+
+ public:
+  /// The constructor
+  FactorizedJoin(std::unique_ptr<Operator> &&left,
+                 std::unique_ptr<Operator> &&right,
+                 const PredicateInfo &p_info)
+      : left_(std::move(left)), right_(std::move(right)), p_info_(p_info) {
+    count_columns_ = right_->countColumns();
+    count_columns_.push_back(CountJoin::countColumn(p_info_.left.binding));
+  };
+  /// Require a column and add it to results (no operator but the checksum
+  /// may read a column of the left input)
+  bool require(SelectInfo info) override;
+  /// Run
+  void run() override;
+  /// Push the right input's tuples with their groups to a consumer
+  void produce(Consumer &consumer) override;
+  /// Apply a join filter in the right input's scans
+  bool pushJoinFilter(const JoinFilter &filter,
+                      const SelectInfo &column) override {
+    return right_->pushJoinFilter(filter, column);
+  }
+  /// Switch pushing a filter on the grouped keys on or off
+  void setJoinFilter(bool enabled) { use_join_filter_ = enabled; }
+};
+
+/// An intermediate result that several queries of a batch share: it is
+/// computed once and every consumer reads its row ids under its own
+/// bindings
+class SharedScan : public Operator {
+ private:
+  /// The row ids of the shared result
+  const std::vector<RowIdColumn> &columns_;
+  /// The binding of every column in the consumer's query
+  std::vector<unsigned> bindings_;
+
+ public:
+  /// The constructor
+  SharedScan(const std::vector<RowIdColumn> &columns,
+             uint64_t size,
+             std::vector<unsigned> bindings)
+      : columns_(columns), bindings_(std::move(bindings)) {
+    result_size_ = size;
+  };
   /// Require a column and add it to results
   bool require(SelectInfo info) override;
   /// Run
@@ -156,23 +650,118 @@ class SelfJoin : public Operator {
   /// The required IUs
   std::set<SelectInfo> required_IUs_;
 
-  /// The entire input data
-  std::vector<uint64_t *> input_data_;
-  /// The input data that has to be copied
-  std::vector<uint64_t *> copy_data_;
+ public:
+  /// The constructor
+  SelfJoin(std::unique_ptr<Operator> &&input, PredicateInfo &p_info)
+      : input_(std::move(input)), p_info_(p_info) {
+    count_columns_ = input_->countColumns();
+  };
+  /// Require a column and add it to results
+  bool require(SelectInfo info) override;
+  /// Run
+  void run() override;
+  /// Push the input's tuples that satisfy the predicate to a consumer
+  void produce(Consumer &consumer) override;
+  /// Apply a join filter in the input's scans
+  bool pushJoinFilter(const JoinFilter &filter,
+                      const SelectInfo &column) override {
+    return input_->pushJoinFilter(filter, column);
+  }
+};
+
+/// A worst-case optimal join of several inputs on all equality predicates
+/// between them at once (Generic Join). Columns that are equal form the
+/// variables of the join, which are bound one after another. Every input is
+/// sorted on its variables in that order, so that its tuples that agree on
+/// the bound variables form a range. The values of the next variable are
+/// those of the smallest range that all other ranges contain. Unlike a tree
+/// of binary joins, no intermediate result of a cyclic query exceeds the
+/// worst-case size of its output.
+class MultiwayJoin : public Operator {
+ public:
+  /// The number of partitions per thread that an input is sorted in
+  static constexpr unsigned kPartitionsPerThread = 4;
+  /// The sampled values per partition that the splitters are chosen from
+  static constexpr unsigned kSamplesPerPartition = 16;
+  /// The ranges [begin, end) of every input's sorted tuples that agree on
+  /// the bound variables
+  using Ranges = std::vector<std::pair<uint64_t, uint64_t>>;
+
+ private:
+  /// An input sorted on its variables
+  struct Trie {
+    /// The input's variables in variable order
+    std::vector<unsigned> variables;
+    /// The column of every variable, and further columns of the input that
+    /// have to hold the same value
+    std::vector<SelectInfo> columns;
+    std::vector<std::pair<SelectInfo, SelectInfo>> equal_columns;
+    /// The positions of the input's tuples in sorted order
+    std::vector<uint64_t> positions;
+    /// The values of every variable in sorted order
+    std::vector<std::vector<uint64_t>> keys;
+  };
+
+  /// The inputs
+  std::vector<std::unique_ptr<Operator>> inputs_;
+  /// The predicates between the inputs
+  std::vector<PredicateInfo> predicates_;
+  /// The sorted inputs
+  std::vector<Trie> tries_;
+  /// The inputs that contain every variable and the variable's level in
+  /// their tries
+  std::vector<std::vector<std::pair<unsigned, unsigned>>> participants_;
+  /// Columns that have been requested
+  std::unordered_set<SelectInfo> requested_columns_;
+  /// The input of every requested column
+  std::vector<std::pair<SelectInfo, unsigned>> requested_inputs_;
+  /// The row ids of every input that are passed to the result
+  std::vector<std::vector<RowIdColumn>> copy_ids_;
 
  private:
-  /// Copy tuple to result
-  void copy2Result(uint64_t id);
+  /// Derive the variables, run the inputs and sort them in parallel (split
+  /// on ranges of the first variable's values)
+  void prepare();
+  /// The input that contains a column
+  unsigned inputOf(const SelectInfo &info);
+  /// Bind the variables from v on within the ranges and call
+  /// emit(ranges) for every combination of values
+  template<typename Emit>
+  void bind(unsigned v, Ranges &ranges, Emit &emit) const;
+  /// Bind variable v to the values of the driver input's tuples that start
+  /// at the positions [from, to) of its range
+  template<typename Emit>
+  void bindValues(unsigned v,
+                  unsigned driver,
+                  uint64_t from,
+                  uint64_t to,
+                  Ranges &ranges,
+                  Emit &emit) const;
+  /// Bind all variables in parallel (split on the values of the first one)
+  template<typename Emit>
+  void bindAll(Emit &&emit) const;
 
  public:
-  /// The constructor
-  SelfJoin(std::unique_ptr<Operator> &&input, PredicateInfo &p_info)
-      : input_(std::move(input)), p_info_(p_info) {};
+  /// The constructor. Every predicate has to connect two inputs; their
+  /// join graph has to be connected.
+  MultiwayJoin(std::vector<std::unique_ptr<Operator>> &&inputs,
+               std::vector<PredicateInfo> predicates)
+      : inputs_(std::move(inputs)), predicates_(std::move(predicates)) {};
   /// Require a column and add it to results
   bool require(SelectInfo info) override;
   /// Run
   void run() override;
+  /// Push the result to a consumer without materializing it
+  void produce(Consumer &consumer) override;
+  /// Apply a join filter in the scans of the inputs
+  bool pushJoinFilter(const JoinFilter &filter,
+                      const SelectInfo &column) override {
+    for (auto &input : inputs_) {
+      if (input->pushJoinFilter(filter, column))
+        return true;
+    }
+    return false;
+  }
 };
 
 class Checksum : public Operator {
@@ -183,12 +772,21 @@ class Checksum : public Operator {
   const std::vector<SelectInfo> col_info_;
 
   std::vector<uint64_t> check_sums_;
+  /// Whether the input pushes its tuples into the sums (pipelined) instead
+  /// of materializing them
+  bool pipelined_;
+
+ private:
+  /// Let the input push its tuples into running sums
+  void runPipelined();
 
  public:
   /// The constructor
   Checksum(std::unique_ptr<Operator> &&input,
-           std::vector<SelectInfo> col_info)
-      : input_(std::move(input)), col_info_(std::move(col_info)) {};
+           std::vector<SelectInfo> col_info,
+           bool pipelined = false)
+      : input_(std::move(input)), col_info_(std::move(col_info)),
+        pipelined_(pipelined) {};
   /// Request a column and add it to results
   bool require(SelectInfo info) override {
     // check sum is always on the highest level
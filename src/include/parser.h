@@ -56,6 +56,15 @@ struct FilterInfo {
         constant(constant),
         comparison(comparison) {};
 
+  /// Whether a value passes the filter
+  bool passes(uint64_t value) const {
+    switch (comparison) {
+      case Comparison::Less:return value < constant;
+      case Comparison::Greater:return value > constant;
+      default:return value == constant;
+    }
+  }
+
   /// Dump SQL
   std::string dumpSQL();
   /// Dump text format
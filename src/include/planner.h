@@ -0,0 +1,108 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+#include "parser.h"
+#include "relation.h"
+#include "statistics.h"
+
+/// A node of a join tree
+struct PlanNode {
+  /// The bindings of the subtree (bit i is set for binding i)
+  uint64_t bindings;
+  /// The estimated result size
+  double cardinality;
+  /// The estimated cost of the subtree
+  double cost;
+  /// The inputs of a join (nullptr for a base relation). The hash table is
+  /// built on left, the input with the smaller estimate.
+  std::unique_ptr<PlanNode> left, right;
+  /// The binding of a base relation
+  unsigned binding = 0;
+  /// The predicates evaluated by this node. The first one of a join is the
+  /// hash join predicate (oriented left to right), all others (and all of a
+  /// base relation) are applied by self joins on top.
+  std::vector<PredicateInfo> predicates;
+
+  /// Whether the node is a base relation
+  bool isLeaf() const { return !left; }
+};
+
+/// A cost-based join optimizer. Connected subgraphs of the join graph are
+/// enumerated with DPccp to find the cheapest bushy tree without cross
+/// products; queries with many relations are ordered greedily (GOO). The
+/// cost of a tree is the sum of its intermediate result sizes plus the
+/// sizes of the hash tables it builds. Cardinalities are estimated with the
+/// statistics catalog if it has been built, otherwise from samples.
+class Planner {
+ public:
+  /// Queries with more bindings are ordered greedily
+  static constexpr unsigned kMaxDPBindings = 14;
+  /// The number of tuples sampled to estimate the selectivity of filters
+  /// (without statistics)
+  static constexpr uint64_t kSampleSize = 1024;
+
+ private:
+  /// The best plan of a connected set of bindings
+  struct Entry {
+    /// The estimated result size and cost
+    double cardinality, cost;
+    /// The bindings of the build (left) and probe (right) input (0 for a
+    /// base relation)
+    uint64_t left, right;
+  };
+
+  /// The relations
+  const std::vector<Relation> &relations_;
+  /// The query
+  const QueryInfo &query_;
+  /// The column statistics (nullptr if not available)
+  const StatisticsCatalog *statistics_;
+  /// The maximum number of bindings to order with dynamic programming
+  unsigned max_dp_bindings_;
+  /// The number of bindings
+  unsigned num_bindings_;
+  /// The bindings adjacent to every binding in the join graph
+  std::vector<uint64_t> neighbors_;
+  /// The predicates between two different bindings and their selectivity
+  std::vector<PredicateInfo> join_predicates_;
+  std::vector<double> join_selectivities_;
+  /// The best plan of every connected set of bindings
+  std::unordered_map<uint64_t, Entry> plans_;
+
+ private:
+  /// Estimate the size of a base relation after its filters
+  double estimateBase(unsigned binding) const;
+  /// The number of distinct values of a column
+  double distinctValues(const SelectInfo &info) const;
+  /// The bindings adjacent to a set of bindings
+  uint64_t neighbors(uint64_t bindings) const;
+  /// Consider joining two disjoint connected sets
+  void emitPair(uint64_t left, uint64_t right);
+  /// Enumerate the connected supersets of bindings that extend it with
+  /// neighbors outside of excluded (DPccp)
+  template<typename Fn>
+  void enumerateCsgRec(uint64_t bindings, uint64_t excluded, Fn &&emit);
+  /// Find the best plan with dynamic programming
+  void planDP();
+  /// Find a plan by greedily joining the pair with the smallest result
+  void planGreedy();
+  /// Turn the plan of a set of bindings into a tree
+  std::unique_ptr<PlanNode> buildTree(uint64_t bindings) const;
+
+ public:
+  /// The constructor
+  Planner(const std::vector<Relation> &relations,
+          const QueryInfo &query,
+          const StatisticsCatalog *statistics = nullptr,
+          unsigned max_dp_bindings = kMaxDPBindings);
+
+  /// Find the join order and the build sides of the query
+  std::unique_ptr<PlanNode> plan();
+  /// The estimated tuples of a plan's intermediate results beyond its
+  /// result, relative to the tuples of its base relations
+  static double danglingRatio(const PlanNode &plan);
+};
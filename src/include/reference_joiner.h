@@ -0,0 +1,31 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "parser.h"
+#include "relation.h"
+
+/// Joins queries the plainest way, as an oracle for the results of Joiner:
+/// the bindings are joined left-deep in the order of the query, each with a
+/// std::unordered_multimap on its filtered tuples, and the checksum sums the
+/// selected columns over the materialized row ids. It uses no statistics,
+/// indexes, compressed columns, caches, join filters or threads.
+class ReferenceJoiner {
+ private:
+  /// The relations that might be joined
+  const std::vector<Relation> &relations_;
+
+  /// The row ids of a binding that pass its filters and the predicates
+  /// among its columns
+  std::vector<uint64_t> scan(const QueryInfo &query, unsigned binding) const;
+
+ public:
+  /// The constructor
+  explicit ReferenceJoiner(const std::vector<Relation> &relations)
+      : relations_(relations) {}
+
+  /// Joins a query, the result is formatted like that of Joiner::join
+  std::string join(const QueryInfo &query) const;
+};
@@ -1,26 +1,81 @@
 #pragma once
 
 #include <cstdint>
+#include <memory>
 #include <string>
 #include <vector>
 
+#include "compressed_column.h"
+#include "hash_table.h"
+#include "sorted_index.h"
+#include "zone_map.h"
+
 using RelationId = unsigned;
 
+/// How a relation file is loaded
+struct LoadOptions {
+  /// Read the file and populate the page tables of its mapping while
+  /// loading, instead of faulting every page in on its first access
+  bool prefault = true;
+  /// Copy relations of at least huge_page_min_bytes into anonymous memory
+  /// backed by transparent huge pages (fewer TLB misses on random access)
+  bool huge_pages = false;
+  uint64_t huge_page_min_bytes = 1ull << 21;
+};
+
 class Relation {
+ public:
+  /// The first word of a columnar (v2) relation file. The first word of the
+  /// original (v1) format is the number of tuples.
+  static constexpr uint64_t kFileMagic = 0x3276'4c45'5242'4424ull;
+  /// The version of the columnar format
+  static constexpr uint64_t kFileVersion = 2;
+  /// The size of the header of a columnar file, the default alignment of
+  /// its segments
+  static constexpr uint64_t kPageSize = 1ull << 12;
+  /// The most columns that a relation file without tuples may declare (the
+  /// file's length bounds those of other files)
+  static constexpr uint64_t kMaxColumns = 1ull << 16;
+
  private:
+  /// A memory mapping that holds the columns
+  struct Mapping {
+    void *addr;
+    size_t length;
+    /// Unmaps the memory
+    ~Mapping();
+  };
+
   /// Owns memory (false if it was mmaped)
   bool owns_memory_;
   /// The number of tuples
   uint64_t size_;
   /// The join column containing the keys
   std::vector<uint64_t *> columns_;
+  /// The zone map of every column
+  std::vector<ZoneMap> zone_maps_;
+  /// The sorted index of every column (nullptr if not built)
+  std::vector<std::unique_ptr<SortedIndex>> sorted_indexes_;
+  /// The hash index (value -> row ids) of every column (nullptr if not
+  /// built)
+  std::vector<std::unique_ptr<HashTable>> hash_indexes_;
+  /// The compressed copy of every column that scans filter on (nullptr if
+  /// not compressed)
+  std::vector<std::unique_ptr<CompressedColumn>> compressed_columns_;
+  /// The mappings of the columns and the persisted indexes (empty if the
+  /// columns were allocated)
+  std::vector<std::unique_ptr<Mapping>> mappings_;
 
  public:
   /// Constructor without mmap
   Relation(uint64_t size, std::vector<uint64_t *> &&columns)
-      : owns_memory_(true), size_(size), columns_(columns) {}
-  /// Constructor using mmap
-  explicit Relation(const char *file_name);
+      : owns_memory_(true), size_(size), columns_(columns) {
+    buildZoneMaps();
+  }
+  /// Constructor using mmap. Throws std::runtime_error if the file cannot
+  /// be mapped or its header does not match its length.
+  explicit Relation(const char *file_name,
+                    const LoadOptions &options = LoadOptions());
   /// Delete copy constructor
   Relation(const Relation &other) = delete;
   /// Move constructor
@@ -31,6 +86,12 @@ class Relation {
 
   /// Stores a relation into a file (binary)
   void storeRelation(const std::string &file_name);
+  /// Stores a relation into a columnar file (v2): a header page, a segment
+  /// per column and per sorted index aligned to `alignment` (e.g., 4K or 2M
+  /// for huge pages) and a footer with the zone maps and the compressed
+  /// copies of the columns. Loading it needs no preparation.
+  void storeRelationV2(const std::string &file_name,
+                       uint64_t alignment = kPageSize) const;
   /// Stores a relation into a file (csv)
   void storeRelationCSV(const std::string &file_name);
   /// Dump SQL: Create and load table (PostgreSQL)
@@ -40,9 +101,43 @@ class Relation {
   uint64_t size() const { return size_; }
   /// The join column containing the keys
   const std::vector<uint64_t *> &columns() const { return columns_; }
+  /// The zone map of a column
+  const ZoneMap &zoneMap(unsigned col_id) const { return zone_maps_[col_id]; }
+  /// Build the sorted index of a column (the columns can be indexed in
+  /// parallel)
+  void buildSortedIndex(unsigned col_id);
+  /// The sorted index of a column (nullptr if not built)
+  const SortedIndex *sortedIndex(unsigned col_id) const {
+    return sorted_indexes_[col_id].get();
+  }
+  /// Build the hash index of a column, sized for the expected number of
+  /// distinct values (the columns can be indexed in parallel)
+  void buildHashIndex(unsigned col_id, uint64_t expected_keys = 0);
+  /// The hash index of a column (nullptr if not built)
+  const HashTable *hashIndex(unsigned col_id) const {
+    return hash_indexes_[col_id].get();
+  }
+  /// Compress a column with the given bounds and (estimated) number of
+  /// distinct values (the columns can be compressed in parallel). Returns
+  /// false if the column does not compress.
+  bool compressColumn(unsigned col_id,
+                      uint64_t min,
+                      uint64_t max,
+                      double distinct);
+  /// The compressed copy of a column (nullptr if not compressed)
+  const CompressedColumn *compressedColumn(unsigned col_id) const {
+    return compressed_columns_[col_id].get();
+  }
 
  private:
   /// Loads data from a file
-  void loadRelation(const char *file_name);
+  void loadRelation(const char *file_name, const LoadOptions &options);
+  /// Use the columns, zone maps and indexes of a mapped columnar file
+  void loadColumnar(const char *addr, uint64_t length, const char *file_name);
+  /// Copy the columns into anonymous memory backed by huge pages. Keeps the
+  /// current mapping if no memory can be mapped.
+  void copyToHugePages();
+  /// Build the zone maps of all columns (and make room for their indexes)
+  void buildZoneMaps();
 };
 
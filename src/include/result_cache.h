@@ -0,0 +1,83 @@
+#pragma once
+
+#include <cstdint>
+#include <list>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+#include "parser.h"
+
+/// A memory-bounded cache of query results. The result of a query depends
+/// only on its relations, predicates, filters and projections, thus results
+/// are keyed on a canonical form of the query (see key()): repeated queries
+/// and queries that differ only in the order of their relations, predicates
+/// and filters or in the sides of their predicates share an entry. Entries
+/// are evicted in least recently used order once the limit is exceeded. The
+/// cache is thread-safe.
+class ResultCache {
+ public:
+  /// The lookups of results
+  struct Counters {
+    /// Lookups with and without entry
+    uint64_t hits = 0, misses = 0;
+    /// The entries that were added and evicted
+    uint64_t insertions = 0, evictions = 0;
+
+    /// The fraction of the lookups that hit
+    double hitRate() const {
+      return hits + misses ? double(hits) / double(hits + misses) : 0.0;
+    }
+  };
+
+ private:
+  /// A cached result
+  struct Entry {
+    std::string key, result;
+  };
+  using Entries = std::list<Entry>;
+
+  /// The most memory that the entries may use in bytes
+  uint64_t limit_;
+  /// The memory used by the entries in bytes
+  uint64_t memory_ = 0;
+  /// Protects the entries and the counters
+  mutable std::mutex mutex_;
+  /// The entries, the least recently used first
+  Entries entries_;
+  /// The entries by key
+  std::unordered_map<std::string, Entries::iterator> index_;
+  /// The lookups
+  Counters counters_;
+
+  /// The memory of an entry in bytes (with the list and index nodes)
+  static uint64_t memory(const std::string &key, const std::string &result) {
+    return 2 * key.size() + result.size() + 8 * sizeof(void *)
+        + sizeof(Entry);
+  }
+
+ public:
+  /// The constructor
+  explicit ResultCache(uint64_t limit) : limit_(limit) {}
+
+  /// Find the result of a query by its key. Returns false on a miss.
+  bool find(const std::string &key, std::string &result);
+  /// Add the result of a query and evict the least recently used ones that
+  /// exceed the limit (a result larger than the limit is not added)
+  void insert(const std::string &key, const std::string &result);
+  /// Remove all entries (the counters are kept)
+  void clear();
+
+  /// The lookups
+  Counters counters() const;
+  /// The memory used by the entries in bytes
+  uint64_t memory() const;
+  /// The most memory that the entries may use in bytes
+  uint64_t limit() const { return limit_; }
+
+  /// The canonical form of a query in the text format: the bindings are
+  /// renumbered by their relation, filters and join neighbours, the sides
+  /// of every predicate are ordered, and the predicates and filters are
+  /// sorted without duplicates. The projections keep their order.
+  static std::string key(const QueryInfo &query);
+};
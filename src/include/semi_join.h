@@ -0,0 +1,57 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "parser.h"
+#include "planner.h"
+
+class Joiner;
+
+/// The tuples of the bindings of a query that remain after semi-join
+/// reduction
+struct SemiJoinReduction {
+  /// The row ids of every binding in ascending order (nullptr if the
+  /// binding was not reduced)
+  std::vector<std::shared_ptr<const std::vector<uint64_t>>> row_ids;
+  /// The tuples of all bindings that pass their filters, and those that
+  /// participate in the result
+  uint64_t filtered_tuples = 0, reduced_tuples = 0;
+};
+
+/// A full reducer for acyclic queries (Yannakakis): the tuples of every
+/// binding are kept in a bitmap on the row ids of its relation. A semi-join
+/// pass from the leaves of the join tree to its root and one back clear the
+/// tuples without a join partner, after which every remaining tuple is part
+/// of the result (unless several predicates connect the same bindings).
+/// Joins on the reduced inputs then produce no intermediate tuples that a
+/// later join throws away.
+class SemiJoinReducer {
+ public:
+  /// Queries with fewer bindings are not reduced (their join eliminates the
+  /// same tuples)
+  static constexpr unsigned kMinBindings = 3;
+  /// A query is reduced only if the plan's intermediate results are
+  /// estimated to hold this many times more tuples than its inputs that do
+  /// not reach the result (each pass costs about one hash join per edge)
+  static constexpr double kMinDangling = 1.0;
+
+ private:
+  /// The joiner whose relations are reduced
+  const Joiner &joiner_;
+
+ public:
+  /// The constructor
+  explicit SemiJoinReducer(const Joiner &joiner) : joiner_(joiner) {}
+
+  /// Whether the join graph of a query (ignoring predicates within a
+  /// binding and parallel predicates) is a forest
+  static bool isAcyclic(const QueryInfo &query);
+  /// Whether reducing the query pays off: it is acyclic, has at least
+  /// kMinBindings bindings, and the plan's intermediate results are
+  /// estimated to exceed the query's result by more than its inputs
+  static bool pays(const PlanNode &plan, const QueryInfo &query);
+  /// Reduce the bindings of an acyclic query
+  SemiJoinReduction reduce(QueryInfo &query) const;
+};
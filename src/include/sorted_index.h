@@ -0,0 +1,36 @@
+#pragma once
+
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+/// A secondary index on one column: the row ids of the relation sorted by
+/// the column's values (a sorted permutation). The tuples with a value in a
+/// range are found by binary search and are consecutive in the index.
+class SortedIndex {
+ private:
+  /// The indexed column
+  const uint64_t *column_ = nullptr;
+  /// The row ids sorted by value (and row id)
+  const uint64_t *row_ids_ = nullptr;
+  /// The number of indexed tuples
+  uint64_t size_ = 0;
+  /// The row ids if the index was built (not mapped)
+  std::vector<uint64_t> built_row_ids_;
+
+ public:
+  /// Build the index of a column
+  void build(const uint64_t *column, uint64_t size);
+  /// Use row ids that were built before (e.g., persisted in a relation
+  /// file) as the index of a column
+  void map(const uint64_t *column, const uint64_t *row_ids, uint64_t size);
+
+  /// The positions [begin, end) of the row ids with a value in [low, high]
+  std::pair<uint64_t, uint64_t> range(uint64_t low, uint64_t high) const;
+  /// The row ids sorted by value
+  const uint64_t *row_ids() const { return row_ids_; }
+  /// The number of indexed tuples
+  uint64_t size() const { return size_; }
+  /// The memory used by the index in bytes
+  uint64_t memory() const { return size_ * sizeof(uint64_t); }
+};
@@ -0,0 +1,91 @@
+#pragma once
+
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+#include "parser.h"
+#include "relation.h"
+
+/// A HyperLogLog sketch that estimates the number of distinct values
+class HyperLogLog {
+ public:
+  /// The number of index bits (2^kPrecision registers)
+  static constexpr unsigned kPrecision = 12;
+
+ private:
+  /// The maximum rank seen by every register
+  std::vector<uint8_t> registers_;
+
+ public:
+  /// The constructor
+  HyperLogLog() : registers_(1u << kPrecision, 0) {};
+
+  /// Add a value
+  void add(uint64_t value);
+  /// Add all values of another sketch
+  void merge(const HyperLogLog &other);
+  /// The estimated number of distinct values
+  double estimate() const;
+};
+
+/// The statistics of one column
+struct ColumnStatistics {
+  /// The number of buckets of the histogram
+  static constexpr unsigned kHistogramBuckets = 64;
+  /// The maximum number of most common values
+  static constexpr unsigned kMostCommonValues = 16;
+  /// The number of values sampled for the histogram and the most common
+  /// values
+  static constexpr uint64_t kSampleSize = 1ull << 16;
+
+  /// The number of tuples
+  uint64_t size = 0;
+  /// The smallest and largest value
+  uint64_t min = 0, max = 0;
+  /// The estimated number of distinct values
+  double distinct = 0;
+  /// Whether every value occurs once
+  bool unique = false;
+  /// An equi-depth histogram: the largest value of every bucket, each
+  /// bucket holds the same number of tuples
+  std::vector<uint64_t> bounds;
+  /// The most common values and their estimated number of occurrences
+  std::vector<std::pair<uint64_t, uint64_t>> most_common;
+
+  /// Compute the statistics of a column
+  static ColumnStatistics compute(const uint64_t *column, uint64_t size);
+
+  /// The estimated fraction of tuples with a value less than constant
+  double lessFraction(uint64_t constant) const;
+  /// The estimated fraction of tuples that pass a filter
+  double selectivity(FilterInfo::Comparison comparison,
+                     uint64_t constant) const;
+  /// Whether every tuple passes a filter
+  bool alwaysPasses(FilterInfo::Comparison comparison,
+                    uint64_t constant) const;
+};
+
+/// The statistics of every column of every relation, computed in the
+/// preparation phase
+class StatisticsCatalog {
+ private:
+  /// The statistics of every column, by relation id
+  std::vector<std::vector<ColumnStatistics>> relations_;
+
+ public:
+  /// Compute the statistics of all relations, the columns are processed in
+  /// parallel on the global thread pool
+  void build(const std::vector<Relation> &relations);
+
+  /// Whether the statistics have been computed
+  bool empty() const { return relations_.empty(); }
+  /// The statistics of a column
+  const ColumnStatistics &column(RelationId rel_id, unsigned col_id) const {
+    return relations_[rel_id][col_id];
+  }
+  /// The statistics of a column
+  const ColumnStatistics &column(const SelectInfo &info) const {
+    return column(info.rel_id, info.col_id);
+  }
+};
@@ -0,0 +1,145 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/// A work-stealing pool of worker threads that processes ranges of tuples in
+/// morsels. Every parallelFor is a job whose morsels form a task on the
+/// deque of the calling thread; a thread splits the task it runs in halves
+/// and pushes the upper halves back, idle threads steal the oldest (largest)
+/// task of the deque with the most queued morsels. Jobs nest: a batch of
+/// queries is a job whose tasks submit the morsels of the operators, thus
+/// threads that finish their queries help the queries that are behind. The
+/// calling thread takes part in the work, thus a pool with one thread has no
+/// workers and runs everything on the caller.
+class ThreadPool {
+ public:
+  /// The number of tuples per morsel
+  static constexpr uint64_t kMorselSize = 1ull << 12;
+  /// A thread that waits for its job and finds no task yields this many
+  /// times before it sleeps
+  static constexpr unsigned kWaitSpins = 16;
+  /// Jobs nested this deep run on the calling thread
+  static constexpr unsigned kMaxDepth = 16;
+  /// Function that processes the tuples [begin, end)
+  using MorselFn = std::function<void(uint64_t begin, uint64_t end)>;
+
+ private:
+  /// A parallelFor call
+  struct Job {
+    /// The function and the range it processes
+    const MorselFn *fn;
+    uint64_t size, morsel_size;
+    /// The nesting depth of the calling thread
+    unsigned depth;
+    /// The morsels that are not processed yet
+    std::atomic<uint64_t> pending;
+
+    /// The constructor
+    Job(const MorselFn *fn,
+        uint64_t size,
+        uint64_t morsel_size,
+        unsigned depth,
+        uint64_t num_morsels)
+        : fn(fn),
+          size(size),
+          morsel_size(morsel_size),
+          depth(depth),
+          pending(num_morsels) {}
+  };
+  /// The morsels [begin, end) of a job
+  struct Task {
+    Job *job;
+    uint64_t begin, end;
+  };
+  /// The tasks of a thread: its owner pushes and pops at the back, thieves
+  /// steal from the front
+  struct Deque {
+    /// Protects the tasks
+    std::mutex mutex;
+    std::deque<Task> tasks;
+    /// The number of morsels of the tasks (read without the lock to pick a
+    /// victim)
+    std::atomic<uint64_t> morsels{0};
+  };
+
+  /// The worker threads
+  std::vector<std::thread> workers_;
+  /// The deque of every worker (index i + 1 for worker i) and of the
+  /// threads outside of the pool (index 0)
+  std::vector<std::unique_ptr<Deque>> deques_;
+  /// The number of tasks in all deques per nesting depth of their job
+  std::atomic<uint64_t> queued_[kMaxDepth] = {};
+  /// Idle workers sleep until tasks are queued (or the pool stops)
+  std::mutex sleep_mutex_;
+  std::condition_variable sleep_cv_;
+  /// Threads that wait for their job sleep until it is done or tasks that
+  /// they may take are queued. They wait on their own condition variable,
+  /// since a notification for a task that they may not take must reach a
+  /// worker.
+  std::condition_variable wait_cv_;
+  /// The number of sleeping threads, and of those that wait for a job
+  std::atomic<unsigned> sleeping_{0}, waiting_{0};
+  /// Set to stop the workers
+  std::atomic<bool> stop_{false};
+  /// The number of tasks taken from the deque of another thread
+  std::atomic<uint64_t> steals_{0};
+
+ private:
+  /// The deque of the calling thread
+  unsigned self() const;
+  /// The number of queued tasks of jobs nested at least min_depth deep
+  uint64_t queued(unsigned min_depth) const;
+  /// Queue a task on a deque
+  void push(unsigned deque, const Task &task);
+  /// Take the newest task of the own deque if its job is nested at least
+  /// min_depth deep
+  bool pop(unsigned deque, unsigned min_depth, Task &task);
+  /// Take the oldest task of a job nested at least min_depth deep from the
+  /// deque with the most queued morsels
+  bool steal(unsigned thief, unsigned min_depth, Task &task);
+  /// Split a task until one morsel is left and process it
+  void execute(unsigned deque, Task task);
+  /// Process tasks until the job is done
+  void wait(unsigned deque, const Job &job);
+  /// The main loop of a worker
+  void work(unsigned deque);
+
+ public:
+  /// The constructor. Pinned workers are bound to one core each.
+  explicit ThreadPool(unsigned num_threads, bool pin = false);
+  /// The destructor
+  ~ThreadPool();
+
+  /// Run fn on all morsels of [0, size) and return when all are processed.
+  /// Calls from within fn (nested jobs) are processed in parallel as well.
+  void parallelFor(uint64_t size, uint64_t morsel_size, const MorselFn &fn);
+  /// Run fn on all morsels of [0, size) with the default morsel size
+  void parallelFor(uint64_t size, const MorselFn &fn) {
+    parallelFor(size, kMorselSize, fn);
+  }
+
+  /// The number of threads including the caller
+  unsigned num_threads() const { return workers_.size() + 1; }
+  /// The number of threads that sleep for lack of tasks (no thread would
+  /// help with a job if 0)
+  unsigned idle_threads() const { return sleeping_; }
+  /// The number of tasks that were stolen
+  uint64_t steals() const { return steals_; }
+
+  /// The pool used by the operators
+  static ThreadPool &global();
+  /// Replace the pool used by the operators (0 = number of cores)
+  static void setGlobalThreads(unsigned num_threads, bool pin = false);
+  /// The number of morsels of a range
+  static uint64_t numMorsels(uint64_t size, uint64_t morsel_size = kMorselSize) {
+    return (size + morsel_size - 1) / morsel_size;
+  }
+};
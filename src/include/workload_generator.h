@@ -0,0 +1,135 @@
+#pragma once
+
+#include <cstdint>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "relation.h"
+
+/// Draws ranks in [1, n] with P(k) ~ 1 / k^skew by rejection-inversion
+/// (Hörmann and Derflinger), in constant time and memory for any n
+class ZipfDistribution {
+ private:
+  /// The number of ranks
+  uint64_t n_;
+  /// The skew
+  double skew_;
+  /// The integral of h at 1.5 minus h(1) and at n + 0.5
+  double h_integral_x1_, h_integral_n_;
+  /// The threshold below which a rank is accepted without evaluating h
+  double threshold_;
+
+  /// The density x^-skew
+  double h(double x) const;
+  /// Its integral (up to a constant)
+  double hIntegral(double x) const;
+  /// The inverse of the integral
+  double hIntegralInverse(double x) const;
+
+ public:
+  /// The constructor
+  ZipfDistribution(uint64_t n, double skew);
+
+  /// Draw a rank
+  uint64_t operator()(std::mt19937_64 &rng) const;
+};
+
+/// Generates relations and queries in the format of the contest at any
+/// scale. Every relation has a primary key (column 0), foreign keys that
+/// reference the primary keys and attribute columns for filters. All keys
+/// lie in the domain [0, size of the largest relation) and the keys of a
+/// relation are a prefix of a permutation of it, thus each foreign key
+/// column joins with the primary key of every relation. Queries only join a
+/// foreign key with a primary key, so the size of a result is bounded by the
+/// size of the relation at the root of its query graph.
+class WorkloadGenerator {
+ public:
+  /// The distribution of the foreign keys and attributes: uniform over the
+  /// key domain (some foreign keys match no tuple), Zipf-skewed ranks (the
+  /// small ranks are frequent) or uniform over the keys that every relation
+  /// contains (every foreign key matches a tuple)
+  enum class Distribution { Uniform, Zipf, ForeignKey };
+  /// The shape of a query graph
+  enum class Shape { Chain, Star, Cycle, Clique };
+
+  struct Config {
+    /// Relations have between 10% and 100% of scale * kBaseSize tuples
+    double scale = 1.0;
+    /// The number of relations
+    unsigned num_relations = 10;
+    /// The number of foreign key and attribute columns per relation
+    unsigned num_foreign_keys = 3, num_attributes = 2;
+    /// The distribution of the foreign keys and attributes
+    Distribution distribution = Distribution::Uniform;
+    /// The skew of the Zipf distribution
+    double skew = 1.0;
+    /// The shapes of the query graphs, picked at random
+    std::vector<Shape> shapes{Shape::Chain, Shape::Star, Shape::Cycle,
+                              Shape::Clique};
+    /// The number of relations per query (at least two)
+    unsigned min_joined = 2, max_joined = 4;
+    /// The number of queries and queries per batch
+    unsigned num_queries = 100, batch_size = 10;
+    /// The probability that a relation of a query is filtered and the
+    /// fraction of its tuples that the filter selects
+    double filter_probability = 0.5, selectivity = 0.1;
+    /// The seed of the random numbers
+    uint64_t seed = 42;
+  };
+
+  /// The relation size at scale 1
+  static constexpr uint64_t kBaseSize = 100000;
+  /// Attribute values lie in [0, kAttributeDomain)
+  static constexpr uint64_t kAttributeDomain = 10000;
+
+ private:
+  /// The configuration
+  Config config_;
+  /// The random numbers
+  std::mt19937_64 rng_;
+  /// The key domain (the size of the largest relation)
+  uint64_t domain_ = 0;
+  /// The size of the smallest relation, its keys are in every relation
+  uint64_t common_keys_ = 0;
+  /// A multiplier that is coprime to the domain, i * stride_ % domain_
+  /// permutes the domain
+  uint64_t stride_ = 1;
+  /// The size of every relation
+  std::vector<uint64_t> sizes_;
+
+  /// The i-th value of the permutation of the domain
+  uint64_t key(uint64_t i) const { return (i % domain_) * stride_ % domain_; }
+  /// Fill a column with ranks in [0, n) of the configured distribution
+  /// that are mapped to values by map
+  template <typename Map>
+  void fill(std::mt19937_64 &rng, uint64_t *column, uint64_t size, uint64_t n,
+            Map map) const;
+  /// P(attribute < c) for every c in [0, kAttributeDomain]
+  std::vector<double> cumulative() const;
+  /// The edges (a, b) of a query graph of count bindings, each is joined on
+  /// the next foreign key of a and the primary key of b
+  static std::vector<std::pair<unsigned, unsigned>> edges(Shape shape,
+                                                          unsigned count);
+
+ public:
+  /// The constructor. Throws std::invalid_argument if the configuration
+  /// admits no query.
+  explicit WorkloadGenerator(const Config &config);
+
+  /// The number of columns of every relation
+  unsigned numColumns() const {
+    return 1 + config_.num_foreign_keys + config_.num_attributes;
+  }
+  /// The size of the i-th relation
+  uint64_t size(unsigned i) const { return sizes_[i]; }
+  /// Generate the i-th relation (independently of the others)
+  Relation relation(unsigned i) const;
+  /// Generate the queries, a line "F" ends each batch
+  std::vector<std::string> queries();
+
+  /// Parse the name of a distribution or shape. Throws
+  /// std::invalid_argument for unknown names.
+  static Distribution parseDistribution(const std::string &name);
+  static Shape parseShape(const std::string &name);
+};
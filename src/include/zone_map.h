@@ -0,0 +1,48 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+/// The minimum and maximum value of every block of a column. Scans use them
+/// to skip blocks without qualifying tuples and to accept blocks whose tuples
+/// all qualify without evaluating them.
+class ZoneMap {
+ public:
+  /// The number of tuples per block
+  static constexpr uint64_t kBlockSize = 1ull << 12;
+
+  /// The values of one block
+  struct Zone {
+    uint64_t min, max;
+  };
+  /// Which tuples of a block can qualify
+  enum class Match { None, Some, All };
+
+ private:
+  /// The zone of every block
+  std::vector<Zone> zones_;
+
+ public:
+  /// Build the zones of a column
+  void build(const uint64_t *column, uint64_t size);
+  /// Use zones that were built before (e.g., persisted in a relation file)
+  void assign(const Zone *zones, uint64_t num_blocks) {
+    zones_.assign(zones, zones + num_blocks);
+  }
+
+  /// The number of blocks
+  uint64_t num_blocks() const { return zones_.size(); }
+  /// The zone of a block
+  const Zone &zone(uint64_t block) const { return zones_[block]; }
+  /// Which tuples of a block have a value in [low, high]
+  Match match(uint64_t block, uint64_t low, uint64_t high) const {
+    auto &zone = zones_[block];
+    if (low > high || zone.max < low || zone.min > high)
+      return Match::None;
+    if (zone.min >= low && zone.max <= high)
+      return Match::All;
+    return Match::Some;
+  }
+  /// The memory used by the zones in bytes
+  uint64_t memory() const { return zones_.size() * sizeof(Zone); }
+};
@@ -0,0 +1,224 @@
+#include "intermediate_cache.h"
+
+#include <algorithm>
+
+namespace {
+
+// Whether every tuple that passes filters passes the cached filters
+bool subsumes(const std::vector<FilterInfo> &cached,
+              const std::vector<FilterInfo> &filters) {
+  return std::all_of(cached.begin(), cached.end(), [&](auto &c) {
+    return std::any_of(filters.begin(), filters.end(), [&](auto &f) {
+      return IntermediateCache::implies(f, c);
+    });
+  });
+}
+
+// Whether the tuples that pass two sets of filters are the same
+bool equivalent(const std::vector<FilterInfo> &cached,
+                const std::vector<FilterInfo> &filters) {
+  return subsumes(cached, filters)
+      && IntermediateCache::residual(filters, cached).empty();
+}
+
+// The memory of a hash table in bytes
+uint64_t tableMemory(const Join::HT &table) {
+#ifdef USE_STD_HASH_TABLE
+  return table.size() * 4 * sizeof(uint64_t);
+#else
+  return table.memory();
+#endif
+}
+
+}
+
+// Whether every tuple that passes filter passes implied as well
+bool IntermediateCache::implies(const FilterInfo &filter,
+                                const FilterInfo &implied) {
+  if (filter.filter_column.col_id != implied.filter_column.col_id)
+    return false;
+  switch (implied.comparison) {
+    case FilterInfo::Comparison::Less:
+      return (filter.comparison == FilterInfo::Comparison::Less
+          && filter.constant <= implied.constant)
+          || (filter.comparison == FilterInfo::Comparison::Equal
+              && filter.constant < implied.constant);
+    case FilterInfo::Comparison::Greater:
+      return (filter.comparison == FilterInfo::Comparison::Greater
+          && filter.constant >= implied.constant)
+          || (filter.comparison == FilterInfo::Comparison::Equal
+              && filter.constant > implied.constant);
+    case FilterInfo::Comparison::Equal:
+      return filter.comparison == FilterInfo::Comparison::Equal
+          && filter.constant == implied.constant;
+  }
+  return false;
+}
+
+// The filters that not every tuple passing the cached filters passes
+std::vector<FilterInfo> IntermediateCache::residual(
+    const std::vector<FilterInfo> &filters,
+    const std::vector<FilterInfo> &cached) {
+  std::vector<FilterInfo> residual;
+  for (auto &f : filters) {
+    if (std::none_of(cached.begin(), cached.end(),
+                     [&](auto &c) { return implies(c, f); }))
+      residual.push_back(f);
+  }
+  return residual;
+}
+
+// Add an entry and evict the least recently used ones
+void IntermediateCache::insert(Entry &&entry, Counters &counters) {
+  // An entry larger than the whole cache would evict everything
+  if (entry.memory > budget_)
+    return;
+  memory_ += entry.memory;
+  entries_.push_back(std::move(entry));
+  ++counters.insertions;
+  while (memory_ > budget_) {
+    auto &victim = entries_.front();
+    ++(victim.selection ? selection_counters_ : table_counters_).evictions;
+    memory_ -= victim.memory;
+    entries_.pop_front();
+  }
+}
+
+// Find an equivalent or the smallest subsuming selection
+std::shared_ptr<const IntermediateCache::Selection>
+IntermediateCache::findSelection(unsigned rel_id,
+                                 const std::vector<FilterInfo> &filters,
+                                 std::vector<FilterInfo> &residual) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto best = entries_.end();
+  for (auto it = entries_.begin(); it != entries_.end(); ++it) {
+    auto &selection = it->selection;
+    if (!selection || selection->rel_id != rel_id
+        || !subsumes(selection->filters, filters))
+      continue;
+    if (equivalent(selection->filters, filters)) {
+      best = it;
+      break;
+    }
+    if (best == entries_.end()
+        || selection->ids.size() < best->selection->ids.size())
+      best = it;
+  }
+  if (best == entries_.end()) {
+    ++selection_counters_.misses;
+    return nullptr;
+  }
+
+  residual = this->residual(filters, best->selection->filters);
+  ++(residual.empty() ? selection_counters_.hits
+                      : selection_counters_.subsumed_hits);
+  entries_.splice(entries_.end(), entries_, best);
+  return best->selection;
+}
+
+// Add a selection
+std::shared_ptr<const IntermediateCache::Selection>
+IntermediateCache::addSelection(Selection &&selection) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  for (auto &entry : entries_) {
+    if (entry.selection && entry.selection->rel_id == selection.rel_id
+        && equivalent(entry.selection->filters, selection.filters))
+      return entry.selection;
+  }
+  auto cached = std::make_shared<const Selection>(std::move(selection));
+  insert({cached, nullptr,
+          sizeof(Selection) + cached->ids.size() * sizeof(uint64_t)},
+         selection_counters_);
+  return cached;
+}
+
+// Find an equivalent or the smallest subsuming table
+std::shared_ptr<const IntermediateCache::Table>
+IntermediateCache::findTable(unsigned rel_id,
+                             unsigned col_id,
+                             const std::vector<FilterInfo> &filters,
+                             uint64_t max_size,
+                             const Relation &relation,
+                             std::vector<FilterInfo> &residual) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto best = entries_.end();
+  for (auto it = entries_.begin(); it != entries_.end(); ++it) {
+    auto &table = it->table;
+    if (!table || table->rel_id != rel_id || table->col_id != col_id
+        || !subsumes(table->filters, filters))
+      continue;
+    if (equivalent(table->filters, filters)) {
+      best = it;
+      break;
+    }
+    // Probing a much larger table costs more than building a new one
+    if (table->size(relation) <= max_size
+        && (best == entries_.end()
+            || table->size(relation) < best->table->size(relation)))
+      best = it;
+  }
+  if (best == entries_.end()) {
+    ++table_counters_.misses;
+    return nullptr;
+  }
+
+  residual = this->residual(filters, best->table->filters);
+  ++(residual.empty() ? table_counters_.hits : table_counters_.subsumed_hits);
+  entries_.splice(entries_.end(), entries_, best);
+  return best->table;
+}
+
+// Add a table
+std::shared_ptr<const IntermediateCache::Table>
+IntermediateCache::addTable(Table &&table) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  for (auto &entry : entries_) {
+    if (entry.table && entry.table->rel_id == table.rel_id
+        && entry.table->col_id == table.col_id
+        && equivalent(entry.table->filters, table.filters))
+      return entry.table;
+  }
+  auto cached = std::make_shared<const Table>(std::move(table));
+  // The table keeps its selection alive, thus it is counted as well
+  auto memory = sizeof(Table) + tableMemory(cached->table);
+  if (cached->selection)
+    memory += cached->selection->ids.size() * sizeof(uint64_t);
+  insert({nullptr, cached, memory}, table_counters_);
+  return cached;
+}
+
+// Whether the entry of a key that missed should be added
+bool IntermediateCache::admit(unsigned rel_id,
+                              unsigned col_id,
+                              const std::vector<FilterInfo> &filters) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  for (auto it = misses_.begin(); it != misses_.end(); ++it) {
+    if (it->rel_id == rel_id && it->col_id == col_id
+        && equivalent(it->filters, filters)) {
+      misses_.erase(it);
+      return true;
+    }
+  }
+  misses_.push_back({rel_id, col_id, filters});
+  if (misses_.size() > kMissHistory)
+    misses_.pop_front();
+  return false;
+}
+
+// The lookups of selections
+IntermediateCache::Counters IntermediateCache::selection_counters() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return selection_counters_;
+}
+
+// The lookups of tables
+IntermediateCache::Counters IntermediateCache::table_counters() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return table_counters_;
+}
+
+// The memory used by the entries
+uint64_t IntermediateCache::memory() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return memory_;
+}
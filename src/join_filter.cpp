@@ -0,0 +1,43 @@
+#include "join_filter.h"
+
+#include <algorithm>
+
+#include "thread_pool.h"
+
+std::atomic<uint64_t> JoinFilter::total_tested_{0};
+std::atomic<uint64_t> JoinFilter::total_eliminated_{0};
+
+// Build the filter on the keys
+void JoinFilter::build(const uint64_t *keys, uint64_t size) {
+  // At least two words, so that the shift stays below 64
+  uint64_t num_words = 2;
+  shift_ = 63;
+  while (num_words * 64 < size * kBitsPerKey) {
+    num_words *= 2;
+    --shift_;
+  }
+  words_.assign(num_words, 0);
+
+  auto &pool = ThreadPool::global();
+  std::vector<uint64_t> mins(ThreadPool::numMorsels(size), UINT64_MAX);
+  std::vector<uint64_t> maxs(mins.size(), 0);
+  pool.parallelFor(size, [&](uint64_t begin, uint64_t end) {
+    auto morsel = begin / ThreadPool::kMorselSize;
+    for (uint64_t i = begin; i != end; ++i) {
+      mins[morsel] = std::min(mins[morsel], keys[i]);
+      maxs[morsel] = std::max(maxs[morsel], keys[i]);
+      __atomic_fetch_or(&words_[word(keys[i])], bits(keys[i]),
+                        __ATOMIC_RELAXED);
+    }
+  });
+  min_ = size ? *std::min_element(mins.begin(), mins.end()) : 1;
+  max_ = size ? *std::max_element(maxs.begin(), maxs.end()) : 0;
+}
+
+// Count tested and eliminated tuples
+void JoinFilter::record(uint64_t tested, uint64_t eliminated) const {
+  tested_.fetch_add(tested, std::memory_order_relaxed);
+  eliminated_.fetch_add(eliminated, std::memory_order_relaxed);
+  total_tested_.fetch_add(tested, std::memory_order_relaxed);
+  total_eliminated_.fetch_add(eliminated, std::memory_order_relaxed);
+}
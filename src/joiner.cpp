@@ -1,6 +1,10 @@
 #include "joiner.h"
 
+#include <algorithm>
 #include <cassert>
+#include <chrono>
+#include <exception>
+#include <functional>
 #include <iostream>
 #include <string>
 #include <unordered_map>
@@ -8,25 +12,33 @@
 #include <set>
 #include <sstream>
 #include <vector>
+#include <sys/resource.h>
+#include <unistd.h>
 
 #include "parser.h"
+#include "planner.h"
+#include "thread_pool.h"
 
 namespace {
 
-enum QueryGraphProvides { Left, Right, Both, None };
-
-// Analyzes inputs of join
-QueryGraphProvides analyzeInputOfJoin(std::set<unsigned> &usedRelations,
-                                      SelectInfo &leftInfo,
-                                      SelectInfo &rightInfo) {
-  bool used_left = usedRelations.count(leftInfo.binding);
-  bool used_right = usedRelations.count(rightInfo.binding);
+// The row ids of a cached selection
+std::shared_ptr<const std::vector<uint64_t>> rowIds(
+    const std::shared_ptr<const IntermediateCache::Selection> &selection) {
+  return {selection, &selection->ids};
+}
 
-  if (used_left ^ used_right)
-    return used_left ? QueryGraphProvides::Left : QueryGraphProvides::Right;
-  if (used_left && used_right)
-    return QueryGraphProvides::Both;
-  return QueryGraphProvides::None;
+// Creates a join of two inputs with the given (estimated) sizes. Inputs whose
+// smaller side exceeds the cache are joined with a partitioned RadixJoin.
+std::unique_ptr<Join> createJoin(std::unique_ptr<Operator> &&left,
+                                 std::unique_ptr<Operator> &&right,
+                                 const PredicateInfo &p_info,
+                                 uint64_t left_size,
+                                 uint64_t right_size,
+                                 Join::BuildSide build_side =
+                                     Join::BuildSide::Smaller) {
+  if (std::min(left_size, right_size) >= RadixJoin::kMinBuildSize)
+    return std::make_unique<RadixJoin>(move(left), move(right), p_info);
+  return std::make_unique<Join>(move(left), move(right), p_info, build_side);
 }
 
 }
@@ -40,8 +52,52 @@ void Joiner::addRelation(Relation &&relation) {
   relations_.emplace_back(std::move(relation));
 }
 
+// Load relations in parallel, each file is mapped (and prefaulted) by one
+// thread
+LoadReport Joiner::addRelations(const std::vector<std::string> &file_names,
+                                const LoadOptions &options) {
+  LoadReport report;
+  auto start = std::chrono::steady_clock::now();
+  auto page_faults = [] {
+    rusage usage{};
+    getrusage(RUSAGE_SELF, &usage);
+    return static_cast<uint64_t>(usage.ru_minflt + usage.ru_majflt);
+  };
+  auto faults_before = page_faults();
+
+  std::vector<std::unique_ptr<Relation>> loaded(file_names.size());
+  std::vector<std::exception_ptr> errors(file_names.size());
+  ThreadPool::global().parallelFor(file_names.size(), 1,
+                                   [&](uint64_t i, uint64_t) {
+    try {
+      loaded[i] = std::make_unique<Relation>(file_names[i].c_str(), options);
+    } catch (...) {
+      errors[i] = std::current_exception();
+    }
+  });
+  for (auto &error : errors) {
+    if (error)
+      std::rethrow_exception(error);
+  }
+
+  auto page_size = static_cast<uint64_t>(sysconf(_SC_PAGESIZE));
+  for (auto &relation : loaded) {
+    auto bytes = (2 + relation->size() * relation->columns().size())
+        * sizeof(uint64_t);
+    report.bytes += bytes;
+    if (options.prefault)
+      report.prefaulted_pages += (bytes + page_size - 1) / page_size;
+    relations_.emplace_back(std::move(*relation));
+  }
+  report.relations = loaded.size();
+  report.page_faults = page_faults() - faults_before;
+  report.ms = std::chrono::duration<double, std::milli>(
+      std::chrono::steady_clock::now() - start).count();
+  return report;
+}
+
 // Loads a relation from disk
-const Relation &Joiner::getRelation(unsigned relation_id) {
+const Relation &Joiner::getRelation(unsigned relation_id) const {
   if (relation_id >= relations_.size()) {
     std::cerr << "Relation with id: " << relation_id << " does not exist"
               << std::endl;
@@ -50,70 +106,624 @@ const Relation &Joiner::getRelation(unsigned relation_id) {
   return relations_[relation_id];
 }
 
-// Add scan to query
-std::unique_ptr<Operator> Joiner::addScan(std::set<unsigned> &used_relations,
-                                          const SelectInfo &info,
-                                          QueryInfo &query) {
-  used_relations.emplace(info.binding);
+// Build the sorted index of every column. The columns that queries filter on
+// are not known before the workload arrives, thus all of them are indexed
+// (unless their index was loaded with the relation).
+void Joiner::buildSortedIndexes() {
+  std::vector<std::pair<unsigned, unsigned>> columns;
+  for (unsigned r = 0; r < relations_.size(); ++r) {
+    for (unsigned c = 0; c < relations_[r].columns().size(); ++c) {
+      if (!relations_[r].sortedIndex(c))
+        columns.emplace_back(r, c);
+    }
+  }
+  ThreadPool::global().parallelFor(columns.size(), 1,
+                                   [&](uint64_t i, uint64_t) {
+    relations_[columns[i].first].buildSortedIndex(columns[i].second);
+  });
+}
+
+// The memory used by the sorted indexes in bytes
+uint64_t Joiner::sortedIndexMemory() const {
+  uint64_t memory = 0;
+  for (auto &relation : relations_) {
+    for (unsigned c = 0; c < relation.columns().size(); ++c) {
+      if (relation.sortedIndex(c))
+        memory += relation.sortedIndex(c)->memory();
+    }
+  }
+  return memory;
+}
+
+// Build hash indexes on the columns that are likely join keys: the unique
+// columns, then the columns whose values lie within the range of another
+// relation's unique column (foreign keys). Smaller indexes are preferred
+// until the memory budget is used up.
+uint64_t Joiner::buildHashIndexes(double budget) {
+  if (statistics_.empty())
+    buildStatistics();
+
+  struct Candidate {
+    unsigned rel_id, col_id;
+    bool key;
+    uint64_t distinct, memory;
+  };
+  std::vector<Candidate> candidates;
+  uint64_t data_size = 0;
+  for (unsigned r = 0; r < relations_.size(); ++r) {
+    auto &relation = relations_[r];
+    data_size += relation.size() * relation.columns().size() * sizeof(uint64_t);
+    for (unsigned c = 0; c < relation.columns().size(); ++c) {
+      auto &stats = statistics_.column(r, c);
+      bool foreign_key = false;
+      for (unsigned o = 0; o < relations_.size() && !stats.unique; ++o) {
+        for (unsigned k = 0; k < relations_[o].columns().size(); ++k) {
+          auto &key = statistics_.column(o, k);
+          foreign_key |= o != r && key.unique && key.min <= stats.min
+              && stats.max <= key.max && stats.distinct <= key.distinct;
+        }
+      }
+      if (stats.size == 0 || (!stats.unique && !foreign_key))
+        continue;
+      // A power of two of at least twice the distinct keys, plus the row ids
+      auto distinct = std::max<uint64_t>(1, stats.distinct);
+      uint64_t slots = 2;
+      while (slots < 2 * distinct)
+        slots *= 2;
+      candidates.push_back(Candidate{r, c, stats.unique, distinct,
+                                     slots * 3 * sizeof(uint64_t)
+                                         + stats.size * sizeof(uint64_t)});
+    }
+  }
+  std::stable_sort(candidates.begin(), candidates.end(),
+                   [](const Candidate &a, const Candidate &b) {
+    return a.key != b.key ? a.key : a.memory < b.memory;
+  });
+
+  uint64_t memory = 0;
+  std::vector<Candidate> selected;
+  for (auto &candidate : candidates) {
+    if (memory + candidate.memory > budget * data_size)
+      continue;
+    memory += candidate.memory;
+    selected.push_back(candidate);
+  }
+  ThreadPool::global().parallelFor(selected.size(), 1,
+                                   [&](uint64_t i, uint64_t) {
+    relations_[selected[i].rel_id].buildHashIndex(selected[i].col_id,
+                                                  selected[i].distinct);
+  });
+
+  memory = 0;
+  for (auto &candidate : selected)
+    memory += relations_[candidate.rel_id].hashIndex(candidate.col_id)->memory();
+  return memory;
+}
+
+// Compress every column that needs at most kMaxBits bits per value (unless
+// it was loaded compressed). The uncompressed columns stay in place for the
+// joins and the checksums, which access values by row id.
+uint64_t Joiner::compressColumns() {
+  if (statistics_.empty())
+    buildStatistics();
+
+  std::vector<std::pair<unsigned, unsigned>> columns;
+  for (unsigned r = 0; r < relations_.size(); ++r) {
+    for (unsigned c = 0; c < relations_[r].columns().size(); ++c) {
+      if (!relations_[r].compressedColumn(c))
+        columns.emplace_back(r, c);
+    }
+  }
+  ThreadPool::global().parallelFor(columns.size(), 1,
+                                   [&](uint64_t i, uint64_t) {
+    auto &stats = statistics_.column(columns[i].first, columns[i].second);
+    relations_[columns[i].first].compressColumn(columns[i].second, stats.min,
+                                                stats.max, stats.distinct);
+  });
+
+  uint64_t memory = 0;
+  for (auto &relation : relations_) {
+    for (unsigned c = 0; c < relation.columns().size(); ++c) {
+      if (auto compressed = relation.compressedColumn(c))
+        memory += compressed->memory();
+    }
+  }
+  return memory;
+}
+
+// The filters of a binding that not every tuple passes
+std::vector<FilterInfo> Joiner::filters(unsigned binding,
+                                        QueryInfo &query) const {
   std::vector<FilterInfo> filters;
   for (auto &f : query.filters()) {
-    if (f.filter_column.binding == info.binding) {
+    if (f.filter_column.binding == binding) {
+      // Skip filters that every tuple passes
+      if (!statistics_.empty()
+          && statistics_.column(f.filter_column)
+              .alwaysPasses(f.comparison, f.constant))
+        continue;
       filters.emplace_back(f);
     }
   }
+  return filters;
+}
+
+// Add scan to query
+std::unique_ptr<Operator> Joiner::addScan(const SelectInfo &info,
+                                          QueryInfo &query) const {
+  auto filters = this->filters(info.binding, query);
+  if (!filters.empty() && cache_) {
+    // Scan the cached row ids, unless they are neither cached nor admitted
+    if (auto selection = select(info.rel_id, filters, false))
+      return std::make_unique<FilterScan>(getRelation(info.rel_id),
+                                          info.binding, rowIds(selection));
+  }
   return !filters.empty() ?
          std::make_unique<FilterScan>(getRelation(info.rel_id), filters)
                           : std::make_unique<Scan>(getRelation(info.rel_id),
                                                    info.binding);
 }
 
-// Executes a join query
-std::string Joiner::join(QueryInfo &query) {
-  std::set<unsigned> used_relations;
-
-  // We always start with the first join predicate and append the other joins
-  // to it (--> left-deep join trees). You might want to choose a smarter
-  // join ordering ...
-  const auto &firstJoin = query.predicates()[0];
-  std::unique_ptr<Operator> left, right;
-  left = addScan(used_relations, firstJoin.left, query);
-  right = addScan(used_relations, firstJoin.right, query);
-  std::unique_ptr<Operator>
-      root = std::make_unique<Join>(move(left), move(right), firstJoin);
-
-  auto predicates_copy = query.predicates();
-  for (unsigned i = 1; i < predicates_copy.size(); ++i) {
-    auto &p_info = predicates_copy[i];
-    auto &left_info = p_info.left;
-    auto &right_info = p_info.right;
-
-    switch (analyzeInputOfJoin(used_relations, left_info, right_info)) {
-      case QueryGraphProvides::Left:left = move(root);
-        right = addScan(used_relations, right_info, query);
-        root = std::make_unique<Join>(move(left), move(right), p_info);
-        break;
-      case QueryGraphProvides::Right:
-        left = addScan(used_relations,
-                       left_info,
-                       query);
-        right = move(root);
-        root = std::make_unique<Join>(move(left), move(right), p_info);
-        break;
-      case QueryGraphProvides::Both:
-        // All relations of this join are already used somewhere else in the
-        // query. Thus, we have either a cycle in our join graph or more than
-        // one join predicate per join.
-        root = std::make_unique<SelfJoin>(move(root), p_info);
-        break;
-      case QueryGraphProvides::None:
-        // Process this predicate later when we can connect it to the other
-        // joins. We never have cross products.
-        predicates_copy.push_back(p_info);
-        break;
-    };
-  }
-
-  Checksum checksum(move(root), query.selections());
+// The tuples of a relation that pass filters
+std::shared_ptr<const IntermediateCache::Selection> Joiner::select(
+    unsigned rel_id,
+    const std::vector<FilterInfo> &filters,
+    bool materialize) const {
+  std::vector<FilterInfo> residual;
+  auto cached = cache_->findSelection(rel_id, filters, residual);
+  if (cached && residual.empty())
+    return cached;
+  // Filtering the cached tuples pays off even if the result is not kept,
+  // filtering the relation only if it is kept
+  bool admitted = cache_->admit(rel_id, IntermediateCache::kSelection,
+                                filters);
+  if (!cached && !admitted && !materialize)
+    return nullptr;
+
+  // Apply the residual filters to the cached tuples, otherwise filter the
+  // relation
+  auto &relation = getRelation(rel_id);
+  auto binding = filters[0].filter_column.binding;
+  auto scan = cached ? std::make_unique<FilterScan>(relation, binding,
+                                                    rowIds(cached), residual)
+                     : std::make_unique<FilterScan>(relation, filters);
+  scan->run();
+  auto &row_ids = scan->rowIds(binding);
+  IntermediateCache::Selection selection{rel_id, filters, {}};
+  selection.ids.resize(scan->result_size());
+  ThreadPool::global().parallelFor(selection.ids.size(),
+                                   [&](uint64_t begin, uint64_t end) {
+    for (auto i = begin; i != end; ++i)
+      selection.ids[i] = row_ids.rowId(i);
+  });
+  if (!admitted)
+    return std::make_shared<const IntermediateCache::Selection>(
+        std::move(selection));
+  return cache_->addSelection(std::move(selection));
+}
+
+// Creates a join whose hash table comes from the cache
+std::unique_ptr<Operator> Joiner::addCachedJoin(
+    const PlanNode &node,
+    QueryInfo &query,
+    const SharedInputs *shared,
+    const SemiJoinReduction *reduction,
+    bool eager_aggregation) const {
+  auto &p_info = node.predicates[0];
+  auto &key = p_info.left;
+  auto &relation = getRelation(key.rel_id);
+  auto filters = this->filters(key.binding, query);
+  std::vector<FilterInfo> residual;
+  auto max_size = static_cast<uint64_t>(
+      kMaxSubsumedTableRatio * std::max(1.0, node.left->cardinality));
+  auto table = cache_->findTable(key.rel_id, key.col_id, filters, max_size,
+                                 relation, residual);
+  if (!table) {
+    // A build side that was not requested before is joined as usual
+    if (!cache_->admit(key.rel_id, key.col_id, filters))
+      return nullptr;
+    IntermediateCache::Table built{key.rel_id, key.col_id, filters,
+                                   nullptr, {}};
+    if (!filters.empty())
+      built.selection = select(key.rel_id, filters, true);
+    auto size = built.size(relation);
+    auto column = relation.columns()[key.col_id];
+    std::vector<uint64_t> keys(size);
+    ThreadPool::global().parallelFor(size, [&](uint64_t begin, uint64_t end) {
+      for (auto i = begin; i != end; ++i)
+        keys[i] = column[built.selection ? built.selection->ids[i] : i];
+    });
+#ifdef USE_STD_HASH_TABLE
+    built.table.reserve(size * 2);
+    for (uint64_t i = 0; i != size; ++i)
+      built.table.emplace(keys[i], i);
+#else
+    built.table.build(keys.data(), size);
+#endif
+    table = cache_->addTable(std::move(built));
+  }
+
+  // The build side are the tuples of the table, those that fail the
+  // residual filters of a subsuming table are masked
+  std::unique_ptr<Operator> left;
+  if (table->selection) {
+    left = std::make_unique<FilterScan>(relation, key.binding,
+                                        rowIds(table->selection));
+  } else {
+    left = std::make_unique<Scan>(relation, key.binding);
+  }
+  std::vector<uint8_t> mask;
+  if (!residual.empty()) {
+    mask.resize(table->size(relation));
+    ThreadPool::global().parallelFor(mask.size(),
+                                     [&](uint64_t begin, uint64_t end) {
+      for (auto i = begin; i != end; ++i) {
+        auto row_id = table->selection ? table->selection->ids[i] : i;
+        bool pass = true;
+        for (auto &filter : residual) {
+          auto col_id = filter.filter_column.col_id;
+          pass &= filter.passes(relation.columns()[col_id][row_id]);
+        }
+        mask[i] = pass;
+      }
+    });
+  }
+  return std::make_unique<Join>(move(left),
+                                addInput(*node.right, query, shared,
+                                         reduction, eager_aggregation),
+                                p_info,
+                                Join::BuildSide::Left,
+                                std::shared_ptr<const Join::HT>(
+                                    table, &table->table),
+                                std::move(mask));
+}
+
+// An input of a join that no predicate above the join reads
+const PlanNode *Joiner::collapsedInput(const PlanNode &node,
+                                       QueryInfo &query,
+                                       bool selected) const {
+  if (node.isLeaf() || node.predicates.size() != 1)
+    return nullptr;
+  uint64_t selections = 0;
+  for (auto &info : query.selections())
+    selections |= 1ull << info.binding;
+  auto contains = [](const PlanNode &n, unsigned binding) {
+    return (n.bindings >> binding & 1) != 0;
+  };
+  auto collapsed = [&](const PlanNode &input, const PlanNode &other) {
+    if (!selected && (input.bindings & selections))
+      return false;
+    // No predicate above the join reads a column of the input
+    for (auto &p : query.predicates()) {
+      if (contains(input, p.left.binding) != contains(input, p.right.binding)
+          && !(contains(node, p.left.binding)
+              && contains(node, p.right.binding)))
+        return false;
+    }
+    if (node.cardinality < kMinCountMultiplicity * other.cardinality)
+      return false;
+    // Collapsing the build side replaces the hash table on it, an indexed
+    // relation is counted by its index, the probe side has to be read
+    auto &column = &input == node.left.get() ? node.predicates[0].left
+                                             : node.predicates[0].right;
+    return &input == node.left.get()
+        || (!selected && leafIndex(input, column, query))
+        || node.cardinality > input.cardinality;
+  };
+  if (collapsed(*node.left, *node.right))
+    return node.left.get();
+  if (collapsed(*node.right, *node.left))
+    return node.right.get();
+  return nullptr;
+}
+
+// The input of a join that only matters through its counts per join key
+const PlanNode *Joiner::countedInput(const PlanNode &node,
+                                     QueryInfo &query) const {
+  return eager_aggregation_ ? collapsedInput(node, query, false) : nullptr;
+}
+
+// The input of a join whose matching tuples are kept unexpanded
+const PlanNode *Joiner::factorizedInput(const PlanNode &node,
+                                        QueryInfo &query) const {
+  if (!factorized_joins_ || countedInput(node, query))
+    return nullptr;
+  return collapsedInput(node, query, true);
+}
+
+// Creates a count join that collapses an input of a join node
+std::unique_ptr<Operator> Joiner::addCountJoin(
+    const PlanNode &node,
+    const PlanNode &counted,
+    QueryInfo &query,
+    const SharedInputs *shared,
+    const SemiJoinReduction *reduction) const {
+  // The counted input's column is the left one of the predicate
+  bool left = &counted == node.left.get();
+  auto &p = node.predicates[0];
+  PredicateInfo p_info = left ? p : PredicateInfo(p.right, p.left);
+  auto input = addInput(left ? *node.right : *node.left, query, shared,
+                        reduction, true);
+  std::unique_ptr<CountJoin> join;
+  bool reduced = reduction && counted.isLeaf()
+      && reduction->row_ids[counted.binding];
+  if (auto index = reduced ? nullptr
+      : leafIndex(counted, p_info.left, query)) {
+    join = std::make_unique<CountJoin>(*index, std::move(input), p_info);
+  } else {
+    join = std::make_unique<CountJoin>(
+        addInput(counted, query, shared, reduction, true), std::move(input),
+        p_info);
+  }
+  join->setJoinFilter(join_filters_);
+  return join;
+}
+
+// Creates a factorized join that groups an input of a join node
+std::unique_ptr<Operator> Joiner::addFactorizedJoin(
+    const PlanNode &node,
+    const PlanNode &grouped,
+    QueryInfo &query,
+    const SharedInputs *shared,
+    const SemiJoinReduction *reduction) const {
+  // The grouped input's column is the left one of the predicate
+  bool left = &grouped == node.left.get();
+  auto &p = node.predicates[0];
+  auto join = std::make_unique<FactorizedJoin>(
+      addInput(grouped, query, shared, reduction, true),
+      addInput(left ? *node.right : *node.left, query, shared, reduction,
+               true),
+      left ? p : PredicateInfo(p.right, p.left));
+  join->setJoinFilter(join_filters_);
+  return join;
+}
+
+// The hash index that answers the join predicate on a plan leaf
+const HashTable *Joiner::leafIndex(const PlanNode &node,
+                                   const SelectInfo &column,
+                                   QueryInfo &query) const {
+  if (!node.isLeaf() || !node.predicates.empty()
+      || !filters(node.binding, query).empty())
+    return nullptr;
+  return relations_[column.rel_id].hashIndex(column.col_id);
+}
+
+// Whether a join of a plan builds a hash table on its left input
+bool Joiner::buildsHashTable(const PlanNode &node, QueryInfo &query) const {
+  auto &p_info = node.predicates[0];
+  return !leafIndex(*node.left, p_info.left, query)
+      && !(leafIndex(*node.right, p_info.right, query)
+          && kIndexProbeCost * node.left->cardinality
+              < node.right->cardinality);
+}
+
+// Creates the operators of an input of a join
+std::unique_ptr<Operator> Joiner::addInput(
+    const PlanNode &node,
+    QueryInfo &query,
+    const SharedInputs *shared,
+    const SemiJoinReduction *reduction,
+    bool eager_aggregation) const {
+  if (shared) {
+    auto input = shared->find(&node);
+    if (input != shared->end()) {
+      auto &subplan = *input->second.subplan;
+      return std::make_unique<SharedScan>(subplan.columns,
+                                          subplan.size,
+                                          input->second.bindings);
+    }
+  }
+  return addPlan(node, query, shared, reduction, eager_aggregation);
+}
+
+// Creates the operators of a plan
+std::unique_ptr<Operator> Joiner::addPlan(
+    const PlanNode &node,
+    QueryInfo &query,
+    const SharedInputs *shared,
+    const SemiJoinReduction *reduction,
+    bool eager_aggregation) const {
+  // A reduced leaf is scanned through its remaining row ids instead of
+  // being probed through an index or a cached table
+  auto reduced = [&](const PlanNode &n) {
+    return reduction && n.isLeaf() && reduction->row_ids[n.binding];
+  };
+  std::unique_ptr<Operator> root;
+  auto predicates = node.predicates;
+  unsigned first_self_join = 0;
+  std::shared_ptr<const Join::HT> table;
+  if (!node.isLeaf() && shared) {
+    // A hash table on the shared build side may have been built already
+    auto input = shared->find(node.left.get());
+    if (input != shared->end()) {
+      table = input->second.subplan->table(
+          {input->second.leaf(predicates[0].left.binding),
+           predicates[0].left.col_id});
+    }
+  }
+  if (reduced(node)) {
+    root = std::make_unique<FilterScan>(
+        getRelation(query.relation_ids()[node.binding]), node.binding,
+        reduction->row_ids[node.binding]);
+  } else if (node.isLeaf()) {
+    SelectInfo info(query.relation_ids()[node.binding], node.binding, 0);
+    root = addScan(info, query);
+  } else if (auto counted = eager_aggregation ? countedInput(node, query)
+                                             : nullptr) {
+    // Only the number of the counted input's partners matters
+    root = addCountJoin(node, *counted, query, shared, reduction);
+    first_self_join = 1;
+  } else if (auto grouped = eager_aggregation ? factorizedInput(node, query)
+                                             : nullptr) {
+    // Only the checksum reads the grouped input's columns
+    root = addFactorizedJoin(node, *grouped, query, shared, reduction);
+    first_self_join = 1;
+  } else if (auto index = reduced(*node.left) ? nullptr
+      : leafIndex(*node.left, predicates[0].left, query)) {
+    // The build side is indexed already
+    root = std::make_unique<IndexJoin>(
+        addInput(*node.right, query, shared, reduction, eager_aggregation),
+        getRelation(predicates[0].left.rel_id), *index, predicates[0]);
+    first_self_join = 1;
+  } else if ((index = reduced(*node.right) ? nullptr
+      : leafIndex(*node.right, predicates[0].right, query))
+      && kIndexProbeCost * node.left->cardinality < node.right->cardinality) {
+    // Probe the index of the (much) larger input instead of scanning it
+    PredicateInfo p_info(predicates[0].right, predicates[0].left);
+    root = std::make_unique<IndexJoin>(
+        addInput(*node.left, query, shared, reduction, eager_aggregation),
+        getRelation(p_info.left.rel_id), *index, p_info);
+    first_self_join = 1;
+  } else if (!table && cache_ && node.left->isLeaf() && !reduced(*node.left)
+      && node.left->predicates.empty()
+      && !(shared && shared->count(node.left.get()))
+      && std::min(node.left->cardinality, node.right->cardinality)
+          < RadixJoin::kMinBuildSize
+      && (root = addCachedJoin(node, query, shared, reduction,
+                               eager_aggregation))) {
+    // Large build sides are partitioned by a radix join instead
+    first_self_join = 1;
+  } else if (table) {
+    root = std::make_unique<Join>(
+        addInput(*node.left, query, shared, reduction, eager_aggregation),
+        addInput(*node.right, query, shared, reduction, eager_aggregation),
+        predicates[0],
+        Join::BuildSide::Left, table);
+    first_self_join = 1;
+  } else {
+    // The planner picked the build side (left) before execution
+    auto join = createJoin(addInput(*node.left, query, shared, reduction,
+                                    eager_aggregation),
+                           addInput(*node.right, query, shared, reduction,
+                                    eager_aggregation),
+                           predicates[0],
+                           node.left->cardinality,
+                           node.right->cardinality,
+                           Join::BuildSide::Left);
+    // All predicates between the inputs form a composite join key
+    for (unsigned p = 1; p < predicates.size(); ++p)
+      join->addKey(predicates[p]);
+    root = std::move(join);
+    first_self_join = predicates.size();
+  }
+  if (auto join = dynamic_cast<Join *>(root.get()))
+    join->setJoinFilter(join_filters_);
+  // All other predicates between the inputs (or of a single relation)
+  for (unsigned p = first_self_join; p < predicates.size(); ++p)
+    root = std::make_unique<SelfJoin>(move(root), predicates[p]);
+  return root;
+}
+
+// Whether a query is joined with a multiway join
+bool Joiner::joinsMultiway(const PlanNode &plan,
+                           const QueryInfo &query) const {
+  return multiway_joins_ && !SemiJoinReducer::isAcyclic(query)
+      && Planner::danglingRatio(plan) > kMinMultiwayDangling;
+}
+
+// Add a multiway join of the leaves of a plan
+std::unique_ptr<Operator> Joiner::addMultiwayJoin(
+    const PlanNode &plan,
+    QueryInfo &query,
+    const SharedInputs *shared) const {
+  std::vector<std::unique_ptr<Operator>> inputs;
+  std::function<void(const PlanNode &)> addLeaves = [&](const PlanNode &node) {
+    if (node.isLeaf()) {
+      inputs.push_back(addInput(node, query, shared));
+      return;
+    }
+    addLeaves(*node.left);
+    addLeaves(*node.right);
+  };
+  addLeaves(plan);
+  std::vector<PredicateInfo> predicates;
+  for (auto &p_info : query.predicates()) {
+    if (p_info.left.binding != p_info.right.binding)
+      predicates.push_back(p_info);
+  }
+  return std::make_unique<MultiwayJoin>(std::move(inputs),
+                                        std::move(predicates));
+}
+
+// Cache the filtered scans and the hash tables on base relations
+uint64_t Joiner::enableCache(double budget) {
+  uint64_t data_size = 0;
+  for (auto &relation : relations_)
+    data_size += relation.size() * relation.columns().size() * sizeof(uint64_t);
+  auto bytes = static_cast<uint64_t>(budget * data_size);
+  cache_ = bytes ? std::make_unique<IntermediateCache>(bytes) : nullptr;
+  return bytes;
+}
+
+// Executes a join query unless its result is cached
+std::string Joiner::join(QueryInfo &query) const {
+  if (!results_)
+    return join(query, *plan(query));
+  auto key = ResultCache::key(query);
+  std::string result;
+  if (results_->find(key, result))
+    return result;
+  result = join(query, *plan(query));
+  results_->insert(key, result);
+  return result;
+}
+
+// Find the join order and the build sides of a query
+std::unique_ptr<PlanNode> Joiner::plan(QueryInfo &query) const {
+  // Pick the join order and the build sides based on cardinality estimates
+  Planner planner(relations_, query, &statistics_);
+  return planner.plan();
+}
+
+// The estimated memory that executing a plan needs
+uint64_t Joiner::memoryEstimate(const PlanNode &node, QueryInfo &query) const {
+  auto tuples = [](const PlanNode &n) {
+    return static_cast<uint64_t>(std::max(0.0, n.cardinality));
+  };
+  // A materialized result holds a row id per binding
+  auto row_bytes = [](const PlanNode &n) {
+    return __builtin_popcountll(n.bindings) * sizeof(uint64_t);
+  };
+  if (node.isLeaf()) {
+    // A filtered scan materializes the row ids that qualify
+    return filters(node.binding, query).empty() ? 0
+        : tuples(node) * row_bytes(node);
+  }
+
+  uint64_t memory = memoryEstimate(*node.left, query)
+      + memoryEstimate(*node.right, query);
+  if (!pipelined_)
+    memory += tuples(node) * row_bytes(node);
+  if (!buildsHashTable(node, query))
+    return memory;
+  // A hash table entry (key and position) plus the build side's rows; a
+  // radix join also partitions the probe side
+  memory += tuples(*node.left) * (2 * sizeof(uint64_t) + row_bytes(*node.left));
+  if (std::min(tuples(*node.left), tuples(*node.right))
+      >= RadixJoin::kMinBuildSize)
+    memory += tuples(*node.right) * (2 * sizeof(uint64_t));
+  return memory;
+}
+
+// Executes a join query with a plan
+std::string Joiner::join(QueryInfo &query,
+                         const PlanNode &plan,
+                         const SharedInputs *shared) const {
+  std::unique_ptr<Operator> root;
+  if (joinsMultiway(plan, query)) {
+    root = addMultiwayJoin(plan, query, shared);
+  } else {
+    // Acyclic queries whose intermediate results would balloon are reduced
+    // to the tuples that participate in the result first
+    SemiJoinReduction reduction;
+    bool reduce = semi_join_reduction_ && SemiJoinReducer::pays(plan, query);
+    if (reduce)
+      reduction = SemiJoinReducer(*this).reduce(query);
+    root = addInput(plan, query, shared, reduce ? &reduction : nullptr,
+                    eager_aggregation_);
+  }
+
+  Checksum checksum(move(root), query.selections(), pipelined_);
   checksum.run();
 
   std::stringstream out;
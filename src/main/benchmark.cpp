@@ -0,0 +1,934 @@
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <set>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <sys/resource.h>
+
+#include "batch_executor.h"
+#include "filter_kernel.h"
+#include "hash_table.h"
+#include "joiner.h"
+#include "relation.h"
+#include "statistics.h"
+#include "thread_pool.h"
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+static void usage() {
+  std::cerr << "Usage: benchmark hash_table <init-file> [repetitions]\n"
+               "       benchmark scaling <init-file> [max-threads]\n"
+               "       benchmark filter <init-file> [repetitions]\n"
+               "       benchmark compression <init-file> [repetitions]\n"
+               "       benchmark load <init-file>\n"
+               "       benchmark columnar <init-file> [alignment]\n"
+               "       benchmark pipeline <init-file> [repetitions]\n"
+               "       benchmark join_filter <init-file> [repetitions]\n"
+               "       benchmark semi_join <init-file> [repetitions]\n"
+               "       benchmark multiway <init-file> [repetitions]\n"
+               "       benchmark eager_aggregation <init-file> [repetitions]\n"
+               "       benchmark factorized <init-file> [repetitions]\n"
+               "       benchmark batch <init-file> [repetitions] [threads]\n"
+               "       benchmark cache <init-file> [repetitions]\n"
+               "       benchmark statistics <init-file>\n"
+               "       benchmark index <init-file> [repetitions]"
+            << std::endl;
+}
+
+// Elapsed milliseconds since start
+static double elapsedMs(Clock::time_point start) {
+  return std::chrono::duration<double, std::milli>(Clock::now() - start)
+      .count();
+}
+
+// Load all relations listed in an init file (paths relative to the file)
+static std::vector<Relation> loadRelations(const std::string &init_file) {
+  auto slash = init_file.find_last_of('/');
+  auto dir = slash == std::string::npos ? "" : init_file.substr(0, slash + 1);
+  std::vector<Relation> relations;
+  std::ifstream in(init_file);
+  for (std::string line; std::getline(in, line);) {
+    if (line.empty() || line == "Done") continue;
+    relations.emplace_back((dir + line).c_str());
+  }
+  return relations;
+}
+
+// Load the queries of the workload next to an init file
+static std::vector<QueryInfo> loadQueries(const std::string &init_file) {
+  auto work_file = init_file.substr(0, init_file.rfind('.')) + ".work";
+  std::ifstream in(work_file);
+  std::vector<QueryInfo> queries;
+  for (std::string line; std::getline(in, line);) {
+    if (line != "F")
+      queries.emplace_back(line);
+  }
+  return queries;
+}
+
+struct Timing {
+  /// Build and probe time in ms
+  double build = 0, probe = 0;
+  /// The number of matches found
+  uint64_t matches = 0;
+};
+
+// Build on keys and probe with the same keys using std::unordered_multimap
+static Timing benchStd(const uint64_t *keys, uint64_t size, unsigned reps) {
+  Timing t;
+  for (unsigned r = 0; r < reps; ++r) {
+    auto start = Clock::now();
+    std::unordered_multimap<uint64_t, uint64_t> table;
+    table.reserve(size * 2);
+    for (uint64_t i = 0; i < size; ++i)
+      table.emplace(keys[i], i);
+    t.build += elapsedMs(start);
+
+    start = Clock::now();
+    uint64_t matches = 0;
+    for (uint64_t i = 0; i < size; ++i) {
+      auto range = table.equal_range(keys[i]);
+      for (auto iter = range.first; iter != range.second; ++iter)
+        matches += iter->second != ~0ull;
+    }
+    t.probe += elapsedMs(start);
+    t.matches = matches;
+  }
+  return t;
+}
+
+// Build on keys and probe with the same keys using the flat HashTable
+static Timing benchFlat(const uint64_t *keys, uint64_t size, unsigned reps) {
+  Timing t;
+  for (unsigned r = 0; r < reps; ++r) {
+    auto start = Clock::now();
+    HashTable table;
+    table.build(keys, nullptr, size);
+    t.build += elapsedMs(start);
+
+    start = Clock::now();
+    uint64_t matches = 0;
+    for (uint64_t i = 0; i < size; ++i) {
+      for (auto value : table.find(keys[i]))
+        matches += value != ~0ull;
+    }
+    t.probe += elapsedMs(start);
+    t.matches = matches;
+  }
+  return t;
+}
+
+// Compare the join hash tables on every column of every relation
+static int benchHashTable(std::vector<Relation> &relations, unsigned reps) {
+  std::cout << "rel col tuples | std build/probe ms | flat build/probe ms"
+            << std::endl;
+  Timing std_total, flat_total;
+  std::cout << std::fixed << std::setprecision(3);
+  for (unsigned r = 0; r < relations.size(); ++r) {
+    auto &rel = relations[r];
+    for (unsigned c = 0; c < rel.columns().size(); ++c) {
+      auto keys = rel.columns()[c];
+      auto std_t = benchStd(keys, rel.size(), reps);
+      auto flat_t = benchFlat(keys, rel.size(), reps);
+      if (std_t.matches != flat_t.matches) {
+        std::cerr << "match count differs for r" << r << "." << c
+                  << std::endl;
+        return 1;
+      }
+      std::cout << "r" << r << " " << c << " " << rel.size() << " | "
+                << std_t.build << " " << std_t.probe << " | "
+                << flat_t.build << " " << flat_t.probe << std::endl;
+      std_total.build += std_t.build;
+      std_total.probe += std_t.probe;
+      flat_total.build += flat_t.build;
+      flat_total.probe += flat_t.probe;
+    }
+  }
+  std::cout << "total | " << std_total.build << " " << std_total.probe
+            << " | " << flat_total.build << " " << flat_total.probe
+            << std::endl;
+  return 0;
+}
+
+// Compare the filter kernels on every column of every relation
+static int benchFilter(std::vector<Relation> &relations, unsigned reps) {
+  std::vector<FilterKernel::Kind> kinds;
+  std::cout << "rel col tuples |";
+  for (auto kind : {FilterKernel::Scalar, FilterKernel::AVX2,
+                    FilterKernel::AVX512}) {
+    if (FilterKernel::supported(kind)) {
+      kinds.push_back(kind);
+      std::cout << " " << FilterKernel::name(kind);
+    }
+  }
+  std::cout << " (ms for <, > and = on the median)" << std::endl;
+
+  std::cout << std::fixed << std::setprecision(3);
+  std::vector<double> totals(kinds.size(), 0);
+  for (unsigned r = 0; r < relations.size(); ++r) {
+    auto &rel = relations[r];
+    std::vector<uint64_t> mask((rel.size() + 63) / 64);
+    std::vector<uint64_t> ids;
+    ids.reserve(rel.size());
+    for (unsigned c = 0; c < rel.columns().size(); ++c) {
+      auto column = rel.columns()[c];
+      std::vector<uint64_t> sorted(column, column + rel.size());
+      std::nth_element(sorted.begin(), sorted.begin() + sorted.size() / 2,
+                       sorted.end());
+      auto constant = sorted.empty() ? 0 : sorted[sorted.size() / 2];
+
+      std::cout << "r" << r << " " << c << " " << rel.size() << " |";
+      uint64_t expected = ~0ull;
+      for (unsigned k = 0; k < kinds.size(); ++k) {
+        FilterKernel::select(kinds[k]);
+        uint64_t selected = 0;
+        auto start = Clock::now();
+        for (unsigned rep = 0; rep < reps; ++rep) {
+          for (auto comparison : comparisonTypes) {
+            ids.clear();
+            FilterKernel::evaluate(column, rel.size(), comparison, constant,
+                                   mask.data(), false);
+            FilterKernel::toSelection(mask.data(), rel.size(), 0, ids);
+            selected += ids.size();
+          }
+        }
+        auto ms = elapsedMs(start);
+        if (expected != ~0ull && selected != expected) {
+          std::cerr << "selection differs for r" << r << "." << c
+                    << std::endl;
+          return 1;
+        }
+        expected = selected;
+        totals[k] += ms;
+        std::cout << " " << ms;
+      }
+      std::cout << std::endl;
+    }
+  }
+  std::cout << "total |";
+  for (auto total : totals)
+    std::cout << " " << total;
+  std::cout << std::endl;
+  FilterKernel::select(FilterKernel::best());
+  return 0;
+}
+
+// Run the workload next to the init file with 1 to max_threads threads
+static int benchScaling(std::vector<Relation> &relations,
+                        const std::string &init_file,
+                        unsigned max_threads) {
+  Joiner joiner;
+  for (auto &relation : relations)
+    joiner.addRelation(std::move(relation));
+  joiner.buildStatistics();
+
+  auto queries = loadQueries(init_file);
+
+  std::vector<unsigned> thread_counts;
+  for (unsigned t = 1; t < max_threads; t *= 2)
+    thread_counts.push_back(t);
+  thread_counts.push_back(max_threads);
+
+  std::cout << "threads ms speedup" << std::endl;
+  std::cout << std::fixed << std::setprecision(3);
+  double base_ms = 0;
+  std::vector<std::string> expected;
+  for (auto threads : thread_counts) {
+    ThreadPool::setGlobalThreads(threads);
+    std::vector<std::string> results;
+    auto start = Clock::now();
+    for (auto &query : queries)
+      results.push_back(joiner.join(query));
+    auto ms = elapsedMs(start);
+
+    if (expected.empty()) {
+      expected = results;
+      base_ms = ms;
+    } else if (results != expected) {
+      std::cerr << "results differ with " << threads << " threads"
+                << std::endl;
+      return 1;
+    }
+    std::cout << threads << " " << ms << " " << base_ms / ms << std::endl;
+  }
+  return 0;
+}
+
+// Add the relations to a joiner with statistics, indexes and compressed
+// columns
+static void addRelations(Joiner &joiner, std::vector<Relation> &relations) {
+  for (auto &relation : relations)
+    joiner.addRelation(std::move(relation));
+  joiner.buildStatistics();
+  joiner.buildSortedIndexes();
+  joiner.buildHashIndexes();
+  joiner.compressColumns();
+}
+
+// Run the queries with a setting of the joiner off and on and report the
+// ms per repetition of each mode. Fails if the results differ.
+static int benchSetting(Joiner &joiner,
+                        std::vector<QueryInfo> &queries,
+                        unsigned reps,
+                        void (Joiner::*set)(bool),
+                        const std::string &name,
+                        const std::string &off_mode,
+                        const std::string &on_mode) {
+  std::cout << "mode ms" << std::endl;
+  std::cout << std::fixed << std::setprecision(3);
+  std::vector<std::string> expected;
+  for (bool on : {false, true}) {
+    (joiner.*set)(on);
+    std::vector<std::string> results;
+    auto start = Clock::now();
+    for (unsigned rep = 0; rep < reps; ++rep) {
+      results.clear();
+      for (auto &query : queries)
+        results.push_back(joiner.join(query));
+    }
+    auto ms = elapsedMs(start) / reps;
+
+    if (expected.empty()) {
+      expected = results;
+    } else if (results != expected) {
+      std::cerr << name << " results differ" << std::endl;
+      return 1;
+    }
+    std::cout << (on ? on_mode : off_mode) << " " << ms << std::endl;
+  }
+  return 0;
+}
+
+// Run the workload next to the init file materialized and pipelined
+static int benchPipeline(std::vector<Relation> &relations,
+                         const std::string &init_file,
+                         unsigned reps) {
+  Joiner joiner;
+  for (auto &relation : relations)
+    joiner.addRelation(std::move(relation));
+  joiner.buildStatistics();
+  auto queries = loadQueries(init_file);
+
+  return benchSetting(joiner, queries, reps, &Joiner::setPipelined,
+                      "pipelined", "materialized", "pipelined");
+}
+
+// Run the workload next to the init file without and with join filters and
+// report the tuples that the filters eliminated
+static int benchJoinFilter(std::vector<Relation> &relations,
+                           const std::string &init_file,
+                           unsigned reps) {
+  Joiner joiner;
+  addRelations(joiner, relations);
+  auto queries = loadQueries(init_file);
+
+  // Only the runs with join filters test tuples
+  auto before = JoinFilter::totals();
+  auto result = benchSetting(joiner, queries, reps, &Joiner::setJoinFilters,
+                             "join filter", "no_join_filters",
+                             "join_filters");
+  auto after = JoinFilter::totals();
+  std::cout << "tested " << (after.tested - before.tested) / reps
+            << " eliminated " << (after.eliminated - before.eliminated) / reps
+            << std::endl;
+  return result;
+}
+
+// Count the joins of the queries' plans for which input picks an input and
+// report them and the queries with such joins
+static void reportJoins(const Joiner &joiner,
+                        std::vector<QueryInfo> &queries,
+                        const PlanNode *(Joiner::*input)(const PlanNode &,
+                                                         QueryInfo &) const,
+                        const std::string &name) {
+  uint64_t matching_queries = 0, matching_joins = 0;
+  for (auto &query : queries) {
+    auto plan = joiner.plan(query);
+    uint64_t joins = 0;
+    std::function<void(const PlanNode &)> visit = [&](const PlanNode &node) {
+      if (node.isLeaf())
+        return;
+      joins += (joiner.*input)(node, query) != nullptr;
+      visit(*node.left);
+      visit(*node.right);
+    };
+    visit(*plan);
+    matching_queries += joins > 0;
+    matching_joins += joins;
+  }
+  std::cout << "queries " << matching_queries << "/" << queries.size() << " "
+            << name << " " << matching_joins << std::endl;
+}
+
+// Run the workload next to the init file without and with semi-join
+// reduction and report the tuples of the acyclic queries that pass their
+// filters and those that remain after reduction
+static int benchSemiJoin(std::vector<Relation> &relations,
+                         const std::string &init_file,
+                         unsigned reps) {
+  Joiner joiner;
+  addRelations(joiner, relations);
+  auto queries = loadQueries(init_file);
+
+  uint64_t acyclic = 0, filtered = 0, reduced = 0;
+  SemiJoinReducer reducer(joiner);
+  for (auto &query : queries) {
+    if (query.relation_ids().size() < SemiJoinReducer::kMinBindings
+        || !SemiJoinReducer::isAcyclic(query))
+      continue;
+    auto reduction = reducer.reduce(query);
+    ++acyclic;
+    filtered += reduction.filtered_tuples;
+    reduced += reduction.reduced_tuples;
+  }
+  std::cout << "acyclic " << acyclic << "/" << queries.size() << " filtered "
+            << filtered << " reduced " << reduced << std::endl;
+
+  return benchSetting(joiner, queries, reps, &Joiner::setSemiJoinReduction,
+                      "semi-join", "no_semi_join", "semi_join");
+}
+
+// Run the workload next to the init file without and with multiway joins
+// and report the cyclic queries, those joined multiway, and the joins on
+// composite keys
+static int benchMultiway(std::vector<Relation> &relations,
+                         const std::string &init_file,
+                         unsigned reps) {
+  Joiner joiner;
+  addRelations(joiner, relations);
+  auto queries = loadQueries(init_file);
+
+  uint64_t cyclic = 0, multiway = 0, composite = 0;
+  for (auto &query : queries) {
+    cyclic += !SemiJoinReducer::isAcyclic(query);
+    multiway += joiner.joinsMultiway(*joiner.plan(query), query);
+    std::set<std::pair<unsigned, unsigned>> edges;
+    for (auto &p : query.predicates()) {
+      if (p.left.binding != p.right.binding
+          && !edges.emplace(std::min(p.left.binding, p.right.binding),
+                            std::max(p.left.binding, p.right.binding))
+                  .second) {
+        ++composite;
+        break;
+      }
+    }
+  }
+  std::cout << "cyclic " << cyclic << "/" << queries.size() << " multiway "
+            << multiway << " composite_keys " << composite << std::endl;
+
+  return benchSetting(joiner, queries, reps, &Joiner::setMultiwayJoins,
+                      "multiway join", "binary", "multiway");
+}
+
+// Run the workload next to the init file without and with eager
+// aggregation and report the joins whose inputs are collapsed into counts
+static int benchEagerAggregation(std::vector<Relation> &relations,
+                                 const std::string &init_file,
+                                 unsigned reps) {
+  Joiner joiner;
+  addRelations(joiner, relations);
+  auto queries = loadQueries(init_file);
+
+  reportJoins(joiner, queries, &Joiner::countedInput, "count_joins");
+  return benchSetting(joiner, queries, reps, &Joiner::setEagerAggregation,
+                      "eager aggregation", "lazy", "eager");
+}
+
+// Run the workload next to the init file without and with factorized joins
+// and report the joins whose build sides are grouped
+static int benchFactorized(std::vector<Relation> &relations,
+                           const std::string &init_file,
+                           unsigned reps) {
+  Joiner joiner;
+  addRelations(joiner, relations);
+  auto queries = loadQueries(init_file);
+
+  reportJoins(joiner, queries, &Joiner::factorizedInput, "factorized_joins");
+  return benchSetting(joiner, queries, reps, &Joiner::setFactorizedJoins,
+                      "factorized join", "flat", "factorized");
+}
+
+// Load the batches of the workload next to an init file
+static std::vector<std::vector<QueryInfo>>
+loadBatches(const std::string &init_file) {
+  auto work_file = init_file.substr(0, init_file.rfind('.')) + ".work";
+  std::ifstream in(work_file);
+  std::vector<std::vector<QueryInfo>> batches(1);
+  for (std::string line; std::getline(in, line);) {
+    if (line == "F")
+      batches.emplace_back();
+    else
+      batches.back().emplace_back(line);
+  }
+  if (batches.back().empty())
+    batches.pop_back();
+  return batches;
+}
+
+// Run the batches of the workload next to the init file query by query and
+// with concurrent queries (without sharing subplans, with sharing and with a
+// tight memory limit)
+static int benchBatch(std::vector<Relation> &relations,
+                      const std::string &init_file,
+                      unsigned reps) {
+  Joiner joiner;
+  for (auto &relation : relations)
+    joiner.addRelation(std::move(relation));
+  joiner.buildStatistics();
+  joiner.buildSortedIndexes();
+  joiner.buildHashIndexes();
+  joiner.compressColumns();
+  auto batches = loadBatches(init_file);
+
+  std::cout << "mode ms peak_queries peak_reserved_MiB steals" << std::endl;
+  std::cout << std::fixed << std::setprecision(3);
+  std::vector<std::string> expected;
+  for (auto &query : loadQueries(init_file))
+    expected.push_back(joiner.join(query));
+
+  auto steals = ThreadPool::global().steals();
+  auto start = Clock::now();
+  for (unsigned rep = 0; rep < reps; ++rep) {
+    for (auto &batch : batches) {
+      for (auto &query : batch)
+        joiner.join(query);
+    }
+  }
+  std::cout << "sequential " << elapsedMs(start) / reps << " 1 0 "
+            << ThreadPool::global().steals() - steals << std::endl;
+
+  // A limit of one byte admits a query only if no other one runs
+  struct Mode {
+    const char *name;
+    uint64_t limit;
+    bool sharing;
+  };
+  SharingReport sharing;
+  for (auto mode : {Mode{"concurrent_unshared", 0, false},
+                    Mode{"concurrent", 0, true},
+                    Mode{"concurrent_limited", 1, true}}) {
+    BatchExecutor executor(joiner, mode.limit);
+    executor.setSharing(mode.sharing);
+    std::vector<std::string> results;
+    steals = ThreadPool::global().steals();
+    start = Clock::now();
+    for (unsigned rep = 0; rep < reps; ++rep) {
+      results.clear();
+      for (auto &batch : batches) {
+        for (auto &result : executor.run(batch))
+          results.push_back(result);
+      }
+    }
+    auto ms = elapsedMs(start) / reps;
+    if (results != expected) {
+      std::cerr << "concurrent results differ" << std::endl;
+      return 1;
+    }
+    std::cout << mode.name << " " << ms << " "
+              << executor.peak_running() << " "
+              << executor.peak_reserved() / double(1 << 20) << " "
+              << ThreadPool::global().steals() - steals << std::endl;
+    sharing = executor.sharing_report();
+  }
+
+  // The savings of one run of the workload
+  std::cout << "shared_subplans " << sharing.shared_subplans / reps
+            << " consumers " << sharing.consumers / reps
+            << " deduplicated_operators "
+            << sharing.deduplicated_operators / reps
+            << " deduplicated_tuples " << sharing.deduplicated_tuples / reps
+            << " shared_tables " << sharing.shared_tables / reps
+            << " deduplicated_builds " << sharing.deduplicated_builds / reps
+            << std::endl;
+  return 0;
+}
+
+// Run the batches of the workload next to the init file without caches, with
+// the intermediate cache and with the result cache as well, and report their
+// lookups
+static int benchCache(std::vector<Relation> &relations,
+                      const std::string &init_file,
+                      unsigned reps) {
+  Joiner joiner;
+  for (auto &relation : relations)
+    joiner.addRelation(std::move(relation));
+  joiner.buildStatistics();
+  joiner.buildSortedIndexes();
+  joiner.buildHashIndexes();
+  joiner.compressColumns();
+  auto batches = loadBatches(init_file);
+
+  std::cout << "mode ms" << std::endl;
+  std::cout << std::fixed << std::setprecision(3);
+  std::vector<std::string> expected;
+  for (auto mode : {"uncached", "cached", "cached_results"}) {
+    if (mode != std::string("uncached"))
+      joiner.enableCache();
+    if (mode == std::string("cached_results"))
+      joiner.enableResultCache();
+    BatchExecutor executor(joiner);
+    std::vector<std::string> results;
+    auto start = Clock::now();
+    for (unsigned rep = 0; rep < reps; ++rep) {
+      results.clear();
+      for (auto &batch : batches) {
+        for (auto &result : executor.run(batch))
+          results.push_back(result);
+      }
+    }
+    auto ms = elapsedMs(start) / reps;
+
+    if (expected.empty()) {
+      expected = results;
+    } else if (results != expected) {
+      std::cerr << "cached results differ" << std::endl;
+      return 1;
+    }
+    std::cout << mode << " " << ms << std::endl;
+  }
+
+  auto &cache = *joiner.cache();
+  std::cout << "kind hits subsumed_hits misses insertions evictions"
+            << std::endl;
+  for (auto kind : {std::make_pair("selections", cache.selection_counters()),
+                    std::make_pair("tables", cache.table_counters())}) {
+    auto &counters = kind.second;
+    std::cout << kind.first << " " << counters.hits << " "
+              << counters.subsumed_hits << " " << counters.misses << " "
+              << counters.insertions << " " << counters.evictions
+              << std::endl;
+  }
+  auto results = joiner.resultCache()->counters();
+  std::cout << "results " << results.hits << " 0 " << results.misses << " "
+            << results.insertions << " " << results.evictions << std::endl;
+  std::cout << "memory_MiB " << cache.memory() / double(1 << 20)
+            << " budget_MiB " << cache.budget() / double(1 << 20)
+            << std::endl;
+  std::cout << "result_hit_rate " << results.hitRate() << " result_memory_MiB "
+            << joiner.resultCache()->memory() / double(1 << 20) << std::endl;
+  return 0;
+}
+
+// Prepare the relations of an init file, store them as columnar files
+// (<file>.v2) and compare the preparation time of both formats
+static int benchColumnar(const std::string &init_file, uint64_t alignment) {
+  auto slash = init_file.find_last_of('/');
+  auto dir = slash == std::string::npos ? "" : init_file.substr(0, slash + 1);
+  std::vector<std::string> files;
+  std::ifstream in(init_file);
+  for (std::string line; std::getline(in, line);) {
+    if (!line.empty() && line != "Done")
+      files.push_back(dir + line);
+  }
+  auto queries = loadQueries(init_file);
+
+  std::cout << "format | load ms prepare ms | workload ms" << std::endl;
+  std::cout << std::fixed << std::setprecision(3);
+  std::vector<std::string> expected;
+  for (bool columnar : {false, true}) {
+    Joiner joiner;
+    auto v2_files = files;
+    for (auto &file : v2_files)
+      file += ".v2";
+    auto start = Clock::now();
+    joiner.addRelations(columnar ? v2_files : files);
+    auto load_ms = elapsedMs(start);
+    start = Clock::now();
+    joiner.buildStatistics();
+    joiner.buildSortedIndexes();
+    joiner.buildHashIndexes();
+    joiner.compressColumns();
+    auto prepare_ms = elapsedMs(start);
+
+    start = Clock::now();
+    std::vector<std::string> results;
+    for (auto &query : queries)
+      results.push_back(joiner.join(query));
+    auto ms = elapsedMs(start);
+    if (expected.empty()) {
+      expected = results;
+    } else if (results != expected) {
+      std::cerr << "columnar results differ" << std::endl;
+      return 1;
+    }
+    std::cout << (columnar ? "v2" : "v1") << " | " << load_ms << " "
+              << prepare_ms << " | " << ms << std::endl;
+
+    if (!columnar) {
+      for (unsigned r = 0; r < files.size(); ++r)
+        joiner.getRelation(r).storeRelationV2(v2_files[r], alignment);
+    }
+  }
+  return 0;
+}
+
+// The page faults of the process so far
+static uint64_t pageFaults() {
+  rusage usage{};
+  getrusage(RUSAGE_SELF, &usage);
+  return usage.ru_minflt + usage.ru_majflt;
+}
+
+// Load the relations of an init file lazily, prefaulted and copied to huge
+// pages and run the workload once after each
+static int benchLoad(const std::string &init_file) {
+  auto slash = init_file.find_last_of('/');
+  auto dir = slash == std::string::npos ? "" : init_file.substr(0, slash + 1);
+  std::vector<std::string> files;
+  std::ifstream in(init_file);
+  for (std::string line; std::getline(in, line);) {
+    if (!line.empty() && line != "Done")
+      files.push_back(dir + line);
+  }
+  auto queries = loadQueries(init_file);
+
+  LoadOptions lazy, prefault, huge_pages;
+  lazy.prefault = false;
+  huge_pages.huge_pages = true;
+  std::cout << "mode | load ms faults prefaulted | first run ms faults"
+            << std::endl;
+  std::cout << std::fixed << std::setprecision(3);
+  std::vector<std::pair<const char *, LoadOptions>> modes{
+      {"lazy", lazy}, {"prefault", prefault}, {"huge_pages", huge_pages}};
+  for (auto &mode : modes) {
+    Joiner joiner;
+    auto report = joiner.addRelations(files, mode.second);
+    auto faults = pageFaults();
+    auto start = Clock::now();
+    for (auto &query : queries)
+      joiner.join(query);
+    auto ms = elapsedMs(start);
+    std::cout << mode.first << " | " << report.ms << " "
+              << report.page_faults << " " << report.prefaulted_pages << " | "
+              << ms << " " << pageFaults() - faults << std::endl;
+  }
+  return 0;
+}
+
+// Compress every column and compare filtering it with the best kernel on
+// the raw values against filtering its codes
+static int benchCompression(std::vector<Relation> &relations, unsigned reps) {
+  StatisticsCatalog catalog;
+  catalog.build(relations);
+  std::cout << "rel col tuples | encoding bits width ratio | raw compressed "
+               "(ms for < and = on the median)" << std::endl;
+  std::cout << std::fixed << std::setprecision(3);
+  uint64_t raw_memory = 0, compressed_memory = 0;
+  double raw_total = 0, compressed_total = 0;
+  for (unsigned r = 0; r < relations.size(); ++r) {
+    auto &rel = relations[r];
+    std::vector<uint64_t> mask((rel.size() + 63) / 64);
+    for (unsigned c = 0; c < rel.columns().size(); ++c) {
+      auto column = rel.columns()[c];
+      auto &stats = catalog.column(r, c);
+      std::cout << "r" << r << " " << c << " " << rel.size() << " | ";
+      raw_memory += rel.size() * sizeof(uint64_t);
+      if (!rel.compressColumn(c, stats.min, stats.max, stats.distinct)) {
+        std::cout << "none" << std::endl;
+        compressed_memory += rel.size() * sizeof(uint64_t);
+        continue;
+      }
+      auto compressed = rel.compressedColumn(c);
+      compressed_memory += compressed->memory();
+      std::cout << (compressed->encoding()
+                    == CompressedColumn::Encoding::Dictionary ? "dict" : "for")
+                << " " << compressed->bits() << " " << compressed->width()
+                << " " << double(rel.size() * sizeof(uint64_t))
+                    / std::max<uint64_t>(1, compressed->memory()) << " |";
+
+      std::vector<uint64_t> sorted(column, column + rel.size());
+      std::nth_element(sorted.begin(), sorted.begin() + sorted.size() / 2,
+                       sorted.end());
+      auto constant = sorted.empty() ? 0 : sorted[sorted.size() / 2];
+      std::vector<std::pair<uint64_t, uint64_t>> ranges{
+          {0, constant - 1}, {constant, constant}};
+
+      uint64_t raw_selected = 0, compressed_selected = 0;
+      auto start = Clock::now();
+      for (unsigned rep = 0; rep < reps; ++rep) {
+        for (auto comparison : {FilterInfo::Comparison::Less,
+                                FilterInfo::Comparison::Equal}) {
+          FilterKernel::evaluate(column, rel.size(), comparison, constant,
+                                 mask.data(), false);
+          for (auto word : mask)
+            raw_selected += __builtin_popcountll(word);
+        }
+      }
+      auto raw_ms = elapsedMs(start);
+      start = Clock::now();
+      for (unsigned rep = 0; rep < reps; ++rep) {
+        for (auto &range : ranges) {
+          uint64_t code_low, code_high;
+          if (constant == 0 && range.second < range.first)
+            continue;
+          if (!compressed->codeRange(range.first, range.second, code_low,
+                                     code_high))
+            continue;
+          compressed->evaluate(0, rel.size(), code_low, code_high,
+                               mask.data(), false);
+          for (auto word : mask)
+            compressed_selected += __builtin_popcountll(word);
+        }
+      }
+      auto compressed_ms = elapsedMs(start);
+      if (raw_selected != compressed_selected) {
+        std::cerr << "selection differs for r" << r << "." << c << std::endl;
+        return 1;
+      }
+      raw_total += raw_ms;
+      compressed_total += compressed_ms;
+      std::cout << " " << raw_ms << " " << compressed_ms << std::endl;
+    }
+  }
+  std::cout << "total | " << double(raw_memory)
+      / std::max<uint64_t>(1, compressed_memory) << " | " << raw_total << " "
+            << compressed_total << std::endl;
+  return 0;
+}
+
+// Run the workload next to the init file without indexes, with sorted
+// indexes and with sorted and hash indexes
+static int benchIndex(std::vector<Relation> &relations,
+                      const std::string &init_file,
+                      unsigned reps) {
+  Joiner joiner;
+  uint64_t data_size = 0;
+  for (auto &relation : relations) {
+    data_size += relation.size() * relation.columns().size()
+        * sizeof(uint64_t);
+    joiner.addRelation(std::move(relation));
+  }
+  joiner.buildStatistics();
+  auto queries = loadQueries(init_file);
+
+  std::cout << "mode ms" << std::endl;
+  std::cout << std::fixed << std::setprecision(3);
+  std::vector<std::string> expected;
+  for (std::string mode : {"scan", "sorted", "hash"}) {
+    if (mode != "scan") {
+      auto start = Clock::now();
+      uint64_t memory;
+      if (mode == "sorted") {
+        joiner.buildSortedIndexes();
+        memory = joiner.sortedIndexMemory();
+      } else {
+        memory = joiner.buildHashIndexes();
+      }
+      std::cout << "build " << mode << " " << elapsedMs(start) << " ms, "
+                << memory / (1 << 20) << " MiB ("
+                << 100.0 * memory / std::max<uint64_t>(1, data_size)
+                << "% of the data)" << std::endl;
+    }
+    std::vector<std::string> results;
+    auto start = Clock::now();
+    for (unsigned rep = 0; rep < reps; ++rep) {
+      results.clear();
+      for (auto &query : queries)
+        results.push_back(joiner.join(query));
+    }
+    auto ms = elapsedMs(start) / reps;
+
+    if (expected.empty()) {
+      expected = results;
+    } else if (results != expected) {
+      std::cerr << mode << " results differ" << std::endl;
+      return 1;
+    }
+    std::cout << mode << " " << ms << std::endl;
+  }
+  return 0;
+}
+
+// Compute the statistics catalog and compare it with the exact values
+static int benchStatistics(std::vector<Relation> &relations) {
+  auto start = Clock::now();
+  StatisticsCatalog catalog;
+  catalog.build(relations);
+  auto ms = elapsedMs(start);
+
+  std::cout << "rel col tuples | min max | distinct exact | unique mcvs"
+            << std::endl;
+  std::cout << std::fixed << std::setprecision(0);
+  for (unsigned r = 0; r < relations.size(); ++r) {
+    auto &rel = relations[r];
+    for (unsigned c = 0; c < rel.columns().size(); ++c) {
+      auto &stats = catalog.column(r, c);
+      std::vector<uint64_t> sorted(rel.columns()[c],
+                                   rel.columns()[c] + rel.size());
+      std::sort(sorted.begin(), sorted.end());
+      auto exact = std::unique(sorted.begin(), sorted.end()) - sorted.begin();
+      std::cout << "r" << r << " " << c << " " << rel.size() << " | "
+                << stats.min << " " << stats.max << " | " << stats.distinct
+                << " " << exact << " | " << stats.unique << " "
+                << stats.most_common.size() << std::endl;
+    }
+  }
+  std::cout << std::setprecision(3) << "build ms " << ms << std::endl;
+  return 0;
+}
+
+}
+
+int main(int argc, char *argv[]) {
+  if (argc < 3) {
+    usage();
+    return 1;
+  }
+  if (strcmp(argv[1], "load") == 0)
+    return benchLoad(argv[2]);
+  if (strcmp(argv[1], "columnar") == 0)
+    return benchColumnar(argv[2], argc > 3 ? std::stoull(argv[3])
+                                           : Relation::kPageSize);
+  auto relations = loadRelations(argv[2]);
+
+  if (strcmp(argv[1], "hash_table") == 0)
+    return benchHashTable(relations, argc > 3 ? std::stoul(argv[3]) : 100);
+  if (strcmp(argv[1], "filter") == 0)
+    return benchFilter(relations, argc > 3 ? std::stoul(argv[3]) : 100);
+  if (strcmp(argv[1], "compression") == 0)
+    return benchCompression(relations, argc > 3 ? std::stoul(argv[3]) : 100);
+  if (strcmp(argv[1], "index") == 0)
+    return benchIndex(relations, argv[2], argc > 3 ? std::stoul(argv[3]) : 10);
+  if (strcmp(argv[1], "statistics") == 0)
+    return benchStatistics(relations);
+  if (strcmp(argv[1], "pipeline") == 0)
+    return benchPipeline(relations, argv[2],
+                         argc > 3 ? std::stoul(argv[3]) : 10);
+  if (strcmp(argv[1], "join_filter") == 0)
+    return benchJoinFilter(relations, argv[2],
+                           argc > 3 ? std::stoul(argv[3]) : 10);
+  if (strcmp(argv[1], "semi_join") == 0)
+    return benchSemiJoin(relations, argv[2],
+                         argc > 3 ? std::stoul(argv[3]) : 10);
+  if (strcmp(argv[1], "multiway") == 0)
+    return benchMultiway(relations, argv[2],
+                         argc > 3 ? std::stoul(argv[3]) : 10);
+  if (strcmp(argv[1], "eager_aggregation") == 0)
+    return benchEagerAggregation(relations, argv[2],
+                                 argc > 3 ? std::stoul(argv[3]) : 10);
+  if (strcmp(argv[1], "factorized") == 0)
+    return benchFactorized(relations, argv[2],
+                           argc > 3 ? std::stoul(argv[3]) : 10);
+  if (strcmp(argv[1], "batch") == 0) {
+    ThreadPool::setGlobalThreads(argc > 4 ? std::stoul(argv[4]) : 0);
+    return benchBatch(relations, argv[2], argc > 3 ? std::stoul(argv[3]) : 10);
+  }
+  if (strcmp(argv[1], "cache") == 0)
+    return benchCache(relations, argv[2], argc > 3 ? std::stoul(argv[3]) : 10);
+  if (strcmp(argv[1], "scaling") == 0) {
+    unsigned max_threads = argc > 3 ? std::stoul(argv[3])
+                                    : std::thread::hardware_concurrency();
+    return benchScaling(relations, argv[2], std::max(1u, max_threads));
+  }
+
+  usage();
+  return 1;
+}
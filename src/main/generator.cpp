@@ -0,0 +1,199 @@
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <sys/resource.h>
+#include <sys/stat.h>
+
+#include "joiner.h"
+#include "parser.h"
+#include "reference_joiner.h"
+#include "workload_generator.h"
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+static void usage() {
+  std::cerr << "Usage: generator <output-dir> [options]\n"
+               "  --name <name>              workload name (synthetic)\n"
+               "  --scale <factor>           relations have up to factor * "
+            << WorkloadGenerator::kBaseSize << " tuples (1)\n"
+               "  --relations <n>            number of relations (10)\n"
+               "  --foreign-keys <n>         foreign keys per relation (3)\n"
+               "  --attributes <n>           attributes per relation (2)\n"
+               "  --distribution <d>         uniform, zipf or fk (uniform)\n"
+               "  --skew <s>                 Zipf skew (1)\n"
+               "  --shapes <s,...>           chain, star, cycle, clique (all)\n"
+               "  --joined <min>-<max>       relations per query (2-4)\n"
+               "  --queries <n>              number of queries (100)\n"
+               "  --batch <n>                queries per batch (10)\n"
+               "  --filters <p>              probability of a filter per "
+               "relation (0.5)\n"
+               "  --selectivity <f>          fraction a range filter selects "
+               "(0.1)\n"
+               "  --seed <n>                 random seed (42)"
+            << std::endl;
+}
+
+// Elapsed milliseconds since start
+static double elapsedMs(Clock::time_point start) {
+  return std::chrono::duration<double, std::milli>(Clock::now() - start)
+      .count();
+}
+
+// The peak resident memory of the process in MiB
+static double peakMemoryMiB() {
+  rusage usage{};
+  getrusage(RUSAGE_SELF, &usage);
+  return usage.ru_maxrss / 1024.0;
+}
+
+// Parse the options into the configuration
+static void parseOptions(int argc,
+                         char *argv[],
+                         WorkloadGenerator::Config &config,
+                         std::string &name) {
+  for (int i = 2; i < argc; i += 2) {
+    if (i + 1 == argc)
+      throw std::invalid_argument(std::string("missing value of ") + argv[i]);
+    std::string option = argv[i], value = argv[i + 1];
+    if (option == "--name") {
+      name = value;
+    } else if (option == "--scale") {
+      config.scale = std::stod(value);
+    } else if (option == "--relations") {
+      config.num_relations = std::stoul(value);
+    } else if (option == "--foreign-keys") {
+      config.num_foreign_keys = std::stoul(value);
+    } else if (option == "--attributes") {
+      config.num_attributes = std::stoul(value);
+    } else if (option == "--distribution") {
+      config.distribution = WorkloadGenerator::parseDistribution(value);
+    } else if (option == "--skew") {
+      config.skew = std::stod(value);
+    } else if (option == "--shapes") {
+      config.shapes.clear();
+      std::stringstream names(value);
+      for (std::string shape; std::getline(names, shape, ',');)
+        config.shapes.push_back(WorkloadGenerator::parseShape(shape));
+    } else if (option == "--joined") {
+      auto dash = value.find('-');
+      config.min_joined = std::stoul(value.substr(0, dash));
+      config.max_joined = dash == std::string::npos
+                          ? config.min_joined
+                          : std::stoul(value.substr(dash + 1));
+    } else if (option == "--queries") {
+      config.num_queries = std::stoul(value);
+    } else if (option == "--batch") {
+      config.batch_size = std::stoul(value);
+    } else if (option == "--filters") {
+      config.filter_probability = std::stod(value);
+    } else if (option == "--selectivity") {
+      config.selectivity = std::stod(value);
+    } else if (option == "--seed") {
+      config.seed = std::stoull(value);
+    } else {
+      throw std::invalid_argument("unknown option " + option);
+    }
+  }
+}
+
+}
+
+int main(int argc, char *argv[]) {
+  if (argc < 2 || argv[1][0] == '-') {
+    usage();
+    return 1;
+  }
+  std::string dir = argv[1], name = "synthetic";
+  WorkloadGenerator::Config config;
+  try {
+    parseOptions(argc, argv, config, name);
+  } catch (const std::exception &e) {
+    std::cerr << e.what() << std::endl;
+    usage();
+    return 1;
+  }
+  if (mkdir(dir.c_str(), 0755) != 0 && errno != EEXIST) {
+    std::cerr << "cannot create " << dir << ": " << strerror(errno)
+              << std::endl;
+    return 1;
+  }
+  dir += "/";
+
+  // Write the relations in the binary format and list them in the init file
+  auto start = Clock::now();
+  WorkloadGenerator generator(config);
+  Joiner joiner;
+  std::ofstream init(dir + name + ".init");
+  uint64_t tuples = 0;
+  for (unsigned i = 0; i < config.num_relations; ++i) {
+    auto relation = generator.relation(i);
+    auto file_name = "r" + std::to_string(i);
+    relation.storeRelation(dir + file_name);
+    init << file_name << "\n";
+    tuples += relation.size();
+    joiner.addRelation(std::move(relation));
+  }
+  auto generate_ms = elapsedMs(start);
+
+  std::ofstream work(dir + name + ".work");
+  auto lines = generator.queries();
+  for (auto &line : lines)
+    work << line << "\n";
+
+  // The expected results come from the reference joiner, before the
+  // preparation touches the relations
+  start = Clock::now();
+  std::vector<std::string> expected;
+  ReferenceJoiner reference(joiner.relations());
+  std::ofstream result(dir + name + ".result");
+  for (auto &line : lines) {
+    if (line == "F") continue;
+    QueryInfo query(line);
+    expected.push_back(reference.join(query));
+    result << expected.back();
+  }
+  auto reference_ms = elapsedMs(start);
+
+  // The engine runs the queries like the driver does
+  start = Clock::now();
+  joiner.buildStatistics();
+  joiner.buildSortedIndexes();
+  joiner.buildHashIndexes();
+  joiner.compressColumns();
+  auto prepare_ms = elapsedMs(start);
+
+  start = Clock::now();
+  unsigned num_queries = 0, mismatches = 0;
+  for (auto &line : lines) {
+    if (line == "F") continue;
+    QueryInfo query(line);
+    if (joiner.join(query) != expected[num_queries++]) {
+      std::cerr << "wrong result: " << line << std::endl;
+      ++mismatches;
+    }
+  }
+  auto query_ms = elapsedMs(start);
+
+  std::cout << std::fixed << std::setprecision(1)
+            << "relations " << config.num_relations << "\n"
+            << "tuples " << tuples << "\n"
+            << "MiB " << tuples * generator.numColumns() * sizeof(uint64_t)
+                / double(1 << 20) << "\n"
+            << "generate ms " << generate_ms << "\n"
+            << "reference ms " << reference_ms << "\n"
+            << "prepare ms " << prepare_ms << "\n"
+            << "queries " << num_queries << "\n"
+            << "query ms " << query_ms << "\n"
+            << "queries/s " << num_queries * 1000 / query_ms << "\n"
+            << "peak MiB " << peakMemoryMiB() << "\n"
+            << "mismatches " << mismatches << std::endl;
+  return mismatches ? 2 : 0;
+}
@@ -1,27 +1,52 @@
 #include <iostream>
 
+#include "batch_executor.h"
 #include "joiner.h"
 #include "parser.h"
+#include "thread_pool.h"
 
 int main(int argc, char *argv[]) {
+  // Number of threads (default: number of cores), `pin` binds them to cores
+  ThreadPool::setGlobalThreads(argc > 1 ? std::stoul(argv[1]) : 0,
+                               argc > 2 && std::string(argv[2]) == "pin");
+
   Joiner joiner;
 
   // Read join relations
   std::string line;
+  std::vector<std::string> files;
   while (getline(std::cin, line)) {
     if (line == "Done") break;
-    joiner.addRelation(line.c_str());
+    files.push_back(line);
   }
+  joiner.addRelations(files);
 
   // Preparation phase (not timed)
-  // Build histograms, indexes,...
+  joiner.buildStatistics();
+  joiner.buildSortedIndexes();
+  joiner.buildHashIndexes();
+  joiner.compressColumns();
+  // Filtered scans and hash tables are reused across batches
+  joiner.enableCache();
+  // Repeated queries are answered without execution
+  joiner.enableResultCache();
 
-  QueryInfo i;
+  // The queries of a batch run concurrently, their results are written in
+  // the order of the batch
+  BatchExecutor executor(joiner);
+  std::vector<QueryInfo> batch;
   while (getline(std::cin, line)) {
-    if (line == "F") continue; // End of a batch
-    i.parseQuery(line);
-    std::cout << joiner.join(i);
+    if (line == "F") { // End of a batch
+      for (auto &result : executor.run(batch))
+        std::cout << result;
+      std::cout << std::flush;
+      batch.clear();
+      continue;
+    }
+    batch.emplace_back(line);
   }
+  for (auto &result : executor.run(batch))
+    std::cout << result;
 
   return 0;
 }
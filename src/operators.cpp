@@ -1,9 +1,305 @@
 #include "operators.h"
 
+#include <algorithm>
 #include <cassert>
+#include <mutex>
+#include <numeric>
+#include <type_traits>
+
+#include "filter_kernel.h"
+#include "thread_pool.h"
+
+namespace {
+
+// Fetch a column of the tuples of a row id column. Returns the base
+// relation's column if the row ids are the entire relation in order.
+const uint64_t *fetchColumn(const RowIdColumn &row_ids,
+                            unsigned col_id,
+                            uint64_t size,
+                            std::vector<uint64_t> &buffer) {
+  auto column = row_ids.relation->columns()[col_id];
+  if (!row_ids.ids)
+    return column;
+  buffer.resize(size);
+  ThreadPool::global().parallelFor(size, [&](uint64_t begin, uint64_t end) {
+    for (uint64_t i = begin; i < end; ++i)
+      buffer[i] = column[row_ids.ids[i]];
+  });
+  return buffer.data();
+}
+
+// The composite keys of the tuples in the key columns. Returns the only
+// column if the key is a single column.
+const uint64_t *compositeKeys(const std::vector<const uint64_t *> &columns,
+                              uint64_t size,
+                              std::vector<uint64_t> &buffer) {
+  if (columns.size() == 1)
+    return columns[0];
+  buffer.resize(size);
+  ThreadPool::global().parallelFor(size, [&](uint64_t begin, uint64_t end) {
+    for (uint64_t i = begin; i < end; ++i) {
+      auto key = columns[0][i];
+      for (unsigned k = 1; k < columns.size(); ++k)
+        key = compositeKey(key, columns[k][i]);
+      buffer[i] = key;
+    }
+  });
+  return buffer.data();
+}
+
+// The values [low, high] that pass a filter (low > high if none does)
+std::pair<uint64_t, uint64_t> filterRange(const FilterInfo &filter) {
+  using Range = std::pair<uint64_t, uint64_t>;
+  auto constant = filter.constant;
+  switch (filter.comparison) {
+    case FilterInfo::Comparison::Less:
+      return constant == 0 ? Range(1, 0) : Range(0, constant - 1);
+    case FilterInfo::Comparison::Greater:
+      return constant == UINT64_MAX ? Range(1, 0)
+                                    : Range(constant + 1, UINT64_MAX);
+    default:return Range(constant, constant);
+  }
+}
+
+// Add the row ids of a binding unless they are part of the columns already
+void addRowIds(std::vector<RowIdColumn> &columns, const RowIdColumn &row_ids) {
+  for (auto &column : columns) {
+    if (column.binding == row_ids.binding)
+      return;
+  }
+  columns.push_back(row_ids);
+}
+
+// The row ids of a binding among the columns of a batch
+const RowIdColumn &findRowIds(const std::vector<RowIdColumn> &columns,
+                              unsigned binding) {
+  for (auto &row_ids : columns) {
+    if (row_ids.binding == binding)
+      return row_ids;
+  }
+  assert(false && "binding is not part of the result");
+  throw std::logic_error("binding is not part of the result");
+}
+
+// The multiplicity of every tuple [begin, end) of a batch, the product of
+// its counts (a factorized column counts the tuples of its group), and the
+// contribution of every column to its sum: the tuple's value times its
+// multiplicity, or for a factorized column the sum of the group times the
+// counts of the tuple's other groups
+void weigh(const std::vector<RowIdColumn> &columns,
+           uint64_t begin,
+           uint64_t end,
+           const std::vector<SelectInfo> &count_columns,
+           const std::vector<SelectInfo> &sum_columns,
+           std::vector<uint64_t> &multiplicities,
+           std::vector<std::vector<uint64_t>> &contributions) {
+  std::vector<const RowIdColumn *> counts;
+  for (auto &info : count_columns)
+    counts.push_back(&findRowIds(columns, info.binding));
+  auto count = [](const RowIdColumn &column, uint64_t i) {
+    auto id = column.rowId(i);
+    return column.groups ? column.groups->counts[id] : id;
+  };
+  multiplicities.assign(end - begin, 1);
+  for (auto column : counts) {
+    for (uint64_t i = begin; i < end; ++i)
+      multiplicities[i - begin] *= count(*column, i);
+  }
+
+  contributions.resize(sum_columns.size());
+  for (unsigned c = 0; c < sum_columns.size(); ++c) {
+    auto &info = sum_columns[c];
+    auto &row_ids = findRowIds(columns, info.binding);
+    auto &contribution = contributions[c];
+    contribution.resize(end - begin);
+    if (!row_ids.groups) {
+      auto column = row_ids.relation->columns()[info.col_id];
+      for (uint64_t i = begin; i < end; ++i)
+        contribution[i - begin] =
+            column[row_ids.rowId(i)] * multiplicities[i - begin];
+      continue;
+    }
+    auto &sums = row_ids.groups->sums.at(info);
+    for (uint64_t i = begin; i < end; ++i) {
+      auto sum = sums[row_ids.rowId(i)];
+      for (auto column : counts) {
+        if (column->groups != row_ids.groups)
+          sum *= count(*column, i);
+      }
+      contribution[i - begin] = sum;
+    }
+  }
+}
+
+/// A consumer that passes every batch to a function
+template<typename Fn>
+class FunctionConsumer : public Consumer {
+ private:
+  /// The function
+  Fn fn_;
+
+ public:
+  /// The constructor
+  explicit FunctionConsumer(Fn fn) : fn_(std::move(fn)) {};
+  /// Consume the tuples [begin, end) of the row id columns
+  void consume(const std::vector<RowIdColumn> &columns,
+               uint64_t begin,
+               uint64_t end) override {
+    fn_(columns, begin, end);
+  }
+};
+
+// Create a consumer from a function
+template<typename Fn>
+FunctionConsumer<Fn> makeConsumer(Fn fn) {
+  return FunctionConsumer<Fn>(std::move(fn));
+}
+
+// The first position in [from, to) of sorted values whose value is not less
+// than value (greater than value if after is set). Gallops from the front,
+// since consecutive seeks move forward.
+uint64_t seek(const std::vector<uint64_t> &values,
+              uint64_t from,
+              uint64_t to,
+              uint64_t value,
+              bool after) {
+  auto before = [&](uint64_t v) { return after ? v <= value : v < value; };
+  if (from == to || !before(values[from]))
+    return from;
+  uint64_t low = from, step = 1;
+  while (low + step < to && before(values[low + step])) {
+    low += step;
+    step *= 2;
+  }
+  auto high = std::min(low + step, to);
+  return std::partition_point(values.begin() + low + 1,
+                              values.begin() + high,
+                              before) - values.begin();
+}
+
+// Call fn(positions) for every combination of one position per range
+template<typename Fn>
+void forEachCombination(const std::vector<std::pair<uint64_t, uint64_t>> &ranges,
+                        Fn &&fn) {
+  std::vector<uint64_t> positions(ranges.size());
+  for (unsigned i = 0; i < ranges.size(); ++i)
+    positions[i] = ranges[i].first;
+  while (true) {
+    fn(positions);
+    unsigned i = 0;
+    for (; i < ranges.size(); ++i) {
+      if (++positions[i] < ranges[i].second)
+        break;
+      positions[i] = ranges[i].first;
+    }
+    if (i == ranges.size())
+      return;
+  }
+}
+
+/// The output of a pipelined operator for one batch: row ids per binding,
+/// pushed whenever a morsel worth of tuples is collected
+class BatchBuffer {
+ private:
+  /// The consumer
+  Consumer &consumer_;
+  /// The bindings and relations of the output
+  std::vector<RowIdColumn> columns_;
+  /// The row ids of every output column
+  std::vector<std::vector<uint64_t>> ids_;
+
+ public:
+  /// The constructor
+  BatchBuffer(Consumer &consumer, std::vector<RowIdColumn> columns)
+      : consumer_(consumer), columns_(std::move(columns)),
+        ids_(columns_.size()) {
+    for (unsigned cId = 0; cId < ids_.size(); ++cId) {
+      ids_[cId].reserve(ThreadPool::kMorselSize);
+      columns_[cId].ids = ids_[cId].data();
+    }
+  }
+  /// The row ids of an output column
+  std::vector<uint64_t> &ids(unsigned cId) { return ids_[cId]; }
+  /// The number of buffered tuples
+  uint64_t size() const { return ids_.empty() ? 0 : ids_[0].size(); }
+  /// Push the buffered tuples if a morsel is full
+  void flushIfFull() {
+    if (size() >= ThreadPool::kMorselSize)
+      flush();
+  }
+  /// Push the buffered tuples
+  void flush() {
+    auto size = this->size();
+    if (size == 0)
+      return;
+    for (unsigned cId = 0; cId < ids_.size(); ++cId)
+      columns_[cId].ids = ids_[cId].data();
+    consumer_.consume(columns_, 0, size);
+    for (auto &ids : ids_)
+      ids.clear();
+  }
+};
+
+}
+
+// Store the row ids of the selected tuples of the inputs
+uint64_t Operator::gatherRowIds(const MorselIds &ids,
+                                const std::vector<RowIdColumn> &inputs) {
+  std::vector<uint64_t> offsets(ids.size() + 1, 0);
+  for (unsigned m = 0; m < ids.size(); ++m)
+    offsets[m + 1] = offsets[m] + ids[m].size();
+
+  auto first_col = row_ids_.size();
+  row_ids_.resize(first_col + inputs.size());
+  for (unsigned cId = 0; cId < inputs.size(); ++cId)
+    row_ids_[first_col + cId].resize(offsets.back());
+
+  ThreadPool::global().parallelFor(ids.size(), 1, [&](uint64_t m, uint64_t) {
+    for (unsigned cId = 0; cId < inputs.size(); ++cId) {
+      auto in = inputs[cId].ids;
+      auto out = row_ids_[first_col + cId].data() + offsets[m];
+      if (in) {
+        for (auto id : ids[m])
+          *out++ = in[id];
+      } else {
+        std::copy(ids[m].begin(), ids[m].end(), out);
+      }
+    }
+  });
+
+  for (unsigned cId = 0; cId < inputs.size(); ++cId) {
+    row_id_columns_.push_back(RowIdColumn{inputs[cId].binding,
+                                          inputs[cId].relation,
+                                          row_ids_[first_col + cId].data(),
+                                          inputs[cId].groups});
+  }
+  return offsets.back();
+}
+
+// Materialize the result and push it to a consumer
+void Operator::produce(Consumer &consumer) {
+  run();
+  ThreadPool::global().parallelFor(result_size_,
+                                   [&](uint64_t begin, uint64_t end) {
+    consumer.consume(row_id_columns_, begin, end);
+  });
+}
 
 // Get materialized results
 std::vector<uint64_t *> Operator::getResults() {
+  // Fetch the values of the required columns through the row ids
+  if (tmp_results_.size() != select_to_result_col_id_.size()) {
+    tmp_results_.resize(select_to_result_col_id_.size());
+    for (auto &col : select_to_result_col_id_) {
+      auto &row_ids = rowIds(col.first.binding);
+      auto &result = tmp_results_[col.second];
+      result.resize(result_size_);
+      for (uint64_t i = 0; i < result_size_; ++i) {
+        result[i] = row_ids.relation ? row_ids.value(col.first.col_id, i)
+                                     : row_ids.rowId(i);
+      }
+    }
+  }
   std::vector<uint64_t *> result_vector;
   for (auto &c : tmp_results_) {
     result_vector.push_back(c.data());
@@ -11,6 +307,11 @@ std::vector<uint64_t *> Operator::getResults() {
   return result_vector;
 }
 
+// The row ids of a binding
+const RowIdColumn &Operator::rowIds(unsigned binding) const {
+  return findRowIds(row_id_columns_, binding);
+}
+
 // Require a column and add it to results
 bool Scan::require(SelectInfo info) {
   if (info.binding != relation_binding_)
@@ -23,13 +324,73 @@ bool Scan::require(SelectInfo info) {
 
 // Run
 void Scan::run() {
-  // Nothing to do
-  result_size_ = relation_.size();
+  if (join_filters_.empty()) {
+    // Nothing to do
+    result_size_ = relation_.size();
+    row_id_columns_ = {RowIdColumn{relation_binding_, &relation_, nullptr}};
+    return;
+  }
+  MorselIds selected(ThreadPool::numMorsels(relation_.size()));
+  ThreadPool::global().parallelFor(relation_.size(),
+                                   [&](uint64_t begin, uint64_t end) {
+    auto &ids = selected[begin / ThreadPool::kMorselSize];
+    for (uint64_t i = begin; i < end; ++i)
+      ids.push_back(i);
+    applyJoinFilters(ids, 0);
+  });
+  result_size_ = gatherRowIds(
+      selected, {RowIdColumn{relation_binding_, &relation_, nullptr}});
+}
+
+// Push the tuples that pass the join filters to a consumer
+void Scan::produce(Consumer &consumer) {
+  if (join_filters_.empty()) {
+    Operator::produce(consumer);
+    return;
+  }
+  ThreadPool::global().parallelFor(relation_.size(),
+                                   [&](uint64_t begin, uint64_t end) {
+    std::vector<uint64_t> ids;
+    ids.reserve(end - begin);
+    for (uint64_t i = begin; i < end; ++i)
+      ids.push_back(i);
+    applyJoinFilters(ids, 0);
+    if (!ids.empty()) {
+      consumer.consume({RowIdColumn{relation_binding_, &relation_, ids.data()}},
+                       0, ids.size());
+    }
+  });
 }
 
 // Get materialized results
 std::vector<uint64_t *> Scan::getResults() {
-  return result_columns_;
+  return join_filters_.empty() ? result_columns_ : Operator::getResults();
+}
+
+// Apply a join filter on a column of the scanned binding
+bool Scan::pushJoinFilter(const JoinFilter &filter, const SelectInfo &column) {
+  if (column.binding != relation_binding_)
+    return false;
+  join_filters_.emplace_back(&filter, column.col_id);
+  return true;
+}
+
+// Remove the ids whose tuples fail a join filter
+void Scan::applyJoinFilters(std::vector<uint64_t> &ids, uint64_t from) const {
+  for (auto &join_filter : join_filters_) {
+    auto &filter = *join_filter.first;
+    // A filter that hardly eliminates tuples is not worth its lookups
+    if (!filter.useful() || ids.size() == from)
+      continue;
+    auto column = relation_.columns()[join_filter.second];
+    auto out = from;
+    for (auto i = from; i < ids.size(); ++i) {
+      ids[out] = ids[i];
+      out += filter.mayContain(column[ids[i]]);
+    }
+    filter.record(ids.size() - from, ids.size() - out);
+    ids.resize(out);
+  }
 }
 
 // Require a column and add it to results
@@ -39,45 +400,194 @@ bool FilterScan::require(SelectInfo info) {
   assert(info.col_id < relation_.columns().size());
   if (select_to_result_col_id_.find(info) == select_to_result_col_id_.end()) {
     // Add to results
-    input_data_.push_back(relation_.columns()[info.col_id]);
-    tmp_results_.emplace_back();
-    unsigned colId = tmp_results_.size() - 1;
+    unsigned colId = select_to_result_col_id_.size();
     select_to_result_col_id_[info] = colId;
   }
   return true;
 }
 
-// Copy to result
-void FilterScan::copy2Result(uint64_t id) {
-  for (unsigned cId = 0; cId < input_data_.size(); ++cId)
-    tmp_results_[cId].push_back(input_data_[cId][id]);
-  ++result_size_;
+// Append the ids of the tuples in [begin, end) that pass all filters
+void FilterScan::select(uint64_t begin,
+                        uint64_t end,
+                        std::vector<uint64_t> &ids) {
+  static_assert(ZoneMap::kBlockSize % 64 == 0,
+                "a block has to fill whole mask words");
+  static_assert(ThreadPool::kMorselSize % ZoneMap::kBlockSize == 0,
+                "a morsel has to consist of whole blocks");
+  assert(begin % ZoneMap::kBlockSize == 0);
+  for (auto block_begin = begin; block_begin < end;
+       block_begin += ZoneMap::kBlockSize) {
+    auto block = block_begin / ZoneMap::kBlockSize;
+    auto size = std::min(end - block_begin, ZoneMap::kBlockSize);
+
+    // Evaluate the filters that the zone maps cannot decide into one bitmask
+    uint64_t mask[ZoneMap::kBlockSize / 64];
+    bool skip = false;
+    unsigned evaluated = 0;
+    for (auto &filter : filters_) {
+      auto col_id = filter.filter_column.col_id;
+      auto range = filterRange(filter);
+      auto match = relation_.zoneMap(col_id).match(block, range.first,
+                                                   range.second);
+      if (match == ZoneMap::Match::None) {
+        skip = true;
+        break;
+      }
+      if (match == ZoneMap::Match::All)
+        continue;
+      // Compressed columns are filtered on their codes, which are read with
+      // a fraction of the memory bandwidth
+      if (auto compressed = relation_.compressedColumn(col_id)) {
+        uint64_t code_low, code_high;
+        if (!compressed->codeRange(range.first, range.second, code_low,
+                                   code_high)) {
+          skip = true;
+          break;
+        }
+        compressed->evaluate(block_begin, size, code_low, code_high, mask,
+                             evaluated++ > 0);
+        continue;
+      }
+      FilterKernel::evaluate(relation_.columns()[col_id] + block_begin, size,
+                             filter.comparison, filter.constant, mask,
+                             evaluated++ > 0);
+    }
+    if (skip)
+      continue;
+    if (evaluated == 0) {
+      // Every tuple of the block qualifies
+      for (uint64_t i = block_begin; i < block_begin + size; ++i)
+        ids.push_back(i);
+    } else {
+      FilterKernel::toSelection(mask, size, block_begin, ids);
+    }
+  }
 }
 
-// Apply filter
-bool FilterScan::applyFilter(uint64_t i, FilterInfo &f) {
-  auto compare_col = relation_.columns()[f.filter_column.col_id];
-  auto constant = f.constant;
-  switch (f.comparison) {
-    case FilterInfo::Comparison::Equal:return compare_col[i] == constant;
-    case FilterInfo::Comparison::Greater:return compare_col[i] > constant;
-    case FilterInfo::Comparison::Less:return compare_col[i] < constant;
-  };
-  return false;
+// Choose between the most selective sorted index and a full scan
+void FilterScan::chooseAccessPath() {
+  // Merge the filters on every column into one range
+  std::unordered_map<unsigned, std::pair<uint64_t, uint64_t>> ranges;
+  for (auto &filter : filters_) {
+    auto range = filterRange(filter);
+    auto iter = ranges.find(filter.filter_column.col_id);
+    if (iter == ranges.end()) {
+      ranges.emplace(filter.filter_column.col_id, range);
+    } else {
+      iter->second.first = std::max(iter->second.first, range.first);
+      iter->second.second = std::min(iter->second.second, range.second);
+    }
+  }
+
+  // The index range size is the exact number of tuples that pass the
+  // filters of its column
+  index_row_ids_ = nullptr;
+  index_size_ = 0;
+  unsigned index_col_id = 0;
+  if (candidates_) {
+    // The candidates pass all but the given filters
+    index_row_ids_ = candidates_->data();
+    index_size_ = candidates_->size();
+    residual_filters_ = filters_;
+    return;
+  }
+  auto max_size = uint64_t(kMaxIndexSelectivity * relation_.size());
+  for (auto &range : ranges) {
+    auto low = range.second.first, high = range.second.second;
+    const uint64_t *row_ids = nullptr;
+    uint64_t size = 0;
+    if (low == high && relation_.hashIndex(range.first)) {
+      auto values = relation_.hashIndex(range.first)->find(low);
+      row_ids = values.begin();
+      size = values.size();
+    } else if (relation_.sortedIndex(range.first)) {
+      auto index = relation_.sortedIndex(range.first);
+      auto positions = index->range(low, high);
+      row_ids = index->row_ids() + positions.first;
+      size = positions.second - positions.first;
+    } else {
+      continue;
+    }
+    if (size <= max_size) {
+      max_size = size;
+      index_row_ids_ = row_ids;
+      index_size_ = size;
+      index_col_id = range.first;
+    }
+  }
+
+  residual_filters_.clear();
+  for (auto &filter : filters_) {
+    if (!index_row_ids_ || filter.filter_column.col_id != index_col_id)
+      residual_filters_.push_back(filter);
+  }
 }
 
-// Run
-void FilterScan::run() {
-  for (uint64_t i = 0; i < relation_.size(); ++i) {
+// Append the ids of the tuples at the positions [begin, end) of the index
+void FilterScan::selectFromIndex(uint64_t begin,
+                                 uint64_t end,
+                                 std::vector<uint64_t> &ids) {
+  for (uint64_t i = begin; i < end; ++i) {
+    auto row_id = index_row_ids_[i];
     bool pass = true;
-    for (auto &f : filters_) {
-      pass &= applyFilter(i, f);
-    }
+    for (auto &filter : residual_filters_)
+      pass &= filter.passes(
+          relation_.columns()[filter.filter_column.col_id][row_id]);
     if (pass)
-      copy2Result(i);
+      ids.push_back(row_id);
   }
 }
 
+// Run
+void FilterScan::run() {
+  chooseAccessPath();
+  if (candidates_ && residual_filters_.empty() && join_filters_.empty()) {
+    // Every candidate qualifies
+    result_size_ = candidates_->size();
+    row_id_columns_ = {RowIdColumn{relation_binding_, &relation_,
+                                   candidates_->data()}};
+    return;
+  }
+  // The candidates may be empty (without data)
+  auto size = index_row_ids_ || candidates_ ? index_size_ : relation_.size();
+  MorselIds selected(ThreadPool::numMorsels(size));
+  ThreadPool::global().parallelFor(size, [&](uint64_t begin, uint64_t end) {
+    auto &ids = selected[begin / ThreadPool::kMorselSize];
+    if (index_row_ids_)
+      selectFromIndex(begin, end, ids);
+    else
+      select(begin, end, ids);
+    applyJoinFilters(ids, 0);
+  });
+  result_size_ = gatherRowIds(
+      selected, {RowIdColumn{relation_binding_, &relation_, nullptr}});
+}
+
+// Push the qualifying tuples of every morsel to a consumer
+void FilterScan::produce(Consumer &consumer) {
+  chooseAccessPath();
+  // The candidates may be empty (without data)
+  auto size = index_row_ids_ || candidates_ ? index_size_ : relation_.size();
+  ThreadPool::global().parallelFor(size, [&](uint64_t begin, uint64_t end) {
+    if (candidates_ && residual_filters_.empty() && join_filters_.empty()) {
+      consumer.consume({RowIdColumn{relation_binding_, &relation_,
+                                    candidates_->data()}}, begin, end);
+      return;
+    }
+    std::vector<uint64_t> ids;
+    ids.reserve(end - begin);
+    if (index_row_ids_)
+      selectFromIndex(begin, end, ids);
+    else
+      select(begin, end, ids);
+    applyJoinFilters(ids, 0);
+    if (!ids.empty()) {
+      consumer.consume({RowIdColumn{relation_binding_, &relation_, ids.data()}},
+                       0, ids.size());
+    }
+  });
+}
+
 // Require a column and add it to results
 bool Join::require(SelectInfo info) {
   if (requested_columns_.count(info) == 0) {
@@ -92,77 +602,717 @@ bool Join::require(SelectInfo info) {
     if (!success)
       return false;
 
-    tmp_results_.emplace_back();
     requested_columns_.emplace(info);
   }
   return true;
 }
 
-// Copy to result
-void Join::copy2Result(uint64_t left_id, uint64_t right_id) {
-  unsigned rel_col_id = 0;
-  for (unsigned cId = 0; cId < copy_left_data_.size(); ++cId)
-    tmp_results_[rel_col_id++].push_back(copy_left_data_[cId][left_id]);
-
-  for (unsigned cId = 0; cId < copy_right_data_.size(); ++cId)
-    tmp_results_[rel_col_id++].push_back(copy_right_data_[cId][right_id]);
-  ++result_size_;
-}
-
-// Run
-void Join::run() {
+// Run the inputs and fetch the join keys
+void Join::prepareInputs(bool materialize_probe_side) {
   left_->require(p_info_.left);
   right_->require(p_info_.right);
-  left_->run();
-  right_->run();
-
+  for (auto &p_info : key_predicates_) {
+    left_->require(p_info.left);
+    right_->require(p_info.right);
+  }
 
-  // Use smaller input_ for build
-  if (left_->result_size() > right_->result_size()) {
+  bool swap = build_side_ == BuildSide::Right;
+  if (build_side_ == BuildSide::Smaller) {
+    // Use smaller input_ for build
+    left_->run();
+    right_->run();
+    swap = left_->result_size() > right_->result_size();
+  }
+  if (swap) {
     std::swap(left_, right_);
     std::swap(p_info_.left, p_info_.right);
+    for (auto &p_info : key_predicates_)
+      std::swap(p_info.left, p_info.right);
     std::swap(requested_columns_left_, requested_columns_right_);
   }
+  if (build_side_ != BuildSide::Smaller)
+    left_->run();
 
-  auto left_input_data = left_->getResults();
-  auto right_input_data = right_->getResults();
-
-  // Resolve the input_ columns_
+  // Resolve the bindings that are passed to the result
   unsigned res_col_id = 0;
   for (auto &info : requested_columns_left_) {
-    copy_left_data_.push_back(left_input_data[left_->resolve(info)]);
+    addRowIds(copy_left_ids_, left_->rowIds(info.binding));
     select_to_result_col_id_[info] = res_col_id++;
   }
-  for (auto &info : requested_columns_right_) {
-    copy_right_data_.push_back(right_input_data[right_->resolve(info)]);
+  for (auto &info : requested_columns_right_)
     select_to_result_col_id_[info] = res_col_id++;
+
+  if (!prebuilt_table_) {
+    left_key_column_ = fetchColumn(left_->rowIds(p_info_.left.binding),
+                                   p_info_.left.col_id,
+                                   left_->result_size(),
+                                   left_keys_);
+    if (!key_predicates_.empty()) {
+      left_key_columns_ = {left_key_column_};
+      left_key_buffers_.resize(key_predicates_.size());
+      for (unsigned k = 0; k < key_predicates_.size(); ++k) {
+        auto &info = key_predicates_[k].left;
+        left_key_columns_.push_back(fetchColumn(left_->rowIds(info.binding),
+                                                info.col_id,
+                                                left_->result_size(),
+                                                left_key_buffers_[k]));
+      }
+    }
   }
+  if (materialize_probe_side || build_side_ == BuildSide::Smaller)
+    materializeProbeSide();
+}
 
-  auto left_col_id = left_->resolve(p_info_.left);
-  auto right_col_id = right_->resolve(p_info_.right);
+// Run the probe side and fetch its join keys
+void Join::materializeProbeSide() {
+  // The smaller input was picked after running both
+  if (build_side_ != BuildSide::Smaller)
+    right_->run();
+  probe_side_materialized_ = true;
+  for (auto &info : requested_columns_right_)
+    addRowIds(copy_right_ids_, right_->rowIds(info.binding));
+  right_key_column_ = fetchColumn(right_->rowIds(p_info_.right.binding),
+                                  p_info_.right.col_id,
+                                  right_->result_size(),
+                                  right_keys_);
+  if (!key_predicates_.empty()) {
+    right_key_columns_ = {right_key_column_};
+    right_key_buffers_.resize(key_predicates_.size());
+    for (unsigned k = 0; k < key_predicates_.size(); ++k) {
+      auto &info = key_predicates_[k].right;
+      right_key_columns_.push_back(fetchColumn(right_->rowIds(info.binding),
+                                               info.col_id,
+                                               right_->result_size(),
+                                               right_key_buffers_[k]));
+    }
+  }
+}
 
-  // Build phase
-  auto left_key_column = left_input_data[left_col_id];
+// Build the hash table on the left input
+void Join::build() {
+  if (prebuilt_table_)
+    return;
+  auto keys = key_predicates_.empty() ? left_key_column_
+      : compositeKeys(left_key_columns_, left_->result_size(),
+                      left_composite_keys_);
+#ifdef USE_STD_HASH_TABLE
   hash_table_.reserve(left_->result_size() * 2);
   for (uint64_t i = 0, limit = i + left_->result_size(); i != limit; ++i) {
-    hash_table_.emplace(left_key_column[i], i);
+    hash_table_.emplace(keys[i], i);
   }
+#else
+  hash_table_.build(keys, left_->result_size());
+#endif
+}
+
+// Push a filter on the build side's keys into the probe side
+void Join::pushBuildKeys() {
+  // A prebuilt table comes without the keys of the build side
+  if (!use_join_filter_ || probe_side_materialized_ || prebuilt_table_
+      || left_->result_size() > JoinFilter::kMaxKeys)
+    return;
+  join_filter_ = std::make_unique<JoinFilter>();
+  join_filter_->build(left_key_column_, left_->result_size());
+  if (!right_->pushJoinFilter(*join_filter_, p_info_.right))
+    join_filter_.reset();
+}
+
+// Apply a join filter in the scan of either input
+bool Join::pushJoinFilter(const JoinFilter &filter, const SelectInfo &column) {
+  // The positions of a prebuilt table's build side must not change
+  return (!prebuilt_table_ && left_->pushJoinFilter(filter, column))
+      || right_->pushJoinFilter(filter, column);
+}
+
+// Store the row ids of the matching tuples as result
+void Join::materialize(const MorselIds &left_ids,
+                       const MorselIds &right_ids) {
+  result_size_ = gatherRowIds(left_ids, copy_left_ids_);
+  gatherRowIds(right_ids, copy_right_ids_);
+}
+
+// Run
+void Join::run() {
+  prepareInputs(false);
+
+  // Build phase, the probe side's scans then drop tuples without partner
+  build();
+  pushBuildKeys();
+  if (!probe_side_materialized_)
+    materializeProbeSide();
+
   // Probe phase
-  auto right_key_column = right_input_data[right_col_id];
-  for (uint64_t i = 0, limit = i + right_->result_size(); i != limit; ++i) {
-    auto rightKey = right_key_column[i];
-    auto range = hash_table_.equal_range(rightKey);
-    for (auto iter = range.first; iter != range.second; ++iter) {
-      copy2Result(iter->second, i);
+  auto probe_size = right_->result_size();
+  MorselIds left_ids(ThreadPool::numMorsels(probe_size));
+  MorselIds right_ids(left_ids.size());
+  ThreadPool::global().parallelFor(probe_size,
+                                   [&](uint64_t begin, uint64_t end) {
+    auto morsel = begin / ThreadPool::kMorselSize;
+    auto &morsel_left_ids = left_ids[morsel];
+    auto &morsel_right_ids = right_ids[morsel];
+    if (key_predicates_.empty()) {
+      for (uint64_t i = begin; i != end; ++i) {
+        forEachMatch(right_key_column_[i], [&](uint64_t left_id) {
+          morsel_left_ids.push_back(left_id);
+          morsel_right_ids.push_back(i);
+        });
+      }
+      return;
+    }
+    std::vector<uint64_t> keys(right_key_columns_.size());
+    for (uint64_t i = begin; i != end; ++i) {
+      for (unsigned k = 0; k < keys.size(); ++k)
+        keys[k] = right_key_columns_[k][i];
+      forEachKeyMatch(keys.data(), [&](uint64_t left_id) {
+        morsel_left_ids.push_back(left_id);
+        morsel_right_ids.push_back(i);
+      });
     }
+  });
+  materialize(left_ids, right_ids);
+}
+
+// Build the hash table and push the probe side's tuples through it
+void Join::produce(Consumer &consumer) {
+  prepareInputs(false);
+  build();
+  pushBuildKeys();
+
+  // The output: the row ids of left, then those of right
+  std::vector<RowIdColumn> output = copy_left_ids_;
+  std::vector<unsigned> right_bindings;
+  for (auto &info : requested_columns_right_) {
+    if (std::find(right_bindings.begin(), right_bindings.end(), info.binding)
+        == right_bindings.end())
+      right_bindings.push_back(info.binding);
   }
+
+  // The probe of a single-column key is compiled separately from that of a
+  // composite key, which would slow down its inner loop
+  auto probe = [&](auto composite) {
+    return makeConsumer([&, composite](const std::vector<RowIdColumn> &columns,
+                                       uint64_t begin,
+                                       uint64_t end) {
+      // Resolve the output columns of the probe side in this batch
+      std::vector<const RowIdColumn *> right_columns;
+      auto batch_output = output;
+      for (auto binding : right_bindings) {
+        right_columns.push_back(&findRowIds(columns, binding));
+        batch_output.push_back(*right_columns.back());
+      }
+      auto &keys = findRowIds(columns, p_info_.right.binding);
+      auto key_column = keys.relation->columns()[p_info_.right.col_id];
+
+      BatchBuffer buffer(consumer, std::move(batch_output));
+      auto num_left = copy_left_ids_.size();
+      auto emit = [&](uint64_t i) {
+        return [&, i](uint64_t left_id) {
+          for (unsigned cId = 0; cId < num_left; ++cId)
+            buffer.ids(cId).push_back(copy_left_ids_[cId].rowId(left_id));
+          for (unsigned cId = 0; cId < right_columns.size(); ++cId)
+            buffer.ids(num_left + cId).push_back(right_columns[cId]->rowId(i));
+        };
+      };
+      if constexpr (!decltype(composite)::value) {
+        for (uint64_t i = begin; i != end; ++i) {
+          forEachMatch(key_column[keys.rowId(i)], emit(i));
+          buffer.flushIfFull();
+        }
+      } else {
+        // The further columns of the composite key
+        std::vector<std::pair<const RowIdColumn *, const uint64_t *>>
+            key_columns;
+        for (auto &p_info : key_predicates_) {
+          auto &row_ids = findRowIds(columns, p_info.right.binding);
+          key_columns.emplace_back(
+              &row_ids, row_ids.relation->columns()[p_info.right.col_id]);
+        }
+        std::vector<uint64_t> values(key_columns.size() + 1);
+        for (uint64_t i = begin; i != end; ++i) {
+          values[0] = key_column[keys.rowId(i)];
+          for (unsigned k = 0; k < key_columns.size(); ++k) {
+            values[k + 1] =
+                key_columns[k].second[key_columns[k].first->rowId(i)];
+          }
+          forEachKeyMatch(values.data(), emit(i));
+          buffer.flushIfFull();
+        }
+      }
+      buffer.flush();
+    });
+  };
+  auto push = [&](auto &&probe) {
+    if (probe_side_materialized_) {
+      // Both inputs were run to pick the smaller one as build side
+      ThreadPool::global().parallelFor(right_->result_size(),
+                                       [&](uint64_t begin, uint64_t end) {
+        probe.consume(right_->getRowIds(), begin, end);
+      });
+    } else {
+      right_->produce(probe);
+    }
+  };
+  if (key_predicates_.empty())
+    push(probe(std::false_type()));
+  else
+    push(probe(std::true_type()));
 }
 
-// Copy to result
-void SelfJoin::copy2Result(uint64_t id) {
-  for (unsigned cId = 0; cId < copy_data_.size(); ++cId)
-    tmp_results_[cId].push_back(copy_data_[cId][id]);
-  ++result_size_;
+// Run
+void RadixJoin::run() {
+  prepareInputs();
+
+  // Choose the fan-out such that a partition's hash table fits into cache
+  auto bits = radix_bits_;
+  if (bits == 0) {
+    while ((left_->result_size() >> bits) > kPartitionSize
+        && bits < 2 * kMaxRadixBitsPerPass)
+      ++bits;
+  }
+
+  // Partition phase (on the composite keys if the key has several columns)
+  std::vector<uint64_t> right_composite_keys;
+  auto left_keys = key_predicates_.empty() ? left_key_column_
+      : compositeKeys(left_key_columns_, left_->result_size(),
+                      left_composite_keys_);
+  auto right_keys = key_predicates_.empty() ? right_key_column_
+      : compositeKeys(right_key_columns_, right_->result_size(),
+                      right_composite_keys);
+  auto left = radixPartition(left_keys, left_->result_size(), bits);
+  auto right = radixPartition(right_keys, right_->result_size(), bits);
+
+  // Build and probe each pair of partitions independently
+  auto num_partitions = left.offsets.size() - 1;
+  MorselIds left_ids(num_partitions), right_ids(num_partitions);
+  ThreadPool::global().parallelFor(num_partitions, 1,
+                                   [&](uint64_t p, uint64_t) {
+    HashTable table;
+    auto left_begin = left.offsets[p];
+    table.build(left.keys.data() + left_begin, left.ids.data() + left_begin,
+                left.offsets[p + 1] - left_begin);
+    for (uint64_t i = right.offsets[p]; i < right.offsets[p + 1]; ++i) {
+      for (auto left_id : table.find(right.keys[i])) {
+        if (!keysMatch(left_id, right.ids[i]))
+          continue;
+        left_ids[p].push_back(left_id);
+        right_ids[p].push_back(right.ids[i]);
+      }
+    }
+  });
+  materialize(left_ids, right_ids);
+}
+
+// Require a column and add it to results
+bool IndexJoin::require(SelectInfo info) {
+  if (requested_columns_.count(info))
+    return true;
+  if (info.binding == p_info_.left.binding) {
+    assert(info.col_id < relation_.columns().size());
+    requested_columns_relation_.push_back(info);
+  } else if (input_->require(info)) {
+    requested_columns_input_.push_back(info);
+  } else {
+    return false;
+  }
+  requested_columns_.emplace(info);
+  return true;
+}
+
+// Require the join key and resolve the result columns
+void IndexJoin::prepare() {
+  input_->require(p_info_.right);
+  unsigned res_col_id = 0;
+  for (auto &info : requested_columns_relation_)
+    select_to_result_col_id_[info] = res_col_id++;
+  for (auto &info : requested_columns_input_)
+    select_to_result_col_id_[info] = res_col_id++;
+}
+
+// Run
+void IndexJoin::run() {
+  prepare();
+  input_->run();
+
+  std::vector<RowIdColumn> copy_relation_ids, copy_input_ids;
+  if (!requested_columns_relation_.empty())
+    copy_relation_ids.push_back(
+        RowIdColumn{p_info_.left.binding, &relation_, nullptr});
+  for (auto &info : requested_columns_input_)
+    addRowIds(copy_input_ids, input_->rowIds(info.binding));
+
+  auto keys = fetchColumn(input_->rowIds(p_info_.right.binding),
+                          p_info_.right.col_id, input_->result_size(), keys_);
+  MorselIds relation_ids(ThreadPool::numMorsels(input_->result_size()));
+  MorselIds input_ids(relation_ids.size());
+  ThreadPool::global().parallelFor(input_->result_size(),
+                                   [&](uint64_t begin, uint64_t end) {
+    auto morsel = begin / ThreadPool::kMorselSize;
+    for (uint64_t i = begin; i != end; ++i) {
+      for (auto row_id : index_.find(keys[i])) {
+        relation_ids[morsel].push_back(row_id);
+        input_ids[morsel].push_back(i);
+      }
+    }
+  });
+  result_size_ = gatherRowIds(relation_ids, copy_relation_ids);
+  gatherRowIds(input_ids, copy_input_ids);
+}
+
+// Push the input's tuples through the index to a consumer
+void IndexJoin::produce(Consumer &consumer) {
+  prepare();
+  std::vector<unsigned> input_bindings;
+  for (auto &info : requested_columns_input_) {
+    if (std::find(input_bindings.begin(), input_bindings.end(), info.binding)
+        == input_bindings.end())
+      input_bindings.push_back(info.binding);
+  }
+  bool copy_relation_ids = !requested_columns_relation_.empty();
+
+  auto probe = makeConsumer([&](const std::vector<RowIdColumn> &columns,
+                                uint64_t begin,
+                                uint64_t end) {
+    // The output: the row ids of the relation, then those of the input
+    std::vector<RowIdColumn> output;
+    if (copy_relation_ids)
+      output.push_back(RowIdColumn{p_info_.left.binding, &relation_, nullptr});
+    std::vector<const RowIdColumn *> input_columns;
+    for (auto binding : input_bindings) {
+      input_columns.push_back(&findRowIds(columns, binding));
+      output.push_back(*input_columns.back());
+    }
+    auto &keys = findRowIds(columns, p_info_.right.binding);
+    auto key_column = keys.relation->columns()[p_info_.right.col_id];
+
+    BatchBuffer buffer(consumer, std::move(output));
+    unsigned first_input = copy_relation_ids;
+    for (uint64_t i = begin; i != end; ++i) {
+      for (auto row_id : index_.find(key_column[keys.rowId(i)])) {
+        if (copy_relation_ids)
+          buffer.ids(0).push_back(row_id);
+        for (unsigned cId = 0; cId < input_columns.size(); ++cId)
+          buffer.ids(first_input + cId).push_back(input_columns[cId]->rowId(i));
+      }
+      buffer.flushIfFull();
+    }
+    buffer.flush();
+  });
+  input_->produce(probe);
+}
+
+// Require a column and add it to results
+bool CountJoin::require(SelectInfo info) {
+  if (requested_columns_.count(info))
+    return true;
+  if (info == countColumn(p_info_.left.binding)) {
+    counts_requested_ = true;
+  } else if (right_->require(info)) {
+    requested_columns_right_.push_back(info);
+  } else {
+    return false;
+  }
+  requested_columns_.emplace(info);
+  return true;
+}
+
+// Aggregate the left input and resolve the result columns
+void CountJoin::prepare() {
+  right_->require(p_info_.right);
+  unsigned res_col_id = 0;
+  for (auto &info : requested_columns_right_)
+    select_to_result_col_id_[info] = res_col_id++;
+  if (counts_requested_)
+    select_to_result_col_id_[countColumn(p_info_.left.binding)] = res_col_id;
+  if (index_)
+    return;
+
+  // The join key of every left tuple and the product of its counts
+  left_->require(p_info_.left);
+  auto &left_counts = left_->countColumns();
+  for (auto &info : left_counts)
+    left_->require(info);
+  std::mutex mutex;
+  std::vector<uint64_t> keys, multiplicities;
+  auto collect = makeConsumer([&](const std::vector<RowIdColumn> &columns,
+                                  uint64_t begin,
+                                  uint64_t end) {
+    auto &row_ids = findRowIds(columns, p_info_.left.binding);
+    auto column = row_ids.relation->columns()[p_info_.left.col_id];
+    std::vector<uint64_t> batch_keys, batch_multiplicities;
+    std::vector<std::vector<uint64_t>> contributions;
+    batch_keys.reserve(end - begin);
+    for (uint64_t i = begin; i != end; ++i)
+      batch_keys.push_back(column[row_ids.rowId(i)]);
+    weigh(columns, begin, end, left_counts, {}, batch_multiplicities,
+          contributions);
+    std::lock_guard<std::mutex> lock(mutex);
+    keys.insert(keys.end(), batch_keys.begin(), batch_keys.end());
+    multiplicities.insert(multiplicities.end(), batch_multiplicities.begin(),
+                          batch_multiplicities.end());
+  });
+  left_->produce(collect);
+  counts_.build(keys.data(), multiplicities.data(), keys.size());
+  counts_.sumValues();
+
+  // The right input's scans drop the tuples without partner
+  if (!use_join_filter_ || keys.size() > JoinFilter::kMaxKeys)
+    return;
+  join_filter_ = std::make_unique<JoinFilter>();
+  join_filter_->build(keys.data(), keys.size());
+  if (!right_->pushJoinFilter(*join_filter_, p_info_.right))
+    join_filter_.reset();
+}
+
+// Run
+void CountJoin::run() {
+  prepare();
+  right_->run();
+
+  std::vector<RowIdColumn> copy_right_ids;
+  for (auto &info : requested_columns_right_)
+    addRowIds(copy_right_ids, right_->rowIds(info.binding));
+  std::vector<uint64_t> keys_buffer;
+  auto keys = fetchColumn(right_->rowIds(p_info_.right.binding),
+                          p_info_.right.col_id, right_->result_size(),
+                          keys_buffer);
+  MorselIds right_ids(ThreadPool::numMorsels(right_->result_size()));
+  MorselIds counts(right_ids.size());
+  ThreadPool::global().parallelFor(right_->result_size(),
+                                   [&](uint64_t begin, uint64_t end) {
+    auto morsel = begin / ThreadPool::kMorselSize;
+    for (uint64_t i = begin; i != end; ++i) {
+      if (auto count = this->count(keys[i])) {
+        right_ids[morsel].push_back(i);
+        counts[morsel].push_back(count);
+      }
+    }
+  });
+  result_size_ = gatherRowIds(right_ids, copy_right_ids);
+  // The counts are stored like the row ids of a full relation
+  if (counts_requested_)
+    gatherRowIds(counts, {RowIdColumn{p_info_.left.binding, nullptr, nullptr}});
+}
+
+// Push the right input's tuples with their multiplicities to a consumer
+void CountJoin::produce(Consumer &consumer) {
+  prepare();
+  std::vector<unsigned> right_bindings;
+  for (auto &info : requested_columns_right_) {
+    if (std::find(right_bindings.begin(), right_bindings.end(), info.binding)
+        == right_bindings.end())
+      right_bindings.push_back(info.binding);
+  }
+
+  auto probe = makeConsumer([&](const std::vector<RowIdColumn> &columns,
+                                uint64_t begin,
+                                uint64_t end) {
+    // The output: the row ids of the right input, then the counts
+    std::vector<const RowIdColumn *> inputs;
+    std::vector<RowIdColumn> output;
+    for (auto binding : right_bindings) {
+      inputs.push_back(&findRowIds(columns, binding));
+      output.push_back(*inputs.back());
+    }
+    if (counts_requested_)
+      output.push_back(RowIdColumn{p_info_.left.binding, nullptr, nullptr});
+    auto &keys = findRowIds(columns, p_info_.right.binding);
+    auto key_column = keys.relation->columns()[p_info_.right.col_id];
+
+    BatchBuffer buffer(consumer, std::move(output));
+    for (uint64_t i = begin; i != end; ++i) {
+      auto count = this->count(key_column[keys.rowId(i)]);
+      if (!count)
+        continue;
+      for (unsigned cId = 0; cId < inputs.size(); ++cId)
+        buffer.ids(cId).push_back(inputs[cId]->rowId(i));
+      if (counts_requested_)
+        buffer.ids(inputs.size()).push_back(count);
+      buffer.flushIfFull();
+    }
+    buffer.flush();
+  });
+  right_->produce(probe);
+}
+
+// Require a column and add it to results
+bool FactorizedJoin::require(SelectInfo info) {
+  if (requested_columns_.count(info))
+    return true;
+  bool count = info == CountJoin::countColumn(p_info_.left.binding);
+  if (count || left_->require(info)) {
+    if (!count)
+      requested_columns_left_.push_back(info);
+    if (std::find(left_bindings_.begin(), left_bindings_.end(), info.binding)
+        == left_bindings_.end())
+      left_bindings_.push_back(info.binding);
+  } else if (right_->require(info)) {
+    requested_columns_right_.push_back(info);
+  } else {
+    return false;
+  }
+  requested_columns_.emplace(info);
+  return true;
+}
+
+// Group the left input and resolve the result columns
+void FactorizedJoin::prepare() {
+  right_->require(p_info_.right);
+  unsigned res_col_id = 0;
+  for (auto &info : requested_columns_right_)
+    select_to_result_col_id_[info] = res_col_id++;
+  for (auto &info : requested_columns_left_)
+    select_to_result_col_id_[info] = res_col_id++;
+
+  // The join key, the multiplicity and the summands of every left tuple
+  left_->require(p_info_.left);
+  auto &left_counts = left_->countColumns();
+  for (auto &info : left_counts)
+    left_->require(info);
+  std::mutex mutex;
+  std::vector<uint64_t> keys, multiplicities;
+  std::vector<std::vector<uint64_t>> summands(requested_columns_left_.size());
+  auto collect = makeConsumer([&](const std::vector<RowIdColumn> &columns,
+                                  uint64_t begin,
+                                  uint64_t end) {
+    auto &row_ids = findRowIds(columns, p_info_.left.binding);
+    auto column = row_ids.relation->columns()[p_info_.left.col_id];
+    std::vector<uint64_t> batch_keys, batch_multiplicities;
+    std::vector<std::vector<uint64_t>> contributions;
+    batch_keys.reserve(end - begin);
+    for (uint64_t i = begin; i != end; ++i)
+      batch_keys.push_back(column[row_ids.rowId(i)]);
+    weigh(columns, begin, end, left_counts, requested_columns_left_,
+          batch_multiplicities, contributions);
+    std::lock_guard<std::mutex> lock(mutex);
+    keys.insert(keys.end(), batch_keys.begin(), batch_keys.end());
+    multiplicities.insert(multiplicities.end(), batch_multiplicities.begin(),
+                          batch_multiplicities.end());
+    for (unsigned c = 0; c < summands.size(); ++c) {
+      summands[c].insert(summands[c].end(), contributions[c].begin(),
+                         contributions[c].end());
+    }
+  });
+  left_->produce(collect);
+
+  // Sum the tuples of every group
+  table_.build(keys.data(), nullptr, keys.size());
+  auto groups = table_.groupValues();
+  groups_.counts.assign(table_.size(), 0);
+  for (uint64_t i = 0; i < groups.size(); ++i)
+    groups_.counts[groups[i]] += multiplicities[i];
+  for (unsigned c = 0; c < summands.size(); ++c) {
+    auto &sums = groups_.sums[requested_columns_left_[c]];
+    sums.assign(table_.size(), 0);
+    for (uint64_t i = 0; i < groups.size(); ++i)
+      sums[groups[i]] += summands[c][i];
+  }
+
+  // The right input's scans drop the tuples without partner
+  if (!use_join_filter_ || keys.size() > JoinFilter::kMaxKeys)
+    return;
+  join_filter_ = std::make_unique<JoinFilter>();
+  join_filter_->build(keys.data(), keys.size());
+  if (!right_->pushJoinFilter(*join_filter_, p_info_.right))
+    join_filter_.reset();
+}
+
+// Run
+void FactorizedJoin::run() {
+  prepare();
+  right_->run();
+
+  std::vector<RowIdColumn> copy_right_ids;
+  for (auto &info : requested_columns_right_)
+    addRowIds(copy_right_ids, right_->rowIds(info.binding));
+  std::vector<uint64_t> keys_buffer;
+  auto keys = fetchColumn(right_->rowIds(p_info_.right.binding),
+                          p_info_.right.col_id, right_->result_size(),
+                          keys_buffer);
+  MorselIds right_ids(ThreadPool::numMorsels(right_->result_size()));
+  MorselIds group_ids(right_ids.size());
+  ThreadPool::global().parallelFor(right_->result_size(),
+                                   [&](uint64_t begin, uint64_t end) {
+    auto morsel = begin / ThreadPool::kMorselSize;
+    for (uint64_t i = begin; i != end; ++i) {
+      if (auto group = this->group(keys[i])) {
+        right_ids[morsel].push_back(i);
+        group_ids[morsel].push_back(*group);
+      }
+    }
+  });
+  result_size_ = gatherRowIds(right_ids, copy_right_ids);
+  if (left_bindings_.empty())
+    return;
+  // The bindings of the left input share the group ids
+  gatherRowIds(group_ids, {RowIdColumn{left_bindings_[0], nullptr, nullptr,
+                                       &groups_}});
+  auto ids = row_id_columns_.back().ids;
+  for (unsigned b = 1; b < left_bindings_.size(); ++b)
+    row_id_columns_.push_back(
+        RowIdColumn{left_bindings_[b], nullptr, ids, &groups_});
+}
+
+// Push the right input's tuples with their groups to a consumer
+void FactorizedJoin::produce(Consumer &consumer) {
+  prepare();
+  std::vector<unsigned> right_bindings;
+  for (auto &info : requested_columns_right_) {
+    if (std::find(right_bindings.begin(), right_bindings.end(), info.binding)
+        == right_bindings.end())
+      right_bindings.push_back(info.binding);
+  }
+
+  auto probe = makeConsumer([&](const std::vector<RowIdColumn> &columns,
+                                uint64_t begin,
+                                uint64_t end) {
+    // The output: the row ids of the right input, then the group ids
+    std::vector<const RowIdColumn *> inputs;
+    std::vector<RowIdColumn> output;
+    for (auto binding : right_bindings) {
+      inputs.push_back(&findRowIds(columns, binding));
+      output.push_back(*inputs.back());
+    }
+    for (auto binding : left_bindings_)
+      output.push_back(RowIdColumn{binding, nullptr, nullptr, &groups_});
+    auto &keys = findRowIds(columns, p_info_.right.binding);
+    auto key_column = keys.relation->columns()[p_info_.right.col_id];
+
+    BatchBuffer buffer(consumer, std::move(output));
+    for (uint64_t i = begin; i != end; ++i) {
+      auto group = this->group(key_column[keys.rowId(i)]);
+      if (!group)
+        continue;
+      for (unsigned cId = 0; cId < inputs.size(); ++cId)
+        buffer.ids(cId).push_back(inputs[cId]->rowId(i));
+      for (unsigned b = 0; b < left_bindings_.size(); ++b)
+        buffer.ids(inputs.size() + b).push_back(*group);
+      buffer.flushIfFull();
+    }
+    buffer.flush();
+  });
+  right_->produce(probe);
+}
+
+// Require a column and add it to results
+bool SharedScan::require(SelectInfo info) {
+  auto binding = std::find(bindings_.begin(), bindings_.end(), info.binding);
+  if (binding == bindings_.end())
+    return false;
+  if (select_to_result_col_id_.find(info) == select_to_result_col_id_.end()) {
+    unsigned colId = select_to_result_col_id_.size();
+    select_to_result_col_id_[info] = colId;
+  }
+  return true;
+}
+
+// Run
+void SharedScan::run() {
+  // Nothing to do, the row ids are those of the shared result
+  row_id_columns_.clear();
+  for (unsigned c = 0; c < columns_.size(); ++c) {
+    row_id_columns_.push_back(RowIdColumn{bindings_[c], columns_[c].relation,
+                                          columns_[c].ids});
+  }
 }
 
 // Require a column and add it to results
@@ -170,7 +1320,6 @@ bool SelfJoin::require(SelectInfo info) {
   if (required_IUs_.count(info))
     return true;
   if (input_->require(info)) {
-    tmp_results_.emplace_back();
     required_IUs_.emplace(info);
     return true;
   }
@@ -182,23 +1331,414 @@ void SelfJoin::run() {
   input_->require(p_info_.left);
   input_->require(p_info_.right);
   input_->run();
-  input_data_ = input_->getResults();
 
+  std::vector<RowIdColumn> copy_ids;
   for (auto &iu : required_IUs_) {
-    auto id = input_->resolve(iu);
-    copy_data_.emplace_back(input_data_[id]);
-    select_to_result_col_id_.emplace(iu, copy_data_.size() - 1);
+    addRowIds(copy_ids, input_->rowIds(iu.binding));
+    select_to_result_col_id_.emplace(iu, select_to_result_col_id_.size());
   }
 
-  auto left_col_id = input_->resolve(p_info_.left);
-  auto right_col_id = input_->resolve(p_info_.right);
+  auto &left_ids = input_->rowIds(p_info_.left.binding);
+  auto &right_ids = input_->rowIds(p_info_.right.binding);
+  auto left_col = left_ids.relation->columns()[p_info_.left.col_id];
+  auto right_col = right_ids.relation->columns()[p_info_.right.col_id];
+  MorselIds selected(ThreadPool::numMorsels(input_->result_size()));
+  ThreadPool::global().parallelFor(input_->result_size(),
+                                   [&](uint64_t begin, uint64_t end) {
+    auto &ids = selected[begin / ThreadPool::kMorselSize];
+    for (uint64_t i = begin; i < end; ++i) {
+      if (left_col[left_ids.rowId(i)] == right_col[right_ids.rowId(i)])
+        ids.push_back(i);
+    }
+  });
+  result_size_ = gatherRowIds(selected, copy_ids);
+}
+
+// Push the input's tuples that satisfy the predicate to a consumer
+void SelfJoin::produce(Consumer &consumer) {
+  input_->require(p_info_.left);
+  input_->require(p_info_.right);
 
-  auto left_col = input_data_[left_col_id];
-  auto right_col = input_data_[right_col_id];
-  for (uint64_t i = 0; i < input_->result_size(); ++i) {
-    if (left_col[i] == right_col[i])
-      copy2Result(i);
+  std::vector<unsigned> bindings;
+  for (auto &iu : required_IUs_) {
+    if (std::find(bindings.begin(), bindings.end(), iu.binding)
+        == bindings.end())
+      bindings.push_back(iu.binding);
+    select_to_result_col_id_.emplace(iu, select_to_result_col_id_.size());
   }
+
+  auto filter = makeConsumer([&](const std::vector<RowIdColumn> &columns,
+                                 uint64_t begin,
+                                 uint64_t end) {
+    auto &left_ids = findRowIds(columns, p_info_.left.binding);
+    auto &right_ids = findRowIds(columns, p_info_.right.binding);
+    auto left_col = left_ids.relation->columns()[p_info_.left.col_id];
+    auto right_col = right_ids.relation->columns()[p_info_.right.col_id];
+
+    std::vector<const RowIdColumn *> inputs;
+    std::vector<RowIdColumn> output;
+    for (auto binding : bindings) {
+      inputs.push_back(&findRowIds(columns, binding));
+      output.push_back(*inputs.back());
+    }
+    BatchBuffer buffer(consumer, std::move(output));
+    for (uint64_t i = begin; i < end; ++i) {
+      if (left_col[left_ids.rowId(i)] != right_col[right_ids.rowId(i)])
+        continue;
+      for (unsigned cId = 0; cId < inputs.size(); ++cId)
+        buffer.ids(cId).push_back(inputs[cId]->rowId(i));
+      buffer.flushIfFull();
+    }
+    buffer.flush();
+  });
+  input_->produce(filter);
+}
+
+// Require a column and add it to results
+bool MultiwayJoin::require(SelectInfo info) {
+  if (requested_columns_.count(info))
+    return true;
+  for (unsigned i = 0; i < inputs_.size(); ++i) {
+    if (inputs_[i]->require(info)) {
+      requested_columns_.emplace(info);
+      requested_inputs_.emplace_back(info, i);
+      return true;
+    }
+  }
+  return false;
+}
+
+// The input that contains a column
+unsigned MultiwayJoin::inputOf(const SelectInfo &info) {
+  for (unsigned i = 0; i < inputs_.size(); ++i) {
+    if (inputs_[i]->require(info))
+      return i;
+  }
+  throw std::logic_error("column is not part of an input");
+}
+
+// Derive the variables, run the inputs and sort them
+void MultiwayJoin::prepare() {
+  // The classes of equal columns (union-find)
+  std::unordered_map<SelectInfo, unsigned> column_ids;
+  std::vector<SelectInfo> columns;
+  std::vector<unsigned> parent;
+  auto id = [&](const SelectInfo &info) {
+    auto entry = column_ids.emplace(info, columns.size());
+    if (entry.second) {
+      columns.push_back(info);
+      parent.push_back(parent.size());
+    }
+    return entry.first->second;
+  };
+  auto find = [&](unsigned c) {
+    while (parent[c] != c)
+      c = parent[c] = parent[parent[c]];
+    return c;
+  };
+  for (auto &p_info : predicates_)
+    parent[find(id(p_info.left))] = find(id(p_info.right));
+
+  // The columns of every class per input (in the order of appearance)
+  std::vector<unsigned> classes;
+  std::unordered_map<unsigned, std::vector<std::vector<SelectInfo>>> members;
+  for (unsigned c = 0; c < columns.size(); ++c) {
+    auto root = find(c);
+    auto entry = members.emplace(root, inputs_.size());
+    if (entry.second)
+      classes.push_back(root);
+    entry.first->second[inputOf(columns[c])].push_back(columns[c]);
+  }
+  // A class is a variable if it spans several inputs. Variables shared by
+  // more inputs are bound first, they restrict the most ranges.
+  tries_.assign(inputs_.size(), Trie());
+  std::vector<std::pair<unsigned, unsigned>> variables;
+  for (unsigned k = 0; k < classes.size(); ++k) {
+    auto &input_columns = members[classes[k]];
+    unsigned num_inputs = 0;
+    for (auto &cols : input_columns)
+      num_inputs += !cols.empty();
+    for (unsigned i = 0; i < inputs_.size(); ++i) {
+      auto &cols = input_columns[i];
+      // Columns of the same input within the class have to be equal
+      for (unsigned c = 1; c < cols.size(); ++c)
+        tries_[i].equal_columns.emplace_back(cols[0], cols[c]);
+    }
+    if (num_inputs > 1)
+      variables.emplace_back(num_inputs, k);
+  }
+  std::stable_sort(variables.begin(), variables.end(),
+                   [](const std::pair<unsigned, unsigned> &a,
+                      const std::pair<unsigned, unsigned> &b) {
+    return a.first > b.first;
+  });
+  participants_.assign(variables.size(), {});
+  for (unsigned v = 0; v < variables.size(); ++v) {
+    auto &input_columns = members[classes[variables[v].second]];
+    for (unsigned i = 0; i < inputs_.size(); ++i) {
+      if (input_columns[i].empty())
+        continue;
+      participants_[v].emplace_back(i, tries_[i].variables.size());
+      tries_[i].variables.push_back(v);
+      tries_[i].columns.push_back(input_columns[i][0]);
+    }
+  }
+
+  // Run the inputs and resolve the bindings that are passed to the result
+  for (auto &input : inputs_)
+    input->run();
+  copy_ids_.assign(inputs_.size(), {});
+  unsigned res_col_id = 0;
+  for (auto &requested : requested_inputs_) {
+    addRowIds(copy_ids_[requested.second],
+              inputs_[requested.second]->rowIds(requested.first.binding));
+    select_to_result_col_id_[requested.first] = res_col_id++;
+  }
+
+  // Sort every input on its variables
+  for (unsigned i = 0; i < inputs_.size(); ++i) {
+    auto &trie = tries_[i];
+    auto &input = *inputs_[i];
+    auto size = input.result_size();
+    auto fetch = [&](const SelectInfo &info, std::vector<uint64_t> &buffer) {
+      return fetchColumn(input.rowIds(info.binding), info.col_id, size,
+                         buffer);
+    };
+    std::vector<std::vector<uint64_t>> buffers(
+        trie.columns.size() + 2 * trie.equal_columns.size());
+    std::vector<const uint64_t *> keys;
+    for (unsigned c = 0; c < trie.columns.size(); ++c)
+      keys.push_back(fetch(trie.columns[c], buffers[c]));
+    std::vector<std::pair<const uint64_t *, const uint64_t *>> equal;
+    auto buffer = buffers.begin() + trie.columns.size();
+    for (auto &columns : trie.equal_columns) {
+      auto first = fetch(columns.first, *buffer++);
+      equal.emplace_back(first, fetch(columns.second, *buffer++));
+    }
+    // Split the tuples into ranges of the first variable's values, such
+    // that the ranges sort in parallel and concatenate in sorted order.
+    // The splitters are taken from an evenly spaced sample of the values.
+    auto &pool = ThreadPool::global();
+    auto num_morsels = ThreadPool::numMorsels(size);
+    auto num_partitions = std::min<uint64_t>(
+        num_morsels, kPartitionsPerThread * pool.num_threads());
+    std::vector<uint64_t> splitters;
+    if (num_partitions > 1) {
+      std::vector<uint64_t> sample;
+      auto sample_size = num_partitions * kSamplesPerPartition;
+      for (uint64_t j = 0; j < sample_size; ++j)
+        sample.push_back(keys[0][j * size / sample_size]);
+      std::sort(sample.begin(), sample.end());
+      for (uint64_t p = 1; p < num_partitions; ++p)
+        splitters.push_back(sample[p * kSamplesPerPartition]);
+      splitters.erase(std::unique(splitters.begin(), splitters.end()),
+                      splitters.end());
+    }
+    // The qualifying tuples of every morsel per partition
+    std::vector<MorselIds> parts(num_morsels,
+                                 MorselIds(splitters.size() + 1));
+    pool.parallelFor(size, [&](uint64_t begin, uint64_t end) {
+      auto &morsel = parts[begin / ThreadPool::kMorselSize];
+      for (uint64_t t = begin; t < end; ++t) {
+        bool qualifies = true;
+        for (auto &columns : equal)
+          qualifies &= columns.first[t] == columns.second[t];
+        if (!qualifies)
+          continue;
+        auto p = std::upper_bound(splitters.begin(), splitters.end(),
+                                  keys[0][t]) - splitters.begin();
+        morsel[p].push_back(t);
+      }
+    });
+    // Partitions in order, morsels in order within a partition
+    std::vector<uint64_t> offsets{0};
+    for (uint64_t p = 0; p <= splitters.size(); ++p) {
+      auto offset = offsets.back();
+      for (auto &morsel : parts)
+        offset += morsel[p].size();
+      offsets.push_back(offset);
+    }
+    trie.positions.resize(offsets.back());
+    // Sort every partition on the variables, then on the positions
+    pool.parallelFor(offsets.size() - 1, 1, [&](uint64_t p, uint64_t) {
+      auto first = trie.positions.begin() + offsets[p], out = first;
+      for (auto &morsel : parts)
+        out = std::copy(morsel[p].begin(), morsel[p].end(), out);
+      std::sort(first, out, [&](uint64_t a, uint64_t b) {
+        for (auto *level : keys) {
+          if (level[a] != level[b])
+            return level[a] < level[b];
+        }
+        return a < b;
+      });
+    });
+    trie.keys.assign(keys.size(), {});
+    for (unsigned level = 0; level < keys.size(); ++level) {
+      auto &values = trie.keys[level];
+      values.resize(trie.positions.size());
+      pool.parallelFor(values.size(), [&](uint64_t begin, uint64_t end) {
+        for (auto j = begin; j < end; ++j)
+          values[j] = keys[level][trie.positions[j]];
+      });
+    }
+  }
+}
+
+// Bind the variables from v on
+template<typename Emit>
+void MultiwayJoin::bind(unsigned v, Ranges &ranges, Emit &emit) const {
+  if (v == participants_.size()) {
+    emit(ranges);
+    return;
+  }
+  // Iterate the values of the smallest range
+  auto driver = participants_[v][0].first;
+  for (auto &participant : participants_[v]) {
+    auto input = participant.first;
+    if (ranges[input].second - ranges[input].first
+        < ranges[driver].second - ranges[driver].first)
+      driver = input;
+  }
+  bindValues(v, driver, ranges[driver].first, ranges[driver].second, ranges,
+             emit);
+}
+
+// Bind variable v to the values of the driver that start in [from, to)
+template<typename Emit>
+void MultiwayJoin::bindValues(unsigned v,
+                              unsigned driver,
+                              uint64_t from,
+                              uint64_t to,
+                              Ranges &ranges,
+                              Emit &emit) const {
+  auto &participants = participants_[v];
+  Ranges saved;
+  std::vector<uint64_t> cursors;
+  const std::vector<uint64_t> *values = nullptr;
+  for (auto &participant : participants) {
+    saved.push_back(ranges[participant.first]);
+    cursors.push_back(ranges[participant.first].first);
+    if (participant.first == driver)
+      values = &tries_[driver].keys[participant.second];
+  }
+  auto driver_end = ranges[driver].second;
+
+  for (auto j = from; j < to;) {
+    auto value = (*values)[j];
+    // Leapfrog: seek the value in every other range, and skip the driver
+    // ahead to the smallest value that another range holds otherwise
+    bool match = true;
+    for (unsigned k = 0; k < participants.size() && match; ++k) {
+      auto input = participants[k].first;
+      if (input == driver)
+        continue;
+      auto &keys = tries_[input].keys[participants[k].second];
+      auto end = saved[k].second;
+      cursors[k] = seek(keys, cursors[k], end, value, false);
+      if (cursors[k] == end) {
+        j = to;
+        match = false;
+      } else if (keys[cursors[k]] != value) {
+        j = seek(*values, j, driver_end, keys[cursors[k]], false);
+        match = false;
+      } else {
+        ranges[input] = {cursors[k], seek(keys, cursors[k], end, value, true)};
+      }
+    }
+    if (!match)
+      continue;
+    auto next = seek(*values, j, driver_end, value, true);
+    ranges[driver] = {j, next};
+    bind(v + 1, ranges, emit);
+    j = next;
+  }
+  for (unsigned k = 0; k < participants.size(); ++k)
+    ranges[participants[k].first] = saved[k];
+}
+
+// Bind all variables in parallel, split on the values of the first one
+template<typename Fn>
+void MultiwayJoin::bindAll(Fn &&fn) const {
+  Ranges full;
+  for (auto &trie : tries_)
+    full.emplace_back(0, trie.positions.size());
+  if (participants_.empty()) {
+    fn(0, [&](auto &emit) { emit(full); });
+    return;
+  }
+  auto driver = participants_[0][0].first;
+  for (auto &participant : participants_[0]) {
+    if (full[participant.first].second < full[driver].second)
+      driver = participant.first;
+  }
+  // The first variable is the first level of every trie that contains it
+  auto &values = tries_[driver].keys[0];
+  ThreadPool::global().parallelFor(values.size(),
+                                   [&](uint64_t begin, uint64_t end) {
+    // A value belongs to the morsel that holds its first tuple
+    auto from = begin;
+    while (from > 0 && from < end && values[from] == values[from - 1])
+      ++from;
+    fn(begin / ThreadPool::kMorselSize, [&](auto &emit) {
+      auto ranges = full;
+      bindValues(0, driver, from, end, ranges, emit);
+    });
+  });
+}
+
+// Run
+void MultiwayJoin::run() {
+  prepare();
+  uint64_t num_morsels = 1;
+  if (!participants_.empty()) {
+    for (auto &participant : participants_[0]) {
+      num_morsels = std::max(num_morsels, ThreadPool::numMorsels(
+          tries_[participant.first].positions.size()));
+    }
+  }
+  std::vector<MorselIds> ids(inputs_.size(), MorselIds(num_morsels));
+  std::vector<uint64_t> counts(num_morsels, 0);
+  bindAll([&](uint64_t morsel, auto &&bind_morsel) {
+    auto emit = [&](const Ranges &ranges) {
+      forEachCombination(ranges, [&](const std::vector<uint64_t> &sorted) {
+        for (unsigned i = 0; i < inputs_.size(); ++i) {
+          if (!copy_ids_[i].empty())
+            ids[i][morsel].push_back(tries_[i].positions[sorted[i]]);
+        }
+        ++counts[morsel];
+      });
+    };
+    bind_morsel(emit);
+  });
+  for (unsigned i = 0; i < inputs_.size(); ++i) {
+    if (!copy_ids_[i].empty())
+      gatherRowIds(ids[i], copy_ids_[i]);
+  }
+  result_size_ = std::accumulate(counts.begin(), counts.end(), 0ull);
+}
+
+// Push the result to a consumer without materializing it
+void MultiwayJoin::produce(Consumer &consumer) {
+  prepare();
+  std::vector<RowIdColumn> output;
+  for (auto &columns : copy_ids_)
+    output.insert(output.end(), columns.begin(), columns.end());
+  bindAll([&](uint64_t, auto &&bind_morsel) {
+    BatchBuffer buffer(consumer, output);
+    auto emit = [&](const Ranges &ranges) {
+      forEachCombination(ranges, [&](const std::vector<uint64_t> &sorted) {
+        unsigned cId = 0;
+        for (unsigned i = 0; i < inputs_.size(); ++i) {
+          auto position = tries_[i].positions[sorted[i]];
+          for (auto &row_ids : copy_ids_[i])
+            buffer.ids(cId++).push_back(row_ids.rowId(position));
+        }
+        buffer.flushIfFull();
+      });
+    };
+    bind_morsel(emit);
+    buffer.flush();
+  });
 }
 
 // Run
@@ -206,19 +1746,106 @@ void Checksum::run() {
   for (auto &sInfo : col_info_) {
     input_->require(sInfo);
   }
+  for (auto &info : input_->countColumns())
+    input_->require(info);
+  if (pipelined_) {
+    runPipelined();
+    return;
+  }
   input_->run();
-  auto results = input_->getResults();
+  result_size_ = input_->result_size();
+
+  if (!input_->countColumns().empty()) {
+    // Partial sums of every morsel, the first one of the multiplicities
+    std::vector<std::vector<uint64_t>> sums(
+        ThreadPool::numMorsels(result_size_),
+        std::vector<uint64_t>(col_info_.size() + 1, 0));
+    ThreadPool::global().parallelFor(result_size_,
+                                     [&](uint64_t begin, uint64_t end) {
+      std::vector<uint64_t> multiplicities;
+      std::vector<std::vector<uint64_t>> contributions;
+      weigh(input_->getRowIds(), begin, end, input_->countColumns(),
+            col_info_, multiplicities, contributions);
+      auto &morsel_sums = sums[begin / ThreadPool::kMorselSize];
+      morsel_sums[0] = std::accumulate(multiplicities.begin(),
+                                       multiplicities.end(), uint64_t(0));
+      for (unsigned c = 0; c < col_info_.size(); ++c) {
+        morsel_sums[c + 1] = std::accumulate(contributions[c].begin(),
+                                             contributions[c].end(),
+                                             uint64_t(0));
+      }
+    });
+    result_size_ = 0;
+    check_sums_.assign(col_info_.size(), 0);
+    for (auto &morsel_sums : sums) {
+      result_size_ += morsel_sums[0];
+      for (unsigned c = 0; c < col_info_.size(); ++c)
+        check_sums_[c] += morsel_sums[c + 1];
+    }
+    return;
+  }
 
   for (auto &sInfo : col_info_) {
-    auto col_id = input_->resolve(sInfo);
-    auto result_col = results[col_id];
+    // Fetch the values through the row ids
+    auto &row_ids = input_->rowIds(sInfo.binding);
+    auto column = row_ids.relation->columns()[sInfo.col_id];
+    // Partial sums of every morsel
+    std::vector<uint64_t> sums(ThreadPool::numMorsels(result_size_), 0);
+    ThreadPool::global().parallelFor(result_size_,
+                                     [&](uint64_t begin, uint64_t end) {
+      uint64_t sum = 0;
+      if (row_ids.ids) {
+        for (uint64_t i = begin; i < end; ++i)
+          sum += column[row_ids.ids[i]];
+      } else {
+        for (uint64_t i = begin; i < end; ++i)
+          sum += column[i];
+      }
+      sums[begin / ThreadPool::kMorselSize] = sum;
+    });
     uint64_t sum = 0;
-    result_size_ = input_->result_size();
-    for (auto iter = result_col, limit = iter + input_->result_size();
-         iter != limit;
-         ++iter)
-      sum += *iter;
+    for (auto morsel_sum : sums)
+      sum += morsel_sum;
     check_sums_.push_back(sum);
   }
 }
 
+// Let the input push its tuples into running sums
+void Checksum::runPipelined() {
+  std::mutex mutex;
+  check_sums_.assign(col_info_.size(), 0);
+  result_size_ = 0;
+  auto sink = makeConsumer([&](const std::vector<RowIdColumn> &columns,
+                               uint64_t begin,
+                               uint64_t end) {
+    std::vector<uint64_t> sums(col_info_.size(), 0);
+    auto size = end - begin;
+    if (!input_->countColumns().empty()) {
+      // Every tuple stands for its multiplicity many tuples
+      std::vector<uint64_t> multiplicities;
+      std::vector<std::vector<uint64_t>> contributions;
+      weigh(columns, begin, end, input_->countColumns(), col_info_,
+            multiplicities, contributions);
+      size = std::accumulate(multiplicities.begin(), multiplicities.end(),
+                             uint64_t(0));
+      for (unsigned c = 0; c < col_info_.size(); ++c) {
+        sums[c] = std::accumulate(contributions[c].begin(),
+                                  contributions[c].end(), uint64_t(0));
+      }
+    } else {
+      for (unsigned c = 0; c < col_info_.size(); ++c) {
+        auto &row_ids = findRowIds(columns, col_info_[c].binding);
+        auto column = row_ids.relation->columns()[col_info_[c].col_id];
+        uint64_t sum = 0;
+        for (uint64_t i = begin; i < end; ++i)
+          sum += column[row_ids.rowId(i)];
+        sums[c] = sum;
+      }
+    }
+    std::lock_guard<std::mutex> lock(mutex);
+    result_size_ += size;
+    for (unsigned c = 0; c < sums.size(); ++c)
+      check_sums_[c] += sums[c];
+  });
+  input_->produce(sink);
+}
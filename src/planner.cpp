@@ -0,0 +1,282 @@
+#include "planner.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <functional>
+#include <stdexcept>
+
+namespace {
+
+// The bindings 0..i
+inline uint64_t bindingsUpTo(unsigned i) {
+  return i >= 63 ? ~0ull : (2ull << i) - 1;
+}
+
+// The number of bindings in a set
+inline unsigned count(uint64_t bindings) {
+  return __builtin_popcountll(bindings);
+}
+
+}
+
+// The constructor
+Planner::Planner(const std::vector<Relation> &relations,
+                 const QueryInfo &query,
+                 const StatisticsCatalog *statistics,
+                 unsigned max_dp_bindings)
+    : relations_(relations), query_(query),
+      statistics_(statistics && !statistics->empty() ? statistics : nullptr),
+      max_dp_bindings_(max_dp_bindings),
+      num_bindings_(query.relation_ids().size()),
+      neighbors_(num_bindings_, 0) {
+  if (num_bindings_ > 64)
+    throw std::invalid_argument("a query joins at most 64 relations");
+  for (auto &p_info : query_.predicates()) {
+    if (p_info.left.binding == p_info.right.binding)
+      continue;
+    neighbors_[p_info.left.binding] |= 1ull << p_info.right.binding;
+    neighbors_[p_info.right.binding] |= 1ull << p_info.left.binding;
+    join_predicates_.push_back(p_info);
+    join_selectivities_.push_back(
+        1 / std::max(distinctValues(p_info.left),
+                     distinctValues(p_info.right)));
+  }
+}
+
+// The number of distinct values of a column
+double Planner::distinctValues(const SelectInfo &info) const {
+  if (statistics_)
+    return std::max(1.0, statistics_->column(info).distinct);
+  // Estimated from an evenly spaced sample with the GEE estimator: values
+  // seen once stand for sqrt(size / samples) distinct values each
+  auto &relation = relations_[info.rel_id];
+  if (relation.size() == 0)
+    return 1;
+  auto column = relation.columns()[info.col_id];
+  auto step = std::max<uint64_t>(1, relation.size() / kSampleSize);
+  std::vector<uint64_t> sample;
+  for (uint64_t i = 0; i < relation.size(); i += step)
+    sample.push_back(column[i]);
+  std::sort(sample.begin(), sample.end());
+
+  double singletons = 0, repeated = 0;
+  for (uint64_t i = 0, j; i < sample.size(); i = j) {
+    for (j = i + 1; j < sample.size() && sample[j] == sample[i]; ++j);
+    (j - i == 1 ? singletons : repeated) += 1;
+  }
+  auto scale = std::sqrt(double(relation.size()) / sample.size());
+  return std::max(1.0, scale * singletons + repeated);
+}
+
+// Estimate the size of a base relation after its filters
+double Planner::estimateBase(unsigned binding) const {
+  auto &relation = relations_[query_.relation_ids()[binding]];
+  double cardinality = relation.size();
+
+  // Evaluate the filters on an evenly spaced sample
+  std::vector<const FilterInfo *> filters;
+  for (auto &filter : query_.filters()) {
+    if (filter.filter_column.binding == binding)
+      filters.push_back(&filter);
+  }
+  if (statistics_ && !filters.empty()) {
+    // Filters on different columns are assumed to be independent
+    for (auto filter : filters) {
+      cardinality *= statistics_->column(filter->filter_column)
+          .selectivity(filter->comparison, filter->constant);
+    }
+    cardinality = std::max(0.5, cardinality);
+  } else if (!filters.empty() && relation.size() > 0) {
+    auto step = std::max<uint64_t>(1, relation.size() / kSampleSize);
+    uint64_t samples = 0, matches = 0;
+    for (uint64_t i = 0; i < relation.size(); i += step) {
+      ++samples;
+      bool pass = true;
+      for (auto filter : filters) {
+        auto column = relation.columns()[filter->filter_column.col_id];
+        pass &= filter->passes(column[i]);
+      }
+      matches += pass;
+    }
+    // No match in the sample still leaves a few tuples
+    cardinality *= std::max(0.5, double(matches)) / samples;
+  }
+
+  for (auto &p_info : query_.predicates()) {
+    if (p_info.left.binding == binding && p_info.right.binding == binding) {
+      cardinality /= std::max(distinctValues(p_info.left),
+                              distinctValues(p_info.right));
+    }
+  }
+  return cardinality;
+}
+
+// The bindings adjacent to a set of bindings
+uint64_t Planner::neighbors(uint64_t bindings) const {
+  uint64_t result = 0;
+  for (auto rest = bindings; rest; rest &= rest - 1)
+    result |= neighbors_[__builtin_ctzll(rest)];
+  return result & ~bindings;
+}
+
+// Consider joining two disjoint connected sets
+void Planner::emitPair(uint64_t left, uint64_t right) {
+  auto &l = plans_.at(left);
+  auto &r = plans_.at(right);
+  auto cardinality = l.cardinality * r.cardinality;
+  for (unsigned p = 0; p < join_predicates_.size(); ++p) {
+    auto bits = (1ull << join_predicates_[p].left.binding)
+        | (1ull << join_predicates_[p].right.binding);
+    if ((bits & left) && (bits & right))
+      cardinality *= join_selectivities_[p];
+  }
+
+  // Build on the smaller input
+  bool swap = l.cardinality > r.cardinality;
+  auto cost = l.cost + r.cost + cardinality
+      + std::min(l.cardinality, r.cardinality);
+  auto bindings = left | right;
+  auto iter = plans_.find(bindings);
+  if (iter == plans_.end() || cost < iter->second.cost) {
+    plans_[bindings] = Entry{cardinality, cost,
+                             swap ? right : left, swap ? left : right};
+  }
+}
+
+// Enumerate the connected supersets of a connected set
+template<typename Fn>
+void Planner::enumerateCsgRec(uint64_t bindings, uint64_t excluded,
+                              Fn &&emit) {
+  auto candidates = neighbors(bindings) & ~excluded;
+  if (!candidates)
+    return;
+  for (auto subset = candidates; subset; subset = (subset - 1) & candidates)
+    emit(bindings | subset);
+  for (auto subset = candidates; subset; subset = (subset - 1) & candidates)
+    enumerateCsgRec(bindings | subset, excluded | candidates, emit);
+}
+
+// Find the best plan with dynamic programming
+void Planner::planDP() {
+  // Enumerate all pairs of connected sets whose union is connected
+  // (csg-cmp pairs) and process them by size of the union, such that the
+  // plans of both sides are final
+  std::vector<std::pair<uint64_t, uint64_t>> pairs;
+  auto enumerateCmp = [&](uint64_t left) {
+    auto lowest = __builtin_ctzll(left);
+    auto excluded = bindingsUpTo(lowest) | left;
+    auto candidates = neighbors(left) & ~excluded;
+    for (int i = 63; i >= 0; --i) {
+      if (!(candidates >> i & 1))
+        continue;
+      pairs.emplace_back(left, 1ull << i);
+      enumerateCsgRec(1ull << i,
+                      excluded | (bindingsUpTo(i) & candidates),
+                      [&](uint64_t right) { pairs.emplace_back(left, right); });
+    }
+  };
+  for (int i = num_bindings_ - 1; i >= 0; --i) {
+    enumerateCmp(1ull << i);
+    enumerateCsgRec(1ull << i, bindingsUpTo(i), enumerateCmp);
+  }
+  std::stable_sort(pairs.begin(), pairs.end(), [](auto &a, auto &b) {
+    return count(a.first | a.second) < count(b.first | b.second);
+  });
+  for (auto &pair : pairs)
+    emitPair(pair.first, pair.second);
+}
+
+// Find a plan by greedily joining the pair with the smallest result
+void Planner::planGreedy() {
+  std::vector<uint64_t> components;
+  for (unsigned b = 0; b < num_bindings_; ++b)
+    components.push_back(1ull << b);
+  while (components.size() > 1) {
+    unsigned best_i = 0, best_j = 0;
+    double best_cardinality = -1;
+    for (unsigned i = 0; i < components.size(); ++i) {
+      auto adjacent = neighbors(components[i]);
+      for (unsigned j = i + 1; j < components.size(); ++j) {
+        if (!(adjacent & components[j]))
+          continue;
+        emitPair(components[i], components[j]);
+        auto cardinality =
+            plans_.at(components[i] | components[j]).cardinality;
+        if (best_cardinality < 0 || cardinality < best_cardinality) {
+          best_cardinality = cardinality;
+          best_i = i;
+          best_j = j;
+        }
+      }
+    }
+    if (best_cardinality < 0)
+      throw std::invalid_argument("the query contains a cross product");
+    components[best_i] |= components[best_j];
+    components.erase(components.begin() + best_j);
+  }
+}
+
+// Turn the plan of a set of bindings into a tree
+std::unique_ptr<PlanNode> Planner::buildTree(uint64_t bindings) const {
+  auto &entry = plans_.at(bindings);
+  auto node = std::make_unique<PlanNode>();
+  node->bindings = bindings;
+  node->cardinality = entry.cardinality;
+  node->cost = entry.cost;
+  if (!entry.left) {
+    node->binding = __builtin_ctzll(bindings);
+    for (auto &p_info : query_.predicates()) {
+      if (p_info.left.binding == node->binding
+          && p_info.right.binding == node->binding)
+        node->predicates.push_back(p_info);
+    }
+    return node;
+  }
+
+  node->left = buildTree(entry.left);
+  node->right = buildTree(entry.right);
+  for (auto p_info : join_predicates_) {
+    if (entry.right >> p_info.left.binding & 1)
+      std::swap(p_info.left, p_info.right);
+    if ((entry.left >> p_info.left.binding & 1)
+        && (entry.right >> p_info.right.binding & 1))
+      node->predicates.push_back(p_info);
+  }
+  assert(!node->predicates.empty());
+  return node;
+}
+
+// Find the join order and the build sides of the query
+std::unique_ptr<PlanNode> Planner::plan() {
+  plans_.clear();
+  for (unsigned b = 0; b < num_bindings_; ++b)
+    plans_[1ull << b] = Entry{estimateBase(b), 0, 0, 0};
+
+  if (num_bindings_ <= max_dp_bindings_)
+    planDP();
+  else
+    planGreedy();
+
+  auto all = bindingsUpTo(num_bindings_ - 1);
+  if (!plans_.count(all))
+    throw std::invalid_argument("the query contains a cross product");
+  return buildTree(all);
+}
+
+// The intermediate tuples of a plan beyond its result per base tuple
+double Planner::danglingRatio(const PlanNode &plan) {
+  double inputs = 0, dangling = 0;
+  std::function<void(const PlanNode &)> visit = [&](const PlanNode &node) {
+    if (node.isLeaf()) {
+      inputs += node.cardinality;
+      return;
+    }
+    if (&node != &plan)
+      dangling += std::max(0.0, node.cardinality - plan.cardinality);
+    visit(*node.left);
+    visit(*node.right);
+  };
+  visit(plan);
+  return inputs > 0 ? dangling / inputs : 0;
+}
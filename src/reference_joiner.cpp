@@ -0,0 +1,139 @@
+#include "reference_joiner.h"
+
+#include <algorithm>
+#include <sstream>
+#include <unordered_map>
+
+namespace {
+
+// Whether a value passes a filter
+bool passes(uint64_t value, const FilterInfo &filter) {
+  switch (filter.comparison) {
+    case FilterInfo::Comparison::Less:
+      return value < filter.constant;
+    case FilterInfo::Comparison::Greater:
+      return value > filter.constant;
+    case FilterInfo::Comparison::Equal:
+      return value == filter.constant;
+  }
+  return false;
+}
+
+}
+
+// The row ids of a binding that pass its filters
+std::vector<uint64_t> ReferenceJoiner::scan(const QueryInfo &query,
+                                            unsigned binding) const {
+  auto &relation = relations_[query.relation_ids()[binding]];
+  std::vector<uint64_t> row_ids;
+  for (uint64_t row = 0; row < relation.size(); ++row) {
+    bool pass = true;
+    for (auto &filter : query.filters()) {
+      if (filter.filter_column.binding == binding)
+        pass &= passes(relation.columns()[filter.filter_column.col_id][row],
+                       filter);
+    }
+    for (auto &predicate : query.predicates()) {
+      if (predicate.left.binding == binding
+          && predicate.right.binding == binding)
+        pass &= relation.columns()[predicate.left.col_id][row]
+            == relation.columns()[predicate.right.col_id][row];
+    }
+    if (pass)
+      row_ids.push_back(row);
+  }
+  return row_ids;
+}
+
+// Joins a query
+std::string ReferenceJoiner::join(const QueryInfo &query) const {
+  auto &relation_ids = query.relation_ids();
+  auto num_bindings = relation_ids.size();
+  auto column = [&](unsigned binding, unsigned col_id) {
+    return relations_[relation_ids[binding]].columns()[col_id];
+  };
+
+  // The intermediate result holds a row id per joined binding, position[b]
+  // is the offset of binding b in its tuples
+  std::vector<unsigned> position(num_bindings, num_bindings);
+  std::vector<uint64_t> tuples = scan(query, 0);
+  position[0] = 0;
+  unsigned width = 1;
+  for (unsigned joined = 1; joined < num_bindings; ++joined) {
+    // The next binding with a predicate to the joined ones (a cross product
+    // if there is none)
+    unsigned binding = num_bindings;
+    for (auto &predicate : query.predicates()) {
+      for (auto [a, b] : {std::make_pair(predicate.left, predicate.right),
+                          std::make_pair(predicate.right, predicate.left)}) {
+        if (position[a.binding] < num_bindings
+            && position[b.binding] == num_bindings)
+          binding = std::min(binding, b.binding);
+      }
+    }
+    for (unsigned b = 0; b < num_bindings && binding == num_bindings; ++b) {
+      if (position[b] == num_bindings)
+        binding = b;
+    }
+
+    // The predicates between the binding (second) and the joined ones
+    std::vector<std::pair<SelectInfo, SelectInfo>> predicates;
+    for (auto &predicate : query.predicates()) {
+      if (predicate.left.binding == binding
+          && position[predicate.right.binding] < num_bindings)
+        predicates.emplace_back(predicate.right, predicate.left);
+      if (predicate.right.binding == binding
+          && position[predicate.left.binding] < num_bindings)
+        predicates.emplace_back(predicate.left, predicate.right);
+    }
+
+    auto rows = scan(query, binding);
+    std::unordered_multimap<uint64_t, uint64_t> hash_table;
+    if (!predicates.empty()) {
+      auto keys = column(binding, predicates[0].second.col_id);
+      for (auto row : rows)
+        hash_table.emplace(keys[row], row);
+    }
+    std::vector<uint64_t> result;
+    auto append = [&](const uint64_t *tuple, uint64_t row) {
+      for (auto &[joined_column, binding_column] : predicates) {
+        auto row_id = tuple[position[joined_column.binding]];
+        if (column(joined_column.binding, joined_column.col_id)[row_id]
+            != column(binding, binding_column.col_id)[row])
+          return;
+      }
+      result.insert(result.end(), tuple, tuple + width);
+      result.push_back(row);
+    };
+    for (uint64_t t = 0; t < tuples.size(); t += width) {
+      auto tuple = &tuples[t];
+      if (predicates.empty()) {
+        for (auto row : rows)
+          append(tuple, row);
+        continue;
+      }
+      auto &key = predicates[0].first;
+      auto range = hash_table.equal_range(
+          column(key.binding, key.col_id)[tuple[position[key.binding]]]);
+      for (auto it = range.first; it != range.second; ++it)
+        append(tuple, it->second);
+    }
+    tuples = std::move(result);
+    position[binding] = width++;
+  }
+
+  std::stringstream out;
+  auto &selections = query.selections();
+  for (unsigned i = 0; i < selections.size(); ++i) {
+    auto &selection = selections[i];
+    uint64_t sum = 0;
+    auto values = column(selection.binding, selection.col_id);
+    for (uint64_t t = 0; t < tuples.size(); t += width)
+      sum += values[tuples[t + position[selection.binding]]];
+    out << (tuples.empty() ? "NULL" : std::to_string(sum));
+    if (i < selections.size() - 1)
+      out << " ";
+  }
+  out << "\n";
+  return out.str();
+}
@@ -1,10 +1,35 @@
 #include "relation.h"
 
+#include <algorithm>
 #include <fcntl.h>
 #include <iostream>
 #include <fstream>
+#include <stdexcept>
 #include <sys/mman.h>
 #include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+
+// The words of the header of a columnar file
+enum HeaderWord : unsigned {
+  Magic, Version, Size, NumColumns, Alignment, FooterOffset, FooterWords,
+  NumHeaderWords
+};
+
+// Pad a file with zeros up to a multiple of alignment
+void pad(std::ofstream &out, uint64_t alignment) {
+  auto offset = static_cast<uint64_t>(out.tellp());
+  static const char zeros[4096] = {};
+  for (auto padding = (alignment - offset % alignment) % alignment;
+       padding > 0;) {
+    auto chunk = std::min<uint64_t>(padding, sizeof(zeros));
+    out.write(zeros, chunk);
+    padding -= chunk;
+  }
+}
+
+}
 
 // Stores a relation into a binary file
 void Relation::storeRelation(const std::string &file_name) {
@@ -19,6 +44,139 @@ void Relation::storeRelation(const std::string &file_name) {
   out_file.close();
 }
 
+// Stores a relation into a columnar file. The footer holds for every
+// column: the offset of its segment, the number of zones and the zones, the
+// offset of its sorted index (0 if none), whether it is compressed and the
+// compressed column.
+void Relation::storeRelationV2(const std::string &file_name,
+                               uint64_t alignment) const {
+  if (alignment < kPageSize || alignment % kPageSize != 0)
+    throw std::invalid_argument("alignment has to be a multiple of 4K");
+  std::ofstream out(file_name, std::ios::out | std::ios::binary);
+  // The header page is written last
+  out.put(0);
+  pad(out, kPageSize);
+
+  std::vector<uint64_t> column_offsets, index_offsets;
+  for (auto column : columns_) {
+    pad(out, alignment);
+    column_offsets.push_back(out.tellp());
+    out.write(reinterpret_cast<const char *>(column), size_ * sizeof(uint64_t));
+  }
+  for (auto &index : sorted_indexes_) {
+    index_offsets.push_back(0);
+    if (!index)
+      continue;
+    pad(out, alignment);
+    index_offsets.back() = out.tellp();
+    out.write(reinterpret_cast<const char *>(index->row_ids()),
+              size_ * sizeof(uint64_t));
+  }
+
+  std::vector<uint64_t> footer;
+  for (unsigned c = 0; c < columns_.size(); ++c) {
+    auto &zone_map = zone_maps_[c];
+    footer.push_back(column_offsets[c]);
+    footer.push_back(zone_map.num_blocks());
+    for (uint64_t b = 0; b < zone_map.num_blocks(); ++b) {
+      footer.push_back(zone_map.zone(b).min);
+      footer.push_back(zone_map.zone(b).max);
+    }
+    footer.push_back(index_offsets[c]);
+    footer.push_back(compressed_columns_[c] != nullptr);
+    if (compressed_columns_[c])
+      compressed_columns_[c]->serialize(footer);
+  }
+  pad(out, kPageSize);
+  uint64_t header[NumHeaderWords];
+  header[Magic] = kFileMagic;
+  header[Version] = kFileVersion;
+  header[Size] = size_;
+  header[NumColumns] = columns_.size();
+  header[Alignment] = alignment;
+  header[FooterOffset] = out.tellp();
+  header[FooterWords] = footer.size();
+  out.write(reinterpret_cast<const char *>(footer.data()),
+            footer.size() * sizeof(uint64_t));
+  out.seekp(0);
+  out.write(reinterpret_cast<const char *>(header), sizeof(header));
+  if (!out)
+    throw std::runtime_error("cannot write " + file_name);
+}
+
+// Use the columns, zone maps and indexes of a mapped columnar file
+void Relation::loadColumnar(const char *addr,
+                            uint64_t length,
+                            const char *file_name) {
+  auto invalid = [&](const std::string &reason) {
+    return std::runtime_error(std::string("relation file ") + file_name
+                                  + " is invalid: " + reason);
+  };
+  if (length < kPageSize)
+    throw invalid("no header");
+  auto header = reinterpret_cast<const uint64_t *>(addr);
+  if (header[Version] != kFileVersion)
+    throw invalid("unknown version " + std::to_string(header[Version]));
+  size_ = header[Size];
+  auto num_columns = header[NumColumns];
+  auto footer_offset = header[FooterOffset];
+  auto footer_words = header[FooterWords];
+  if (footer_offset % sizeof(uint64_t) != 0 || footer_offset > length
+      || footer_words > (length - footer_offset) / sizeof(uint64_t))
+    throw invalid("footer out of bounds");
+  // The footer holds at least four words per column
+  if (num_columns > footer_words / 4)
+    throw invalid("footer too short for " + std::to_string(num_columns)
+                      + " columns");
+
+  // A segment of size_ words at offset has to be within the file
+  auto segment = [&](uint64_t offset) {
+    if (offset % sizeof(uint64_t) != 0 || offset > length
+        || size_ > (length - offset) / sizeof(uint64_t))
+      throw invalid("segment out of bounds");
+    return reinterpret_cast<const uint64_t *>(addr + offset);
+  };
+  auto words = reinterpret_cast<const uint64_t *>(addr + footer_offset);
+  auto end = words + footer_words;
+  auto next = [&]() {
+    if (words == end)
+      throw invalid("footer too short");
+    return *words++;
+  };
+
+  auto num_blocks = (size_ + ZoneMap::kBlockSize - 1) / ZoneMap::kBlockSize;
+  zone_maps_.resize(num_columns);
+  sorted_indexes_.resize(num_columns);
+  hash_indexes_.resize(num_columns);
+  compressed_columns_.resize(num_columns);
+  for (unsigned c = 0; c < num_columns; ++c) {
+    // The columns are read only, the relation never writes them
+    columns_.push_back(const_cast<uint64_t *>(segment(next())));
+    if (next() != num_blocks || uint64_t(end - words) < 2 * num_blocks)
+      throw invalid("zone map does not match the size");
+    zone_maps_[c].assign(reinterpret_cast<const ZoneMap::Zone *>(words),
+                         num_blocks);
+    words += 2 * num_blocks;
+    if (auto index_offset = next()) {
+      // Scans read the column at every row id of the index
+      auto row_ids = segment(index_offset);
+      for (uint64_t i = 0; i < size_; ++i) {
+        if (row_ids[i] >= size_)
+          throw invalid("sorted index out of bounds");
+      }
+      sorted_indexes_[c] = std::make_unique<SortedIndex>();
+      sorted_indexes_[c]->map(columns_[c], row_ids, size_);
+    }
+    if (next()) {
+      auto compressed = std::make_unique<CompressedColumn>();
+      words = compressed->deserialize(words, end);
+      if (!words || compressed->size() != size_)
+        throw invalid("compressed column");
+      compressed_columns_[c] = std::move(compressed);
+    }
+  }
+}
+
 // Stores a relation into a file (csv), e.g., for loading/testing it with a DBMS
 void Relation::storeRelationCSV(const std::string &file_name) {
   std::ofstream out_file;
@@ -47,52 +205,184 @@ void Relation::dumpSQL(const std::string &file_name, unsigned relation_id) {
            << ".tbl' delimiter '|';\n";
 }
 
-void Relation::loadRelation(const char *file_name) {
+// Loads data from a file
+void Relation::loadRelation(const char *file_name,
+                            const LoadOptions &options) {
   int fd = open(file_name, O_RDONLY);
-  if (fd == -1) {
-    std::cerr << "cannot open " << file_name << std::endl;
-    throw;
-  }
+  if (fd == -1)
+    throw std::runtime_error(std::string("cannot open ") + file_name);
 
   // Obtain file size_
   struct stat sb{};
-  if (fstat(fd, &sb) == -1)
-    std::cerr << "fstat\n";
+  if (fstat(fd, &sb) == -1) {
+    close(fd);
+    throw std::runtime_error(std::string("cannot stat ") + file_name);
+  }
+  auto length = static_cast<uint64_t>(sb.st_size);
+  if (length < 16) {
+    close(fd);
+    throw std::runtime_error(std::string("relation file ") + file_name
+                                 + " does not contain a valid header");
+  }
 
-  auto length = sb.st_size;
+  // The segments of a columnar file are aligned in memory as in the file,
+  // the mapping is placed in an aligned range of reserved address space
+  uint64_t header[NumHeaderWords] = {};
+  void *placement = nullptr;
+  uint64_t placement_length = 0;
+  int placement_flags = 0;
+  if (length >= kPageSize && pread(fd, header, sizeof(header), 0) > 0
+      && header[Magic] == kFileMagic && header[Alignment] > kPageSize
+      && header[Alignment] <= (1ull << 30)) {
+    auto alignment = header[Alignment];
+    auto reserved = mmap(nullptr, length + alignment, PROT_NONE,
+                         MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (reserved != MAP_FAILED) {
+      auto begin = reinterpret_cast<uintptr_t>(reserved);
+      auto aligned = (begin + alignment - 1) & ~(alignment - 1);
+      auto mapped_end = aligned + ((length + kPageSize - 1) & ~(kPageSize - 1));
+      if (aligned > begin)
+        munmap(reserved, aligned - begin);
+      if (begin + length + alignment > mapped_end)
+        munmap(reinterpret_cast<void *>(mapped_end),
+               begin + length + alignment - mapped_end);
+      placement = reinterpret_cast<void *>(aligned);
+      placement_length = mapped_end - aligned;
+      placement_flags = MAP_FIXED;
+    }
+  }
 
-  char *addr = static_cast<char *>(mmap(nullptr,
+  // MAP_POPULATE reads the whole file and maps all of its pages now
+  char *addr = static_cast<char *>(mmap(placement,
                                         length,
                                         PROT_READ,
-                                        MAP_PRIVATE,
+                                        MAP_PRIVATE | placement_flags
+                                            | (options.prefault ? MAP_POPULATE
+                                                                : 0),
                                         fd,
                                         0u));
+  close(fd);
   if (addr == MAP_FAILED) {
-    std::cerr << "cannot mmap " << file_name << " of length " << length
-              << std::endl;
-    throw;
+    // The reserved address space is only released by a successful mapping
+    if (placement)
+      munmap(placement, placement_length);
+    throw std::runtime_error(std::string("cannot mmap ") + file_name
+                                 + " of length " + std::to_string(length));
   }
+  mappings_.emplace_back(new Mapping{addr, length});
+  if (options.prefault)
+    madvise(addr, length, MADV_WILLNEED);
 
-  if (length < 16) {
-    std::cerr << "relation_ file " << file_name
-              << " does not contain a valid header"
-              << std::endl;
-    throw;
+  if (*reinterpret_cast<uint64_t *>(addr) == kFileMagic) {
+    loadColumnar(addr, length, file_name);
+    if (options.huge_pages && length >= options.huge_page_min_bytes)
+      copyToHugePages();
+    return;
   }
 
-  this->size_ = *reinterpret_cast<uint64_t *>(addr);
-  addr += sizeof(size_);
-  auto numColumns = *reinterpret_cast<size_t *>(addr);
-  addr += sizeof(size_t);
-  for (unsigned i = 0; i < numColumns; ++i) {
+  // The header has to describe the file exactly
+  auto size = *reinterpret_cast<uint64_t *>(addr);
+  auto num_columns = *reinterpret_cast<uint64_t *>(addr + sizeof(uint64_t));
+  auto data_length = length - 2 * sizeof(uint64_t);
+  if ((size != 0 && num_columns > data_length / sizeof(uint64_t) / size)
+      || (size == 0 && num_columns > kMaxColumns)
+      || size * num_columns * sizeof(uint64_t) != data_length) {
+    throw std::runtime_error(std::string("relation file ") + file_name
+                                 + " of length " + std::to_string(length)
+                                 + " does not match its header ("
+                                 + std::to_string(size) + " tuples, "
+                                 + std::to_string(num_columns) + " columns)");
+  }
+
+  this->size_ = size;
+  addr += 2 * sizeof(uint64_t);
+  for (uint64_t i = 0; i < num_columns; ++i) {
     this->columns_.push_back(reinterpret_cast<uint64_t *>(addr));
     addr += size_ * sizeof(uint64_t);
   }
+  buildZoneMaps();
+  if (options.huge_pages && length >= options.huge_page_min_bytes)
+    copyToHugePages();
+}
+
+// Copy the columns into anonymous memory backed by huge pages
+void Relation::copyToHugePages() {
+  constexpr uint64_t kHugePageSize = 1ull << 21;
+  auto data_length = size_ * columns_.size() * sizeof(uint64_t);
+  // One more huge page to align the columns to a huge page boundary
+  auto length = (data_length + 2 * kHugePageSize - 1) & ~(kHugePageSize - 1);
+  auto addr = mmap(nullptr, length, PROT_READ | PROT_WRITE,
+                   MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (addr == MAP_FAILED)
+    return;
+  mappings_.emplace_back(new Mapping{addr, length});
+  auto aligned = (reinterpret_cast<uintptr_t>(addr) + kHugePageSize - 1)
+      & ~(kHugePageSize - 1);
+#ifdef MADV_HUGEPAGE
+  madvise(reinterpret_cast<void *>(aligned), data_length, MADV_HUGEPAGE);
+#endif
+
+  auto out = reinterpret_cast<uint64_t *>(aligned);
+  bool mapped_indexes = false;
+  for (unsigned c = 0; c < columns_.size(); ++c) {
+    std::copy(columns_[c], columns_[c] + size_, out);
+    columns_[c] = out;
+    out += size_;
+    if (auto &index = sorted_indexes_[c]) {
+      index->map(columns_[c], index->row_ids(), size_);
+      mapped_indexes = true;
+    }
+  }
+  // The file is still needed for the indexes persisted in it
+  if (!mapped_indexes)
+    mappings_.erase(mappings_.begin(), mappings_.end() - 1);
+}
+
+// Unmaps the memory
+Relation::Mapping::~Mapping() {
+  munmap(addr, length);
+}
+
+// Build the zone maps of all columns
+void Relation::buildZoneMaps() {
+  zone_maps_.resize(columns_.size());
+  for (unsigned i = 0; i < columns_.size(); ++i)
+    zone_maps_[i].build(columns_[i], size_);
+  sorted_indexes_.resize(columns_.size());
+  hash_indexes_.resize(columns_.size());
+  compressed_columns_.resize(columns_.size());
+}
+
+// Build the sorted index of a column
+void Relation::buildSortedIndex(unsigned col_id) {
+  auto index = std::make_unique<SortedIndex>();
+  index->build(columns_[col_id], size_);
+  sorted_indexes_[col_id] = std::move(index);
+}
+
+// Build the hash index of a column
+void Relation::buildHashIndex(unsigned col_id, uint64_t expected_keys) {
+  auto index = std::make_unique<HashTable>();
+  index->build(columns_[col_id], nullptr, size_, expected_keys);
+  hash_indexes_[col_id] = std::move(index);
+}
+
+// Compress a column
+bool Relation::compressColumn(unsigned col_id,
+                              uint64_t min,
+                              uint64_t max,
+                              double distinct) {
+  auto column = std::make_unique<CompressedColumn>();
+  if (!column->compress(columns_[col_id], size_, min, max, distinct))
+    return false;
+  compressed_columns_[col_id] = std::move(column);
+  return true;
 }
 
 // Constructor that loads relation_ from disk
-Relation::Relation(const char *file_name) : owns_memory_(false), size_(0) {
-  loadRelation(file_name);
+Relation::Relation(const char *file_name, const LoadOptions &options)
+    : owns_memory_(false), size_(0) {
+  loadRelation(file_name, options);
 }
 
 // Destructor
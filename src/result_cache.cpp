@@ -0,0 +1,204 @@
+#include "result_cache.h"
+
+#include <algorithm>
+#include <numeric>
+#include <sstream>
+#include <tuple>
+#include <vector>
+
+namespace {
+
+// A column of a renumbered binding
+using Column = std::pair<unsigned, unsigned>;
+
+// Replace every signature by its rank among the distinct signatures
+std::vector<uint64_t> ranks(const std::vector<std::vector<uint64_t>> &sigs) {
+  auto distinct = sigs;
+  std::sort(distinct.begin(), distinct.end());
+  distinct.erase(std::unique(distinct.begin(), distinct.end()),
+                 distinct.end());
+  std::vector<uint64_t> ranks;
+  for (auto &sig : sigs) {
+    ranks.push_back(std::lower_bound(distinct.begin(), distinct.end(), sig)
+                        - distinct.begin());
+  }
+  return ranks;
+}
+
+}
+
+// Find the result of a query
+bool ResultCache::find(const std::string &key, std::string &result) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto it = index_.find(key);
+  if (it == index_.end()) {
+    ++counters_.misses;
+    return false;
+  }
+  ++counters_.hits;
+  entries_.splice(entries_.end(), entries_, it->second);
+  result = it->second->result;
+  return true;
+}
+
+// Add the result of a query and evict the least recently used ones
+void ResultCache::insert(const std::string &key, const std::string &result) {
+  auto bytes = memory(key, result);
+  if (bytes > limit_)
+    return;
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (index_.count(key))
+    return;
+  entries_.push_back(Entry{key, result});
+  index_.emplace(key, std::prev(entries_.end()));
+  memory_ += bytes;
+  ++counters_.insertions;
+  while (memory_ > limit_) {
+    auto &victim = entries_.front();
+    memory_ -= memory(victim.key, victim.result);
+    index_.erase(victim.key);
+    entries_.pop_front();
+    ++counters_.evictions;
+  }
+}
+
+// Remove all entries
+void ResultCache::clear() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  index_.clear();
+  entries_.clear();
+  memory_ = 0;
+}
+
+// The lookups
+ResultCache::Counters ResultCache::counters() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return counters_;
+}
+
+// The memory used by the entries
+uint64_t ResultCache::memory() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return memory_;
+}
+
+// The canonical form of a query. Every binding gets a label from its
+// relation, its filters and the projections on it; the labels are refined
+// with the labels of the join neighbours until they stop splitting (like
+// colour refinement), and the bindings are renumbered in label order. Ties
+// are broken by the original order, thus the key of a permuted query with
+// indistinguishable bindings may differ, but equal keys always denote the
+// same query.
+std::string ResultCache::key(const QueryInfo &query) {
+  auto n = query.relation_ids().size();
+  std::vector<std::vector<uint64_t>> sigs(n);
+  for (unsigned b = 0; b < n; ++b)
+    sigs[b].push_back(query.relation_ids()[b]);
+  std::vector<std::tuple<unsigned, unsigned, uint64_t>> filters;
+  for (auto &f : query.filters()) {
+    filters.emplace_back(f.filter_column.col_id, f.comparison, f.constant);
+  }
+  for (unsigned b = 0; b < n; ++b) {
+    std::vector<std::tuple<unsigned, unsigned, uint64_t>> own;
+    for (unsigned i = 0; i < filters.size(); ++i) {
+      if (query.filters()[i].filter_column.binding == b)
+        own.push_back(filters[i]);
+    }
+    std::sort(own.begin(), own.end());
+    own.erase(std::unique(own.begin(), own.end()), own.end());
+    for (auto &f : own) {
+      sigs[b].insert(sigs[b].end(),
+                     {std::get<0>(f), std::get<1>(f), std::get<2>(f)});
+    }
+  }
+  // The projections are ordered, thus they tell bindings apart
+  for (unsigned i = 0; i < query.selections().size(); ++i) {
+    auto &s = query.selections()[i];
+    sigs[s.binding].insert(sigs[s.binding].end(), {~0ull, i, s.col_id});
+  }
+  auto labels = ranks(sigs);
+
+  auto distinct = [](const std::vector<uint64_t> &labels) {
+    auto sorted = labels;
+    std::sort(sorted.begin(), sorted.end());
+    return std::unique(sorted.begin(), sorted.end()) - sorted.begin();
+  };
+  for (unsigned round = 0; round < n; ++round) {
+    std::vector<std::vector<std::tuple<uint64_t, uint64_t, uint64_t>>>
+        neighbours(n);
+    for (auto &p : query.predicates()) {
+      neighbours[p.left.binding].emplace_back(p.left.col_id,
+                                              labels[p.right.binding],
+                                              p.right.col_id);
+      neighbours[p.right.binding].emplace_back(p.right.col_id,
+                                               labels[p.left.binding],
+                                               p.left.col_id);
+    }
+    for (unsigned b = 0; b < n; ++b) {
+      auto &edges = neighbours[b];
+      std::sort(edges.begin(), edges.end());
+      edges.erase(std::unique(edges.begin(), edges.end()), edges.end());
+      sigs[b] = {labels[b]};
+      for (auto &e : edges) {
+        sigs[b].insert(sigs[b].end(),
+                       {std::get<0>(e), std::get<1>(e), std::get<2>(e)});
+      }
+    }
+    auto refined = ranks(sigs);
+    bool split = distinct(refined) > distinct(labels);
+    labels = std::move(refined);
+    if (!split)
+      break;
+  }
+
+  std::vector<unsigned> order(n), renumbered(n);
+  std::iota(order.begin(), order.end(), 0);
+  std::stable_sort(order.begin(), order.end(), [&](unsigned a, unsigned b) {
+    return labels[a] < labels[b];
+  });
+  for (unsigned i = 0; i < n; ++i)
+    renumbered[order[i]] = i;
+
+  std::vector<std::pair<Column, Column>> predicates;
+  for (auto &p : query.predicates()) {
+    Column left{renumbered[p.left.binding], p.left.col_id};
+    Column right{renumbered[p.right.binding], p.right.col_id};
+    predicates.emplace_back(std::min(left, right), std::max(left, right));
+  }
+  std::sort(predicates.begin(), predicates.end());
+  predicates.erase(std::unique(predicates.begin(), predicates.end()),
+                   predicates.end());
+  std::vector<std::tuple<Column, unsigned, uint64_t>> renumbered_filters;
+  for (auto &f : query.filters()) {
+    renumbered_filters.emplace_back(
+        Column{renumbered[f.filter_column.binding], f.filter_column.col_id},
+        f.comparison, f.constant);
+  }
+  std::sort(renumbered_filters.begin(), renumbered_filters.end());
+  renumbered_filters.erase(std::unique(renumbered_filters.begin(),
+                                       renumbered_filters.end()),
+                           renumbered_filters.end());
+
+  std::stringstream key;
+  for (unsigned i = 0; i < n; ++i)
+    key << (i ? " " : "") << query.relation_ids()[order[i]];
+  key << "|";
+  bool first = true;
+  for (auto &p : predicates) {
+    key << (first ? "" : "&") << p.first.first << "." << p.first.second << "="
+        << p.second.first << "." << p.second.second;
+    first = false;
+  }
+  for (auto &f : renumbered_filters) {
+    key << (first ? "" : "&") << std::get<0>(f).first << "."
+        << std::get<0>(f).second << static_cast<char>(std::get<1>(f))
+        << std::get<2>(f);
+    first = false;
+  }
+  key << "|";
+  for (unsigned i = 0; i < query.selections().size(); ++i) {
+    auto &s = query.selections()[i];
+    key << (i ? " " : "") << renumbered[s.binding] << "." << s.col_id;
+  }
+  return key.str();
+}
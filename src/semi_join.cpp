@@ -0,0 +1,241 @@
+#include "semi_join.h"
+
+#include <algorithm>
+#include <functional>
+#include <map>
+#include <numeric>
+
+#include "hash_table.h"
+#include "joiner.h"
+#include "operators.h"
+#include "thread_pool.h"
+
+namespace {
+
+// One bit per tuple of a relation
+using Bitmap = std::vector<uint64_t>;
+
+// Call fn(row_id) for the tuples in [begin, end) whose bits are set (begin
+// has to be a multiple of 64)
+template<typename Fn>
+void forEachSet(const Bitmap &bitmap, uint64_t begin, uint64_t end, Fn &&fn) {
+  for (auto w = begin / 64; w * 64 < end; ++w) {
+    for (auto word = bitmap[w]; word; word &= word - 1)
+      fn(w * 64 + __builtin_ctzll(word));
+  }
+}
+
+// The number of tuples whose bits are set
+uint64_t count(const Bitmap &bitmap) {
+  uint64_t count = 0;
+  for (auto word : bitmap)
+    count += __builtin_popcountll(word);
+  return count;
+}
+
+// The tuples of a binding in a bitmap: those that pass the binding's filters
+// and the predicates among its columns
+Bitmap select(const Relation &relation,
+              const std::vector<FilterInfo> &filters,
+              const std::vector<PredicateInfo> &predicates) {
+  auto size = relation.size();
+  Bitmap bitmap((size + 63) / 64, filters.empty() ? ~0ull : 0);
+  if (filters.empty()) {
+    if (size % 64)
+      bitmap.back() = (1ull << (size % 64)) - 1;
+  } else {
+    FilterScan scan(relation, filters);
+    scan.run();
+    auto &row_ids = scan.rowIds(filters[0].filter_column.binding);
+    ThreadPool::global().parallelFor(scan.result_size(),
+                                     [&](uint64_t begin, uint64_t end) {
+      for (auto i = begin; i != end; ++i) {
+        auto row_id = row_ids.rowId(i);
+        __atomic_fetch_or(&bitmap[row_id / 64], 1ull << (row_id % 64),
+                          __ATOMIC_RELAXED);
+      }
+    });
+  }
+  if (predicates.empty())
+    return bitmap;
+  ThreadPool::global().parallelFor(size, [&](uint64_t begin, uint64_t end) {
+    forEachSet(bitmap, begin, end, [&](uint64_t row_id) {
+      for (auto &p : predicates) {
+        if (relation.columns()[p.left.col_id][row_id]
+            != relation.columns()[p.right.col_id][row_id]) {
+          bitmap[row_id / 64] &= ~(1ull << (row_id % 64));
+          break;
+        }
+      }
+    });
+  });
+  return bitmap;
+}
+
+// Clear the tuples of reduced whose value of a column has no partner among
+// the tuples of the other binding: reduced ⋉ other
+void semiJoin(Bitmap &reduced,
+              const Relation &reduced_relation,
+              unsigned reduced_col_id,
+              const Bitmap &other,
+              const Relation &other_relation,
+              unsigned other_col_id) {
+  auto &pool = ThreadPool::global();
+  auto other_column = other_relation.columns()[other_col_id];
+  MorselIds morsel_keys(ThreadPool::numMorsels(other_relation.size()));
+  pool.parallelFor(other_relation.size(), [&](uint64_t begin, uint64_t end) {
+    auto &keys = morsel_keys[begin / ThreadPool::kMorselSize];
+    forEachSet(other, begin, end, [&](uint64_t row_id) {
+      keys.push_back(other_column[row_id]);
+    });
+  });
+  std::vector<uint64_t> keys;
+  for (auto &morsel : morsel_keys)
+    keys.insert(keys.end(), morsel.begin(), morsel.end());
+  PartitionedHashTable table;
+  table.build(keys.data(), keys.size());
+
+  auto column = reduced_relation.columns()[reduced_col_id];
+  pool.parallelFor(reduced_relation.size(),
+                   [&](uint64_t begin, uint64_t end) {
+    forEachSet(reduced, begin, end, [&](uint64_t row_id) {
+      if (table.find(column[row_id]).empty())
+        reduced[row_id / 64] &= ~(1ull << (row_id % 64));
+    });
+  });
+}
+
+// The row ids of the tuples in a bitmap in ascending order
+std::vector<uint64_t> rowIds(const Bitmap &bitmap, uint64_t size) {
+  MorselIds morsel_ids(ThreadPool::numMorsels(size));
+  ThreadPool::global().parallelFor(size, [&](uint64_t begin, uint64_t end) {
+    auto &ids = morsel_ids[begin / ThreadPool::kMorselSize];
+    forEachSet(bitmap, begin, end, [&](uint64_t row_id) {
+      ids.push_back(row_id);
+    });
+  });
+  std::vector<uint64_t> row_ids;
+  for (auto &ids : morsel_ids)
+    row_ids.insert(row_ids.end(), ids.begin(), ids.end());
+  return row_ids;
+}
+
+// The predicates between two different bindings, grouped by the pair of
+// bindings (the smaller binding first)
+std::map<std::pair<unsigned, unsigned>, std::vector<PredicateInfo>>
+joinEdges(const QueryInfo &query) {
+  std::map<std::pair<unsigned, unsigned>, std::vector<PredicateInfo>> edges;
+  for (auto &p : query.predicates()) {
+    if (p.left.binding == p.right.binding)
+      continue;
+    if (p.left.binding < p.right.binding)
+      edges[{p.left.binding, p.right.binding}].push_back(p);
+    else
+      edges[{p.right.binding, p.left.binding}].emplace_back(p.right, p.left);
+  }
+  return edges;
+}
+
+}
+
+// Whether the join graph of a query is a forest
+bool SemiJoinReducer::isAcyclic(const QueryInfo &query) {
+  std::vector<unsigned> parent(query.relation_ids().size());
+  std::iota(parent.begin(), parent.end(), 0);
+  std::function<unsigned(unsigned)> find = [&](unsigned b) {
+    return parent[b] == b ? b : parent[b] = find(parent[b]);
+  };
+  for (auto &edge : joinEdges(query)) {
+    auto a = find(edge.first.first), b = find(edge.first.second);
+    if (a == b)
+      return false;
+    parent[a] = b;
+  }
+  return true;
+}
+
+// Whether reducing the query pays off
+bool SemiJoinReducer::pays(const PlanNode &plan, const QueryInfo &query) {
+  if (query.relation_ids().size() < kMinBindings || !isAcyclic(query))
+    return false;
+  // After the reduction every intermediate tuple extends to a result tuple,
+  // so an intermediate result shrinks to at most the query's result
+  return Planner::danglingRatio(plan) > kMinDangling;
+}
+
+// Reduce the bindings of an acyclic query
+SemiJoinReduction SemiJoinReducer::reduce(QueryInfo &query) const {
+  auto n = query.relation_ids().size();
+  auto relation = [&](unsigned binding) -> const Relation & {
+    return joiner_.getRelation(query.relation_ids()[binding]);
+  };
+  std::vector<std::vector<PredicateInfo>> self_predicates(n);
+  for (auto &p : query.predicates()) {
+    if (p.left.binding == p.right.binding)
+      self_predicates[p.left.binding].push_back(p);
+  }
+  SemiJoinReduction reduction;
+  std::vector<Bitmap> bitmaps(n);
+  for (unsigned b = 0; b < n; ++b) {
+    bitmaps[b] = select(relation(b), joiner_.filters(b, query),
+                        self_predicates[b]);
+    reduction.filtered_tuples += count(bitmaps[b]);
+  }
+
+  // Root every tree of the join graph at its smallest binding and order the
+  // bindings breadth-first
+  auto edges = joinEdges(query);
+  std::vector<std::vector<unsigned>> neighbors(n);
+  for (auto &edge : edges) {
+    neighbors[edge.first.first].push_back(edge.first.second);
+    neighbors[edge.first.second].push_back(edge.first.first);
+  }
+  std::vector<unsigned> order, parent(n, n);
+  std::vector<bool> visited(n, false);
+  for (unsigned root = 0; root < n; ++root) {
+    if (visited[root])
+      continue;
+    visited[root] = true;
+    order.push_back(root);
+    for (auto i = order.size() - 1; i < order.size(); ++i) {
+      for (auto neighbor : neighbors[order[i]]) {
+        if (!visited[neighbor]) {
+          visited[neighbor] = true;
+          parent[neighbor] = order[i];
+          order.push_back(neighbor);
+        }
+      }
+    }
+  }
+
+  // reduced ⋉ other on all predicates between them
+  auto reduce = [&](unsigned reduced, unsigned other) {
+    auto &predicates = edges[{std::min(reduced, other),
+                              std::max(reduced, other)}];
+    for (auto &p : predicates) {
+      bool left = p.left.binding == reduced;
+      auto &reduced_column = left ? p.left : p.right;
+      auto &other_column = left ? p.right : p.left;
+      semiJoin(bitmaps[reduced], relation(reduced), reduced_column.col_id,
+               bitmaps[other], relation(other), other_column.col_id);
+    }
+  };
+  // Bottom-up: every parent keeps the tuples with partners in its children
+  for (auto it = order.rbegin(); it != order.rend(); ++it) {
+    if (parent[*it] != n)
+      reduce(parent[*it], *it);
+  }
+  // Top-down: every child keeps the tuples with partners in its parent
+  for (auto b : order) {
+    if (parent[b] != n)
+      reduce(b, parent[b]);
+  }
+
+  for (unsigned b = 0; b < n; ++b) {
+    auto row_ids = std::make_shared<std::vector<uint64_t>>(
+        rowIds(bitmaps[b], relation(b).size()));
+    reduction.reduced_tuples += row_ids->size();
+    reduction.row_ids.push_back(std::move(row_ids));
+  }
+  return reduction;
+}
@@ -0,0 +1,40 @@
+#include "sorted_index.h"
+
+#include <algorithm>
+#include <numeric>
+
+// Build the index of a column
+void SortedIndex::build(const uint64_t *column, uint64_t size) {
+  built_row_ids_.resize(size);
+  std::iota(built_row_ids_.begin(), built_row_ids_.end(), 0);
+  std::sort(built_row_ids_.begin(), built_row_ids_.end(),
+            [&](uint64_t a, uint64_t b) {
+    return column[a] < column[b] || (column[a] == column[b] && a < b);
+  });
+  map(column, built_row_ids_.data(), size);
+}
+
+// Use row ids that were built before as the index of a column
+void SortedIndex::map(const uint64_t *column,
+                      const uint64_t *row_ids,
+                      uint64_t size) {
+  column_ = column;
+  row_ids_ = row_ids;
+  size_ = size;
+}
+
+// The positions of the row ids with a value in [low, high]
+std::pair<uint64_t, uint64_t> SortedIndex::range(uint64_t low,
+                                                 uint64_t high) const {
+  if (low > high)
+    return {0, 0};
+  auto begin = std::lower_bound(row_ids_, row_ids_ + size_, low,
+                                [&](uint64_t row_id, uint64_t value) {
+                                  return column_[row_id] < value;
+                                });
+  auto end = std::upper_bound(begin, row_ids_ + size_, high,
+                              [&](uint64_t value, uint64_t row_id) {
+                                return value < column_[row_id];
+                              });
+  return {begin - row_ids_, end - row_ids_};
+}
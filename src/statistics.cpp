@@ -0,0 +1,181 @@
+#include "statistics.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "hash_table.h"
+#include "thread_pool.h"
+
+namespace {
+
+// Hash a value such that all bits are mixed (murmur3 finalizer)
+inline uint64_t mixHash(uint64_t value) {
+  value = partitionHash(value) * 0xC4CEB9FE1A85EC53ull;
+  return value ^ (value >> 33);
+}
+
+}
+
+// Add a value
+void HyperLogLog::add(uint64_t value) {
+  auto hash = mixHash(value);
+  auto index = hash >> (64 - kPrecision);
+  auto rest = hash << kPrecision;
+  uint8_t rank = rest ? __builtin_clzll(rest) + 1 : 64 - kPrecision + 1;
+  registers_[index] = std::max(registers_[index], rank);
+}
+
+// Add all values of another sketch
+void HyperLogLog::merge(const HyperLogLog &other) {
+  for (unsigned i = 0; i < registers_.size(); ++i)
+    registers_[i] = std::max(registers_[i], other.registers_[i]);
+}
+
+// The estimated number of distinct values
+double HyperLogLog::estimate() const {
+  double m = registers_.size();
+  double sum = 0;
+  unsigned zeros = 0;
+  for (auto rank : registers_) {
+    sum += std::ldexp(1.0, -rank);
+    zeros += rank == 0;
+  }
+  auto estimate = 0.7213 / (1 + 1.079 / m) * m * m / sum;
+  // Linear counting is more accurate for few values
+  if (estimate <= 2.5 * m && zeros > 0)
+    estimate = m * std::log(m / zeros);
+  return estimate;
+}
+
+// Compute the statistics of a column
+ColumnStatistics ColumnStatistics::compute(const uint64_t *column,
+                                           uint64_t size) {
+  ColumnStatistics stats;
+  stats.size = size;
+  if (size == 0)
+    return stats;
+
+  HyperLogLog sketch;
+  stats.min = stats.max = column[0];
+  for (uint64_t i = 0; i < size; ++i) {
+    stats.min = std::min(stats.min, column[i]);
+    stats.max = std::max(stats.max, column[i]);
+    sketch.add(column[i]);
+  }
+  stats.distinct = std::min<double>(sketch.estimate(), size);
+
+  // Only columns the sketch considers (almost) unique are checked exactly
+  if (stats.distinct >= 0.9 * size) {
+    std::vector<uint64_t> sorted(column, column + size);
+    std::sort(sorted.begin(), sorted.end());
+    stats.unique =
+        std::adjacent_find(sorted.begin(), sorted.end()) == sorted.end();
+    if (stats.unique)
+      stats.distinct = size;
+  }
+
+  // The histogram and the most common values are derived from an evenly
+  // spaced sample
+  auto step = std::max<uint64_t>(1, size / kSampleSize);
+  std::vector<uint64_t> sample;
+  for (uint64_t i = 0; i < size; i += step)
+    sample.push_back(column[i]);
+  std::sort(sample.begin(), sample.end());
+
+  auto buckets = std::min<uint64_t>(kHistogramBuckets, sample.size());
+  for (uint64_t b = 0; b < buckets; ++b)
+    stats.bounds.push_back(sample[(b + 1) * sample.size() / buckets - 1]);
+
+  if (!stats.unique) {
+    // Values that occur more than twice as often as the average one
+    auto threshold = std::max(2.0, 2 * sample.size() / stats.distinct);
+    std::vector<std::pair<uint64_t, uint64_t>> candidates;
+    for (uint64_t i = 0, j; i < sample.size(); i = j) {
+      for (j = i + 1; j < sample.size() && sample[j] == sample[i]; ++j);
+      if (j - i >= threshold)
+        candidates.emplace_back(j - i, sample[i]);
+    }
+    auto count = std::min<uint64_t>(kMostCommonValues, candidates.size());
+    std::partial_sort(candidates.begin(), candidates.begin() + count,
+                      candidates.end(), std::greater<>());
+    for (uint64_t c = 0; c < count; ++c) {
+      stats.most_common.emplace_back(
+          candidates[c].second, candidates[c].first * size / sample.size());
+    }
+  }
+  return stats;
+}
+
+// The estimated fraction of tuples with a value less than constant
+double ColumnStatistics::lessFraction(uint64_t constant) const {
+  if (size == 0 || constant <= min)
+    return 0;
+  if (constant > max)
+    return 1;
+  auto bucket = std::lower_bound(bounds.begin(), bounds.end(), constant)
+      - bounds.begin();
+  if (bucket == int64_t(bounds.size()))
+    return 1;
+  // Interpolate linearly within the bucket
+  auto low = bucket == 0 ? min : bounds[bucket - 1];
+  auto high = bounds[bucket];
+  double within = constant > low
+                  ? double(constant - low) / (double(high - low) + 1) : 0;
+  return (bucket + std::min(1.0, within)) / bounds.size();
+}
+
+// The estimated fraction of tuples that pass a filter
+double ColumnStatistics::selectivity(FilterInfo::Comparison comparison,
+                                     uint64_t constant) const {
+  if (size == 0)
+    return 0;
+  switch (comparison) {
+    case FilterInfo::Comparison::Less:return lessFraction(constant);
+    case FilterInfo::Comparison::Greater:
+      return constant == UINT64_MAX ? 0 : 1 - lessFraction(constant + 1);
+    case FilterInfo::Comparison::Equal: {
+      if (constant < min || constant > max)
+        return 0;
+      uint64_t common = 0;
+      for (auto &value : most_common) {
+        if (value.first == constant)
+          return double(value.second) / size;
+        common += value.second;
+      }
+      // The remaining tuples are spread evenly over the remaining values
+      auto others = std::max(1.0, distinct - most_common.size());
+      return std::max(0.0, double(size) - common) / size / others;
+    }
+  }
+  return 1;
+}
+
+// Whether every tuple passes a filter
+bool ColumnStatistics::alwaysPasses(FilterInfo::Comparison comparison,
+                                    uint64_t constant) const {
+  switch (comparison) {
+    case FilterInfo::Comparison::Less:return max < constant;
+    case FilterInfo::Comparison::Greater:return min > constant;
+    case FilterInfo::Comparison::Equal:
+      return min == constant && max == constant;
+  }
+  return false;
+}
+
+// Compute the statistics of all relations
+void StatisticsCatalog::build(const std::vector<Relation> &relations) {
+  std::vector<std::pair<unsigned, unsigned>> columns;
+  relations_.assign(relations.size(), {});
+  for (unsigned r = 0; r < relations.size(); ++r) {
+    relations_[r].resize(relations[r].columns().size());
+    for (unsigned c = 0; c < relations[r].columns().size(); ++c)
+      columns.emplace_back(r, c);
+  }
+  ThreadPool::global().parallelFor(columns.size(), 1,
+                                   [&](uint64_t i, uint64_t) {
+    auto &relation = relations[columns[i].first];
+    relations_[columns[i].first][columns[i].second] =
+        ColumnStatistics::compute(relation.columns()[columns[i].second],
+                                  relation.size());
+  });
+}
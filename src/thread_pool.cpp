@@ -0,0 +1,238 @@
+#include "thread_pool.h"
+
+#include <algorithm>
+#include <memory>
+#include <pthread.h>
+
+namespace {
+
+/// The pool whose worker the calling thread is (nullptr outside of a pool)
+thread_local const ThreadPool *worker_pool = nullptr;
+/// The deque of the calling worker
+thread_local unsigned worker_deque = 0;
+/// The nesting depth of the job that the calling thread runs a task of
+thread_local unsigned job_depth = 0;
+
+/// The pool used by the operators
+std::unique_ptr<ThreadPool> global_pool;
+
+// Bind the calling thread to a core
+void pinToCore(unsigned core) {
+  cpu_set_t cpus;
+  CPU_ZERO(&cpus);
+  CPU_SET(core % std::max(1u, std::thread::hardware_concurrency()), &cpus);
+  pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus);
+}
+
+}
+
+// Constructor
+ThreadPool::ThreadPool(unsigned num_threads, bool pin) {
+  for (unsigned i = 0; i < std::max(1u, num_threads); ++i)
+    deques_.push_back(std::make_unique<Deque>());
+  for (unsigned i = 1; i < num_threads; ++i) {
+    workers_.emplace_back([this, i, pin] {
+      if (pin)
+        pinToCore(i);
+      work(i);
+    });
+  }
+}
+
+// Destructor
+ThreadPool::~ThreadPool() {
+  {
+    std::lock_guard<std::mutex> lock(sleep_mutex_);
+    stop_ = true;
+  }
+  sleep_cv_.notify_all();
+  for (auto &worker : workers_)
+    worker.join();
+}
+
+// The deque of the calling thread
+unsigned ThreadPool::self() const {
+  return worker_pool == this ? worker_deque : 0;
+}
+
+// The number of queued tasks of jobs nested at least min_depth deep
+uint64_t ThreadPool::queued(unsigned min_depth) const {
+  uint64_t queued = 0;
+  for (auto depth = min_depth; depth < kMaxDepth; ++depth)
+    queued += queued_[depth];
+  return queued;
+}
+
+// Queue a task on a deque
+void ThreadPool::push(unsigned deque, const Task &task) {
+  auto &d = *deques_[deque];
+  {
+    std::lock_guard<std::mutex> lock(d.mutex);
+    d.tasks.push_back(task);
+  }
+  d.morsels += task.end - task.begin;
+  ++queued_[task.job->depth];
+  // Threads check queued_ after announcing that they sleep, thus either
+  // they see the task or we see them. Every worker may take the task, but
+  // only some of the waiting threads.
+  if (sleeping_ > 0) {
+    std::lock_guard<std::mutex> lock(sleep_mutex_);
+    if (sleeping_ > waiting_)
+      sleep_cv_.notify_one();
+    if (waiting_ > 0)
+      wait_cv_.notify_all();
+  }
+}
+
+// Take the newest task of the own deque
+bool ThreadPool::pop(unsigned deque, unsigned min_depth, Task &task) {
+  auto &d = *deques_[deque];
+  if (d.morsels == 0)
+    return false;
+  std::lock_guard<std::mutex> lock(d.mutex);
+  if (d.tasks.empty() || d.tasks.back().job->depth < min_depth)
+    return false;
+  task = d.tasks.back();
+  d.tasks.pop_back();
+  d.morsels -= task.end - task.begin;
+  --queued_[task.job->depth];
+  return true;
+}
+
+// Take the oldest task from the deque with the most queued morsels
+bool ThreadPool::steal(unsigned thief, unsigned min_depth, Task &task) {
+  unsigned num_deques = deques_.size(), victim = thief;
+  uint64_t most = 0;
+  for (unsigned d = 0; d < num_deques; ++d) {
+    auto morsels = deques_[d]->morsels.load(std::memory_order_relaxed);
+    if (d != thief && morsels > most) {
+      most = morsels;
+      victim = d;
+    }
+  }
+  if (most == 0)
+    return false;
+
+  // Try the others if the tasks of the victim are not nested deep enough
+  for (unsigned i = 0; i < num_deques; ++i) {
+    auto &d = *deques_[(victim + i) % num_deques];
+    if (&d == deques_[thief].get() || d.morsels == 0)
+      continue;
+    std::lock_guard<std::mutex> lock(d.mutex);
+    auto it = std::find_if(d.tasks.begin(), d.tasks.end(), [&](auto &t) {
+      return t.job->depth >= min_depth;
+    });
+    if (it == d.tasks.end())
+      continue;
+    task = *it;
+    d.tasks.erase(it);
+    d.morsels -= task.end - task.begin;
+    --queued_[task.job->depth];
+    ++steals_;
+    return true;
+  }
+  return false;
+}
+
+// Split a task until one morsel is left and process it
+void ThreadPool::execute(unsigned deque, Task task) {
+  auto job = task.job;
+  // The upper halves can be stolen, the owner pops them in order
+  while (task.end - task.begin > 1) {
+    auto middle = task.begin + (task.end - task.begin) / 2;
+    push(deque, {job, middle, task.end});
+    task.end = middle;
+  }
+  auto depth = job_depth;
+  job_depth = job->depth + 1;
+  auto begin = task.begin * job->morsel_size;
+  (*job->fn)(begin, std::min(begin + job->morsel_size, job->size));
+  job_depth = depth;
+  // The job may end (and be destroyed by its caller) right after this, its
+  // caller might sleep
+  if (job->pending.fetch_sub(1) == 1 && waiting_ > 0) {
+    std::lock_guard<std::mutex> lock(sleep_mutex_);
+    wait_cv_.notify_all();
+  }
+}
+
+// Process tasks until the job is done
+void ThreadPool::wait(unsigned deque, const Job &job) {
+  // Only tasks of jobs at least as deep as ours: a thread that waits within
+  // a query must not start another query, which might wait for this one
+  unsigned spins = 0;
+  while (job.pending != 0) {
+    Task task;
+    if (pop(deque, job.depth, task) || steal(deque, job.depth, task)) {
+      execute(deque, task);
+      spins = 0;
+    } else if (spins < kWaitSpins) {
+      ++spins;
+      std::this_thread::yield();
+    } else {
+      // Sleep until there are tasks we may take or the last morsel is
+      // processed
+      std::unique_lock<std::mutex> lock(sleep_mutex_);
+      ++sleeping_;
+      ++waiting_;
+      wait_cv_.wait(lock, [&] {
+        return queued(job.depth) > 0 || job.pending == 0;
+      });
+      --waiting_;
+      --sleeping_;
+    }
+  }
+}
+
+// The main loop of a worker
+void ThreadPool::work(unsigned deque) {
+  worker_pool = this;
+  worker_deque = deque;
+  while (true) {
+    Task task;
+    if (pop(deque, 0, task) || steal(deque, 0, task)) {
+      execute(deque, task);
+      continue;
+    }
+    std::unique_lock<std::mutex> lock(sleep_mutex_);
+    ++sleeping_;
+    sleep_cv_.wait(lock, [&] { return stop_ || queued(0) > 0; });
+    --sleeping_;
+    if (stop_)
+      return;
+  }
+}
+
+// Run fn on all morsels of [0, size)
+void ThreadPool::parallelFor(uint64_t size,
+                             uint64_t morsel_size,
+                             const MorselFn &fn) {
+  auto num_morsels = numMorsels(size, morsel_size);
+  if (workers_.empty() || num_morsels <= 1 || job_depth >= kMaxDepth) {
+    ++job_depth;
+    for (uint64_t begin = 0; begin < size; begin += morsel_size)
+      fn(begin, std::min(begin + morsel_size, size));
+    --job_depth;
+    return;
+  }
+
+  auto deque = self();
+  Job job(&fn, size, morsel_size, job_depth, num_morsels);
+  execute(deque, {&job, 0, num_morsels});
+  wait(deque, job);
+}
+
+// The pool used by the operators
+ThreadPool &ThreadPool::global() {
+  if (!global_pool)
+    setGlobalThreads(0);
+  return *global_pool;
+}
+
+// Replace the pool used by the operators
+void ThreadPool::setGlobalThreads(unsigned num_threads, bool pin) {
+  if (num_threads == 0)
+    num_threads = std::max(1u, std::thread::hardware_concurrency());
+  global_pool.reset();
+  global_pool = std::make_unique<ThreadPool>(num_threads, pin);
+}
@@ -0,0 +1,283 @@
+#include "workload_generator.h"
+
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+#include <stdexcept>
+
+namespace {
+
+// log1p(x) / x, stable around 0
+inline double helper1(double x) {
+  if (std::abs(x) > 1e-8)
+    return std::log1p(x) / x;
+  return 1 - x * (0.5 - x * (1.0 / 3 - 0.25 * x));
+}
+
+// expm1(x) / x, stable around 0
+inline double helper2(double x) {
+  if (std::abs(x) > 1e-8)
+    return std::expm1(x) / x;
+  return 1 + x * 0.5 * (1 + x / 3 * (1 + 0.25 * x));
+}
+
+}
+
+// The constructor
+ZipfDistribution::ZipfDistribution(uint64_t n, double skew)
+    : n_(n), skew_(skew) {
+  h_integral_x1_ = hIntegral(1.5) - 1;
+  h_integral_n_ = hIntegral(n + 0.5);
+  threshold_ = 2 - hIntegralInverse(hIntegral(2.5) - h(2));
+}
+
+// The density x^-skew
+double ZipfDistribution::h(double x) const {
+  return std::exp(-skew_ * std::log(x));
+}
+
+// The integral of the density
+double ZipfDistribution::hIntegral(double x) const {
+  auto log_x = std::log(x);
+  return helper2((1 - skew_) * log_x) * log_x;
+}
+
+// The inverse of the integral
+double ZipfDistribution::hIntegralInverse(double x) const {
+  auto t = std::max(-1.0, x * (1 - skew_));
+  return std::exp(helper1(t) * x);
+}
+
+// Draw a rank
+uint64_t ZipfDistribution::operator()(std::mt19937_64 &rng) const {
+  std::uniform_real_distribution<double> uniform;
+  while (true) {
+    auto u = h_integral_n_ + uniform(rng) * (h_integral_x1_ - h_integral_n_);
+    auto x = hIntegralInverse(u);
+    auto k = static_cast<uint64_t>(
+        std::max(1.0, std::min<double>(x + 0.5, n_)));
+    if (k - x <= threshold_ || u >= hIntegral(k + 0.5) - h(k))
+      return k;
+  }
+}
+
+// The constructor
+WorkloadGenerator::WorkloadGenerator(const Config &config)
+    : config_(config), rng_(config.seed) {
+  if (config_.num_relations == 0 || config_.num_foreign_keys == 0
+      || config_.shapes.empty() || config_.min_joined < 2
+      || config_.min_joined > config_.max_joined || config_.batch_size == 0
+      || config_.scale <= 0)
+    throw std::invalid_argument("the configuration admits no query");
+
+  // Sizes between 10% and 100% of the scaled base size (log-uniform), the
+  // first relation has the full size
+  auto full = std::max<uint64_t>(1, std::llround(config_.scale * kBaseSize));
+  std::uniform_real_distribution<double> exponent(-1, 0);
+  for (unsigned i = 0; i < config_.num_relations; ++i) {
+    uint64_t size = std::llround(full * std::pow(10, exponent(rng_)));
+    sizes_.push_back(i == 0 ? full : std::max<uint64_t>(1, size));
+  }
+  domain_ = *std::max_element(sizes_.begin(), sizes_.end());
+  common_keys_ = *std::min_element(sizes_.begin(), sizes_.end());
+
+  // A multiplier near the golden ratio of the domain scatters the keys
+  stride_ = std::max<uint64_t>(1, domain_ * 0.618) | 1;
+  while (std::gcd(stride_, domain_) != 1)
+    ++stride_;
+}
+
+// Fill a column with ranks of the configured distribution
+template <typename Map>
+void WorkloadGenerator::fill(std::mt19937_64 &rng,
+                             uint64_t *column,
+                             uint64_t size,
+                             uint64_t n,
+                             Map map) const {
+  if (config_.distribution == Distribution::Zipf) {
+    ZipfDistribution zipf(n, config_.skew);
+    for (uint64_t i = 0; i < size; ++i)
+      column[i] = map(zipf(rng) - 1);
+  } else {
+    std::uniform_int_distribution<uint64_t> uniform(0, n - 1);
+    for (uint64_t i = 0; i < size; ++i)
+      column[i] = map(uniform(rng));
+  }
+}
+
+// Generate the i-th relation
+Relation WorkloadGenerator::relation(unsigned i) const {
+  std::mt19937_64 rng(config_.seed + i + 1);
+  auto size = sizes_[i];
+  std::vector<uint64_t *> columns;
+  for (unsigned c = 0; c < numColumns(); ++c)
+    columns.push_back(new uint64_t[size]);
+
+  // The primary key
+  for (uint64_t row = 0; row < size; ++row)
+    columns[0][row] = key(row);
+
+  // Foreign keys reference the whole domain or only the keys of the
+  // smallest relation
+  auto keys = config_.distribution == Distribution::ForeignKey ? common_keys_
+                                                               : domain_;
+  for (unsigned c = 1; c <= config_.num_foreign_keys; ++c)
+    fill(rng, columns[c], size, keys, [this](uint64_t r) { return key(r); });
+  for (unsigned c = 1 + config_.num_foreign_keys; c < numColumns(); ++c)
+    fill(rng, columns[c], size, kAttributeDomain, [](uint64_t r) { return r; });
+  return Relation(size, std::move(columns));
+}
+
+// P(attribute < c) for every c in [0, kAttributeDomain]
+std::vector<double> WorkloadGenerator::cumulative() const {
+  std::vector<double> below(kAttributeDomain + 1);
+  if (config_.distribution != Distribution::Zipf) {
+    for (uint64_t c = 0; c <= kAttributeDomain; ++c)
+      below[c] = double(c) / kAttributeDomain;
+    return below;
+  }
+  for (uint64_t v = 0; v < kAttributeDomain; ++v)
+    below[v + 1] = below[v] + std::pow(v + 1, -config_.skew);
+  for (auto &fraction : below)
+    fraction /= below.back();
+  return below;
+}
+
+// The edges of a query graph
+std::vector<std::pair<unsigned, unsigned>>
+WorkloadGenerator::edges(Shape shape, unsigned count) {
+  std::vector<std::pair<unsigned, unsigned>> edges;
+  switch (shape) {
+    case Shape::Chain:
+    case Shape::Cycle:
+      for (unsigned b = 1; b < count; ++b)
+        edges.emplace_back(b - 1, b);
+      if (shape == Shape::Cycle && count > 2)
+        edges.emplace_back(count - 1, 0);
+      break;
+    case Shape::Star:
+      // The center references every other relation (like a fact table)
+      for (unsigned b = 1; b < count; ++b)
+        edges.emplace_back(0, b);
+      break;
+    case Shape::Clique:
+      for (unsigned a = 0; a < count; ++a)
+        for (unsigned b = a + 1; b < count; ++b)
+          edges.emplace_back(a, b);
+      break;
+  }
+  return edges;
+}
+
+// Generate the queries
+std::vector<std::string> WorkloadGenerator::queries() {
+  auto pick = [this](uint64_t low, uint64_t high) {
+    return std::uniform_int_distribution<uint64_t>(low, high)(rng_);
+  };
+  std::bernoulli_distribution filtered(config_.filter_probability);
+  // The constants whose filters attribute < less and attribute >= greater
+  // select the fraction of tuples closest to the selectivity. Under skew
+  // one side may miss it (the most frequent value alone can exceed it),
+  // then only the other side is used.
+  auto below = cumulative();
+  auto closest = [&below](double fraction) {
+    uint64_t best = 0;
+    for (uint64_t c = 1; c < below.size(); ++c) {
+      if (std::abs(below[c] - fraction) < std::abs(below[best] - fraction))
+        best = c;
+    }
+    return best;
+  };
+  auto selectivity = config_.selectivity;
+  auto less = closest(selectivity);
+  auto greater = closest(1 - selectivity);
+  auto less_error = std::abs(below[less] - selectivity);
+  auto greater_error = std::abs(1 - below[greater] - selectivity);
+  auto tolerance = 0.1 * selectivity;
+  bool use_less = less_error <= std::max(tolerance, greater_error);
+  bool use_greater = greater_error <= std::max(tolerance, less_error);
+
+  std::vector<std::string> lines;
+  for (unsigned q = 0; q < config_.num_queries; ++q) {
+    auto shape = config_.shapes[pick(0, config_.shapes.size() - 1)];
+    unsigned count = pick(config_.min_joined, config_.max_joined);
+    // A binding references at most one relation per foreign key
+    if (shape == Shape::Star || shape == Shape::Clique)
+      count = std::min(count, config_.num_foreign_keys + 1);
+
+    std::string query;
+    for (unsigned b = 0; b < count; ++b) {
+      query += b ? " " : "";
+      query += std::to_string(pick(0, config_.num_relations - 1));
+    }
+    query += "|";
+
+    std::vector<std::string> predicates;
+    std::vector<unsigned> next_key(count, 1);
+    for (auto &edge : edges(shape, count)) {
+      predicates.push_back(std::to_string(edge.first) + "."
+                               + std::to_string(next_key[edge.first]++) + "="
+                               + std::to_string(edge.second) + ".0");
+    }
+    for (unsigned b = 0; b < count && config_.num_attributes; ++b) {
+      if (!filtered(rng_))
+        continue;
+      auto column = std::to_string(b) + "."
+          + std::to_string(config_.num_foreign_keys
+                               + pick(1, config_.num_attributes));
+      auto kind = pick(0, 4);
+      if (kind < 4 && !use_less)
+        kind = 2;
+      else if (kind < 4 && !use_greater)
+        kind = 0;
+      if (kind < 2)
+        predicates.push_back(column + "<" + std::to_string(less));
+      else if (kind < 4)
+        predicates.push_back(column + ">" + std::to_string(greater ? greater - 1
+                                                                   : 0));
+      else
+        predicates.push_back(
+            column + "=" + std::to_string(pick(0, kAttributeDomain - 1)));
+    }
+    for (unsigned p = 0; p < predicates.size(); ++p)
+      query += (p ? "&" : "") + predicates[p];
+    query += "|";
+
+    auto selections = pick(1, 3);
+    for (unsigned s = 0; s < selections; ++s) {
+      query += s ? " " : "";
+      query += std::to_string(pick(0, count - 1)) + "."
+          + std::to_string(pick(0, numColumns() - 1));
+    }
+    lines.push_back(query);
+    if ((q + 1) % config_.batch_size == 0 || q + 1 == config_.num_queries)
+      lines.emplace_back("F");
+  }
+  return lines;
+}
+
+// Parse the name of a distribution
+WorkloadGenerator::Distribution
+WorkloadGenerator::parseDistribution(const std::string &name) {
+  if (name == "uniform")
+    return Distribution::Uniform;
+  if (name == "zipf")
+    return Distribution::Zipf;
+  if (name == "fk")
+    return Distribution::ForeignKey;
+  throw std::invalid_argument("unknown distribution " + name);
+}
+
+// Parse the name of a shape
+WorkloadGenerator::Shape
+WorkloadGenerator::parseShape(const std::string &name) {
+  if (name == "chain")
+    return Shape::Chain;
+  if (name == "star")
+    return Shape::Star;
+  if (name == "cycle")
+    return Shape::Cycle;
+  if (name == "clique")
+    return Shape::Clique;
+  throw std::invalid_argument("unknown shape " + name);
+}
@@ -0,0 +1,14 @@
+#include "zone_map.h"
+
+#include <algorithm>
+
+// Build the zones of a column
+void ZoneMap::build(const uint64_t *column, uint64_t size) {
+  zones_.resize((size + kBlockSize - 1) / kBlockSize);
+  for (uint64_t b = 0; b < zones_.size(); ++b) {
+    auto begin = column + b * kBlockSize;
+    auto end = column + std::min(size, (b + 1) * kBlockSize);
+    auto minmax = std::minmax_element(begin, end);
+    zones_[b] = Zone{*minmax.first, *minmax.second};
+  }
+}
@@ -0,0 +1,102 @@
+#include <algorithm>
+#include <iterator>
+#include <regex>
+#include <sstream>
+
+#include "gtest/gtest.h"
+
+#include "batch_executor.h"
+#include "thread_pool.h"
+#include "workload_generator.h"
+
+TEST(BatchExecutor, OrderedResults) {
+  WorkloadGenerator::Config config;
+  config.scale = 0.05;
+  config.num_relations = 6;
+  config.num_queries = 40;
+  config.batch_size = 40;
+  WorkloadGenerator generator(config);
+  Joiner joiner;
+  for (unsigned i = 0; i < config.num_relations; ++i)
+    joiner.addRelation(generator.relation(i));
+  joiner.buildStatistics();
+  joiner.buildHashIndexes();
+
+  std::vector<QueryInfo> batch;
+  std::vector<std::string> expected;
+  for (auto &line : generator.queries()) {
+    if (line == "F") continue;
+    batch.emplace_back(line);
+    expected.push_back(joiner.join(batch.back()));
+  }
+
+  ThreadPool::setGlobalThreads(4);
+  BatchExecutor executor(joiner);
+  ASSERT_EQ(executor.run(batch), expected);
+  ASSERT_GT(executor.peak_reserved(), 0u);
+  ASSERT_LE(executor.peak_reserved(), executor.memory_limit());
+
+  // No query fits next to another one
+  BatchExecutor limited(joiner, 1);
+  ASSERT_EQ(limited.run(batch), expected);
+  ASSERT_EQ(limited.peak_running(), 1u);
+  ThreadPool::setGlobalThreads(0);
+}
+
+TEST(BatchExecutor, SharedSubplans) {
+  WorkloadGenerator::Config config;
+  config.scale = 0.05;
+  config.num_relations = 6;
+  config.num_queries = 20;
+  config.batch_size = 20;
+  WorkloadGenerator generator(config);
+  Joiner joiner;
+  for (unsigned i = 0; i < config.num_relations; ++i)
+    joiner.addRelation(generator.relation(i));
+  joiner.buildStatistics();
+
+  // Every query twice, the second time with the bindings in reverse order
+  std::vector<QueryInfo> batch;
+  for (auto &line : generator.queries()) {
+    if (line == "F") continue;
+    batch.emplace_back(line);
+    auto relations = line.substr(0, line.find('|'));
+    auto num_bindings = std::count(relations.begin(), relations.end(), ' ') + 1;
+    std::istringstream in(relations);
+    std::vector<std::string> ids{std::istream_iterator<std::string>(in), {}};
+    std::reverse(ids.begin(), ids.end());
+    std::string reversed;
+    for (auto &id : ids)
+      reversed += (reversed.empty() ? "" : " ") + id;
+    // Rename the binding b of every column b.c
+    std::regex column("(\\d+)\\.(\\d+)");
+    auto rest = line.substr(line.find('|'));
+    std::smatch match;
+    while (std::regex_search(rest, match, column)) {
+      reversed += match.prefix().str()
+          + std::to_string(num_bindings - 1 - std::stoul(match[1])) + "."
+          + match[2].str();
+      rest = match.suffix();
+    }
+    batch.emplace_back(reversed + rest);
+  }
+  std::vector<std::string> expected;
+  for (auto &query : batch)
+    expected.push_back(joiner.join(query));
+  for (unsigned q = 0; q < batch.size(); q += 2)
+    ASSERT_EQ(expected[q], expected[q + 1]);
+
+  ThreadPool::setGlobalThreads(4);
+  BatchExecutor unshared(joiner);
+  unshared.setSharing(false);
+  ASSERT_EQ(unshared.run(batch), expected);
+  ASSERT_EQ(unshared.sharing_report().shared_subplans, 0u);
+
+  BatchExecutor executor(joiner);
+  ASSERT_EQ(executor.run(batch), expected);
+  auto &report = executor.sharing_report();
+  ASSERT_GE(report.shared_subplans, config.num_queries);
+  ASSERT_GE(report.consumers, 2 * report.shared_subplans);
+  ASSERT_GT(report.deduplicated_operators, 0u);
+  ThreadPool::setGlobalThreads(0);
+}
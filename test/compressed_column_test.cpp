@@ -0,0 +1,127 @@
+#include <algorithm>
+
+#include "gtest/gtest.h"
+
+#include "compressed_column.h"
+#include "operators.h"
+
+namespace {
+
+// Compress a column with its exact bounds
+CompressedColumn compress(const std::vector<uint64_t> &column) {
+  CompressedColumn compressed;
+  auto minmax = std::minmax_element(column.begin(), column.end());
+  auto sorted = column;
+  std::sort(sorted.begin(), sorted.end());
+  auto distinct = std::unique(sorted.begin(), sorted.end()) - sorted.begin();
+  EXPECT_TRUE(compressed.compress(column.data(), column.size(),
+                                  *minmax.first, *minmax.second, distinct));
+  return compressed;
+}
+
+}
+
+TEST(CompressedColumn, Encodings) {
+  using Encoding = CompressedColumn::Encoding;
+  struct Case {
+    uint64_t base, range, step;
+    Encoding encoding;
+    unsigned width;
+  };
+  std::vector<Case> cases{
+      {1000, 200, 1, Encoding::FrameOfReference, 8},
+      {1ull << 40, 5, 1, Encoding::FrameOfReference, 3},
+      {7, 6000, 1, Encoding::FrameOfReference, 16},
+      {0, 1000, 1ull << 30, Encoding::Dictionary, 16},
+      {0, 1ull << 29, 1ull << 10, Encoding::FrameOfReference, 39},
+      {42, 1, 1, Encoding::FrameOfReference, 0},
+      {0, 1ull << 29, 1, Encoding::FrameOfReference, 32},
+  };
+  for (auto &c : cases) {
+    std::vector<uint64_t> column;
+    for (uint64_t i = 0; i < 80000; ++i)
+      column.push_back(c.base + (i * 7919 % c.range) * c.step);
+    auto compressed = compress(column);
+    ASSERT_EQ(compressed.encoding(), c.encoding) << c.range;
+    ASSERT_EQ(compressed.width(), c.width) << c.range;
+    ASSERT_LT(compressed.memory(), column.size() * sizeof(uint64_t));
+
+    std::vector<uint64_t> decoded(column.size());
+    compressed.decode(0, column.size(), decoded.data());
+    ASSERT_EQ(decoded, column);
+
+    // Every range of values is evaluated on the codes
+    auto low = c.base + c.range / 3 * c.step, high = low + c.range / 4 * c.step;
+    uint64_t code_low, code_high;
+    ASSERT_TRUE(compressed.codeRange(low, high, code_low, code_high))
+        << c.range;
+    std::vector<uint64_t> mask(column.size() / 64 + 1);
+    compressed.evaluate(64, column.size() - 64, code_low, code_high,
+                        mask.data(), false);
+    for (uint64_t i = 64; i < column.size(); ++i) {
+      bool pass = column[i] >= low && column[i] <= high;
+      ASSERT_EQ((mask[(i - 64) / 64] >> ((i - 64) % 64)) & 1, pass) << i;
+    }
+  }
+}
+
+TEST(CompressedColumn, CodeRange) {
+  // Three values need fewer bits as dictionary codes than as differences
+  std::vector<uint64_t> column;
+  for (unsigned i = 0; i < 200; ++i)
+    column.insert(column.end(), {10, 5000, 1000, 5000, 10});
+  auto compressed = compress(column);
+  ASSERT_EQ(compressed.encoding(), CompressedColumn::Encoding::Dictionary);
+  ASSERT_EQ(compressed.bits(), 2u);
+  uint64_t code_low, code_high;
+  ASSERT_FALSE(compressed.codeRange(0, 9, code_low, code_high));
+  ASSERT_FALSE(compressed.codeRange(5001, 10000, code_low, code_high));
+  ASSERT_FALSE(compressed.codeRange(11, 999, code_low, code_high));
+  ASSERT_TRUE(compressed.codeRange(0, 15, code_low, code_high));
+  ASSERT_EQ(code_low, 0u);
+  ASSERT_EQ(code_high, 0u);
+  ASSERT_TRUE(compressed.codeRange(15, 10000, code_low, code_high));
+  ASSERT_EQ(code_low, 1u);
+  ASSERT_EQ(code_high, 2u);
+  ASSERT_EQ(compressed.value(1), 5000u);
+}
+
+TEST(CompressedColumn, FilterScan) {
+  uint64_t size = 3 * ZoneMap::kBlockSize + 100;
+  // The same columns twice, only those of relation are compressed
+  auto create = [size]() {
+    std::vector<uint64_t *> columns{new uint64_t[size], new uint64_t[size]};
+    for (uint64_t i = 0; i < size; ++i) {
+      columns[0][i] = (i * 7919) % 5000;
+      columns[1][i] = (i % 100) << 20;
+    }
+    return Relation(size, std::move(columns));
+  };
+  auto relation = create(), uncompressed = create();
+  ASSERT_TRUE(relation.compressColumn(0, 0, 4999, 5000));
+  ASSERT_TRUE(relation.compressColumn(1, 0, 99 << 20, 100));
+  ASSERT_EQ(relation.compressedColumn(1)->encoding(),
+            CompressedColumn::Encoding::Dictionary);
+
+  using Comparison = FilterInfo::Comparison;
+  std::vector<std::vector<FilterInfo>> queries{
+      {FilterInfo(SelectInfo(0, 0, 0), 2500, Comparison::Less)},
+      {FilterInfo(SelectInfo(0, 0, 0), 100, Comparison::Greater),
+       FilterInfo(SelectInfo(0, 0, 1), 7 << 20, Comparison::Equal)},
+      {FilterInfo(SelectInfo(0, 0, 1), (7 << 20) + 1, Comparison::Equal)},
+  };
+  for (auto &filters : queries) {
+    FilterScan scan(uncompressed, filters);
+    scan.run();
+    auto expected = scan.result_size();
+    std::vector<uint64_t> expected_ids;
+    for (uint64_t i = 0; i < expected; ++i)
+      expected_ids.push_back(scan.rowIds(0).rowId(i));
+
+    FilterScan compressed_scan(relation, filters);
+    compressed_scan.run();
+    ASSERT_EQ(compressed_scan.result_size(), expected);
+    for (uint64_t i = 0; i < expected; ++i)
+      ASSERT_EQ(compressed_scan.rowIds(0).rowId(i), expected_ids[i]);
+  }
+}
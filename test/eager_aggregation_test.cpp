@@ -0,0 +1,92 @@
+#include "gtest/gtest.h"
+
+#include "joiner.h"
+#include "operators.h"
+#include "utils/test_utils.h"
+
+TEST(EagerAggregation, CountJoin) {
+  auto r0 = TestUtils::createRelation(2000, 0);
+  auto r1 = TestUtils::createRelation(3000, 1);
+  auto r2 = TestUtils::createRelation(1000, 2);
+  auto r3 = TestUtils::createRelation(500, 3);
+  HashTable index;
+  index.build(r1.columns()[1], nullptr, r1.size());
+  // r0 ⋈ r1 ⋈ r2 on r0.0 = r1.1 and r1.2 = r2.0, and r3 ⋈ r0 on r3.2 = r0.1
+  PredicateInfo p01(SelectInfo(0, 0, 0), SelectInfo(1, 1, 1));
+  PredicateInfo p12(SelectInfo(1, 1, 2), SelectInfo(2, 2, 0));
+  PredicateInfo p30(SelectInfo(3, 3, 2), SelectInfo(0, 0, 1));
+  PredicateInfo p10(p01.right, p01.left);
+  std::vector<SelectInfo> selections{SelectInfo(0, 0, 2), SelectInfo(0, 0, 1)};
+  auto scan = [](const Relation &r, unsigned binding) {
+    return std::make_unique<Scan>(r, binding);
+  };
+  for (bool pipelined : {false, true}) {
+    auto run = [&](std::unique_ptr<Operator> expected_plan,
+                   std::unique_ptr<Operator> plan,
+                   const std::vector<SelectInfo> &selections) {
+      TestUtils::checkCollapsedPlan(std::move(expected_plan), std::move(plan),
+                                    selections, pipelined);
+    };
+    // r1 counted by aggregation and by its index
+    run(std::make_unique<Join>(scan(r1, 1), scan(r0, 0), p10),
+        std::make_unique<CountJoin>(scan(r1, 1), scan(r0, 0), p10),
+        selections);
+    run(std::make_unique<Join>(scan(r1, 1), scan(r0, 0), p10),
+        std::make_unique<CountJoin>(index, scan(r0, 0), p10), selections);
+    // r1 ⋈ r2 collapsed at once: r1's counts are those of r2
+    run(std::make_unique<Join>(
+            std::make_unique<Join>(scan(r2, 2), scan(r1, 1),
+                                   PredicateInfo(p12.right, p12.left)),
+            scan(r0, 0), p10),
+        std::make_unique<CountJoin>(
+            std::make_unique<CountJoin>(scan(r2, 2), scan(r1, 1),
+                                        PredicateInfo(p12.right, p12.left)),
+            scan(r0, 0), p10),
+        selections);
+    // A join above a count join, which reads r0.1
+    run(std::make_unique<Join>(
+            scan(r3, 3),
+            std::make_unique<Join>(scan(r1, 1), scan(r0, 0), p10), p30),
+        std::make_unique<Join>(
+            scan(r3, 3),
+            std::make_unique<CountJoin>(scan(r1, 1), scan(r0, 0), p10), p30),
+        {SelectInfo(0, 0, 2), SelectInfo(3, 3, 0)});
+  }
+}
+
+TEST(EagerAggregation, Joiner) {
+  Joiner joiner;
+  for (unsigned i = 0; i < 4; i++)
+    joiner.addRelation(TestUtils::createRelation(2000, i));
+  joiner.buildStatistics();
+  // Projections on one side of many-to-many joins, with filters, self joins
+  // and parallel predicates
+  std::vector<std::string> queries{
+      "0 1|0.0=1.1|0.2",
+      "0 1 2|0.0=1.1&1.2=2.0|0.1 0.2",
+      "0 1 2 3|0.0=1.1&1.2=2.0&0.1=3.0&3.1<20|3.2",
+      "0 1 2|0.0=1.1&0.1=2.0&2.1=2.2&1.2<40|0.2",
+      "0 1 2|0.0=1.1&0.1=1.2&1.0=2.1&2.0<30|0.2",
+      "0 1 1|0.0=1.1&1.0=2.1&0.2>10|0.2 0.0",
+  };
+  uint64_t count_joins = 0;
+  for (auto &query : queries) {
+    QueryInfo i(query);
+    SCOPED_TRACE(query);
+    count_joins +=
+        TestUtils::checkCollapsedQuery(joiner, i, &Joiner::countedInput);
+  }
+  ASSERT_GT(count_joins, 0u);
+
+  // Columns of both inputs are selected
+  QueryInfo selected("0 1|0.0=1.1|0.2 1.2");
+  ASSERT_EQ(joiner.countedInput(*joiner.plan(selected), selected),
+            nullptr);
+
+  // Eager aggregation on and off
+  QueryInfo i(queries[1]);
+  auto expected = joiner.join(i);
+  joiner.setEagerAggregation(false);
+  ASSERT_EQ(joiner.countedInput(*joiner.plan(i), i), nullptr);
+  ASSERT_EQ(joiner.join(i), expected);
+}
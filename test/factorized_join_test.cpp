@@ -0,0 +1,102 @@
+#include "gtest/gtest.h"
+
+#include "joiner.h"
+#include "operators.h"
+#include "reference_joiner.h"
+#include "utils/test_utils.h"
+
+namespace {
+
+// r2 ⋈ r1 on r2.0 = r1.2 below r1 ⋈ r0 on r1.1 = r0.0
+const PredicateInfo kInner(SelectInfo(2, 2, 0), SelectInfo(1, 1, 2));
+const PredicateInfo kOuter(SelectInfo(1, 1, 1), SelectInfo(0, 0, 0));
+
+std::unique_ptr<Operator> scan(const Relation &relation, unsigned binding) {
+  return std::make_unique<Scan>(relation, binding);
+}
+
+// The plan of binary joins that the factorized plans have to match
+std::unique_ptr<Operator> expandedPlan(const std::vector<Relation> &r) {
+  return std::make_unique<Join>(
+      std::make_unique<Join>(scan(r[2], 2), scan(r[1], 1), kInner),
+      scan(r[0], 0), kOuter);
+}
+
+}
+
+TEST(FactorizedJoin, GroupsOfGroups) {
+  // r1 is grouped on r1.1 by the outer join, its groups hold the groups of
+  // r2 on r2.0. Columns of every input are selected, two of them of r2.
+  std::vector<Relation> r;
+  for (unsigned i = 0; i < 3; ++i)
+    r.push_back(TestUtils::createRelation(1500 + 700 * i, 4 + i));
+  std::vector<SelectInfo> selections{SelectInfo(2, 2, 1),
+                                     SelectInfo(2, 2, 2),
+                                     SelectInfo(1, 1, 0),
+                                     SelectInfo(0, 0, 2)};
+  for (bool pipelined : {false, true}) {
+    for (bool join_filter : {false, true}) {
+      auto inner = std::make_unique<FactorizedJoin>(scan(r[2], 2),
+                                                    scan(r[1], 1), kInner);
+      inner->setJoinFilter(join_filter);
+      auto outer = std::make_unique<FactorizedJoin>(std::move(inner),
+                                                    scan(r[0], 0), kOuter);
+      outer->setJoinFilter(join_filter);
+      TestUtils::checkCollapsedPlan(expandedPlan(r), std::move(outer),
+                                    selections, pipelined);
+    }
+  }
+}
+
+TEST(FactorizedJoin, CountedGroups) {
+  // The groups of r1 count their partners in r2 instead of holding them,
+  // since no column of r2 is selected
+  std::vector<Relation> r;
+  for (unsigned i = 0; i < 3; ++i)
+    r.push_back(TestUtils::createRelation(2500 - 600 * i, 7 + i));
+  std::vector<SelectInfo> selections{SelectInfo(1, 1, 0),
+                                     SelectInfo(1, 1, 2),
+                                     SelectInfo(0, 0, 1)};
+  for (bool pipelined : {false, true}) {
+    TestUtils::checkCollapsedPlan(
+        expandedPlan(r),
+        std::make_unique<FactorizedJoin>(
+            std::make_unique<CountJoin>(scan(r[2], 2), scan(r[1], 1),
+                                        kInner),
+            scan(r[0], 0), kOuter),
+        selections, pipelined);
+  }
+}
+
+TEST(FactorizedJoin, Joiner) {
+  Joiner joiner;
+  for (unsigned i = 0; i < 3; i++)
+    joiner.addRelation(TestUtils::createRelation(1800, 4 + i));
+  joiner.buildStatistics();
+  ReferenceJoiner reference(joiner.relations());
+  // Columns selected on both sides of many-to-many joins, of several grouped
+  // inputs and of self joins
+  std::vector<std::string> queries{
+      "0 1|0.0=1.1|0.2 1.2",
+      "0 1 2|0.0=1.1&1.2=2.0|0.1 1.0 2.2",
+      "0 1 2|0.0=1.1&0.0=2.0&1.2<150|0.1 1.0 2.1",
+      "0 1 1|0.0=1.1&1.0=2.1&0.2>10|0.2 2.0",
+  };
+  uint64_t factorized_joins = 0;
+  for (auto &query : queries) {
+    QueryInfo i(query);
+    SCOPED_TRACE(query);
+    factorized_joins +=
+        TestUtils::checkCollapsedQuery(joiner, i, &Joiner::factorizedInput);
+  }
+  ASSERT_GT(factorized_joins, 0u);
+
+  // The joiner's results with and without factorized joins
+  for (bool factorized : {true, false}) {
+    joiner.setFactorizedJoins(factorized);
+    for (auto &query : queries) {
+      QueryInfo i(query);
+      ASSERT_EQ(joiner.join(i), reference.join(i)) << query;
+    }
+  }
+}
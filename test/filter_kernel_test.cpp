@@ -0,0 +1,71 @@
+#include "gtest/gtest.h"
+
+#include "filter_kernel.h"
+
+namespace {
+
+// Values around the constants, including values with the highest bit set
+std::vector<uint64_t> createColumn(uint64_t size) {
+  std::vector<uint64_t> column;
+  uint64_t state = 42;
+  for (uint64_t i = 0; i < size; ++i) {
+    state = state * 6364136223846793005ull + 1442695040888963407ull;
+    column.push_back(i % 3 == 0 ? (state >> 60) : state);
+  }
+  return column;
+}
+
+}
+
+TEST(FilterKernel, MatchesScalarComparison) {
+  auto column = createColumn(1000);
+  std::vector<uint64_t> constants{0, 7, 1ull << 63, ~0ull};
+  for (auto kind : {FilterKernel::Scalar, FilterKernel::AVX2,
+                    FilterKernel::AVX512}) {
+    if (!FilterKernel::supported(kind))
+      continue;
+    FilterKernel::select(kind);
+    for (auto comparison : comparisonTypes) {
+      for (auto constant : constants) {
+        // Odd size to cover the last, partial word
+        uint64_t size = 999;
+        std::vector<uint64_t> mask((size + 63) / 64);
+        FilterKernel::evaluate(column.data(), size, comparison, constant,
+                               mask.data(), false);
+        std::vector<uint64_t> ids;
+        FilterKernel::toSelection(mask.data(), size, 10, ids);
+
+        std::vector<uint64_t> expected;
+        for (uint64_t i = 0; i < size; ++i) {
+          bool pass = comparison == FilterInfo::Comparison::Less
+                      ? column[i] < constant
+                      : comparison == FilterInfo::Comparison::Greater
+                        ? column[i] > constant : column[i] == constant;
+          if (pass)
+            expected.push_back(10 + i);
+        }
+        ASSERT_EQ(ids, expected) << FilterKernel::name(kind) << " "
+                                 << static_cast<char>(comparison)
+                                 << constant;
+      }
+    }
+  }
+  FilterKernel::select(FilterKernel::best());
+}
+
+TEST(FilterKernel, CombineFilters) {
+  std::vector<uint64_t> column;
+  for (uint64_t i = 0; i < 200; ++i)
+    column.push_back(i);
+  std::vector<uint64_t> mask(4);
+  FilterKernel::evaluate(column.data(), column.size(),
+                         FilterInfo::Comparison::Greater, 60, mask.data(),
+                         false);
+  FilterKernel::evaluate(column.data(), column.size(),
+                         FilterInfo::Comparison::Less, 140, mask.data(), true);
+  std::vector<uint64_t> ids;
+  FilterKernel::toSelection(mask.data(), column.size(), 0, ids);
+  ASSERT_EQ(ids.size(), 79u);
+  ASSERT_EQ(ids.front(), 61u);
+  ASSERT_EQ(ids.back(), 139u);
+}
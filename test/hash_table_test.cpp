@@ -0,0 +1,83 @@
+#include <algorithm>
+
+#include "gtest/gtest.h"
+
+#include "hash_table.h"
+
+TEST(HashTable, Empty) {
+  HashTable table;
+  table.build(nullptr, nullptr, 0);
+  ASSERT_EQ(table.size(), 0u);
+  ASSERT_TRUE(table.find(0).empty());
+  ASSERT_TRUE(table.find(42).empty());
+}
+
+TEST(HashTable, UniqueKeys) {
+  std::vector<uint64_t> keys;
+  for (uint64_t i = 0; i < 1000; ++i)
+    keys.push_back(i * 7);
+  HashTable table;
+  table.build(keys.data(), nullptr, keys.size());
+
+  ASSERT_EQ(table.num_keys(), keys.size());
+  for (uint64_t i = 0; i < keys.size(); ++i) {
+    auto range = table.find(keys[i]);
+    ASSERT_EQ(range.size(), 1u);
+    ASSERT_EQ(*range.begin(), i);
+  }
+  ASSERT_TRUE(table.find(1).empty());
+}
+
+TEST(HashTable, Duplicates) {
+  std::vector<uint64_t> keys{5, 3, 5, 0, 5, 3};
+  std::vector<uint64_t> values{10, 11, 12, 13, 14, 15};
+  HashTable table;
+  table.build(keys.data(), values.data(), keys.size());
+
+  ASSERT_EQ(table.size(), keys.size());
+  ASSERT_EQ(table.num_keys(), 3u);
+
+  auto range = table.find(5);
+  std::vector<uint64_t> found(range.begin(), range.end());
+  std::sort(found.begin(), found.end());
+  ASSERT_EQ(found, (std::vector<uint64_t>{10, 12, 14}));
+  ASSERT_EQ(table.find(3).size(), 2u);
+  ASSERT_EQ(*table.find(0).begin(), 13u);
+  ASSERT_TRUE(table.find(4).empty());
+}
+
+TEST(HashTable, SumValues) {
+  std::vector<uint64_t> keys{5, 3, 5, 0, 5, 3};
+  std::vector<uint64_t> values{10, 11, 12, 13, 14, 15};
+  HashTable table;
+  table.build(keys.data(), values.data(), keys.size());
+  table.sumValues();
+
+  ASSERT_EQ(table.size(), 3u);
+  ASSERT_EQ(table.num_keys(), 3u);
+  auto range = table.find(5);
+  ASSERT_EQ(range.size(), 1u);
+  ASSERT_EQ(*range.begin(), 10u + 12u + 14u);
+  ASSERT_EQ(*table.find(3).begin(), 11u + 15u);
+  ASSERT_EQ(*table.find(0).begin(), 13u);
+  ASSERT_TRUE(table.find(4).empty());
+}
+
+TEST(HashTable, GroupValues) {
+  std::vector<uint64_t> keys{5, 3, 5, 0, 5, 3};
+  HashTable table;
+  table.build(keys.data(), nullptr, keys.size());
+  auto groups = table.groupValues();
+
+  ASSERT_EQ(table.size(), 3u);
+  ASSERT_EQ(groups.size(), keys.size());
+  for (uint64_t i = 0; i < keys.size(); ++i) {
+    auto range = table.find(keys[i]);
+    ASSERT_EQ(range.size(), 1u);
+    ASSERT_EQ(*range.begin(), groups[i]);
+  }
+  ASSERT_NE(groups[0], groups[1]);
+  ASSERT_NE(groups[0], groups[3]);
+  ASSERT_NE(groups[1], groups[3]);
+  ASSERT_TRUE(table.find(4).empty());
+}
@@ -0,0 +1,97 @@
+#include "gtest/gtest.h"
+
+#include "joiner.h"
+#include "operators.h"
+#include "reference_joiner.h"
+#include "thread_pool.h"
+#include "utils/test_utils.h"
+
+TEST(HashIndex, ExpectedKeys) {
+  std::vector<uint64_t> column;
+  for (uint64_t i = 0; i < 10000; ++i)
+    column.push_back(i % 100);
+  HashTable sized, undersized;
+  sized.build(column.data(), nullptr, column.size(), 100);
+  // Too few expected keys, the table grows to hold all of them
+  undersized.build(column.data(), nullptr, column.size(), 10);
+  ASSERT_LT(sized.memory(), undersized.memory());
+  for (auto *table : {&sized, &undersized}) {
+    ASSERT_EQ(table->num_keys(), 100u);
+    ASSERT_EQ(table->find(42).size(), 100u);
+    ASSERT_EQ(*table->find(42).begin(), 42u);
+    ASSERT_TRUE(table->find(100).empty());
+  }
+}
+
+TEST(HashIndex, IndexJoin) {
+  // r0.0 is a key, r1.1 references it
+  uint64_t size = 20000;
+  std::vector<uint64_t *> keys{new uint64_t[size], new uint64_t[size]};
+  std::vector<uint64_t *> references{new uint64_t[size], new uint64_t[size]};
+  for (uint64_t i = 0; i < size; ++i) {
+    keys[0][i] = i * 7 % size;
+    keys[1][i] = i;
+    references[0][i] = i;
+    references[1][i] = i % 1000;
+  }
+  Relation r0(size, std::move(keys)), r1(size, std::move(references));
+  r0.buildHashIndex(0);
+
+  PredicateInfo p_info(SelectInfo(0, 0, 0), SelectInfo(1, 1, 1));
+  std::vector<SelectInfo> selections{SelectInfo(0, 0, 1), SelectInfo(1, 1, 0)};
+  for (bool pipelined : {false, true}) {
+    auto join = std::make_unique<IndexJoin>(
+        std::make_unique<FilterScan>(
+            r1, std::vector<FilterInfo>{FilterInfo(
+                SelectInfo(1, 1, 0), 5000, FilterInfo::Comparison::Less)}),
+        r0, *r0.hashIndex(0), p_info);
+    Checksum checksum(std::move(join), selections, pipelined);
+    checksum.run();
+    ASSERT_EQ(checksum.result_size(), 5000u);
+    uint64_t expected_keys = 0, expected_references = 0;
+    for (uint64_t i = 0; i < 5000; ++i) {
+      // The row of key i % 1000 is the one with i * 7 % size == i % 1000
+      for (uint64_t row = 0; row < size; ++row) {
+        if (r0.columns()[0][row] == i % 1000) {
+          expected_keys += row;
+          break;
+        }
+      }
+      expected_references += i;
+    }
+    ASSERT_EQ(checksum.check_sums()[0], expected_keys);
+    ASSERT_EQ(checksum.check_sums()[1], expected_references);
+  }
+}
+
+TEST(HashIndex, Joiner) {
+  // Column 0 is a key that the other columns reference with repeated
+  // values, joins between those are many-to-many and miss some tuples
+  Joiner joiner;
+  for (unsigned i = 0; i < 4; i++) {
+    uint64_t size = i < 3 ? 4000 : 300;
+    auto relation = TestUtils::createRelation(size, i, i < 3 ? 3 : 2);
+    for (uint64_t t = 0; t < size; ++t)
+      relation.columns()[0][t] = t * 7919 % size;
+    joiner.addRelation(std::move(relation));
+  }
+  joiner.buildStatistics();
+  std::vector<std::string> queries{
+      "0 1|0.0=1.1|1.2",
+      "0 3|0.1=1.0|0.0 1.1",
+      "0 1 2|0.0=1.1&1.2=2.0&1.1<30|1.0 2.2",
+      "0 1 2|0.1=1.1&1.2=2.0&2.2=0.1&0.2>100|1.0",
+      "3 0 1|0.1=1.1&1.0=2.0&0.0=5|2.0 0.0",
+      "3 0 1|0.0=1.2&0.1=2.2&0.1<50|1.0 2.1",
+  };
+  ASSERT_GT(joiner.buildHashIndexes(100), 0u);
+  ReferenceJoiner reference(joiner.relations());
+  ThreadPool::setGlobalThreads(4);
+  for (auto &query : queries) {
+    QueryInfo i(query);
+    auto expected = reference.join(i);
+    ASSERT_EQ(expected.find("NULL"), std::string::npos) << query;
+    ASSERT_EQ(joiner.join(i), expected) << query;
+  }
+  ThreadPool::setGlobalThreads(0);
+}
@@ -0,0 +1,157 @@
+#include "gtest/gtest.h"
+
+#include "intermediate_cache.h"
+#include "joiner.h"
+#include "reference_joiner.h"
+#include "utils/test_utils.h"
+
+namespace {
+
+FilterInfo filter(unsigned col_id, uint64_t constant,
+                  FilterInfo::Comparison comparison) {
+  return FilterInfo(SelectInfo(0, 0, col_id), constant, comparison);
+}
+
+}
+
+TEST(IntermediateCache, Implies) {
+  using C = FilterInfo::Comparison;
+  ASSERT_TRUE(IntermediateCache::implies(filter(0, 10, C::Less),
+                                         filter(0, 20, C::Less)));
+  ASSERT_FALSE(IntermediateCache::implies(filter(0, 20, C::Less),
+                                          filter(0, 10, C::Less)));
+  ASSERT_TRUE(IntermediateCache::implies(filter(0, 30, C::Greater),
+                                         filter(0, 20, C::Greater)));
+  ASSERT_TRUE(IntermediateCache::implies(filter(0, 5, C::Equal),
+                                         filter(0, 6, C::Less)));
+  ASSERT_FALSE(IntermediateCache::implies(filter(0, 6, C::Equal),
+                                          filter(0, 6, C::Less)));
+  ASSERT_FALSE(IntermediateCache::implies(filter(1, 10, C::Less),
+                                          filter(0, 20, C::Less)));
+
+  auto residual = IntermediateCache::residual(
+      {filter(0, 10, C::Less), filter(1, 3, C::Greater)},
+      {filter(0, 20, C::Less)});
+  ASSERT_EQ(residual.size(), 2u);
+  residual = IntermediateCache::residual({filter(0, 10, C::Less)},
+                                         {filter(0, 10, C::Less)});
+  ASSERT_TRUE(residual.empty());
+}
+
+TEST(IntermediateCache, Lookups) {
+  using C = FilterInfo::Comparison;
+  // Room for two selections of 100 row ids
+  auto entry = sizeof(IntermediateCache::Selection) + 100 * sizeof(uint64_t);
+  IntermediateCache cache(2 * entry);
+  std::vector<FilterInfo> residual;
+  ASSERT_EQ(cache.findSelection(0, {filter(0, 100, C::Less)}, residual),
+            nullptr);
+  auto add = [&](unsigned rel_id, uint64_t constant) {
+    IntermediateCache::Selection selection{rel_id,
+                                           {filter(0, constant, C::Less)},
+                                           std::vector<uint64_t>(100)};
+    cache.addSelection(std::move(selection));
+  };
+  add(0, 100);
+  add(1, 100);
+
+  // Exact and subsumed hits, the latter with the residual filter
+  ASSERT_NE(cache.findSelection(0, {filter(0, 100, C::Less)}, residual),
+            nullptr);
+  ASSERT_TRUE(residual.empty());
+  ASSERT_NE(cache.findSelection(0, {filter(0, 50, C::Less)}, residual),
+            nullptr);
+  ASSERT_EQ(residual.size(), 1u);
+  ASSERT_EQ(residual[0].constant, 50u);
+  ASSERT_EQ(cache.findSelection(0, {filter(0, 200, C::Less)}, residual),
+            nullptr);
+
+  // Relation 1 is the least recently used one
+  add(2, 100);
+  ASSERT_EQ(cache.findSelection(1, {filter(0, 100, C::Less)}, residual),
+            nullptr);
+  ASSERT_NE(cache.findSelection(0, {filter(0, 100, C::Less)}, residual),
+            nullptr);
+
+  auto counters = cache.selection_counters();
+  ASSERT_EQ(counters.hits, 2u);
+  ASSERT_EQ(counters.subsumed_hits, 1u);
+  ASSERT_EQ(counters.misses, 3u);
+  ASSERT_EQ(counters.insertions, 3u);
+  ASSERT_EQ(counters.evictions, 1u);
+  ASSERT_LE(cache.memory(), cache.budget());
+}
+
+TEST(IntermediateCache, Admission) {
+  using C = FilterInfo::Comparison;
+  IntermediateCache cache(1 << 20);
+  // Only keys that missed before are admitted, selections and tables apart
+  ASSERT_FALSE(cache.admit(0, IntermediateCache::kSelection,
+                           {filter(0, 100, C::Less)}));
+  ASSERT_FALSE(cache.admit(0, 1, {filter(0, 100, C::Less)}));
+  ASSERT_FALSE(cache.admit(0, IntermediateCache::kSelection,
+                           {filter(0, 99, C::Less)}));
+  ASSERT_TRUE(cache.admit(0, IntermediateCache::kSelection,
+                          {filter(0, 100, C::Less)}));
+  ASSERT_TRUE(cache.admit(0, 1, {filter(0, 100, C::Less)}));
+  // The oldest misses are forgotten
+  for (unsigned i = 0; i < IntermediateCache::kMissHistory; ++i)
+    cache.admit(1, i, {});
+  ASSERT_FALSE(cache.admit(0, IntermediateCache::kSelection,
+                           {filter(0, 99, C::Less)}));
+}
+
+TEST(IntermediateCache, Joiner) {
+  // Joins with repeated keys, filters that select some of the tuples
+  Joiner joiner;
+  for (unsigned i = 0; i < 3; i++)
+    joiner.addRelation(TestUtils::createRelation(3000, i));
+  joiner.buildStatistics();
+  ASSERT_GT(joiner.enableCache(), 0u);
+  ReferenceJoiner reference(joiner.relations());
+  auto run = [&](const std::string &query) {
+    QueryInfo i(query);
+    auto expected = reference.join(i);
+    EXPECT_EQ(joiner.join(i), expected) << query;
+    return expected;
+  };
+  auto insertions = [&] {
+    return joiner.cache()->selection_counters().insertions
+        + joiner.cache()->table_counters().insertions;
+  };
+  auto subsumed_hits = [&] {
+    return joiner.cache()->selection_counters().subsumed_hits
+        + joiner.cache()->table_counters().subsumed_hits;
+  };
+
+  // A scan and build side are cached the second time they are requested
+  auto weak = run("0 1|0.0=1.1&0.2<150|1.2");
+  ASSERT_EQ(insertions(), 0u);
+  run("0 1|0.0=1.1&0.2<150|0.1 1.0");
+  ASSERT_GT(insertions(), 0u);
+  // A stricter filter reads the cached tuples and drops those that fail it
+  auto hits = subsumed_hits();
+  auto strict = run("0 1|0.0=1.1&0.2<100|1.2");
+  ASSERT_NE(strict, weak);
+  ASSERT_GT(subsumed_hits(), hits);
+
+  // Repeated and narrowed filters and build sides
+  std::vector<std::string> queries{
+      "0 1|0.0=1.1&0.2<150&0.1>50|1.2",
+      "0 1 2|0.0=1.1&1.2=2.0&1.1<120|1.0 2.2",
+      "0 1 2|0.0=1.1&1.2=2.0&1.1<60|1.0 2.2",
+      "0 1|0.0=1.1|1.2",
+      "0 0|0.0=1.1&0.2<140|1.2",
+      // Empty selections
+      "0 1|0.0=1.1&0.2=123456789|1.2",
+      "0 1|0.0=1.1&1.2=123456789|1.2",
+  };
+  for (unsigned round = 0; round < 3; ++round) {
+    for (auto &query : queries)
+      run(query);
+  }
+  auto selections = joiner.cache()->selection_counters();
+  auto tables = joiner.cache()->table_counters();
+  ASSERT_GT(selections.hits + tables.hits, 0u);
+  ASSERT_GT(selections.misses + tables.misses, 0u);
+}
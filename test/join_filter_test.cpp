@@ -0,0 +1,105 @@
+#include "gtest/gtest.h"
+
+#include "join_filter.h"
+#include "joiner.h"
+#include "operators.h"
+#include "reference_joiner.h"
+#include "utils.h"
+#include "utils/test_utils.h"
+
+TEST(JoinFilter, Lookups) {
+  std::vector<uint64_t> keys;
+  for (uint64_t i = 1000; i < 3000; i += 2)
+    keys.push_back(i);
+  JoinFilter filter;
+  filter.build(keys.data(), keys.size());
+  for (auto key : keys)
+    ASSERT_TRUE(filter.mayContain(key));
+  // Out of the keys' range
+  ASSERT_FALSE(filter.mayContain(999));
+  ASSERT_FALSE(filter.mayContain(3000));
+  uint64_t false_positives = 0;
+  for (uint64_t i = 1001; i < 3000; i += 2)
+    false_positives += filter.mayContain(i);
+  ASSERT_LT(false_positives, keys.size() / 20);
+
+  JoinFilter empty;
+  empty.build(nullptr, 0);
+  ASSERT_FALSE(empty.mayContain(0));
+  ASSERT_FALSE(empty.mayContain(42));
+}
+
+TEST(JoinFilter, Join) {
+  // r0.0 = r1.1 = r2.0 matches 1 in 100 tuples of r1
+  uint64_t size = 100000;
+  auto r0 = Utils::createRelation(size, 2);
+  auto r1 = Utils::createRelation(size, 2);
+  auto r2 = Utils::createRelation(size, 2);
+  std::vector<SelectInfo> selections{SelectInfo(0, 0, 1), SelectInfo(1, 1, 0),
+                                     SelectInfo(2, 2, 1)};
+  auto plan = [&](bool join_filters) {
+    // r0 (filtered) is the build side of the upper join, the probe side
+    // joins r1 with r2
+    auto lower = std::make_unique<Join>(
+        std::make_unique<Scan>(r2, 2), std::make_unique<Scan>(r1, 1),
+        PredicateInfo(SelectInfo(2, 2, 0), SelectInfo(1, 1, 1)),
+        Join::BuildSide::Left);
+    lower->setJoinFilter(join_filters);
+    auto upper = std::make_unique<Join>(
+        std::make_unique<FilterScan>(
+            r0, std::vector<FilterInfo>{FilterInfo(
+                SelectInfo(0, 0, 0), size / 100,
+                FilterInfo::Comparison::Less)}),
+        std::move(lower),
+        PredicateInfo(SelectInfo(0, 0, 0), SelectInfo(1, 1, 1)),
+        Join::BuildSide::Left);
+    upper->setJoinFilter(join_filters);
+    return upper;
+  };
+  for (bool pipelined : {false, true}) {
+    auto expected_plan = plan(false);
+    Checksum expected(std::move(expected_plan), selections, pipelined);
+    expected.run();
+    ASSERT_EQ(expected.result_size(), size / 100);
+
+    auto filtered_plan = plan(true);
+    auto &join = *filtered_plan;
+    Checksum checksum(std::move(filtered_plan), selections, pipelined);
+    checksum.run();
+    ASSERT_EQ(checksum.result_size(), expected.result_size());
+    ASSERT_EQ(checksum.check_sums(), expected.check_sums());
+    // The filter on r0's keys reached the scan of r1
+    ASSERT_NE(join.joinFilter(), nullptr);
+    auto counters = join.joinFilter()->counters();
+    ASSERT_EQ(counters.tested, size);
+    ASSERT_GE(counters.eliminated, size * 9 / 10);
+  }
+}
+
+TEST(JoinFilter, Joiner) {
+  // The join columns of the relations share only some of their values:
+  // r0.0 holds 0..99, r1.1 the even values of 0..199, r2.0 the multiples of
+  // 5 below 100, thus probe tuples without partner exist without filters
+  Joiner joiner;
+  for (unsigned i = 0; i < 3; i++)
+    joiner.addRelation(TestUtils::createRelation(3000, i));
+  joiner.buildStatistics();
+  ReferenceJoiner reference(joiner.relations());
+  std::vector<std::string> queries{
+      "0 1|0.0=1.1|1.2",
+      "0 1|0.0=1.1&0.2<50|1.2",
+      "0 1 2|0.0=1.1&1.2=2.0&0.1<30|1.0 2.2",
+      "0 1 2|0.0=1.1&0.0=2.0&2.2>200|1.0 0.2",
+      "0 1|0.0=1.1&0.1=1.2&0.2<50|1.2",
+  };
+  for (bool pipelined : {false, true}) {
+    joiner.setPipelined(pipelined);
+    for (auto &query : queries) {
+      QueryInfo i(query);
+      auto before = JoinFilter::totals();
+      ASSERT_EQ(joiner.join(i), reference.join(i)) << query;
+      // Every query has probe tuples whose keys the build side lacks
+      ASSERT_GT(JoinFilter::totals().eliminated, before.eliminated) << query;
+    }
+  }
+}
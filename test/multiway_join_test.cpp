@@ -0,0 +1,107 @@
+#include "gtest/gtest.h"
+
+#include "joiner.h"
+#include "operators.h"
+#include "thread_pool.h"
+#include "utils.h"
+
+TEST(MultiwayJoin, CompositeKey) {
+  // r0.0 = r1.1 and r0.1 = r1.2 on few distinct values per column, so that
+  // most tuples match the first predicate only
+  uint64_t size = 3000;
+  auto r0 = Utils::createRelation(size, 3);
+  auto r1 = Utils::createRelation(size, 3);
+  for (uint64_t t = 0; t < size; ++t) {
+    r0.columns()[0][t] = t % 20;
+    r0.columns()[1][t] = t % 7;
+    r1.columns()[1][t] = (t * 3) % 20;
+    r1.columns()[2][t] = (t * 5) % 7;
+  }
+  uint64_t expected_size = 0, expected_sum = 0;
+  for (uint64_t l = 0; l < size; ++l) {
+    for (uint64_t r = 0; r < size; ++r) {
+      if (r0.columns()[0][l] == r1.columns()[1][r]
+          && r0.columns()[1][l] == r1.columns()[2][r]) {
+        ++expected_size;
+        expected_sum += r0.columns()[2][l] + r1.columns()[0][r];
+      }
+    }
+  }
+  ASSERT_GT(expected_size, 0u);
+
+  PredicateInfo first(SelectInfo(0, 0, 0), SelectInfo(1, 1, 1));
+  PredicateInfo second(SelectInfo(0, 0, 1), SelectInfo(1, 1, 2));
+  std::vector<SelectInfo> selections{SelectInfo(0, 0, 2), SelectInfo(1, 1, 0)};
+  auto check = [&](std::unique_ptr<Join> join, bool pipelined) {
+    join->addKey(second);
+    Checksum checksum(std::move(join), selections, pipelined);
+    checksum.run();
+    ASSERT_EQ(checksum.result_size(), expected_size);
+    ASSERT_EQ(checksum.check_sums()[0] + checksum.check_sums()[1],
+              expected_sum);
+  };
+  for (bool pipelined : {false, true}) {
+    for (auto build_side : {Join::BuildSide::Left, Join::BuildSide::Right}) {
+      check(std::make_unique<Join>(std::make_unique<Scan>(r0, 0),
+                                   std::make_unique<Scan>(r1, 1), first,
+                                   build_side),
+            pipelined);
+    }
+    check(std::make_unique<RadixJoin>(std::make_unique<Scan>(r0, 0),
+                                      std::make_unique<Scan>(r1, 1), first,
+                                      4),
+          pipelined);
+  }
+}
+
+TEST(MultiwayJoin, Joiner) {
+  Joiner joiner;
+  // Few distinct keys, so that the binary joins multiply their inputs
+  for (unsigned i = 0; i < 4; i++) {
+    auto relation = Utils::createRelation(5000, 3);
+    for (unsigned c = 0; c < 3; ++c) {
+      for (uint64_t t = 0; t < relation.size(); ++t)
+        relation.columns()[c][t] = (t * (2 * c + i + 3)) % (100 * (c + 1));
+    }
+    joiner.addRelation(std::move(relation));
+  }
+  joiner.buildStatistics();
+  std::vector<std::string> queries{
+      // Triangle, 4-cycle, a cycle through a self join, a cycle with
+      // parallel predicates and a variable with three columns in one input
+      "0 1 2|0.0=1.1&1.2=2.0&2.1=0.2|0.0 2.2",
+      "0 1 2 3|0.0=1.1&1.2=2.0&2.1=3.0&3.1=0.1&3.2<50|1.0 3.2",
+      "0 1 1|0.0=1.1&1.2=2.0&2.1=0.2&0.1<30|2.0",
+      "0 1 2|0.0=1.1&0.1=1.2&1.0=2.1&2.0=0.2|1.0",
+      "0 1 2|0.0=1.1&1.1=2.0&2.0=0.0&0.0=0.1|0.2 1.2",
+  };
+  // Several threads sort the inputs in partitions
+  ThreadPool::setGlobalThreads(4);
+  for (bool pipelined : {false, true}) {
+    for (auto &query : queries) {
+      QueryInfo i(query);
+      auto plan = joiner.plan(i);
+      Checksum expected(joiner.addPlan(*plan, i), i.selections(), pipelined);
+      expected.run();
+
+      Checksum checksum(joiner.addMultiwayJoin(*plan, i), i.selections(),
+                        pipelined);
+      checksum.run();
+      ASSERT_EQ(checksum.result_size(), expected.result_size()) << query;
+      ASSERT_EQ(checksum.check_sums(), expected.check_sums()) << query;
+    }
+  }
+  ThreadPool::setGlobalThreads(0);
+
+  // Acyclic queries are joined with binary joins
+  QueryInfo chain("0 1 2|0.0=1.1&1.2=2.0|0.0");
+  ASSERT_FALSE(joiner.joinsMultiway(*joiner.plan(chain), chain));
+
+  // Multiway joins on and off
+  QueryInfo cycle(queries[0]);
+  ASSERT_TRUE(joiner.joinsMultiway(*joiner.plan(cycle), cycle));
+  auto expected = joiner.join(cycle);
+  joiner.setMultiwayJoins(false);
+  ASSERT_FALSE(joiner.joinsMultiway(*joiner.plan(cycle), cycle));
+  ASSERT_EQ(joiner.join(cycle), expected);
+}
@@ -2,6 +2,7 @@
 
 #include "joiner.h"
 #include "operators.h"
+#include "thread_pool.h"
 #include "utils.h"
 
 namespace {
@@ -132,6 +133,63 @@ TEST_F(OperatorTest, Join) {
   }
 }
 
+TEST_F(OperatorTest, RowIds) {
+  unsigned r1_bind = 0, r2_bind = 1;
+  FilterInfo f_info(SelectInfo(0, r2_bind, 0), 6,
+                    FilterInfo::Comparison::Greater);
+  PredicateInfo p_info(SelectInfo(0, r1_bind, 1), SelectInfo(1, r2_bind, 2));
+  Join join(std::make_unique<Scan>(r1, r1_bind),
+            std::make_unique<FilterScan>(r2, f_info),
+            p_info);
+  join.require(SelectInfo(r2_bind, 4));
+  join.run();
+
+  // Only the required binding is passed on, as row ids into r2
+  ASSERT_EQ(join.result_size(), 0u);
+  ASSERT_EQ(join.getRowIds().size(), 1u);
+  ASSERT_EQ(join.getRowIds()[0].binding, r2_bind);
+  ASSERT_EQ(join.getRowIds()[0].relation, &r2);
+
+  FilterInfo f_info2(SelectInfo(0, r2_bind, 0), 2,
+                     FilterInfo::Comparison::Greater);
+  FilterScan filter_scan(r2, f_info2);
+  filter_scan.run();
+  auto &row_ids = filter_scan.rowIds(r2_bind);
+  ASSERT_EQ(filter_scan.result_size(), 7u);
+  for (unsigned j = 0; j < filter_scan.result_size(); ++j) {
+    ASSERT_EQ(row_ids.rowId(j), j + 3);
+    ASSERT_EQ(row_ids.value(4, j), r2.columns()[4][j + 3]);
+  }
+}
+
+TEST_F(OperatorTest, RadixJoin) {
+  Relation big = Utils::createRelation(1000, 2);
+  unsigned l_bind = 0, r_bind = 1;
+  PredicateInfo p_info(SelectInfo(0, l_bind, 0), SelectInfo(1, r_bind, 1));
+
+  // One pass (4 bits) and two passes (8 + 2 bits)
+  for (unsigned bits : {4u, 10u}) {
+    RadixJoin join(std::make_unique<Scan>(big, l_bind),
+                   std::make_unique<Scan>(r2, r_bind),
+                   p_info, bits);
+    join.require(SelectInfo(l_bind, 1));
+    join.require(SelectInfo(r_bind, 3));
+    join.run();
+
+    ASSERT_EQ(join.result_size(), r2.size());
+    auto results = join.getResults();
+    auto left_col = results[join.resolve(SelectInfo(l_bind, 1))];
+    auto right_col = results[join.resolve(SelectInfo(r_bind, 3))];
+    uint64_t left_sum = 0, right_sum = 0;
+    for (unsigned j = 0; j < join.result_size(); ++j) {
+      ASSERT_EQ(left_col[j], right_col[j]);
+      left_sum += left_col[j];
+      right_sum += r2.columns()[3][j];
+    }
+    ASSERT_EQ(left_sum, right_sum);
+  }
+}
+
 TEST_F(OperatorTest, Checksum) {
   unsigned rel_binding = 5;
   Scan r1_scan(r1, rel_binding);
@@ -289,4 +347,80 @@ TEST_F(OperatorTest, Joiner) {
   }
 }
 
+TEST_F(OperatorTest, ParallelJoiner) {
+  // Large enough for many morsels and a partitioned hash table build
+  Joiner joiner;
+  unsigned num_tuples = 50000;
+  for (unsigned i = 0; i < 3; i++) {
+    joiner.addRelation(Utils::createRelation(num_tuples, 3));
+  }
+  std::vector<std::string> queries{
+      "0 1|0.0=1.1|1.2",
+      "0 1 2|0.0=1.1&1.2=2.0&1.1<30000|1.0 2.2",
+      "0 1 2|0.0=1.1&1.1=2.0&2.2=0.1&0.2>100|1.0",
+  };
+
+  std::vector<std::string> expected;
+  ThreadPool::setGlobalThreads(1);
+  for (auto &query : queries) {
+    QueryInfo i(query);
+    expected.push_back(joiner.join(i));
+  }
+  ThreadPool::setGlobalThreads(4);
+  for (unsigned q = 0; q < queries.size(); ++q) {
+    QueryInfo i(queries[q]);
+    ASSERT_EQ(joiner.join(i), expected[q]);
+  }
+  {
+    RadixJoin join(std::make_unique<Scan>(joiner.relations()[0], 0),
+                   std::make_unique<Scan>(joiner.relations()[1], 1),
+                   PredicateInfo(SelectInfo(0, 0, 0), SelectInfo(1, 1, 2)),
+                   10);
+    join.require(SelectInfo(0, 1));
+    join.run();
+    ASSERT_EQ(join.result_size(), num_tuples);
+  }
+  ThreadPool::setGlobalThreads(0);
+}
+
+TEST_F(OperatorTest, PipelinedJoiner) {
+  Joiner joiner;
+  unsigned num_tuples = 20000;
+  for (unsigned i = 0; i < 3; i++) {
+    joiner.addRelation(Utils::createRelation(num_tuples, 3));
+  }
+  std::vector<std::string> queries{
+      "0 1|0.0=1.1|1.2",
+      "0 1 2|0.0=1.1&1.2=2.0&1.1<3000|1.0 2.2",
+      "0 1 2|1.2=2.0&0.0=1.1&1.1<3000|0.1 2.2",
+      "0 1 2|0.0=1.1&1.1=2.0&2.2=0.1&0.2>100|1.0",
+      "0 1|0.0=1.1&0.0>30000|1.0",
+  };
+
+  ThreadPool::setGlobalThreads(4);
+  for (auto &query : queries) {
+    QueryInfo i(query);
+    joiner.setPipelined(false);
+    auto expected = joiner.join(i);
+    joiner.setPipelined(true);
+    ASSERT_EQ(joiner.join(i), expected) << query;
+  }
+  ThreadPool::setGlobalThreads(0);
+
+  // A pipelined Checksum on a join that streams its larger input
+  auto join = std::make_unique<Join>(
+      std::make_unique<Scan>(r1, 0), std::make_unique<Scan>(r2, 1),
+      PredicateInfo(SelectInfo(0, 0, 0), SelectInfo(1, 1, 0)),
+      Join::BuildSide::Left);
+  Checksum checksum(std::move(join),
+                    {SelectInfo(0, 0, 1), SelectInfo(1, 1, 4)}, true);
+  checksum.run();
+  ASSERT_EQ(checksum.result_size(), r1.size());
+  uint64_t expected_sum = 0;
+  for (unsigned i = 0; i < r1.size(); ++i)
+    expected_sum += r1.columns()[1][i];
+  ASSERT_EQ(checksum.check_sums()[0], expected_sum);
+  ASSERT_EQ(checksum.check_sums()[1], expected_sum);
+}
+
 }
@@ -0,0 +1,66 @@
+#include "gtest/gtest.h"
+
+#include "planner.h"
+#include "utils.h"
+
+namespace {
+
+// The number of predicates in a plan
+unsigned countPredicates(const PlanNode &node) {
+  unsigned count = node.predicates.size();
+  if (!node.isLeaf())
+    count += countPredicates(*node.left) + countPredicates(*node.right);
+  return count;
+}
+
+class PlannerTest : public testing::Test {
+ protected:
+  std::vector<Relation> relations;
+
+  void SetUp() override {
+    relations.push_back(Utils::createRelation(1000, 2));
+    relations.push_back(Utils::createRelation(1000, 2));
+    relations.push_back(Utils::createRelation(100, 2));
+  }
+};
+
+}
+
+TEST_F(PlannerTest, BuildOnSmallerInput) {
+  QueryInfo query("0 2|0.0=1.0|0.1");
+  Planner planner(relations, query);
+  auto plan = planner.plan();
+  ASSERT_FALSE(plan->isLeaf());
+  ASSERT_EQ(plan->left->binding, 1u);
+  ASSERT_EQ(plan->right->binding, 0u);
+  ASSERT_EQ(plan->predicates.size(), 1u);
+  // Oriented from build to probe side
+  ASSERT_EQ(plan->predicates[0].left.binding, 1u);
+  ASSERT_NEAR(plan->cardinality, 100, 1);
+}
+
+TEST_F(PlannerTest, FilteredRelationJoinsFirst) {
+  // Left-deep in predicate order would join 0 and 1 first
+  QueryInfo query("0 1 0|0.0=1.0&1.1=2.1&2.0<10|0.1");
+  for (unsigned max_dp_bindings : {Planner::kMaxDPBindings, 0u}) {
+    Planner planner(relations, query, nullptr, max_dp_bindings);
+    auto plan = planner.plan();
+    ASSERT_EQ(plan->bindings, 7u);
+    ASSERT_EQ(plan->left->bindings, 6u);
+    ASSERT_EQ(plan->right->binding, 0u);
+    ASSERT_NEAR(plan->left->left->cardinality, 10, 1);
+  }
+}
+
+TEST_F(PlannerTest, Cycle) {
+  QueryInfo query("0 1 2|0.0=1.0&1.1=2.1&2.0=0.1&0.0=0.1|0.1");
+  for (unsigned max_dp_bindings : {Planner::kMaxDPBindings, 0u}) {
+    Planner planner(relations, query, nullptr, max_dp_bindings);
+    auto plan = planner.plan();
+    ASSERT_EQ(plan->bindings, 7u);
+    // The join closing the cycle applies two predicates, the one on a
+    // single relation is applied on top of its scan
+    ASSERT_EQ(plan->predicates.size(), 2u);
+    ASSERT_EQ(countPredicates(*plan), 4u);
+  }
+}
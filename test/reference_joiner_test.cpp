@@ -0,0 +1,47 @@
+#include "gtest/gtest.h"
+
+#include "reference_joiner.h"
+#include "utils.h"
+
+TEST(ReferenceJoiner, Join) {
+  // r0.0 = r1.1 with repeated keys, r1.2 = r2.0 with misses
+  std::vector<Relation> relations;
+  relations.push_back(Utils::createRelation(60, 2));
+  relations.push_back(Utils::createRelation(80, 3));
+  relations.push_back(Utils::createRelation(40, 2));
+  for (uint64_t t = 0; t < 60; ++t)
+    relations[0].columns()[0][t] = t % 12;
+  for (uint64_t t = 0; t < 80; ++t) {
+    relations[1].columns()[1][t] = t % 15;
+    relations[1].columns()[2][t] = t % 50;
+  }
+  ReferenceJoiner reference(relations);
+
+  // The result of a nested-loop join
+  auto r0 = relations[0].columns(), r1 = relations[1].columns(),
+      r2 = relations[2].columns();
+  uint64_t size = 0, sum0 = 0, sum2 = 0;
+  for (uint64_t a = 0; a < 60; ++a) {
+    for (uint64_t b = 0; b < 80; ++b) {
+      for (uint64_t c = 0; c < 40; ++c) {
+        if (r0[0][a] == r1[1][b] && r1[2][b] == r2[0][c] && r0[1][a] > 10) {
+          ++size;
+          sum0 += r0[1][a];
+          sum2 += r2[1][c];
+        }
+      }
+    }
+  }
+  ASSERT_GT(size, 0u);
+  // The bindings in any order, the filter on either side
+  ASSERT_EQ(reference.join(QueryInfo("0 1 2|0.0=1.1&1.2=2.0&0.1>10|0.1 2.1")),
+            std::to_string(sum0) + " " + std::to_string(sum2) + "\n");
+  ASSERT_EQ(reference.join(QueryInfo("2 0 1|2.1=1.0&0.0=2.2&1.1>10|1.1 0.1")),
+            std::to_string(sum0) + " " + std::to_string(sum2) + "\n");
+  // A self join with a predicate within a binding (t % 15 = t % 50 holds
+  // for t < 15), and an empty result
+  ASSERT_EQ(reference.join(QueryInfo("1 1|0.0=1.0&0.1=0.2|0.0")),
+            std::to_string(14 * 15 / 2) + "\n");
+  ASSERT_EQ(reference.join(QueryInfo("0 2|0.0=1.0&1.1>100|0.0 1.1")),
+            "NULL NULL\n");
+}
@@ -1,7 +1,10 @@
 #include <fstream>
+#include <stdexcept>
+#include <unistd.h>
 
 #include "gtest/gtest.h"
 
+#include "joiner.h"
 #include "relation.h"
 #include "utils.h"
 
@@ -71,3 +74,129 @@ TEST(Relation, CreateSQL) {
   ASSERT_FALSE(std::getline(infile, line));
 }
 
+
+TEST(Relation, LoadOptions) {
+  Relation r1 = Utils::createRelation(100000, 3);
+  r1.storeRelation("r1");
+
+  LoadOptions lazy, huge_pages;
+  lazy.prefault = false;
+  huge_pages.huge_pages = true;
+  huge_pages.huge_page_min_bytes = 0;
+  for (auto &options : {lazy, huge_pages, LoadOptions()}) {
+    Relation r2("r1", options);
+    ASSERT_RELATION_EQ(r1, r2);
+  }
+}
+
+TEST(Relation, InvalidHeader) {
+  Relation r1 = Utils::createRelation(1000, 2);
+  r1.storeRelation("r1");
+  // Truncate the last tuple
+  truncate("r1", 2 * sizeof(uint64_t) + (2 * 1000 - 1) * sizeof(uint64_t));
+  ASSERT_THROW(Relation("r1"), std::runtime_error);
+  truncate("r1", 8);
+  ASSERT_THROW(Relation("r1"), std::runtime_error);
+  // No tuples, with few and with countless columns
+  for (uint64_t num_columns : {2ull, 1ull << 40}) {
+    {
+      std::ofstream out("r1", std::ios::binary | std::ios::trunc);
+      uint64_t header[2]{0, num_columns};
+      out.write(reinterpret_cast<const char *>(header), sizeof(header));
+    }
+    if (num_columns > Relation::kMaxColumns) {
+      ASSERT_THROW(Relation("r1"), std::runtime_error);
+    } else {
+      Relation empty("r1");
+      ASSERT_EQ(empty.size(), 0u);
+      ASSERT_EQ(empty.columns().size(), num_columns);
+    }
+  }
+  ASSERT_THROW(Relation("does_not_exist"), std::runtime_error);
+}
+
+TEST(Relation, ParallelLoad) {
+  std::vector<std::string> files;
+  for (unsigned i = 0; i < 4; ++i) {
+    auto relation = Utils::createRelation(1000 * (i + 1), 2);
+    files.push_back("r" + std::to_string(i));
+    relation.storeRelation(files.back());
+  }
+  Joiner joiner;
+  auto report = joiner.addRelations(files);
+  ASSERT_EQ(report.relations, 4u);
+  ASSERT_EQ(report.bytes, (4 * 2 + 10000 * 2) * sizeof(uint64_t));
+  ASSERT_GT(report.prefaulted_pages, 0u);
+  // The relations keep the order of the files
+  for (unsigned i = 0; i < 4; ++i)
+    ASSERT_EQ(joiner.getRelation(i).size(), 1000 * (i + 1));
+}
+
+TEST(Relation, ColumnarFormat) {
+  uint64_t size = 3 * ZoneMap::kBlockSize + 17;
+  std::vector<uint64_t *> columns{new uint64_t[size], new uint64_t[size]};
+  for (uint64_t i = 0; i < size; ++i) {
+    columns[0][i] = (i * 7919) % 1000;
+    columns[1][i] = i << 20;
+  }
+  Relation r1(size, std::move(columns));
+  r1.buildSortedIndex(0);
+  ASSERT_TRUE(r1.compressColumn(0, 0, 999, 1000));
+
+  LoadOptions huge_pages;
+  huge_pages.huge_pages = true;
+  huge_pages.huge_page_min_bytes = 0;
+  for (uint64_t alignment : {Relation::kPageSize, uint64_t(1) << 21}) {
+    r1.storeRelationV2("r1.v2", alignment);
+    for (auto &options : {LoadOptions(), huge_pages}) {
+      Relation r2("r1.v2", options);
+      ASSERT_RELATION_EQ(r1, r2);
+      if (!options.huge_pages) {
+        for (auto column : r2.columns())
+          ASSERT_EQ(reinterpret_cast<uintptr_t>(column) % alignment, 0u);
+      }
+      // The zone maps, the index and the compressed column are loaded
+      ASSERT_EQ(r2.zoneMap(1).zone(2).min, r1.zoneMap(1).zone(2).min);
+      ASSERT_EQ(r2.zoneMap(0).num_blocks(), 4u);
+      ASSERT_EQ(r2.sortedIndex(1), nullptr);
+      ASSERT_EQ(r2.sortedIndex(0)->range(10, 20),
+                r1.sortedIndex(0)->range(10, 20));
+      ASSERT_EQ(memcmp(r2.sortedIndex(0)->row_ids(),
+                       r1.sortedIndex(0)->row_ids(), size * sizeof(uint64_t)),
+                0);
+      ASSERT_EQ(r2.compressedColumn(1), nullptr);
+      for (uint64_t i = 0; i < size; i += 101)
+        ASSERT_EQ(r2.compressedColumn(0)->value(i), r1.columns()[0][i]);
+    }
+  }
+
+  // A file cut off in its footer
+  truncate("r1.v2", 5 * Relation::kPageSize);
+  ASSERT_THROW(Relation("r1.v2"), std::runtime_error);
+
+  // Overwrite a word of the file at a byte offset
+  auto corrupt = [](uint64_t offset, uint64_t word) {
+    std::fstream file("r1.v2", std::ios::in | std::ios::out | std::ios::binary);
+    file.seekp(offset);
+    file.write(reinterpret_cast<const char *>(&word), sizeof(word));
+  };
+  auto read = [](uint64_t offset) {
+    std::ifstream file("r1.v2", std::ios::binary);
+    file.seekg(offset);
+    uint64_t word = 0;
+    file.read(reinterpret_cast<char *>(&word), sizeof(word));
+    return word;
+  };
+  // More columns than the footer describes
+  r1.storeRelationV2("r1.v2");
+  corrupt(3 * sizeof(uint64_t), uint64_t(1) << 60);
+  ASSERT_THROW(Relation("r1.v2"), std::runtime_error);
+  // A row id of the sorted index beyond the relation: the footer of column
+  // 0 holds its offset, its zone map (the number of blocks and two words per
+  // block) and then the offset of its index
+  r1.storeRelationV2("r1.v2");
+  auto footer = read(5 * sizeof(uint64_t));
+  auto index_offset = read(footer + (2 + 2 * 4) * sizeof(uint64_t));
+  corrupt(index_offset + 7 * sizeof(uint64_t), size);
+  ASSERT_THROW(Relation("r1.v2"), std::runtime_error);
+}
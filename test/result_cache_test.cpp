@@ -0,0 +1,97 @@
+#include "gtest/gtest.h"
+
+#include "batch_executor.h"
+#include "joiner.h"
+#include "reference_joiner.h"
+#include "result_cache.h"
+#include "utils/test_utils.h"
+
+TEST(ResultCache, Key) {
+  auto key = [](const std::string &query) {
+    return ResultCache::key(QueryInfo(query));
+  };
+  // Permuted relations, predicates and filters, swapped predicate sides
+  ASSERT_EQ(key("0 1 2|0.0=1.1&1.2=2.0&1.1<3000|1.0 2.2"),
+            key("2 0 1|0.0=2.2&1.0=2.1&2.1<3000|2.0 0.2"));
+  ASSERT_EQ(key("0 1|0.0=1.1&0.2>5|1.2"), key("0 1|1.1=0.0&0.2>5&0.2>5|1.2"));
+  // The canonical form is a query in the text format
+  auto canonical = key("2 0 1|0.0=2.2&1.0=2.1&2.1<3000|2.0 0.2");
+  ASSERT_EQ(key(canonical), canonical);
+
+  // Different constants, comparisons, columns and projection orders
+  ASSERT_NE(key("0 1|0.0=1.1&0.2>5|1.2"), key("0 1|0.0=1.1&0.2>6|1.2"));
+  ASSERT_NE(key("0 1|0.0=1.1&0.2>5|1.2"), key("0 1|0.0=1.1&0.2<5|1.2"));
+  ASSERT_NE(key("0 1|0.0=1.1|1.2"), key("0 1|0.0=1.2|1.2"));
+  ASSERT_NE(key("0 1|0.0=1.1|1.2 0.1"), key("0 1|0.0=1.1|0.1 1.2"));
+  // The same relations filtered on different bindings
+  ASSERT_NE(key("0 0|0.0=1.1&0.2>5|0.1"), key("0 0|0.0=1.1&1.2>5|0.1"));
+}
+
+TEST(ResultCache, Lookups) {
+  ResultCache cache(700);
+  std::string result;
+  ASSERT_FALSE(cache.find("a", result));
+  cache.insert("a", std::string(100, '1'));
+  cache.insert("b", std::string(100, '2'));
+  ASSERT_TRUE(cache.find("a", result));
+  ASSERT_EQ(result, std::string(100, '1'));
+
+  // b is the least recently used one
+  cache.insert("c", std::string(300, '3'));
+  ASSERT_FALSE(cache.find("b", result));
+  ASSERT_TRUE(cache.find("a", result));
+  ASSERT_TRUE(cache.find("c", result));
+  // Larger than the limit
+  cache.insert("d", std::string(1000, '4'));
+  ASSERT_FALSE(cache.find("d", result));
+
+  auto counters = cache.counters();
+  ASSERT_EQ(counters.hits, 3u);
+  ASSERT_EQ(counters.misses, 3u);
+  ASSERT_EQ(counters.insertions, 3u);
+  ASSERT_EQ(counters.evictions, 1u);
+  ASSERT_DOUBLE_EQ(counters.hitRate(), 0.5);
+  ASSERT_LE(cache.memory(), cache.limit());
+  cache.clear();
+  ASSERT_EQ(cache.memory(), 0u);
+}
+
+TEST(ResultCache, Joiner) {
+  // Distinct columns with repeated keys, thus queries that differ in a
+  // constant, a column or a selection have different results
+  Joiner joiner;
+  for (unsigned i = 0; i < 3; i++)
+    joiner.addRelation(TestUtils::createRelation(3000, i));
+  joiner.buildStatistics();
+  std::vector<QueryInfo> batch{
+      QueryInfo("0 1|0.0=1.1&0.2<150|1.2"),
+      QueryInfo("0 1 2|0.0=1.1&1.2=2.0&1.1<120|1.0 2.2"),
+      QueryInfo("1 0|1.2<150&0.1=1.0|0.2"),
+      QueryInfo("0 0|0.0=1.1&0.2<140|1.2"),
+      QueryInfo("2 0 1|0.0=2.2&1.0=2.1&2.1<120|2.0 0.2"),
+      // Close to the first query, but not equivalent
+      QueryInfo("0 1|0.0=1.1&0.2<151|1.2"),
+      QueryInfo("0 1|0.1=1.1&0.2<150|1.2"),
+      QueryInfo("0 1|0.0=1.1&0.2<150|1.1"),
+  };
+  ReferenceJoiner reference(joiner.relations());
+  std::vector<std::string> expected;
+  for (auto &query : batch)
+    expected.push_back(reference.join(query));
+  for (unsigned q = 5; q < batch.size(); ++q)
+    ASSERT_NE(expected[q], expected[0]) << q;
+
+  joiner.enableResultCache();
+  BatchExecutor executor(joiner);
+  ASSERT_EQ(executor.run(batch), expected);
+  // The permuted queries are executed once
+  auto counters = joiner.resultCache()->counters();
+  ASSERT_EQ(counters.misses, 6u);
+  ASSERT_EQ(counters.insertions, 6u);
+  ASSERT_EQ(executor.run(batch), expected);
+  for (unsigned q = 0; q < batch.size(); ++q)
+    ASSERT_EQ(joiner.join(batch[q]), expected[q]);
+  counters = joiner.resultCache()->counters();
+  ASSERT_EQ(counters.hits, 6u + batch.size());
+  ASSERT_EQ(counters.misses, 6u);
+}
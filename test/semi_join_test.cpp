@@ -0,0 +1,127 @@
+#include "gtest/gtest.h"
+
+#include "joiner.h"
+#include "operators.h"
+#include "semi_join.h"
+#include "utils.h"
+
+TEST(SemiJoin, Acyclic) {
+  // Chains, stars, parallel predicates and self joins
+  ASSERT_TRUE(
+      SemiJoinReducer::isAcyclic(QueryInfo("0 1 2|0.0=1.1&1.2=2.0|0.0")));
+  ASSERT_TRUE(SemiJoinReducer::isAcyclic(
+      QueryInfo("0 1 2 3|0.0=1.1&0.1=2.0&0.2=3.0|0.0")));
+  ASSERT_TRUE(SemiJoinReducer::isAcyclic(QueryInfo("0 1|0.0=1.1&0.1=1.2|0.0")));
+  ASSERT_TRUE(SemiJoinReducer::isAcyclic(QueryInfo("0 1|0.0=1.1&1.0=1.2|0.0")));
+  // Cycles
+  ASSERT_FALSE(SemiJoinReducer::isAcyclic(
+      QueryInfo("0 1 2|0.0=1.1&1.2=2.0&2.1=0.2|0.0")));
+  ASSERT_FALSE(SemiJoinReducer::isAcyclic(
+      QueryInfo("0 1 2 3|0.0=1.1&1.2=2.0&2.1=3.0&3.1=0.1|0.0")));
+}
+
+TEST(SemiJoin, Reduce) {
+  Joiner joiner;
+  for (unsigned i = 0; i < 3; i++)
+    joiner.addRelation(Utils::createRelation(1000, 2));
+  // r1.1 counts down, so that only r1's tuples 0..9 match both r0.0 < 100
+  // and r2.0 >= 990
+  auto r1 = joiner.getRelation(1).columns()[1];
+  for (uint64_t i = 0; i < 1000; ++i)
+    r1[i] = 999 - i;
+  joiner.buildStatistics();
+
+  QueryInfo query("0 1 2|0.0=1.0&1.1=2.0&0.0<100&2.0>989|0.0");
+  auto reduction = SemiJoinReducer(joiner).reduce(query);
+  ASSERT_EQ(reduction.filtered_tuples, 100u + 1000u + 10u);
+  ASSERT_EQ(reduction.reduced_tuples, 30u);
+  std::vector<uint64_t> first(10), last(10);
+  for (uint64_t i = 0; i < 10; ++i) {
+    first[i] = i;
+    last[i] = 990 + i;
+  }
+  ASSERT_EQ(*reduction.row_ids[0], first);
+  ASSERT_EQ(*reduction.row_ids[1], first);
+  ASSERT_EQ(*reduction.row_ids[2], last);
+
+  // No tuple of r1 matches both filters
+  QueryInfo empty("0 1 2|0.0=1.0&1.1=2.0&0.0<100&2.0<100|0.0");
+  ASSERT_EQ(SemiJoinReducer(joiner).reduce(empty).reduced_tuples, 0u);
+}
+
+TEST(SemiJoin, Pays) {
+  QueryInfo chain("0 1 2|0.0=1.1&1.2=2.0|0.0");
+  auto leaf = [](unsigned binding, double cardinality) {
+    auto node = std::make_unique<PlanNode>();
+    node->bindings = 1ull << binding;
+    node->cardinality = cardinality;
+    node->binding = binding;
+    return node;
+  };
+  auto plan = [&](double intermediate, double result) {
+    auto lower = std::make_unique<PlanNode>();
+    lower->bindings = 3;
+    lower->cardinality = intermediate;
+    lower->left = leaf(0, 100);
+    lower->right = leaf(1, 1000);
+    auto root = std::make_unique<PlanNode>();
+    root->bindings = 7;
+    root->cardinality = result;
+    root->left = leaf(2, 100);
+    root->right = std::move(lower);
+    return root;
+  };
+  // Most of the intermediate result does not reach the result
+  ASSERT_TRUE(SemiJoinReducer::pays(*plan(10000, 10), chain));
+  // The intermediate result is small, or most of it reaches the result
+  ASSERT_FALSE(SemiJoinReducer::pays(*plan(1000, 10), chain));
+  ASSERT_FALSE(SemiJoinReducer::pays(*plan(10000, 9000), chain));
+  // Cyclic queries and two-way joins are not reduced
+  QueryInfo cycle("0 1 2|0.0=1.1&1.2=2.0&2.1=0.2|0.0");
+  ASSERT_FALSE(SemiJoinReducer::pays(*plan(10000, 10), cycle));
+}
+
+TEST(SemiJoin, Joiner) {
+  Joiner joiner;
+  // Few distinct keys, so that the joins multiply their inputs
+  for (unsigned i = 0; i < 4; i++) {
+    auto relation = Utils::createRelation(20000, 3);
+    for (unsigned c = 0; c < 3; ++c) {
+      for (uint64_t t = 0; t < relation.size(); ++t)
+        relation.columns()[c][t] = (t * (2 * c + i + 3)) % (500 * (c + 1));
+    }
+    joiner.addRelation(std::move(relation));
+  }
+  joiner.buildStatistics();
+  std::vector<std::string> queries{
+      "0 1 2 3|0.0=1.1&0.1=2.0&0.2=3.2&3.1<20&2.2>1400|1.0 3.2",
+      "0 1 2 3|0.0=1.0&1.1=2.1&2.2=3.2&3.1<5|1.0",
+      "0 1 2|0.0=1.1&1.2=2.0&0.1<20|1.0 2.2",
+      "0 1 2|0.0=1.1&0.1=1.2&1.0=2.1&2.0<30|0.2",
+      "0 1 1|0.0=1.1&0.1=2.2&1.0=1.2&2.1<50|2.0",
+  };
+  for (bool pipelined : {false, true}) {
+    for (auto &query : queries) {
+      QueryInfo i(query);
+      auto plan = joiner.plan(i);
+      Checksum expected(joiner.addPlan(*plan, i), i.selections(), pipelined);
+      expected.run();
+
+      // The joins on the reduced inputs produce the same result
+      auto reduction = SemiJoinReducer(joiner).reduce(i);
+      ASSERT_LE(reduction.reduced_tuples, reduction.filtered_tuples);
+      Checksum checksum(joiner.addPlan(*plan, i, nullptr, &reduction),
+                        i.selections(), pipelined);
+      checksum.run();
+      ASSERT_EQ(checksum.result_size(), expected.result_size()) << query;
+      ASSERT_EQ(checksum.check_sums(), expected.check_sums()) << query;
+    }
+  }
+
+  // Reduction on and off
+  std::string query = "0 1 2|0.0=1.1&1.2=2.0&2.1<100|1.0";
+  QueryInfo i(query);
+  auto expected = joiner.join(i);
+  joiner.setSemiJoinReduction(false);
+  ASSERT_EQ(joiner.join(i), expected);
+}
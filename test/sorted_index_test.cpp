@@ -0,0 +1,76 @@
+#include <algorithm>
+
+#include "gtest/gtest.h"
+
+#include "operators.h"
+#include "sorted_index.h"
+
+TEST(SortedIndex, Range) {
+  std::vector<uint64_t> column{5, 3, 9, 3, 0, 7, 3};
+  SortedIndex index;
+  index.build(column.data(), column.size());
+  ASSERT_EQ(index.size(), column.size());
+  ASSERT_EQ(index.memory(), column.size() * sizeof(uint64_t));
+
+  auto range = index.range(3, 3);
+  ASSERT_EQ(range.second - range.first, 3u);
+  // Equal values are ordered by row id
+  ASSERT_EQ(index.row_ids()[range.first], 1u);
+  ASSERT_EQ(index.row_ids()[range.first + 2], 6u);
+
+  range = index.range(4, 8);
+  ASSERT_EQ(range.second - range.first, 2u);
+  ASSERT_EQ(index.range(10, 20).second - index.range(10, 20).first, 0u);
+  ASSERT_EQ(index.range(0, UINT64_MAX).second, column.size());
+  ASSERT_EQ(index.range(2, 1).second, 0u);
+}
+
+TEST(SortedIndex, FilterScan) {
+  uint64_t size = 50000;
+  std::vector<uint64_t *> columns{new uint64_t[size], new uint64_t[size]};
+  for (uint64_t i = 0; i < size; ++i) {
+    columns[0][i] = (i * 7919) % size;
+    columns[1][i] = i % 10;
+  }
+  Relation relation(size, std::move(columns));
+
+  using Comparison = FilterInfo::Comparison;
+  std::vector<std::vector<FilterInfo>> queries{
+      {FilterInfo(SelectInfo(0, 0, 0), 4242, Comparison::Equal)},
+      // Merged into the range [100, 199] plus a residual filter
+      {FilterInfo(SelectInfo(0, 0, 0), 99, Comparison::Greater),
+       FilterInfo(SelectInfo(0, 0, 0), 200, Comparison::Less),
+       FilterInfo(SelectInfo(0, 0, 1), 3, Comparison::Equal)},
+      // Not selective enough for the index
+      {FilterInfo(SelectInfo(0, 0, 0), 10000, Comparison::Less)},
+  };
+  // The expected row ids of a plain loop over the columns
+  std::vector<std::vector<uint64_t>> expected(queries.size());
+  for (unsigned q = 0; q < queries.size(); ++q) {
+    for (uint64_t i = 0; i < size; ++i) {
+      bool pass = true;
+      for (auto &filter : queries[q]) {
+        auto value = relation.columns()[filter.filter_column.col_id][i];
+        pass &= filter.comparison == Comparison::Less ? value < filter.constant
+            : filter.comparison == Comparison::Greater
+                ? value > filter.constant
+                : value == filter.constant;
+      }
+      if (pass)
+        expected[q].push_back(i);
+    }
+  }
+
+  relation.buildSortedIndex(0);
+  for (unsigned q = 0; q < queries.size(); ++q) {
+    FilterScan index_scan(relation, queries[q]);
+    index_scan.run();
+    ASSERT_EQ(index_scan.result_size(), expected[q].size());
+    std::vector<uint64_t> row_ids;
+    for (uint64_t i = 0; i < index_scan.result_size(); ++i)
+      row_ids.push_back(index_scan.rowIds(0).rowId(i));
+    // The index produces the row ids in the order of the values
+    std::sort(row_ids.begin(), row_ids.end());
+    ASSERT_EQ(row_ids, expected[q]);
+  }
+}
@@ -0,0 +1,78 @@
+#include <algorithm>
+
+#include "gtest/gtest.h"
+
+#include "statistics.h"
+#include "utils.h"
+
+TEST(Statistics, HyperLogLog) {
+  HyperLogLog sketch, other;
+  ASSERT_NEAR(sketch.estimate(), 0, 0.5);
+  for (uint64_t i = 0; i < 100000; ++i)
+    sketch.add(i * 3);
+  ASSERT_NEAR(sketch.estimate(), 100000, 5000);
+  // Duplicates do not count
+  for (uint64_t i = 0; i < 100000; ++i)
+    sketch.add(i * 3);
+  ASSERT_NEAR(sketch.estimate(), 100000, 5000);
+
+  for (uint64_t i = 0; i < 100; ++i)
+    other.add(i);
+  ASSERT_NEAR(other.estimate(), 100, 5);
+  other.merge(sketch);
+  ASSERT_NEAR(other.estimate(), 100066, 5000);
+}
+
+TEST(Statistics, UniqueColumn) {
+  std::vector<uint64_t> column;
+  for (uint64_t i = 0; i < 10000; ++i)
+    column.push_back(10000 - i);
+  auto stats = ColumnStatistics::compute(column.data(), column.size());
+  ASSERT_EQ(stats.min, 1u);
+  ASSERT_EQ(stats.max, 10000u);
+  ASSERT_TRUE(stats.unique);
+  ASSERT_EQ(stats.distinct, 10000);
+  ASSERT_TRUE(stats.most_common.empty());
+  ASSERT_EQ(stats.bounds.size(), ColumnStatistics::kHistogramBuckets);
+
+  using Comparison = FilterInfo::Comparison;
+  ASSERT_NEAR(stats.selectivity(Comparison::Less, 2501), 0.25, 0.01);
+  ASSERT_NEAR(stats.selectivity(Comparison::Greater, 9000), 0.1, 0.01);
+  ASSERT_NEAR(stats.selectivity(Comparison::Equal, 42), 0.0001, 0.00001);
+  ASSERT_EQ(stats.selectivity(Comparison::Less, 1), 0);
+  ASSERT_EQ(stats.selectivity(Comparison::Greater, 10000), 0);
+  ASSERT_EQ(stats.selectivity(Comparison::Equal, 10001), 0);
+  ASSERT_TRUE(stats.alwaysPasses(Comparison::Less, 10001));
+  ASSERT_FALSE(stats.alwaysPasses(Comparison::Less, 10000));
+  ASSERT_TRUE(stats.alwaysPasses(Comparison::Greater, 0));
+}
+
+TEST(Statistics, SkewedColumn) {
+  // Half of the tuples are 7, the others are distinct
+  std::vector<uint64_t> column;
+  for (uint64_t i = 0; i < 20000; ++i)
+    column.push_back(i % 2 ? 7 : 1000 + i);
+  auto stats = ColumnStatistics::compute(column.data(), column.size());
+  ASSERT_FALSE(stats.unique);
+  ASSERT_NEAR(stats.distinct, 10001, 500);
+  ASSERT_EQ(stats.most_common.size(), 1u);
+  ASSERT_EQ(stats.most_common[0].first, 7u);
+  ASSERT_NEAR(stats.selectivity(FilterInfo::Comparison::Equal, 7), 0.5, 0.01);
+  ASSERT_NEAR(stats.selectivity(FilterInfo::Comparison::Equal, 1002),
+              0.00005, 0.00001);
+  ASSERT_NEAR(stats.selectivity(FilterInfo::Comparison::Less, 1000), 0.5,
+              0.02);
+}
+
+TEST(Statistics, Catalog) {
+  std::vector<Relation> relations;
+  relations.push_back(Utils::createRelation(100, 2));
+  relations.push_back(Utils::createRelation(5000, 3));
+  StatisticsCatalog catalog;
+  ASSERT_TRUE(catalog.empty());
+  catalog.build(relations);
+  ASSERT_FALSE(catalog.empty());
+  ASSERT_EQ(catalog.column(0, 1).max, 99u);
+  ASSERT_EQ(catalog.column(1, 2).size, 5000u);
+  ASSERT_TRUE(catalog.column(SelectInfo(1, 0, 2)).unique);
+}
@@ -0,0 +1,93 @@
+#include <atomic>
+#include <chrono>
+#include <ctime>
+#include <thread>
+
+#include "gtest/gtest.h"
+
+#include "thread_pool.h"
+
+TEST(ThreadPool, ParallelFor) {
+  for (unsigned threads : {1u, 4u}) {
+    ThreadPool pool(threads, threads > 1);
+    for (uint64_t size : {0ull, 1ull, 4095ull, 4096ull, 100000ull}) {
+      std::vector<std::atomic<unsigned>> counts(size);
+      pool.parallelFor(size, [&](uint64_t begin, uint64_t end) {
+        ASSERT_LE(end - begin, ThreadPool::kMorselSize);
+        for (auto i = begin; i < end; ++i)
+          ++counts[i];
+      });
+      for (auto &count : counts)
+        ASSERT_EQ(count, 1u);
+    }
+  }
+}
+
+TEST(ThreadPool, NestedJobs) {
+  // One large job among small ones, like a giant query in a batch
+  ThreadPool pool(4);
+  std::vector<uint64_t> sizes{1 << 20, 10, 5000, 1, 70000, 3, 100, 9000};
+  std::vector<uint64_t> sums(sizes.size());
+  pool.parallelFor(sizes.size(), 1, [&](uint64_t job, uint64_t) {
+    std::atomic<uint64_t> sum{0};
+    pool.parallelFor(sizes[job], 1000, [&](uint64_t begin, uint64_t end) {
+      uint64_t local = 0;
+      for (auto i = begin; i < end; ++i)
+        local += i;
+      sum += local;
+    });
+    sums[job] = sum;
+  });
+  for (unsigned job = 0; job < sizes.size(); ++job)
+    ASSERT_EQ(sums[job], sizes[job] * (sizes[job] - 1) / 2) << job;
+}
+
+TEST(ThreadPool, NestedWaitSleeps) {
+  // The caller waits for a nested job whose last morsel sleeps on a worker,
+  // while a shallower job's task is queued that the caller may not take.
+  // The caller has to sleep instead of spinning until the morsel is done.
+  using namespace std::chrono_literals;
+  ThreadPool pool(3);
+  std::atomic<bool> outer_started{false}, nested_started{false},
+      release{false};
+  auto until = [](std::atomic<bool> &flag) {
+    while (!flag)
+      std::this_thread::sleep_for(1ms);
+  };
+  std::thread other;
+  double wait_cpu_ms = 0;
+  pool.parallelFor(2, 1, [&](uint64_t outer, uint64_t) {
+    if (outer == 1) {
+      // Keeps a worker busy until the end
+      outer_started = true;
+      until(release);
+      return;
+    }
+    until(outer_started);
+    timespec start{}, end{};
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &start);
+    pool.parallelFor(2, 1, [&](uint64_t nested, uint64_t) {
+      if (nested == 1) {
+        // The other worker
+        nested_started = true;
+        std::this_thread::sleep_for(300ms);
+        release = true;
+        return;
+      }
+      until(nested_started);
+      // A job of another thread outside of any job queues a task
+      other = std::thread([&] {
+        pool.parallelFor(2, 1, [&](uint64_t i, uint64_t) {
+          if (i == 0)
+            until(release);
+        });
+      });
+    });
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &end);
+    wait_cpu_ms = (end.tv_sec - start.tv_sec) * 1e3
+        + (end.tv_nsec - start.tv_nsec) / 1e6;
+  });
+  other.join();
+  ASSERT_TRUE(release);
+  ASSERT_LT(wait_cpu_ms, 100);
+}
@@ -0,0 +1,63 @@
+#include "test_utils.h"
+
+#include <functional>
+
+#include "gtest/gtest.h"
+
+#include "utils.h"
+
+// Create a relation whose columns hold few distinct values
+Relation TestUtils::createRelation(uint64_t size,
+                                   unsigned seed,
+                                   unsigned num_columns) {
+  auto relation = Utils::createRelation(size, num_columns);
+  for (unsigned c = 0; c < num_columns; ++c) {
+    for (uint64_t t = 0; t < size; ++t)
+      relation.columns()[c][t] = (t * (2 * c + seed + 3)) % (100 * (c + 1));
+  }
+  return relation;
+}
+
+// Compare a plan with collapsed inputs with the plan without
+void TestUtils::checkCollapsedPlan(std::unique_ptr<Operator> expected_plan,
+                                   std::unique_ptr<Operator> plan,
+                                   const std::vector<SelectInfo> &selections,
+                                   bool pipelined) {
+  ASSERT_FALSE(plan->countColumns().empty());
+  Checksum expected(std::move(expected_plan), selections, pipelined);
+  expected.run();
+  Checksum checksum(std::move(plan), selections, pipelined);
+  checksum.run();
+  ASSERT_GT(expected.result_size(), 0u);
+  ASSERT_EQ(checksum.result_size(), expected.result_size());
+  ASSERT_EQ(checksum.check_sums(), expected.check_sums());
+}
+
+// Compare the plan of a query with collapsed inputs with the plan without
+uint64_t TestUtils::checkCollapsedQuery(
+    const Joiner &joiner,
+    QueryInfo &query,
+    const PlanNode *(Joiner::*input)(const PlanNode &, QueryInfo &) const) {
+  auto plan = joiner.plan(query);
+  uint64_t joins = 0;
+  std::function<void(const PlanNode &)> visit = [&](const PlanNode &node) {
+    if (node.isLeaf())
+      return;
+    joins += (joiner.*input)(node, query) != nullptr;
+    visit(*node.left);
+    visit(*node.right);
+  };
+  visit(*plan);
+
+  for (bool pipelined : {false, true}) {
+    Checksum expected(joiner.addPlan(*plan, query), query.selections(),
+                      pipelined);
+    expected.run();
+    Checksum checksum(joiner.addPlan(*plan, query, nullptr, nullptr, true),
+                      query.selections(), pipelined);
+    checksum.run();
+    EXPECT_EQ(checksum.result_size(), expected.result_size());
+    EXPECT_EQ(checksum.check_sums(), expected.check_sums());
+  }
+  return joins;
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "joiner.h"
+#include "operators.h"
+#include "relation.h"
+
+class TestUtils {
+ public:
+  /// Create a relation whose columns hold few distinct values: column c
+  /// repeats every value about size / (100 * (c + 1)) times, thus joins on
+  /// it are many-to-many and miss some tuples. Relations with other seeds
+  /// share only some of the values.
+  static Relation createRelation(uint64_t size,
+                                 unsigned seed,
+                                 unsigned num_columns = 3);
+  /// Assert that a plan with collapsed inputs (count columns) produces the
+  /// non-empty result of the plan without
+  static void checkCollapsedPlan(std::unique_ptr<Operator> expected_plan,
+                                 std::unique_ptr<Operator> plan,
+                                 const std::vector<SelectInfo> &selections,
+                                 bool pipelined);
+  /// Assert that the plan of a query with collapsed inputs produces the
+  /// result of the plan without, and return the joins of the plan for which
+  /// input picks an input to collapse
+  static uint64_t checkCollapsedQuery(
+      const Joiner &joiner,
+      QueryInfo &query,
+      const PlanNode *(Joiner::*input)(const PlanNode &, QueryInfo &) const);
+};
@@ -0,0 +1,181 @@
+#include <algorithm>
+#include <set>
+
+#include "gtest/gtest.h"
+
+#include "joiner.h"
+#include "parser.h"
+#include "reference_joiner.h"
+#include "workload_generator.h"
+
+TEST(WorkloadGenerator, Zipf) {
+  ZipfDistribution zipf(1000, 1.0);
+  std::mt19937_64 rng(7);
+  std::vector<uint64_t> counts(1001);
+  unsigned draws = 200000;
+  for (unsigned i = 0; i < draws; ++i) {
+    auto rank = zipf(rng);
+    ASSERT_GE(rank, 1u);
+    ASSERT_LE(rank, 1000u);
+    ++counts[rank];
+  }
+  // P(1) = 1 / H(1000) ~ 0.134, P(2) = P(1) / 2
+  ASSERT_NEAR(counts[1] / double(draws), 0.134, 0.01);
+  ASSERT_NEAR(counts[2] / double(counts[1]), 0.5, 0.05);
+  ASSERT_GT(counts[10], counts[100]);
+}
+
+TEST(WorkloadGenerator, Relations) {
+  using Distribution = WorkloadGenerator::Distribution;
+  for (auto distribution : {Distribution::Uniform, Distribution::Zipf,
+                            Distribution::ForeignKey}) {
+    WorkloadGenerator::Config config;
+    config.scale = 0.05;
+    config.num_relations = 4;
+    config.distribution = distribution;
+    WorkloadGenerator generator(config);
+
+    std::vector<Relation> relations;
+    for (unsigned i = 0; i < config.num_relations; ++i)
+      relations.push_back(generator.relation(i));
+    std::set<uint64_t> smallest_keys;
+    auto smallest = std::min_element(relations.begin(), relations.end(),
+                                     [](auto &a, auto &b) {
+                                       return a.size() < b.size();
+                                     });
+    smallest_keys.insert(smallest->columns()[0],
+                         smallest->columns()[0] + smallest->size());
+    // Every key of the smallest relation is a key of the others
+    for (auto &relation : relations) {
+      ASSERT_EQ(relation.columns().size(), generator.numColumns());
+      std::set<uint64_t> keys(relation.columns()[0],
+                              relation.columns()[0] + relation.size());
+      ASSERT_EQ(keys.size(), relation.size());
+      ASSERT_TRUE(std::includes(keys.begin(), keys.end(),
+                                smallest_keys.begin(), smallest_keys.end()));
+      if (distribution == Distribution::ForeignKey) {
+        for (uint64_t i = 0; i < relation.size(); ++i)
+          ASSERT_TRUE(smallest_keys.count(relation.columns()[1][i]));
+      }
+    }
+  }
+}
+
+TEST(WorkloadGenerator, Queries) {
+  using Shape = WorkloadGenerator::Shape;
+  // The number of join predicates of a graph on four relations
+  std::vector<std::pair<Shape, unsigned>> shapes{
+      {Shape::Chain, 3}, {Shape::Star, 3}, {Shape::Cycle, 4},
+      {Shape::Clique, 6}};
+  for (auto &shape : shapes) {
+    WorkloadGenerator::Config config;
+    config.scale = 0.02;
+    config.num_relations = 5;
+    config.shapes = {shape.first};
+    config.min_joined = config.max_joined = 4;
+    config.num_queries = 10;
+    config.batch_size = 4;
+    WorkloadGenerator generator(config);
+    Joiner joiner;
+    for (unsigned i = 0; i < config.num_relations; ++i)
+      joiner.addRelation(generator.relation(i));
+    joiner.buildStatistics();
+
+    auto lines = generator.queries();
+    ASSERT_EQ(std::count(lines.begin(), lines.end(), "F"), 3);
+    ASSERT_EQ(lines.back(), "F");
+    for (auto &line : lines) {
+      if (line == "F") continue;
+      QueryInfo query(line);
+      ASSERT_EQ(query.relation_ids().size(), 4u);
+      ASSERT_EQ(query.predicates().size(), shape.second) << line;
+      ASSERT_FALSE(joiner.join(query).empty());
+    }
+  }
+}
+
+TEST(WorkloadGenerator, Results) {
+  using Distribution = WorkloadGenerator::Distribution;
+  for (auto distribution : {Distribution::Uniform, Distribution::Zipf,
+                            Distribution::ForeignKey}) {
+    WorkloadGenerator::Config config;
+    config.scale = 0.02;
+    config.num_relations = 5;
+    config.distribution = distribution;
+    config.num_queries = 30;
+    WorkloadGenerator generator(config);
+    Joiner joiner;
+    for (unsigned i = 0; i < config.num_relations; ++i)
+      joiner.addRelation(generator.relation(i));
+    auto lines = generator.queries();
+
+    // The expected results of the generator, then the engine prepared like
+    // the driver prepares it
+    ReferenceJoiner reference(joiner.relations());
+    std::vector<std::string> expected;
+    unsigned non_empty = 0;
+    for (auto &line : lines) {
+      if (line == "F") continue;
+      expected.push_back(reference.join(QueryInfo(line)));
+      non_empty += expected.back().find("NULL") == std::string::npos;
+    }
+    ASSERT_GT(non_empty, 0u);
+    joiner.buildStatistics();
+    joiner.buildSortedIndexes();
+    joiner.buildHashIndexes();
+    joiner.compressColumns();
+    unsigned q = 0;
+    for (auto &line : lines) {
+      if (line == "F") continue;
+      QueryInfo query(line);
+      ASSERT_EQ(joiner.join(query), expected[q++]) << line;
+    }
+  }
+}
+
+TEST(WorkloadGenerator, Selectivity) {
+  using Distribution = WorkloadGenerator::Distribution;
+  for (auto distribution : {Distribution::Uniform, Distribution::Zipf}) {
+    for (double selectivity : {0.01, 0.1, 0.3}) {
+      WorkloadGenerator::Config config;
+      config.scale = 0.1;
+      config.num_relations = 3;
+      config.distribution = distribution;
+      config.num_queries = 40;
+      config.filter_probability = 1;
+      config.selectivity = selectivity;
+      WorkloadGenerator generator(config);
+      std::vector<Relation> relations;
+      for (unsigned i = 0; i < config.num_relations; ++i)
+        relations.push_back(generator.relation(i));
+
+      // The fraction of the tuples that each range filter selects
+      unsigned ranges = 0;
+      for (auto &line : generator.queries()) {
+        if (line == "F") continue;
+        QueryInfo query(line);
+        for (auto &filter : query.filters()) {
+          auto &relation = relations[filter.filter_column.rel_id];
+          auto column = relation.columns()[filter.filter_column.col_id];
+          uint64_t selected = 0;
+          for (uint64_t t = 0; t < relation.size(); ++t) {
+            selected += filter.comparison == FilterInfo::Comparison::Less
+                ? column[t] < filter.constant
+                : filter.comparison == FilterInfo::Comparison::Greater
+                    ? column[t] > filter.constant
+                    : column[t] == filter.constant;
+          }
+          auto fraction = selected / double(relation.size());
+          if (filter.comparison == FilterInfo::Comparison::Equal) {
+            ASSERT_LT(fraction, selectivity + 0.02) << line;
+            continue;
+          }
+          ++ranges;
+          ASSERT_NEAR(fraction, selectivity, 0.02 + selectivity * 0.2)
+              << line;
+        }
+      }
+      ASSERT_GT(ranges, 0u);
+    }
+  }
+}
@@ -0,0 +1,67 @@
+#include "gtest/gtest.h"
+
+#include "operators.h"
+#include "zone_map.h"
+
+TEST(ZoneMap, Match) {
+  std::vector<uint64_t> column;
+  for (uint64_t i = 0; i < 2 * ZoneMap::kBlockSize + 10; ++i)
+    column.push_back(i);
+  ZoneMap zone_map;
+  zone_map.build(column.data(), column.size());
+  ASSERT_EQ(zone_map.num_blocks(), 3u);
+  ASSERT_EQ(zone_map.zone(1).min, ZoneMap::kBlockSize);
+  ASSERT_EQ(zone_map.zone(2).max, column.back());
+
+  using Match = ZoneMap::Match;
+  ASSERT_EQ(zone_map.match(0, 0, ZoneMap::kBlockSize), Match::All);
+  ASSERT_EQ(zone_map.match(0, 10, 20), Match::Some);
+  ASSERT_EQ(zone_map.match(1, 0, 10), Match::None);
+  ASSERT_EQ(zone_map.match(2, 1, 0), Match::None);
+}
+
+TEST(ZoneMap, FilterScan) {
+  // Column 0 is sorted, column 1 cycles through 0..99
+  uint64_t size = 10 * ZoneMap::kBlockSize + 123;
+  std::vector<uint64_t *> columns{new uint64_t[size], new uint64_t[size]};
+  for (uint64_t i = 0; i < size; ++i) {
+    columns[0][i] = i;
+    columns[1][i] = i % 100;
+  }
+  Relation relation(size, std::move(columns));
+
+  using Comparison = FilterInfo::Comparison;
+  std::vector<std::vector<FilterInfo>> queries{
+      // Some blocks are skipped, the others are accepted entirely
+      {FilterInfo(SelectInfo(0, 0, 0), 3 * ZoneMap::kBlockSize,
+                  Comparison::Less)},
+      {FilterInfo(SelectInfo(0, 0, 0), 5000, Comparison::Greater),
+       FilterInfo(SelectInfo(0, 0, 1), 7, Comparison::Equal)},
+      {FilterInfo(SelectInfo(0, 0, 1), 100, Comparison::Less),
+       FilterInfo(SelectInfo(0, 0, 0), 2 * ZoneMap::kBlockSize + 7,
+                  Comparison::Equal)},
+      {FilterInfo(SelectInfo(0, 0, 0), size, Comparison::Greater)},
+  };
+  for (auto &filters : queries) {
+    std::vector<uint64_t> expected;
+    for (uint64_t i = 0; i < size; ++i) {
+      bool pass = true;
+      for (auto &filter : filters) {
+        auto value = relation.columns()[filter.filter_column.col_id][i];
+        pass &= filter.comparison == Comparison::Less
+                ? value < filter.constant
+                : filter.comparison == Comparison::Greater
+                  ? value > filter.constant : value == filter.constant;
+      }
+      if (pass)
+        expected.push_back(i);
+    }
+
+    FilterScan scan(relation, filters);
+    scan.run();
+    ASSERT_EQ(scan.result_size(), expected.size());
+    auto &row_ids = scan.rowIds(0);
+    for (uint64_t i = 0; i < expected.size(); ++i)
+      ASSERT_EQ(row_ids.rowId(i), expected[i]);
+  }
+}